@@ -64,6 +64,10 @@ public:
     }
 
   void load_addins_for_note(const Note::Ptr &);
+  bool note_addins_loaded(const Note::Ptr & note) const
+    {
+      return m_note_addins.find(note) != m_note_addins.end();
+    }
   ApplicationAddin *get_application_addin(const std::string & id) const;
   sync::SyncServiceAddin *get_sync_service_addin(const std::string & id) const;
   void get_preference_tab_addins(std::list<PreferenceTabAddin *> &) const;
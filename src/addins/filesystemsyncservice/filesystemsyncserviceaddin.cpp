@@ -22,11 +22,13 @@
 #include <stdexcept>
 
 #include <glibmm/i18n.h>
+#include <glibmm/miscutils.h>
 #include <gtkmm/label.h>
 #include <gtkmm/table.h>
 
 #include "debug.hpp"
 #include "filesystemsyncserviceaddin.hpp"
+#include "ignote.hpp"
 #include "preferences.hpp"
 #include "sharp/directory.hpp"
 #include "sharp/files.hpp"
@@ -71,7 +73,14 @@ gnote::sync::SyncServer::Ptr FileSystemSyncServiceAddin::create_sync_server()
       sharp::directory_create(m_path);
     }
 
-    server = gnote::sync::FileSystemSyncServer::create(m_path);
+    if(gnote::Preferences::obj().get_schema_settings(
+         gnote::Preferences::SCHEMA_SYNC)->get_boolean(gnote::Preferences::SYNC_DELTA_REVISIONS)) {
+      server = gnote::sync::FileSystemSyncServer::create(
+        m_path, Glib::build_filename(gnote::IGnote::cache_dir(), "sync"));
+    }
+    else {
+      server = gnote::sync::FileSystemSyncServer::create(m_path);
+    }
   }
   else {
     throw std::logic_error("FileSystemSyncServiceAddin.create_sync_server() called without being configured");
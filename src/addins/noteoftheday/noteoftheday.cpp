@@ -62,7 +62,7 @@ gnote::NoteBase::Ptr NoteOfTheDay::create(gnote::NoteManager & manager,
 void NoteOfTheDay::cleanup_old(gnote::NoteManager & manager)
 {
   gnote::NoteBase::List kill_list;
-  const gnote::NoteBase::List & notes = manager.get_notes();
+  const gnote::NoteCollection & notes = manager.get_notes();
 
   Glib::Date date;
   date.set_time_current(); // time set to 00:00:00
@@ -123,7 +123,7 @@ gnote::NoteBase::Ptr NoteOfTheDay::get_note_by_date(
                                  gnote::NoteManager & manager,
                                  const Glib::Date & date)
 {
-  const gnote::NoteBase::List & notes = manager.get_notes();
+  const gnote::NoteCollection & notes = manager.get_notes();
 
   FOREACH(gnote::NoteBase::Ptr note, notes) {
     const Glib::ustring & title = note->get_title();
@@ -48,6 +48,12 @@ namespace {
         return is_template_note(note);
       }
 
+    virtual gnote::NoteBitmap get_notes(bool = false) override
+      {
+        gnote::Tag::Ptr tag = template_tag();
+        return tag ? tag->notes() : gnote::NoteBitmap();
+      }
+
     virtual bool add_note(const Note::Ptr &) override
       {
         return false;
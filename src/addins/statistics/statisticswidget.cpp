@@ -24,7 +24,6 @@
 #include <gtkmm/treestore.h>
 
 #include "debug.hpp"
-#include "itagmanager.hpp"
 #include "statisticswidget.hpp"
 #include "notebooks/notebookmanager.hpp"
 
@@ -85,7 +84,7 @@ private:
   void build_stats()
     {
       clear();
-      gnote::NoteBase::List notes = m_note_manager.get_notes();
+      const gnote::NoteCollection & notes = m_note_manager.get_notes();
 
       Gtk::TreeIter iter = append();
       std::string stat = _("Total Notes:");
@@ -98,28 +97,11 @@ private:
       iter->set_value(0, stat);
       iter->set_value(1, TO_STRING(notebooks->children().size()));
 
-      Gtk::TreeIter notebook = notebooks->children().begin();
-      std::map<gnote::notebooks::Notebook::Ptr, int> notebook_notes;
-      while(notebook) {
+      std::map<std::string, int> notebook_stats;
+      for(Gtk::TreeIter notebook = notebooks->children().begin(); notebook; ++notebook) {
         gnote::notebooks::Notebook::Ptr nbook;
         notebook->get_value(0, nbook);
-        notebook_notes[nbook] = 0;
-        ++notebook;
-      }
-      gnote::Tag::Ptr template_tag = gnote::ITagManager::obj().get_or_create_system_tag(
-        gnote::ITagManager::TEMPLATE_NOTE_SYSTEM_TAG);
-      FOREACH(gnote::NoteBase::Ptr note, notes) {
-        for(std::map<gnote::notebooks::Notebook::Ptr, int>::iterator nb = notebook_notes.begin();
-            nb != notebook_notes.end(); ++nb) {
-          if(note->contains_tag(nb->first->get_tag()) && !note->contains_tag(template_tag)) {
-            ++nb->second;
-          }
-        }
-      }
-      std::map<std::string, int> notebook_stats;
-      for(std::map<gnote::notebooks::Notebook::Ptr, int>::iterator nb = notebook_notes.begin();
-          nb != notebook_notes.end(); ++nb) {
-        notebook_stats[nb->first->get_name()] = nb->second;
+        notebook_stats[nbook->get_name()] = nbook->get_notes().count();
       }
       for(std::map<std::string, int>::iterator nb = notebook_stats.begin(); nb != notebook_stats.end(); ++nb) {
         Gtk::TreeIter nb_stat = append(iter->children());
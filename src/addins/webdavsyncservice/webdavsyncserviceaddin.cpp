@@ -1,7 +1,7 @@
 /*
  * gnote
  *
- * Copyright (C) 2012-2013 Aurimas Cernius
+ * Copyright (C) 2012-2014 Aurimas Cernius
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -18,6 +18,10 @@
  */
 
 
+#include <config.h>
+
+#include <stdexcept>
+
 #include <boost/format.hpp>
 #include <glibmm/i18n.h>
 
@@ -28,6 +32,9 @@
 #include "gnome_keyring/ring.hpp"
 #include "sharp/string.hpp"
 #include "synchronization/isyncmanager.hpp"
+#ifdef HAVE_LIBSOUP
+#include "synchronization/webdavsyncserver.hpp"
+#endif
 
 
 using gnome::keyring::KeyringException;
@@ -54,6 +61,33 @@ WebDavSyncServiceAddin * WebDavSyncServiceAddin::create()
   return new WebDavSyncServiceAddin;
 }
 
+WebDavSyncServiceAddin::WebDavSyncServiceAddin()
+  : m_url_entry(NULL)
+  , m_username_entry(NULL)
+  , m_password_entry(NULL)
+  , m_initialized(false)
+{
+}
+
+gnote::sync::SyncServer::Ptr WebDavSyncServiceAddin::create_sync_server()
+{
+  std::string url, username, password;
+  if(!get_config_settings(url, username, password)) {
+    throw std::logic_error("create_sync_server called without being configured");
+  }
+
+#ifdef HAVE_LIBSOUP
+  return gnote::sync::WebDavSyncServer::create(url, username, password, accept_ssl_cert());
+#else
+  throw std::logic_error("create_sync_server called, but gnote is built without libsoup");
+#endif
+}
+
+void WebDavSyncServiceAddin::post_sync_cleanup()
+{
+  // Nothing mounted, connections are closed with the server
+}
+
 Gtk::Widget *WebDavSyncServiceAddin::create_preferences_control(EventHandler requiredPrefChanged)
 {
   Gtk::Table *table = new Gtk::Table(3, 2, false);
@@ -112,105 +146,59 @@ std::string WebDavSyncServiceAddin::id()
   return "wdfs";
 }
 
-std::string WebDavSyncServiceAddin::fuse_mount_directory_error()
-{
-  const char *res = _("There was an error connecting to the server.  This may be caused by using an incorrect user name and/or password.");
-  return res;
-}
-
-std::vector<std::string> WebDavSyncServiceAddin::get_fuse_mount_exe_args(const std::string & mountPath, bool fromStoredValues)
+bool WebDavSyncServiceAddin::save_configuration()
 {
   std::string url, username, password;
-  if(fromStoredValues) {
-    get_config_settings(url, username, password);
-  }
-  else {
-    get_pref_widget_settings(url, username, password);
-  }
-  
-  return get_fuse_mount_exe_args(mountPath, url, username, password, accept_ssl_cert());
-}
 
-std::string WebDavSyncServiceAddin::get_fuse_mount_exe_args_for_display(const std::string & mountPath, bool fromStoredValues)
-{
-  /*std::string url, username, password;
-  if(fromStoredValues) {
-    get_config_settings(url, username, password);
-  }
-  else {
-    get_pref_widget_settings(url, username, password);
-  }
-  
-  // Mask password
-  std::string acceptSsl;
-  if(accept_ssl_cert()) {
-    acceptSsl = "-ac";
+  if(!get_pref_widget_settings(url, username, password)) {
+    // TODO: Figure out a way to send the error back to the client
+    DBG_OUT("One of url, username, or password was empty");
+    throw gnote::sync::GnoteSyncException(_("URL, username, or password field is empty."));
   }
 
-  return str(boost::format("%1% -a %2% -u %3% -p %4% %5% -o fsname=gnotewdfs")
-             % mountPath % url % username % password % acceptSsl);*/
-  std::vector<std::string> args = get_fuse_mount_exe_args(mountPath, fromStoredValues);
-  std::string result;
-  for(std::vector<std::string>::iterator iter = args.begin(); iter != args.end(); ++iter) {
-    result += *iter + " ";
+#ifdef HAVE_LIBSOUP
+  // Connect to the server to make sure the settings work
+  try {
+    gnote::sync::WebDavSyncServer::create(url, username, password, accept_ssl_cert())->latest_revision();
+  }
+  catch(const std::exception & e) {
+    DBG_OUT("Connecting to WebDAV server failed: %s", e.what());
+    throw gnote::sync::GnoteSyncException(_("There was an error connecting to the server.  This may be caused by using an incorrect user name and/or password."));
   }
+#endif
 
-  return result;
+  save_config_settings(url, username, password);
+  return true;
 }
 
-std::string WebDavSyncServiceAddin::fuse_mount_exe_name()
+void WebDavSyncServiceAddin::reset_configuration()
 {
-  return "wdfs";
+  save_config_settings("", "", "");
 }
 
-bool WebDavSyncServiceAddin::verify_configuration()
+bool WebDavSyncServiceAddin::is_supported()
 {
-  std::string url, username, password;
-
-  if(!get_pref_widget_settings(url, username, password)) {
-    // TODO: Figure out a way to send the error back to the client
-    DBG_OUT("One of url, username, or password was empty");
-    throw gnote::sync::GnoteSyncException(_("URL, username, or password field is empty."));
-  }
-
+#ifdef HAVE_LIBSOUP
   return true;
+#else
+  // Server is only accessed using libsoup
+  return false;
+#endif
 }
 
-void WebDavSyncServiceAddin::save_configuration_values()
+void WebDavSyncServiceAddin::initialize()
 {
-  std::string url, username, password;
-  get_pref_widget_settings(url, username, password);
-
-  save_config_settings(url, username, password);
+  m_initialized = true;
 }
 
-void WebDavSyncServiceAddin::reset_configuration_values()
+void WebDavSyncServiceAddin::shutdown()
 {
-  save_config_settings("", "", "");
-
-  // TODO: Unmount the FUSE mount!
+  m_initialized = false;
 }
 
-std::vector<std::string> WebDavSyncServiceAddin::get_fuse_mount_exe_args(const std::string & mountPath, const std::string & url,
-    const std::string & username, const std::string & password, bool acceptSsl)
+bool WebDavSyncServiceAddin::initialized()
 {
-  std::vector<std::string> args;
-  args.reserve(12);
-  args.push_back(url);
-  args.push_back(mountPath);
-  args.push_back("-o");
-  args.push_back("username=" + username);
-  args.push_back("-o");
-  args.push_back("password=" + password);
-  args.push_back("-o");
-  args.push_back("fsname=gnotewdfs");
-  if(acceptSsl) {
-    args.push_back("-o");
-    args.push_back("accept_sslcert");
-  }
-  args.push_back("-o");
-  args.push_back("fsname=gnotewdfs");
-  return args;
+  return m_initialized;
 }
 
 bool WebDavSyncServiceAddin::get_config_settings(std::string & url, std::string & username, std::string & password)
@@ -1,7 +1,7 @@
 /*
  * gnote
  *
- * Copyright (C) 2012-2013 Aurimas Cernius
+ * Copyright (C) 2012-2014 Aurimas Cernius
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -27,7 +27,7 @@
 
 #include "base/macros.hpp"
 #include "sharp/dynamicmodule.hpp"
-#include "synchronization/fusesyncserviceaddin.hpp"
+#include "synchronization/syncserviceaddin.hpp"
 
 
 namespace webdavsyncserviceaddin {
@@ -44,11 +44,14 @@ DECLARE_MODULE(WebDavSyncServiceModule)
 
 
 class WebDavSyncServiceAddin
-  : public gnote::sync::FuseSyncServiceAddin
+  : public gnote::sync::SyncServiceAddin
 {
 public:
   static WebDavSyncServiceAddin * create();
 
+  virtual gnote::sync::SyncServer::Ptr create_sync_server() override;
+  virtual void post_sync_cleanup() override;
+
   /// <summary>
   /// Creates a Gtk.Widget that's used to configure the service.  This
   /// will be used in the Synchronization Preferences.  Preferences should
@@ -78,21 +81,21 @@ public:
   /// </summary>
   virtual std::string id() override;
 
-  virtual std::string fuse_mount_directory_error() override;
-protected:
-  virtual std::vector<std::string> get_fuse_mount_exe_args(const std::string & mountPath, bool fromStoredValues) override;
-  virtual std::string get_fuse_mount_exe_args_for_display(const std::string & mountPath, bool fromStoredValues) override;
-  virtual std::string fuse_mount_exe_name() override;
-  virtual bool verify_configuration() override;
-  virtual void save_configuration_values() override;
+  /// <summary>
+  /// Verifies the settings by connecting to the server and saves them.
+  /// </summary>
+  virtual bool save_configuration() override;
 
   /// <summary>
   /// Reset the configuration so that IsConfigured will return false.
   /// </summary>
-  virtual void reset_configuration_values() override;
+  virtual void reset_configuration() override;
+  virtual bool is_supported() override;
+  virtual void initialize() override;
+  virtual void shutdown() override;
+  virtual bool initialized() override;
 private:
-  std::vector<std::string> get_fuse_mount_exe_args(const std::string & mountPath, const std::string & url,
-      const std::string & username, const std::string & password, bool acceptSsl);
+  WebDavSyncServiceAddin();
   bool get_config_settings(std::string & url, std::string & username, std::string & password);
   void save_config_settings(const std::string & url, const std::string & username, const std::string & password);
   bool get_pref_widget_settings(std::string & url, std::string & username, std::string & password);
@@ -102,6 +105,7 @@ private:
   Gtk::Entry *m_url_entry;
   Gtk::Entry *m_username_entry;
   Gtk::Entry *m_password_entry;
+  bool m_initialized;
 
   static const char *KEYRING_ITEM_NAME;
   static std::map<std::string, std::string> s_request_attributes;
@@ -31,11 +31,15 @@
 
 #if __cplusplus < 201103L
   #include <tr1/memory>
+  #include <tr1/unordered_map>
+  #include <tr1/unordered_set>
   #include <boost/foreach.hpp>
   #include <boost/lexical_cast.hpp>
 #else
   #include <memory>
   #include <string>
+  #include <unordered_map>
+  #include <unordered_set>
 #endif
 
 #if __GNUC__
@@ -58,6 +62,9 @@
   using std::tr1::enable_shared_from_this;
   using std::tr1::dynamic_pointer_cast;
   using std::tr1::static_pointer_cast;
+  using std::tr1::unordered_map;
+  using std::tr1::unordered_multimap;
+  using std::tr1::unordered_set;
 #else
   #define FOREACH(var, container) for(var : container)
   #define TO_STRING(x) std::to_string(x)
@@ -68,6 +75,9 @@
   using std::enable_shared_from_this;
   using std::dynamic_pointer_cast;
   using std::static_pointer_cast;
+  using std::unordered_map;
+  using std::unordered_multimap;
+  using std::unordered_set;
 #endif
 
 #endif
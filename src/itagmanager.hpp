@@ -36,6 +36,7 @@ public:
 
   virtual ~ITagManager();
 
+  // Tags can be looked up and created from any thread
   virtual Tag::Ptr get_tag(const std::string & tag_name) const = 0;
   virtual Tag::Ptr get_or_create_tag(const std::string &) = 0;
   virtual Tag::Ptr get_system_tag(const std::string & tag_name) const = 0;
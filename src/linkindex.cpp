@@ -0,0 +1,179 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "linkindex.hpp"
+#include "notemanagerbase.hpp"
+#include "utils.hpp"
+
+
+namespace gnote {
+
+namespace {
+
+const std::string LINK_START = "<link:internal>";
+const std::string LINK_END = "</link:internal>";
+
+}
+
+
+void LinkIndex::get_links(const Glib::ustring & note_xml, Links & links)
+{
+  const std::string & xml = note_xml.raw();
+  std::string::size_type pos = xml.find(LINK_START);
+  while(pos != std::string::npos) {
+    std::string::size_type start = pos + LINK_START.size();
+    std::string::size_type end = xml.find(LINK_END, start);
+    if(end == std::string::npos) {
+      break;
+    }
+    links.insert(xml.substr(start, end - start));
+    pos = xml.find(LINK_START, end + LINK_END.size());
+  }
+}
+
+
+LinkIndex::LinkIndex(NoteManagerBase & manager)
+  : m_manager(manager)
+  , m_built(false)
+{
+  m_manager.signal_note_added.connect(sigc::mem_fun(*this, &LinkIndex::on_note_added));
+  m_manager.signal_note_deleted.connect(sigc::mem_fun(*this, &LinkIndex::on_note_deleted));
+  m_manager.signal_note_saved.connect(sigc::mem_fun(*this, &LinkIndex::on_note_saved));
+}
+
+
+NoteBase::List LinkIndex::get_notes_linking_to(const Glib::ustring & title)
+{
+  if(!m_built) {
+    build();
+  }
+  else {
+    update();
+  }
+
+  NoteBase::List result;
+  BacklinkMap::const_iterator backlinks = m_backlinks.find(utils::XmlEncoder::encode(title));
+  if(backlinks == m_backlinks.end()) {
+    return result;
+  }
+  FOREACH(const std::string & uri, backlinks->second) {
+    NoteBase::Ptr note = m_manager.find_by_uri(uri);
+    if(note && note->get_title() != title) {
+      result.push_back(note);
+    }
+  }
+  return result;
+}
+
+
+void LinkIndex::invalidate(const NoteBase::Ptr & note)
+{
+  if(m_built) {
+    m_invalid.insert(note->uri());
+  }
+}
+
+
+void LinkIndex::build()
+{
+  m_links.clear();
+  m_backlinks.clear();
+  m_invalid.clear();
+  FOREACH(const NoteBase::Ptr & note, m_manager.get_notes()) {
+    add_note(note);
+  }
+  m_built = true;
+}
+
+
+void LinkIndex::update()
+{
+  FOREACH(const std::string & uri, m_invalid) {
+    NoteBase::Ptr note = m_manager.find_by_uri(uri);
+    if(note) {
+      add_note(note);
+    }
+    else {
+      remove_note(uri);
+    }
+  }
+  m_invalid.clear();
+}
+
+
+void LinkIndex::add_note(const NoteBase::Ptr & note)
+{
+  remove_note(note->uri());
+
+  Links links;
+  get_links(note->xml_content(), links);
+  if(links.empty()) {
+    return;
+  }
+  FOREACH(const std::string & link, links) {
+    m_backlinks[link].insert(note->uri());
+  }
+  m_links[note->uri()].swap(links);
+}
+
+
+void LinkIndex::remove_note(const std::string & uri)
+{
+  LinkMap::iterator iter = m_links.find(uri);
+  if(iter == m_links.end()) {
+    return;
+  }
+  FOREACH(const std::string & link, iter->second) {
+    BacklinkMap::iterator backlinks = m_backlinks.find(link);
+    if(backlinks != m_backlinks.end()) {
+      backlinks->second.erase(uri);
+      if(backlinks->second.empty()) {
+        m_backlinks.erase(backlinks);
+      }
+    }
+  }
+  m_links.erase(iter);
+}
+
+
+void LinkIndex::on_note_added(const NoteBase::Ptr & note)
+{
+  if(m_built) {
+    add_note(note);
+  }
+}
+
+
+void LinkIndex::on_note_deleted(const NoteBase::Ptr & note)
+{
+  m_invalid.erase(note->uri());
+  remove_note(note->uri());
+}
+
+
+void LinkIndex::on_note_saved(const NoteBase::Ptr & note)
+{
+  if(m_built) {
+    m_invalid.erase(note->uri());
+    add_note(note);
+  }
+}
+
+}
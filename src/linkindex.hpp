@@ -0,0 +1,79 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _LINKINDEX_HPP_
+#define _LINKINDEX_HPP_
+
+#include <set>
+#include <string>
+
+#include <glibmm/ustring.h>
+
+#include "base/macros.hpp"
+#include "notebase.hpp"
+
+
+namespace gnote {
+
+class NoteManagerBase;
+
+
+// Internal links between notes, in both directions.
+// Built on first query, because it needs the text of every note, and
+// then kept up to date using note manager signals. Notes, that were
+// changed but not saved yet, are reindexed on the next query.
+class LinkIndex
+{
+public:
+  // Link targets, as they appear in note XML (encoded titles)
+  typedef std::set<std::string> Links;
+
+  static void get_links(const Glib::ustring & note_xml, Links & links);
+
+  explicit LinkIndex(NoteManagerBase & manager);
+
+  // Notes, that contain a link to the given title
+  NoteBase::List get_notes_linking_to(const Glib::ustring & title);
+  // Note content has changed since it was last indexed
+  void invalidate(const NoteBase::Ptr & note);
+private:
+  typedef unordered_map<std::string, Links> LinkMap;
+  typedef unordered_map<std::string, std::set<std::string> > BacklinkMap;
+
+  void build();
+  void update();
+  void add_note(const NoteBase::Ptr & note);
+  void remove_note(const std::string & uri);
+  void on_note_added(const NoteBase::Ptr & note);
+  void on_note_deleted(const NoteBase::Ptr & note);
+  void on_note_saved(const NoteBase::Ptr & note);
+
+  NoteManagerBase & m_manager;
+  bool m_built;
+  // Note URI -> link targets
+  LinkMap m_links;
+  // Link target -> URIs of linking notes
+  BacklinkMap m_backlinks;
+  unordered_set<std::string> m_invalid;
+};
+
+}
+
+#endif
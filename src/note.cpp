@@ -34,6 +34,7 @@
 
 #include "mainwindow.hpp"
 #include "note.hpp"
+#include "linkindex.hpp"
 #include "notemanager.hpp"
 #include "noterenamedialog.hpp"
 #include "notetag.hpp"
@@ -142,6 +143,7 @@ namespace gnote {
 
   NoteData::NoteData(const std::string & _uri)
     : m_uri(_uri)
+    , m_text_read_failed(false)
     , m_cursor_pos(s_noPosition)
     , m_selection_bound_pos(s_noPosition)
     , m_width(0)
@@ -164,6 +166,48 @@ namespace gnote {
     return (m_width != 0) && (m_height != 0);
   }
 
+  void NoteData::read_text() const
+  {
+    Glib::ustring file = m_text_file;
+    m_text_file.clear();
+    try {
+      sharp::FileStamp stamp;
+      if(sharp::file_stamp(file, stamp) && stamp != m_text_file_stamp) {
+        // Rest of the data is outdated too, text alone would not match it
+        DBG_OUT("Note file %s was changed after the note was loaded, reloading it", file.c_str());
+        const_cast<NoteData*>(this)->reload(file);
+      }
+      else {
+        m_text = NoteArchiver::obj().get_text_from_note_file(file);
+      }
+    }
+    catch(const std::exception & e) {
+      ERR_OUT(_("Failed to read text of note %s: %s"), file.c_str(), e.what());
+      m_text_read_failed = true;
+    }
+  }
+
+  void NoteData::reload(const Glib::ustring & file)
+  {
+    NoteData data(m_uri);
+    NoteArchiver::read(file, data);
+
+    Glib::ustring old_title = m_title;
+    TagMap old_tags;
+    old_tags.swap(m_tags);
+    m_title = data.m_title;
+    m_text = data.m_text;
+    m_create_date = data.m_create_date;
+    m_change_date = data.m_change_date;
+    m_metadata_change_date = data.m_metadata_change_date;
+    m_cursor_pos = data.m_cursor_pos;
+    m_selection_bound_pos = data.m_selection_bound_pos;
+    m_width = data.m_width;
+    m_height = data.m_height;
+    m_tags = data.m_tags;
+    signal_reloaded(old_title, old_tags);
+  }
+
   void NoteDataBufferSynchronizer::set_buffer(const Glib::RefPtr<NoteBuffer> & b)
   {
     m_buffer = b;
@@ -271,6 +315,7 @@ namespace gnote {
 
   Note::~Note()
   {
+    leave_tags();
     delete m_save_timeout;
     delete m_window;
   }
@@ -355,8 +400,14 @@ namespace gnote {
   Note::Ptr Note::load(const std::string & read_file, NoteManager & manager)
   {
     NoteData *data = new NoteData(url_from_path(read_file));
-    NoteArchiver::read(read_file, *data);
-    return create_existing_note(data, read_file, manager);
+    Glib::ustring version;
+    NoteArchiver::read(read_file, *data, version);
+    Note::Ptr note = create_existing_note(data, read_file, manager);
+    if(version != NoteArchiver::CURRENT_VERSION) {
+      // Rewritten in the newest format in background
+      note->queue_save(NO_CHANGE);
+    }
+    return note;
   }
 
   
@@ -372,18 +423,42 @@ namespace gnote {
     if (!m_save_needed)
       return;
 
+    if(!m_data.data().is_text_readable()) {
+      ERR_OUT(_("Not saving note %s, its text could not be read"), file_path().c_str());
+      return;
+    }
+
     DBG_OUT("Saving '%s'...", m_data.data().title().c_str());
 
+    Glib::ustring xml;
     try {
-      NoteArchiver::write(file_path(), m_data.synchronized_data());
+      xml = NoteArchiver::write_string(m_data.synchronized_data());
     } 
     catch (const sharp::Exception & e) {
-      // Probably IOException or UnauthorizedAccessException?
       ERR_OUT(_("Exception while saving note: %s"), e.what());
-      show_io_error_dialog(dynamic_cast<Gtk::Window*>(m_window->host()));
+      show_io_error_dialog(m_window ? dynamic_cast<Gtk::Window*>(m_window->host()) : NULL);
+      return;
     }
 
-    signal_saved(shared_from_this());
+    invalidate_text_content();
+    update_content_hash();
+    // File is written in background, signal_saved is emitted once it is done
+    static_cast<NoteManager&>(manager()).save_scheduler().schedule(
+      file_path(), xml.raw(),
+      sigc::bind(sigc::ptr_fun(&Note::on_save_finished), NoteBase::WeakPtr(shared_from_this())));
+  }
+
+  void Note::on_save_finished(bool success, const NoteBase::WeakPtr & weak_note)
+  {
+    Note::Ptr note = static_pointer_cast<Note>(weak_note.lock());
+    if(!note) {
+      return;
+    }
+    if(!success) {
+      show_io_error_dialog(note->m_window ? dynamic_cast<Gtk::Window*>(note->m_window->host()) : NULL);
+      return;
+    }
+    note->signal_saved(note);
   }
 
   
@@ -461,6 +536,18 @@ namespace gnote {
     if (!m_is_deleting)
       m_save_needed = true;
     set_change_type(changeType);
+    if(changeType != NO_CHANGE) {
+      manager().link_index().invalidate(shared_from_this());
+    }
+  }
+
+  void Note::rewrite()
+  {
+    if(m_save_needed || m_is_deleting) {
+      return;
+    }
+    m_save_needed = true;
+    on_save_timeout();
   }
 
   void Note::on_save_timeout()
@@ -501,6 +588,7 @@ namespace gnote {
     tag.remove_note(*this);
 
     signal_tag_removed(shared_from_this(), tag_name);
+    manager().signal_note_tag_removed(shared_from_this(), tag_name);
 
     DBG_OUT("Tag removed, queueing save");
     queue_save(OTHER_DATA_CHANGED);
@@ -684,8 +772,9 @@ namespace gnote {
 
   Glib::ustring Note::text_content()
   {
+    // Avoid creating buffer for notes that are not open
     if(!m_buffer) {
-      get_buffer();
+      return NoteBase::text_content();
     }
     return m_buffer->get_slice(m_buffer->begin(), m_buffer->end());
   }
@@ -728,6 +817,9 @@ namespace gnote {
         sigc::mem_fun(*this, &Note::on_buffer_mark_set));
       m_mark_deleted_conn = m_buffer->signal_mark_deleted().connect(
         sigc::mem_fun(*this, &Note::on_buffer_mark_deleted));
+
+      // Notes are loaded without addins, they are only needed once note is used
+      static_cast<NoteManager&>(manager()).load_note_addins(static_pointer_cast<Note>(shared_from_this()));
     }
     return m_buffer;
   }
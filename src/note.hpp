@@ -109,6 +109,8 @@ public:
   static Note::Ptr load(const std::string &, NoteManager &);
   virtual void save() override;
   virtual void queue_save(ChangeType c) override;
+  // Save in the current file format, unless a save is already queued
+  void rewrite();
   using NoteBase::remove_tag;
   virtual void remove_tag(Tag &) override;
   void add_child_widget(const Glib::RefPtr<Gtk::TextChildAnchor> & child_anchor,
@@ -118,7 +120,7 @@ public:
   virtual void set_title(const Glib::ustring & new_title, bool from_user_action) override;
   virtual void rename_without_link_update(const Glib::ustring & newTitle) override;
   virtual void set_xml_content(const Glib::ustring & xml) override;
-  Glib::ustring text_content();
+  virtual Glib::ustring text_content() override;
   void set_text_content(const std::string & text);
 
   const Glib::RefPtr<NoteTagTable> & get_tag_table();
@@ -173,6 +175,8 @@ private:
   void on_buffer_mark_deleted(const Glib::RefPtr<Gtk::TextBuffer::Mark> & mark);
   bool on_window_destroyed(GdkEventAny *ev);
   void on_save_timeout();
+  // Note can be gone by the time its write finishes
+  static void on_save_finished(bool success, const NoteBase::WeakPtr & weak_note);
   void process_child_widget_queue();
   void process_rename_link_update(const std::string & old_title);
   void process_rename_link_update_end(int response, Gtk::Dialog *dialog,
@@ -19,8 +19,15 @@
  */
 
 
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
 #include <boost/format.hpp>
+#include <glibmm/checksum.h>
+#include <glibmm/fileutils.h>
 #include <glibmm/i18n.h>
+#include <glibmm/threads.h>
 
 #include "config.h"
 #include "debug.hpp"
@@ -46,6 +53,436 @@
 
 namespace gnote {
 
+namespace {
+
+bool decode_entity(const std::string & entity, std::string & result)
+{
+  if(entity == "amp") {
+    result += '&';
+  }
+  else if(entity == "lt") {
+    result += '<';
+  }
+  else if(entity == "gt") {
+    result += '>';
+  }
+  else if(entity == "quot") {
+    result += '"';
+  }
+  else if(entity == "apos") {
+    result += '\'';
+  }
+  else if(entity.size() > 1 && entity[0] == '#') {
+    gunichar c;
+    if(entity[1] == 'x' || entity[1] == 'X') {
+      c = std::strtoul(entity.c_str() + 2, NULL, 16);
+    }
+    else {
+      c = std::strtoul(entity.c_str() + 1, NULL, 10);
+    }
+    if(c == 0 || !g_unichar_validate(c)) {
+      return false;
+    }
+    char buf[6];
+    result.append(buf, g_unichar_to_utf8(c, buf));
+  }
+  else {
+    return false;
+  }
+  return true;
+}
+
+
+// Sets a simple field of note, elements that are not one are ignored
+void set_note_field(NoteData & data, const std::string & name, const std::string & value)
+{
+  if(name == "title") {
+    data.title() = value;
+  }
+  else if(name == "last-change-date") {
+    data.set_change_date(sharp::XmlConvert::to_date_time(value));
+  }
+  else if(name == "last-metadata-change-date") {
+    data.metadata_change_date() = sharp::XmlConvert::to_date_time(value);
+  }
+  else if(name == "create-date") {
+    data.create_date() = sharp::XmlConvert::to_date_time(value);
+  }
+  else if(name == "cursor-position") {
+    data.set_cursor_position(STRING_TO_INT(value));
+  }
+  else if(name == "selection-bound-position") {
+    data.set_selection_bound_position(STRING_TO_INT(value));
+  }
+  else if(name == "width") {
+    data.width() = STRING_TO_INT(value);
+  }
+  else if(name == "height") {
+    data.height() = STRING_TO_INT(value);
+  }
+}
+
+
+// Whole note file in memory
+std::string read_note_file(const Glib::ustring & file)
+{
+  try {
+    return Glib::file_get_contents(file);
+  }
+  catch(const Glib::FileError & e) {
+    throw sharp::Exception(e.what());
+  }
+}
+
+
+// Single pass over a note file in memory, in the form NoteArchiver::write
+// produces. Text is taken as it is between <text> and </text>, instead of
+// being parsed and serialized again, and tags are read as they come.
+// Anything else, like comments, CDATA or markup in values, makes it give
+// up, so that the caller can fall back to XmlReader. The fallback gets the
+// text from find_text(), so it is the same whichever way the note is read.
+class NoteParser
+{
+public:
+  explicit NoteParser(const std::string & xml)
+    : m_xml(xml)
+    , m_pos(0)
+    {}
+
+  bool parse(NoteData & data, Glib::ustring & version, std::list<Glib::ustring> & tags, bool read_text)
+    {
+      std::string name;
+      std::string attributes;
+      bool empty;
+      if(!skip_prolog() || !read_start_tag(name, attributes, empty) || name != "note") {
+        return false;
+      }
+      std::string note_version;
+      if(!get_attribute(attributes, "version", note_version)) {
+        return false;
+      }
+      version = note_version;
+      if(empty) {
+        return true;
+      }
+
+      while(true) {
+        skip_space();
+        if(m_xml.compare(m_pos, 2, "</") == 0) {
+          return read_end_tag("note");
+        }
+        if(!read_start_tag(name, attributes, empty)) {
+          return false;
+        }
+        if(empty) {
+          continue;
+        }
+
+        if(name == "text") {
+          std::string text;
+          if(!read_content("text", text)) {
+            return false;
+          }
+          if(read_text) {
+            data.text() = text;
+          }
+        }
+        else if(name == "tags") {
+          if(!read_tags(tags)) {
+            return false;
+          }
+        }
+        else {
+          std::string value;
+          if(!read_value(name, value)) {
+            return false;
+          }
+          set_note_field(data, name, value);
+        }
+      }
+    }
+
+  // Text of a note in any form, as long as it is in UTF-8
+  bool find_text(std::string & text)
+    {
+      std::string name;
+      std::string attributes;
+      bool empty;
+      if(!skip_prolog() || !skip_markup() || !read_start_tag(name, attributes, empty)
+         || name != "note" || empty) {
+        return false;
+      }
+      while(skip_markup()) {
+        if(m_xml.compare(m_pos, 2, "</") == 0 || !read_start_tag(name, attributes, empty)) {
+          return false;
+        }
+        if(empty) {
+          continue;
+        }
+        std::string content;
+        if(!read_content(name, content)) {
+          return false;
+        }
+        if(name == "text") {
+          text = content;
+          return true;
+        }
+      }
+      return false;
+    }
+private:
+  static bool is_space(char c)
+    {
+      return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+  void skip_space()
+    {
+      while(m_pos < m_xml.size() && is_space(m_xml[m_pos])) {
+        ++m_pos;
+      }
+    }
+
+  // XML declaration, only UTF-8 is read as it is
+  bool skip_prolog()
+    {
+      skip_space();
+      if(m_xml.compare(m_pos, 5, "<?xml") != 0) {
+        return true;
+      }
+      std::string::size_type end = m_xml.find("?>", m_pos);
+      if(end == std::string::npos) {
+        return false;
+      }
+      std::string encoding;
+      if(!get_attribute(m_xml.substr(m_pos + 5, end - m_pos - 5), "encoding", encoding)
+         || (encoding != "" && g_ascii_strcasecmp(encoding.c_str(), "utf-8") != 0)) {
+        return false;
+      }
+      m_pos = end + 2;
+      skip_space();
+      return true;
+    }
+
+  bool read_start_tag(std::string & name, std::string & attributes, bool & empty)
+    {
+      if(m_pos >= m_xml.size() || m_xml[m_pos] != '<') {
+        return false;
+      }
+      std::string::size_type name_start = ++m_pos;
+      while(m_pos < m_xml.size() && (g_ascii_isalnum(m_xml[m_pos]) || m_xml[m_pos] == '-'
+                                     || m_xml[m_pos] == '_' || m_xml[m_pos] == ':' || m_xml[m_pos] == '.')) {
+        ++m_pos;
+      }
+      if(m_pos == name_start) {
+        return false;
+      }
+      name = m_xml.substr(name_start, m_pos - name_start);
+
+      // Attribute values can contain '>'
+      std::string::size_type attributes_start = m_pos;
+      char quote = 0;
+      for(; m_pos < m_xml.size(); ++m_pos) {
+        char c = m_xml[m_pos];
+        if(quote) {
+          if(c == quote) {
+            quote = 0;
+          }
+        }
+        else if(c == '"' || c == '\'') {
+          quote = c;
+        }
+        else if(c == '>') {
+          break;
+        }
+      }
+      if(m_pos >= m_xml.size()) {
+        return false;
+      }
+      empty = m_xml[m_pos - 1] == '/';
+      attributes = m_xml.substr(attributes_start, m_pos - attributes_start - (empty ? 1 : 0));
+      ++m_pos;
+      return true;
+    }
+
+  bool read_end_tag(const char *name)
+    {
+      std::string end_tag = std::string("</") + name;
+      if(m_xml.compare(m_pos, end_tag.size(), end_tag) != 0) {
+        return false;
+      }
+      m_pos += end_tag.size();
+      skip_space();
+      if(m_pos >= m_xml.size() || m_xml[m_pos] != '>') {
+        return false;
+      }
+      ++m_pos;
+      return true;
+    }
+
+  // Moves to the next tag, past character data, comments, CDATA,
+  // processing instructions and document type declaration
+  bool skip_markup()
+    {
+      while(true) {
+        m_pos = m_xml.find('<', m_pos);
+        if(m_pos == std::string::npos) {
+          m_pos = m_xml.size();
+          return false;
+        }
+        const char *end_marker;
+        if(m_xml.compare(m_pos, 4, "<!--") == 0) {
+          end_marker = "-->";
+        }
+        else if(m_xml.compare(m_pos, 9, "<![CDATA[") == 0) {
+          end_marker = "]]>";
+        }
+        else if(m_xml.compare(m_pos, 2, "<?") == 0) {
+          end_marker = "?>";
+        }
+        else if(m_xml.compare(m_pos, 2, "<!") == 0) {
+          // Internal subset of DOCTYPE is not expected in notes
+          end_marker = ">";
+        }
+        else {
+          return true;
+        }
+        std::string::size_type end = m_xml.find(end_marker, m_pos + 2);
+        if(end == std::string::npos) {
+          m_pos = m_xml.size();
+          return false;
+        }
+        m_pos = end + strlen(end_marker);
+      }
+    }
+
+  // Everything between start tag and its end tag, as it is in the file
+  bool read_content(const std::string & name, std::string & content)
+    {
+      std::string::size_type start = m_pos;
+      std::string child;
+      std::string attributes;
+      bool empty;
+      int depth = 1;
+      while(skip_markup()) {
+        if(m_xml.compare(m_pos, 2, "</") != 0) {
+          if(!read_start_tag(child, attributes, empty)) {
+            return false;
+          }
+          if(!empty) {
+            ++depth;
+          }
+        }
+        else if(--depth > 0) {
+          m_pos = m_xml.find('>', m_pos);
+          if(m_pos == std::string::npos) {
+            return false;
+          }
+          ++m_pos;
+        }
+        else {
+          content = m_xml.substr(start, m_pos - start);
+          return read_end_tag(name.c_str());
+        }
+      }
+      return false;
+    }
+
+  // Text content of a simple element, up to and including its end tag
+  bool read_value(const std::string & name, std::string & value)
+    {
+      std::string::size_type end = m_xml.find('<', m_pos);
+      if(end == std::string::npos || !decode(m_xml.substr(m_pos, end - m_pos), value)) {
+        return false;
+      }
+      m_pos = end;
+      return read_end_tag(name.c_str());
+    }
+
+  bool read_tags(std::list<Glib::ustring> & tags)
+    {
+      std::string name;
+      std::string attributes;
+      bool empty;
+      while(true) {
+        skip_space();
+        if(m_xml.compare(m_pos, 2, "</") == 0) {
+          return read_end_tag("tags");
+        }
+        if(!read_start_tag(name, attributes, empty) || name != "tag") {
+          return false;
+        }
+        std::string value;
+        if(!empty && !read_value(name, value)) {
+          return false;
+        }
+        tags.push_back(value);
+      }
+    }
+
+  // Value of attribute, empty if there is no such attribute
+  static bool get_attribute(const std::string & attributes, const std::string & name, std::string & value)
+    {
+      value.clear();
+      std::string::size_type pos = 0;
+      while(true) {
+        while(pos < attributes.size() && is_space(attributes[pos])) {
+          ++pos;
+        }
+        if(pos >= attributes.size()) {
+          return true;
+        }
+        std::string::size_type eq = attributes.find('=', pos);
+        if(eq == std::string::npos) {
+          return false;
+        }
+        std::string attribute = attributes.substr(pos, eq - pos);
+        while(!attribute.empty() && is_space(attribute[attribute.size() - 1])) {
+          attribute.erase(attribute.size() - 1);
+        }
+        pos = eq + 1;
+        while(pos < attributes.size() && is_space(attributes[pos])) {
+          ++pos;
+        }
+        if(pos >= attributes.size() || (attributes[pos] != '"' && attributes[pos] != '\'')) {
+          return false;
+        }
+        std::string::size_type end = attributes.find(attributes[pos], pos + 1);
+        if(end == std::string::npos) {
+          return false;
+        }
+        if(attribute == name) {
+          return decode(attributes.substr(pos + 1, end - pos - 1), value);
+        }
+        pos = end + 1;
+      }
+    }
+
+  static bool decode(const std::string & text, std::string & value)
+    {
+      value.clear();
+      std::string::size_type pos = 0;
+      while(true) {
+        std::string::size_type amp = text.find('&', pos);
+        value.append(text, pos, amp == std::string::npos ? std::string::npos : amp - pos);
+        if(amp == std::string::npos) {
+          return true;
+        }
+        std::string::size_type end = text.find(';', amp);
+        if(end == std::string::npos || !decode_entity(text.substr(amp + 1, end - amp - 1), value)) {
+          return false;
+        }
+        pos = end + 1;
+      }
+    }
+
+  const std::string & m_xml;
+  std::string::size_type m_pos;
+};
+
+}
+
+
 NoteDataBufferSynchronizerBase::~NoteDataBufferSynchronizerBase()
 {
   delete m_data;
@@ -89,11 +526,58 @@ void NoteBase::parse_tags(const xmlNodePtr tagnodes, std::list<Glib::ustring> &
 }
 
 
-NoteBase::NoteBase(NoteData *, const Glib::ustring & filepath, NoteManagerBase & _manager)
+namespace {
+
+// Notes by ordinal. Ordinals of destroyed notes are reused, so that
+// bitmaps stay as small as the number of notes.
+std::vector<NoteBase*> s_notes_by_ordinal;
+std::vector<NoteBitmap::size_type> s_free_ordinals;
+Glib::Threads::Mutex s_ordinal_lock;
+
+}
+
+NoteBase *NoteBase::from_ordinal(NoteBitmap::size_type ordinal)
+{
+  Glib::Threads::Mutex::Lock lock(s_ordinal_lock);
+  return ordinal < s_notes_by_ordinal.size() ? s_notes_by_ordinal[ordinal] : NULL;
+}
+
+NoteBase::NoteBase(NoteData *_data, const Glib::ustring & filepath, NoteManagerBase & _manager)
   : m_manager(_manager)
   , m_file_path(filepath)
   , m_enabled(true)
+  , m_text_content_valid(false)
 {
+  _data->signal_reloaded.connect(sigc::mem_fun(*this, &NoteBase::on_data_reloaded));
+
+  Glib::Threads::Mutex::Lock lock(s_ordinal_lock);
+  if(s_free_ordinals.empty()) {
+    m_ordinal = s_notes_by_ordinal.size();
+    s_notes_by_ordinal.push_back(this);
+  }
+  else {
+    m_ordinal = s_free_ordinals.back();
+    s_free_ordinals.pop_back();
+    s_notes_by_ordinal[m_ordinal] = this;
+  }
+}
+
+NoteBase::~NoteBase()
+{
+  Glib::Threads::Mutex::Lock lock(s_ordinal_lock);
+  s_notes_by_ordinal[m_ordinal] = NULL;
+  s_free_ordinals.push_back(m_ordinal);
+}
+
+// Ordinal of the note is reused once it is destroyed, so it must not be
+// left in tags. Data is owned by derived classes, which call this from
+// their destructors, before it is gone.
+void NoteBase::leave_tags()
+{
+  const NoteData::TagMap & tags = data_synchronizer().data().tags();
+  for(NoteData::TagMap::const_iterator iter = tags.begin(); iter != tags.end(); ++iter) {
+    iter->second->remove_note(*this);
+  }
 }
 
 int NoteBase::get_hash_code() const
@@ -192,6 +676,11 @@ void NoteBase::set_change_type(ChangeType c)
 
 void NoteBase::save()
 {
+  if(!data_synchronizer().data().is_text_readable()) {
+    ERR_OUT(_("Not saving note %s, its text could not be read"), m_file_path.c_str());
+    return;
+  }
+
   try {
     NoteArchiver::write(m_file_path, data_synchronizer().data());
   } 
@@ -200,6 +689,37 @@ void NoteBase::save()
     ERR_OUT(_("Exception while saving note: %s"), e.what());
   }
 
+  invalidate_text_content();
+  update_content_hash();
+  signal_saved(shared_from_this());
+}
+
+// Bring everything, that depends on title and tags, up to date with the reloaded note
+void NoteBase::on_data_reloaded(const Glib::ustring & old_title, const NoteData::TagMap & old_tags)
+{
+  invalidate_text_content();
+  update_content_hash();
+
+  const NoteData::TagMap & tags = data_synchronizer().data().tags();
+  for(NoteData::TagMap::const_iterator iter = old_tags.begin(); iter != old_tags.end(); ++iter) {
+    if(tags.find(iter->first) == tags.end()) {
+      iter->second->remove_note(*this);
+      signal_tag_removed(shared_from_this(), iter->first);
+      m_manager.signal_note_tag_removed(shared_from_this(), iter->first);
+    }
+  }
+  for(NoteData::TagMap::const_iterator iter = tags.begin(); iter != tags.end(); ++iter) {
+    if(old_tags.find(iter->first) == old_tags.end()) {
+      iter->second->add_note(*this);
+      signal_tag_added(*this, iter->second);
+      m_manager.signal_note_tag_added(*this, iter->second);
+    }
+  }
+
+  if(get_title() != old_title) {
+    signal_renamed(shared_from_this(), old_title);
+  }
+  // Note is the same as its file again, like after a save
   signal_saved(shared_from_this());
 }
 
@@ -238,6 +758,7 @@ void NoteBase::add_tag(const Tag::Ptr & tag)
     thetags[tag->normalized_name()] = tag;
 
     signal_tag_added(*this, tag);
+    m_manager.signal_note_tag_added(*this, tag);
 
     DBG_OUT ("Tag added, queueing save");
     queue_save(OTHER_DATA_CHANGED);
@@ -261,6 +782,7 @@ void NoteBase::remove_tag(Tag & tag)
   tag.remove_note(*this);
 
   signal_tag_removed(shared_from_this(), tag_name);
+  m_manager.signal_note_tag_removed(shared_from_this(), tag_name);
 
   DBG_OUT("Tag removed, queueing save");
   queue_save(OTHER_DATA_CHANGED);
@@ -290,6 +812,38 @@ Glib::ustring NoteBase::get_complete_note_xml()
 void NoteBase::set_xml_content(const Glib::ustring & xml)
 {
   data_synchronizer().set_text(xml);
+  invalidate_text_content();
+}
+
+Glib::ustring NoteBase::text_content()
+{
+  if(!m_text_content_valid) {
+    m_text_content = NoteArchiver::obj().get_text_from_note_content(xml_content());
+    m_text_content_valid = true;
+  }
+  return m_text_content;
+}
+
+void NoteBase::update_content_hash()
+{
+  // Same bits, that synchronization compares, tags are sorted by name
+  const NoteData & note_data = data_synchronizer().synchronized_data();
+  Glib::Checksum checksum(Glib::Checksum::CHECKSUM_SHA1);
+  checksum.update(note_data.title().raw());
+  checksum.update(std::string(1, '\0'));
+  for(NoteData::TagMap::const_iterator iter = note_data.tags().begin();
+      iter != note_data.tags().end(); ++iter) {
+    checksum.update(iter->first);
+    checksum.update(std::string(1, '\0'));
+  }
+  checksum.update(note_data.text().raw());
+  m_content_hash = checksum.get_string();
+}
+
+void NoteBase::invalidate_text_content()
+{
+  m_text_content_valid = false;
+  m_text_content.clear();
 }
 
 void NoteBase::load_foreign_note_xml(const Glib::ustring & foreignNoteXml, ChangeType changeType)
@@ -424,26 +978,22 @@ NoteArchiver NoteArchiver::s_obj;
 
 void NoteArchiver::read(const Glib::ustring & read_file, NoteData & data)
 {
-  return obj().read_file(read_file, data);
+  Glib::ustring version; // discarded
+  obj().read_file(read_file, data, version);
 }
 
-void NoteArchiver::read_file(const Glib::ustring & file, NoteData & data)
+void NoteArchiver::read(const Glib::ustring & read_file, NoteData & data, Glib::ustring & version)
 {
-  Glib::ustring version;
-  sharp::XmlReader xml(file);
-  _read(xml, data, version);
-  if(version != NoteArchiver::CURRENT_VERSION) {
-    try {
-      // Note has old format, so rewrite it.  No need
-      // to reread, since we are not adding anything.
-      DBG_OUT("Updating note XML from %s to newest format...", version.c_str());
-      NoteArchiver::write(file, data);
-    }
-    catch(sharp::Exception & e) {
-      // write failure, but not critical
-      ERR_OUT(_("Failed to update note format: %s"), e.what());
-    }
-  }
+  obj().read_file(read_file, data, version);
+}
+
+void NoteArchiver::read_file(const Glib::ustring & file, NoteData & data, Glib::ustring & version)
+{
+  // Notes in old format are not rewritten here, that is left to the
+  // caller to do on the next save
+  std::list<Glib::ustring> tag_strings;
+  _read(read_note_file(file), data, version, tag_strings, true);
+  add_tags(data, tag_strings);
 }
 
 void NoteArchiver::read(sharp::XmlReader & xml, NoteData & data)
@@ -452,12 +1002,68 @@ void NoteArchiver::read(sharp::XmlReader & xml, NoteData & data)
   _read(xml, data, version);
 }
 
+void NoteArchiver::read_buffer(const std::string & xml, NoteData & data)
+{
+  Glib::ustring version; // discarded
+  std::list<Glib::ustring> tag_strings;
+  _read(xml, data, version, tag_strings, true);
+  add_tags(data, tag_strings);
+}
+
+void NoteArchiver::read_header(const Glib::ustring & read_file, NoteData & data,
+                               std::list<Glib::ustring> & tags, Glib::ustring & version)
+{
+  // Stamp before reading, so that a change while reading is noticed later
+  sharp::FileStamp stamp;
+  sharp::file_stamp(read_file, stamp);
+  obj()._read(read_note_file(read_file), data, version, tags, false);
+  data.set_text_file(read_file, stamp);
+}
+
+
+void NoteArchiver::add_tags(NoteData & data, const std::list<Glib::ustring> & tag_strings)
+{
+  FOREACH(const Glib::ustring & tag_str, tag_strings) {
+    Tag::Ptr tag = ITagManager::obj().get_or_create_tag(tag_str);
+    data.tags()[tag->normalized_name()] = tag;
+  }
+}
+
+void NoteArchiver::_read(const std::string & xml, NoteData & data, Glib::ustring & version,
+                         std::list<Glib::ustring> & tags, bool read_text)
+{
+  // Fields set before the fast path gives up are set again by XmlReader
+  std::list<Glib::ustring> parsed_tags;
+  if(NoteParser(xml).parse(data, version, parsed_tags, read_text)) {
+    tags.splice(tags.end(), parsed_tags);
+    return;
+  }
+
+  DBG_OUT("Note is not in the usual form, parsing it fully");
+  sharp::XmlReader reader;
+  reader.load_buffer(xml);
+  std::string text;
+  bool has_text = read_text && NoteParser(xml).find_text(text);
+  _read(reader, data, version, tags, read_text && !has_text);
+  if(has_text) {
+    data.text() = text;
+  }
+}
 
 void NoteArchiver::_read(sharp::XmlReader & xml, NoteData & data, Glib::ustring & version)
+{
+  std::list<Glib::ustring> tag_strings;
+  _read(xml, data, version, tag_strings, true);
+  add_tags(data, tag_strings);
+}
+
+void NoteArchiver::_read(sharp::XmlReader & xml, NoteData & data, Glib::ustring & version,
+                         std::list<Glib::ustring> & tags, bool read_text)
 {
   std::string name;
 
-  while(xml.read ()) {
+  bool has_node = xml.read();
+  while(has_node) {
     switch(xml.get_node_type()) {
     case XML_READER_TYPE_ELEMENT:
       name = xml.get_name();
@@ -465,56 +1071,28 @@ void NoteArchiver::_read(sharp::XmlReader & xml, NoteData & data, Glib::ustring
       if(name == "note") {
         version = xml.get_attribute("version");
       }
-      else if(name == "title") {
-        data.title() = xml.read_string();
-      } 
       else if(name == "text") {
-        // <text> is just a wrapper around <note-content>
-        // NOTE: Use .text here to avoid triggering a save.
-        data.text() = xml.read_inner_xml();
-      }
-      else if(name == "last-change-date") {
-        data.set_change_date(sharp::XmlConvert::to_date_time (xml.read_string()));
-      }
-      else if(name == "last-metadata-change-date") {
-        data.metadata_change_date() = sharp::XmlConvert::to_date_time(xml.read_string());
-      }
-      else if(name == "create-date") {
-        data.create_date() = sharp::XmlConvert::to_date_time (xml.read_string());
-      }
-      else if(name == "cursor-position") {
-        data.set_cursor_position(STRING_TO_INT(xml.read_string()));
-      }
-      else if(name == "selection-bound-position") {
-        data.set_selection_bound_position(STRING_TO_INT(xml.read_string()));
-      }
-      else if(name == "width") {
-        data.width() = STRING_TO_INT(xml.read_string());
+        if(read_text) {
+          // <text> is just a wrapper around <note-content>
+          // NOTE: Use .text here to avoid triggering a save.
+          data.text() = xml.read_inner_xml();
+        }
+        has_node = xml.skip();
+        continue;
       }
-      else if(name == "height") {
-        data.height() = STRING_TO_INT(xml.read_string());
+      else if(name == "tag") {
+        // Only found in <tags>, text is skipped above
+        tags.push_back(xml.read_string());
       }
-      else if(name == "tags") {
-        xmlDocPtr doc2 = xmlParseDoc((const xmlChar*)xml.read_outer_xml().c_str());
-
-        if(doc2) {
-          std::list<Glib::ustring> tag_strings;
-          NoteBase::parse_tags(doc2->children, tag_strings);
-          FOREACH(Glib::ustring & tag_str, tag_strings) {
-            Tag::Ptr tag = ITagManager::obj().get_or_create_tag(tag_str);
-            data.tags()[tag->normalized_name()] = tag;
-          }
-          xmlFreeDoc(doc2);
-        }
-        else {
-          DBG_OUT("loading tag subtree failed");
-        }
+      else if(name != "tags") {
+        set_note_field(data, name, xml.read_string());
       }
       break;
 
     default:
       break;
     }
+    has_node = xml.read();
   }
   xml.close ();
 }
@@ -671,6 +1249,68 @@ Glib::ustring NoteArchiver::get_title_from_note_xml(const Glib::ustring & noteXm
 
   return "";
 }
+
+Glib::ustring NoteArchiver::get_text_from_note_file(const Glib::ustring & file) const
+{
+  std::string content = read_note_file(file);
+  NoteData data("");
+  Glib::ustring version;
+  std::list<Glib::ustring> tags;
+  if(NoteParser(content).parse(data, version, tags, true)) {
+    return data.text();
+  }
+  std::string text;
+  if(NoteParser(content).find_text(text)) {
+    return text;
+  }
+
+  sharp::XmlReader xml;
+  xml.load_buffer(content);
+  while(xml.read()) {
+    if(xml.get_node_type() == XML_READER_TYPE_ELEMENT && xml.get_name() == "text") {
+      return xml.read_inner_xml();
+    }
+  }
+
+  return "";
+}
+
+Glib::ustring NoteArchiver::get_text_from_note_content(const Glib::ustring & note_content) const
+{
+  // Single pass over the content, dropping tags and decoding entities.
+  // All markup characters are ASCII, so working on bytes is safe for UTF-8.
+  const std::string & source = note_content.raw();
+  std::string result;
+  result.reserve(source.size());
+
+  std::string::size_type pos = 0;
+  while(pos < source.size()) {
+    char c = source[pos];
+    if(c == '<') {
+      std::string::size_type end = source.find('>', pos);
+      if(end == std::string::npos) {
+        break;
+      }
+      pos = end + 1;
+    }
+    else if(c == '&') {
+      std::string::size_type end = source.find(';', pos);
+      if(end == std::string::npos || !decode_entity(source.substr(pos + 1, end - pos - 1), result)) {
+        result += c;
+        ++pos;
+      }
+      else {
+        pos = end + 1;
+      }
+    }
+    else {
+      result += c;
+      ++pos;
+    }
+  }
+
+  return result;
+}
  
 }
 
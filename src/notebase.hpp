@@ -22,6 +22,7 @@
 #ifndef _NOTEBASE_HPP_
 #define _NOTEBASE_HPP_
 
+#include <list>
 #include <map>
 
 #include <glibmm/ustring.h>
@@ -31,6 +32,7 @@
 #include "base/singleton.hpp"
 #include "tag.hpp"
 #include "sharp/datetime.hpp"
+#include "sharp/files.hpp"
 #include "sharp/xmlreader.hpp"
 #include "sharp/xmlwriter.hpp"
 
@@ -63,12 +65,40 @@ public:
     }
   const Glib::ustring & text() const
     { 
+      load_text();
       return m_text;
     }
   Glib::ustring & text()
     { 
+      load_text();
       return m_text;
     }
+  // Don't keep text in memory until it is needed, read it from file instead.
+  // Stamp is of the file version, the rest of the data was read from.
+  // Text is read on first access, so once note is loaded, it is only to
+  // be used from the main thread.
+  void set_text_file(const Glib::ustring & file, const sharp::FileStamp & stamp)
+    {
+      m_text_file = file;
+      m_text_file_stamp = stamp;
+      m_text.clear();
+    }
+  bool is_text_loaded() const
+    {
+      return m_text_file.empty();
+    }
+  // False if text could not be read from file. Such note must not be
+  // saved, that would replace the text on disk with an empty one.
+  bool is_text_readable() const
+    {
+      load_text();
+      return !m_text_read_failed;
+    }
+  // File, the text is yet to be read from
+  const Glib::ustring & text_file() const
+    {
+      return m_text_file;
+    }
   const sharp::DateTime & create_date() const
     {
       return m_create_date;
@@ -138,10 +168,26 @@ public:
   void set_extent(int width, int height);
   bool has_extent();
 
+  // Emitted when file changed since the header was read, so the whole
+  // note was read again. Gets title and tags from before the reload.
+  typedef sigc::signal<void, const Glib::ustring &, const TagMap &> ReloadedHandler;
+  ReloadedHandler signal_reloaded;
 private:
+  void load_text() const
+    {
+      if(!m_text_file.empty()) {
+        read_text();
+      }
+    }
+  void read_text() const;
+  void reload(const Glib::ustring & file);
+
   const std::string m_uri;
   Glib::ustring     m_title;
-  Glib::ustring     m_text;
+  mutable Glib::ustring m_text;
+  mutable Glib::ustring m_text_file;
+  sharp::FileStamp  m_text_file_stamp;
+  mutable bool      m_text_read_failed;
   sharp::DateTime             m_create_date;
   sharp::DateTime             m_change_date;
   sharp::DateTime             m_metadata_change_date;
@@ -195,7 +241,11 @@ public:
   static Glib::ustring url_from_path(const Glib::ustring &);
   static void parse_tags(const xmlNodePtr tagnodes, std::list<Glib::ustring> & tags);
 
+  // Note with the given ordinal, NULL if it no longer exists
+  static NoteBase *from_ordinal(NoteBitmap::size_type ordinal);
+
   NoteBase(NoteData *_data, const Glib::ustring & filepath, NoteManagerBase & manager);
+  virtual ~NoteBase();
 
   NoteManagerBase & manager()
     {
@@ -207,6 +257,12 @@ public:
     }
 
   int get_hash_code() const;
+  // Small number, unique among existing notes, for NoteBitmap.
+  // Ordinal of a destroyed note is given to the next one created.
+  NoteBitmap::size_type ordinal() const
+    {
+      return m_ordinal;
+    }
   const std::string & uri() const;
   const std::string id() const;
   const Glib::ustring & get_title() const;
@@ -234,6 +290,20 @@ public:
       return data_synchronizer().text();
     }
   virtual void set_xml_content(const Glib::ustring & xml);
+  // Plain text of the note, extracted from XML content and cached until note changes
+  virtual Glib::ustring text_content();
+  // Hash of synchronized data (title, tags and content) as of last save,
+  // empty if it is not known for a note loaded from disk
+  const std::string & content_hash() const
+    {
+      return m_content_hash;
+    }
+  void update_content_hash();
+  // Hash known without reading the text, like from metadata cache
+  void set_content_hash(const std::string & hash)
+    {
+      m_content_hash = hash;
+    }
   void load_foreign_note_xml(const Glib::ustring & foreignNoteXml, ChangeType changeType);
   void get_tags(std::list<Tag::Ptr> &) const;
   const NoteData & data() const;
@@ -264,11 +334,19 @@ protected:
   virtual NoteDataBufferSynchronizerBase & data_synchronizer() = 0;
   virtual void process_rename_link_update(const Glib::ustring & old_title);
   void set_change_type(ChangeType c);
+  void invalidate_text_content();
+  void leave_tags();
   virtual void handle_link_rename(const Glib::ustring & old_title, const Ptr & renamed, bool rename);
 private:
+  void on_data_reloaded(const Glib::ustring & old_title, const NoteData::TagMap & old_tags);
+
   NoteManagerBase & m_manager;
+  NoteBitmap::size_type m_ordinal;
   Glib::ustring m_file_path;
   bool m_enabled;
+  Glib::ustring m_text_content;
+  bool m_text_content_valid;
+  std::string m_content_hash;
 };
 
 
@@ -279,17 +357,33 @@ public:
   static const char *CURRENT_VERSION;
 
   static void read(const Glib::ustring & read_file, NoteData & data);
+  // Notes in older format are not updated, version tells if they need to be
+  static void read(const Glib::ustring & read_file, NoteData & data, Glib::ustring & version);
+  // Read everything except text, which is loaded when needed.
+  // Tags are returned by name, so this can be called from any thread.
+  static void read_header(const Glib::ustring & read_file, NoteData & data,
+                          std::list<Glib::ustring> & tags, Glib::ustring & version);
   static Glib::ustring write_string(const NoteData & data);
   static void write(const Glib::ustring & write_file, const NoteData & data);
-  void read_file(const Glib::ustring & file, NoteData & data);
+  void read_file(const Glib::ustring & file, NoteData & data, Glib::ustring & version);
   void read(sharp::XmlReader & xml, NoteData & data);
+  void read_buffer(const std::string & xml, NoteData & data);
   void write_file(const Glib::ustring & write_file, const NoteData & data);
   void write(sharp::XmlWriter & xml, const NoteData & data);
 
   Glib::ustring get_renamed_note_xml(const Glib::ustring &, const Glib::ustring &, const Glib::ustring &) const;
   Glib::ustring get_title_from_note_xml(const Glib::ustring & noteXml) const;
+  Glib::ustring get_text_from_note_file(const Glib::ustring & file) const;
+  // Text of note-content element without any markup
+  Glib::ustring get_text_from_note_content(const Glib::ustring & note_content) const;
 protected:
+  static void add_tags(NoteData & data, const std::list<Glib::ustring> & tag_strings);
+  // Single pass over the file in the usual form, XmlReader for anything else
+  void _read(const std::string & xml, NoteData & data, Glib::ustring & version,
+             std::list<Glib::ustring> & tags, bool read_text);
   void _read(sharp::XmlReader & xml, NoteData & data, Glib::ustring & version);
+  void _read(sharp::XmlReader & xml, NoteData & data, Glib::ustring & version,
+             std::list<Glib::ustring> & tags, bool read_text);
 
   static NoteArchiver s_obj;
 };
@@ -0,0 +1,234 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+
+#include "notebitmap.hpp"
+
+
+namespace gnote {
+
+namespace {
+
+NoteBitmap::size_type count_bits(guint64 bits)
+{
+  NoteBitmap::size_type count = 0;
+  while(bits) {
+    bits &= bits - 1;
+    ++count;
+  }
+  return count;
+}
+
+}
+
+
+NoteBitmap::WordList::iterator NoteBitmap::find_word(size_type index)
+{
+  return std::lower_bound(m_words.begin(), m_words.end(), index, word_before);
+}
+
+
+NoteBitmap::WordList::const_iterator NoteBitmap::find_word(size_type index) const
+{
+  return std::lower_bound(m_words.begin(), m_words.end(), index, word_before);
+}
+
+
+void NoteBitmap::set(size_type bit)
+{
+  size_type index = bit / WORD_BITS;
+  guint64 mask = G_GUINT64_CONSTANT(1) << (bit % WORD_BITS);
+  WordList::iterator word = find_word(index);
+  if(word != m_words.end() && word->index == index) {
+    word->bits |= mask;
+  }
+  else {
+    m_words.insert(word, Word(index, mask));
+  }
+}
+
+
+void NoteBitmap::reset(size_type bit)
+{
+  size_type index = bit / WORD_BITS;
+  WordList::iterator word = find_word(index);
+  if(word != m_words.end() && word->index == index) {
+    word->bits &= ~(G_GUINT64_CONSTANT(1) << (bit % WORD_BITS));
+    if(word->bits == 0) {
+      m_words.erase(word);
+    }
+  }
+}
+
+
+bool NoteBitmap::test(size_type bit) const
+{
+  size_type index = bit / WORD_BITS;
+  WordList::const_iterator word = find_word(index);
+  return word != m_words.end() && word->index == index
+    && (word->bits & (G_GUINT64_CONSTANT(1) << (bit % WORD_BITS)));
+}
+
+
+NoteBitmap::size_type NoteBitmap::count() const
+{
+  size_type count = 0;
+  for(WordList::const_iterator word = m_words.begin(); word != m_words.end(); ++word) {
+    count += count_bits(word->bits);
+  }
+  return count;
+}
+
+
+bool NoteBitmap::intersects(const NoteBitmap & other) const
+{
+  WordList::const_iterator a = m_words.begin(), b = other.m_words.begin();
+  while(a != m_words.end() && b != other.m_words.end()) {
+    if(a->index < b->index) {
+      ++a;
+    }
+    else if(b->index < a->index) {
+      ++b;
+    }
+    else {
+      if(a->bits & b->bits) {
+        return true;
+      }
+      ++a;
+      ++b;
+    }
+  }
+  return false;
+}
+
+
+NoteBitmap & NoteBitmap::subtract(const NoteBitmap & other)
+{
+  WordList result;
+  result.reserve(m_words.size());
+  WordList::const_iterator b = other.m_words.begin();
+  for(WordList::const_iterator a = m_words.begin(); a != m_words.end(); ++a) {
+    while(b != other.m_words.end() && b->index < a->index) {
+      ++b;
+    }
+    guint64 bits = a->bits;
+    if(b != other.m_words.end() && b->index == a->index) {
+      bits &= ~b->bits;
+    }
+    if(bits) {
+      result.push_back(Word(a->index, bits));
+    }
+  }
+  m_words.swap(result);
+  return *this;
+}
+
+
+NoteBitmap & NoteBitmap::operator&=(const NoteBitmap & other)
+{
+  WordList result;
+  WordList::const_iterator a = m_words.begin(), b = other.m_words.begin();
+  while(a != m_words.end() && b != other.m_words.end()) {
+    if(a->index < b->index) {
+      ++a;
+    }
+    else if(b->index < a->index) {
+      ++b;
+    }
+    else {
+      guint64 bits = a->bits & b->bits;
+      if(bits) {
+        result.push_back(Word(a->index, bits));
+      }
+      ++a;
+      ++b;
+    }
+  }
+  m_words.swap(result);
+  return *this;
+}
+
+
+NoteBitmap & NoteBitmap::operator|=(const NoteBitmap & other)
+{
+  WordList result;
+  result.reserve(std::max(m_words.size(), other.m_words.size()));
+  WordList::const_iterator a = m_words.begin(), b = other.m_words.begin();
+  while(a != m_words.end() || b != other.m_words.end()) {
+    if(b == other.m_words.end() || (a != m_words.end() && a->index < b->index)) {
+      result.push_back(*a++);
+    }
+    else if(a == m_words.end() || b->index < a->index) {
+      result.push_back(*b++);
+    }
+    else {
+      result.push_back(Word(a->index, a->bits | b->bits));
+      ++a;
+      ++b;
+    }
+  }
+  m_words.swap(result);
+  return *this;
+}
+
+
+bool NoteBitmap::operator==(const NoteBitmap & other) const
+{
+  if(m_words.size() != other.m_words.size()) {
+    return false;
+  }
+  for(size_type i = 0; i < m_words.size(); ++i) {
+    if(m_words[i].index != other.m_words[i].index || m_words[i].bits != other.m_words[i].bits) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+void NoteBitmap::get_bits(std::vector<size_type> & bits) const
+{
+  for(WordList::const_iterator word = m_words.begin(); word != m_words.end(); ++word) {
+    for(size_type bit = 0; bit < WORD_BITS; ++bit) {
+      if(word->bits & (G_GUINT64_CONSTANT(1) << bit)) {
+        bits.push_back(word->index * WORD_BITS + bit);
+      }
+    }
+  }
+}
+
+
+NoteBitmap operator&(const NoteBitmap & a, const NoteBitmap & b)
+{
+  NoteBitmap result(a);
+  result &= b;
+  return result;
+}
+
+
+NoteBitmap operator|(const NoteBitmap & a, const NoteBitmap & b)
+{
+  NoteBitmap result(a);
+  result |= b;
+  return result;
+}
+
+}
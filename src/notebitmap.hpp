@@ -0,0 +1,98 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _NOTEBITMAP_HPP_
+#define _NOTEBITMAP_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include <glib.h>
+
+
+namespace gnote {
+
+
+// Set of note ordinals (see NoteBase::ordinal()).
+// Only non-empty 64 bit words are stored, sorted by their position, so
+// sparse sets stay small and set operations are a merge of two word lists.
+class NoteBitmap
+{
+public:
+  typedef std::size_t size_type;
+
+  void set(size_type bit);
+  void reset(size_type bit);
+  bool test(size_type bit) const;
+  // Number of bits set
+  size_type count() const;
+  bool empty() const
+    {
+      return m_words.empty();
+    }
+  void clear()
+    {
+      m_words.clear();
+    }
+  // True, if at least one bit is set in both
+  bool intersects(const NoteBitmap & other) const;
+  // Bits set in this one, but not in other
+  NoteBitmap & subtract(const NoteBitmap & other);
+  NoteBitmap & operator&=(const NoteBitmap & other);
+  NoteBitmap & operator|=(const NoteBitmap & other);
+  bool operator==(const NoteBitmap & other) const;
+  bool operator!=(const NoteBitmap & other) const
+    {
+      return !(*this == other);
+    }
+  // Append set bits in ascending order
+  void get_bits(std::vector<size_type> & bits) const;
+private:
+  enum { WORD_BITS = 64 };
+
+  struct Word
+  {
+    Word(size_type i, guint64 b)
+      : index(i)
+      , bits(b)
+      {}
+
+    size_type index;
+    guint64 bits;
+  };
+  typedef std::vector<Word> WordList;
+
+  static bool word_before(const Word & word, size_type index)
+    {
+      return word.index < index;
+    }
+  WordList::iterator find_word(size_type index);
+  WordList::const_iterator find_word(size_type index) const;
+
+  WordList m_words;
+};
+
+
+NoteBitmap operator&(const NoteBitmap & a, const NoteBitmap & b);
+NoteBitmap operator|(const NoteBitmap & a, const NoteBitmap & b);
+
+}
+
+#endif
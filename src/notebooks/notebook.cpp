@@ -52,7 +52,15 @@ namespace notebooks {
     if(tag == NULL) {
       return false;
     }
-    return note->contains_tag(tag);
+    return tag->has_note(*note);
+  }
+
+  void Notebook::exclude_template_notes(NoteBitmap & notes)
+  {
+    Tag::Ptr tag = template_tag();
+    if(tag) {
+      notes.subtract(tag->notes());
+    }
   }
 
   /// <summary>
@@ -202,13 +210,34 @@ namespace notebooks {
   /// </returns>
   bool Notebook::contains_note(const Note::Ptr & note, bool include_system)
   {
-    bool contains = note->contains_tag(m_tag);
+    bool contains = m_tag && m_tag->has_note(*note);
     if(!contains || include_system) {
       return contains;
     }
     return !is_template_note(note);
   }
 
+  NoteBitmap Notebook::get_notes(bool include_system)
+  {
+    NoteBitmap notes;
+    Tag::Ptr tag = get_tag();
+    if(tag) {
+      notes = tag->notes();
+    }
+    else {
+      // No tag to take them from, ask note by note
+      FOREACH(const NoteBase::Ptr & note, m_note_manager.get_notes()) {
+        if(contains_note(static_pointer_cast<Note>(note), true)) {
+          notes.set(note->ordinal());
+        }
+      }
+    }
+    if(!include_system) {
+      exclude_template_notes(notes);
+    }
+    return notes;
+  }
+
   bool Notebook::add_note(const Note::Ptr & note)
   {
     NotebookManager::obj().move_note_to_notebook(note, shared_from_this());
@@ -53,6 +53,8 @@ public:
   virtual Note::Ptr   get_template_note() const;
   Note::Ptr create_notebook_note();
   virtual bool contains_note(const Note::Ptr & note, bool include_system = false);
+  // Ordinals of the notes in this notebook
+  virtual NoteBitmap get_notes(bool include_system = false);
   virtual bool add_note(const Note::Ptr &);
   static std::string normalize(const std::string & s);
 ////
@@ -61,6 +63,7 @@ public:
 protected:
   static Tag::Ptr template_tag();
   static bool is_template_note(const Note::Ptr &);
+  static void exclude_template_notes(NoteBitmap & notes);
 
   NoteManager & m_note_manager;
 private:
@@ -78,17 +78,10 @@ namespace gnote {
 
       NoteManager & nm(note_manager());
 
-      FOREACH(const NoteBase::Ptr & note, nm.get_notes()) {
-        note->signal_tag_added.connect(
-          sigc::mem_fun(*this, &NotebookApplicationAddin::on_tag_added));
-        note->signal_tag_removed.connect(
-          sigc::mem_fun(*this, &NotebookApplicationAddin::on_tag_removed));
-      }
-       
-      nm.signal_note_added.connect(
-        sigc::mem_fun(*this, &NotebookApplicationAddin::on_note_added));
-      nm.signal_note_deleted.connect(
-        sigc::mem_fun(*this, &NotebookApplicationAddin::on_note_deleted));
+      nm.signal_note_tag_added.connect(
+        sigc::mem_fun(*this, &NotebookApplicationAddin::on_tag_added));
+      nm.signal_note_tag_removed.connect(
+        sigc::mem_fun(*this, &NotebookApplicationAddin::on_tag_removed));
 
       am.add_app_action("new-notebook");
       am.get_app_action("new-notebook")->signal_activate().connect(
@@ -240,20 +233,5 @@ namespace gnote {
       NotebookManager::obj().signal_note_removed_from_notebook() (*static_pointer_cast<Note>(note), notebook);
     }
 
-    void NotebookApplicationAddin::on_note_added(const NoteBase::Ptr & note)
-    {
-        note->signal_tag_added.connect(
-          sigc::mem_fun(*this, &NotebookApplicationAddin::on_tag_added));
-        note->signal_tag_removed.connect(
-          sigc::mem_fun(*this, &NotebookApplicationAddin::on_tag_removed));
-    }
-
-
-    void NotebookApplicationAddin::on_note_deleted(const NoteBase::Ptr &)
-    {
-      // remove the signal to the note...
-    }
-
-
   }
 }
@@ -52,8 +52,6 @@ namespace gnote {
       void on_new_notebook_menu_item();
       void on_tag_added(const NoteBase&, const Tag::Ptr&);
       void on_tag_removed(const NoteBase::Ptr&, const std::string&);
-      void on_note_added(const NoteBase::Ptr &);
-      void on_note_deleted(const NoteBase::Ptr &);
       void on_new_notebook_action(const Glib::VariantBase&);
 
       bool m_initialized;
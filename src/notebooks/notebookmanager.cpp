@@ -69,6 +69,9 @@ namespace gnote {
      Notebook::Ptr pinned_notes_notebook(new PinnedNotesNotebook(manager));
      iter = m_notebooks->append();
      iter->set_value(0, pinned_notes_notebook);
+     signal_note_pin_status_changed
+       .connect(sigc::mem_fun(*static_pointer_cast<PinnedNotesNotebook>(pinned_notes_notebook),
+                              &PinnedNotesNotebook::on_note_pin_status_changed));
 
      iter = m_notebooks->append();
      iter->set_value(0, m_active_notes);
@@ -258,6 +261,19 @@ namespace gnote {
     }
 
 
+    NoteBitmap NotebookManager::get_filed_notes() const
+    {
+      NoteBitmap notes;
+      for(std::map<std::string, Gtk::TreeIter>::const_iterator iter = m_notebookMap.begin();
+          iter != m_notebookMap.end(); ++iter) {
+        Notebook::Ptr notebook;
+        iter->second->get_value(0, notebook);
+        notes |= notebook->get_tag()->notes();
+      }
+      return notes;
+    }
+
+
         /// <summary>
     /// Returns the Notebook associated with the specified tag
     /// or null if the Tag does not represent a notebook.
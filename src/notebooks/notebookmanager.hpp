@@ -80,6 +80,8 @@ public:
   bool get_notebook_iter(const Notebook::Ptr &, Gtk::TreeIter & );
   Notebook::Ptr get_notebook_from_note(const NoteBase::Ptr &);
   Notebook::Ptr get_notebook_from_tag(const Tag::Ptr &);
+  // Ordinals of the notes, that are in any notebook
+  NoteBitmap get_filed_notes() const;
   static bool is_notebook_tag(const Tag::Ptr &);
   static Notebook::Ptr prompt_create_new_notebook(Gtk::Window *);
   static Notebook::Ptr prompt_create_new_notebook(Gtk::Window *,
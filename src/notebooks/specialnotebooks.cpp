@@ -19,10 +19,14 @@
  */
 
 
+#include <vector>
+
 #include <glibmm/i18n.h>
 
 #include "iconmanager.hpp"
 #include "notemanager.hpp"
+#include "preferences.hpp"
+#include "sharp/string.hpp"
 #include "notebookmanager.hpp"
 #include "specialnotebooks.hpp"
 
@@ -60,6 +64,15 @@ bool AllNotesNotebook::contains_note(const Note::Ptr & note, bool include_system
   return !is_template_note(note);
 }
 
+NoteBitmap AllNotesNotebook::get_notes(bool include_system)
+{
+  NoteBitmap notes = m_note_manager.get_notes().ordinals();
+  if(!include_system) {
+    exclude_template_notes(notes);
+  }
+  return notes;
+}
+
 bool AllNotesNotebook::add_note(const Note::Ptr &)
 {
   return false;
@@ -83,13 +96,23 @@ std::string UnfiledNotesNotebook::get_normalized_name() const
 
 bool UnfiledNotesNotebook::contains_note(const Note::Ptr & note, bool include_system)
 {
-  bool contains = !notebooks::NotebookManager::obj().get_notebook_from_note(note);
+  bool contains = !NotebookManager::obj().get_filed_notes().test(note->ordinal());
   if(!contains || include_system) {
     return contains;
   }
   return !is_template_note(note);
 }
 
+NoteBitmap UnfiledNotesNotebook::get_notes(bool include_system)
+{
+  NoteBitmap notes = m_note_manager.get_notes().ordinals();
+  notes.subtract(NotebookManager::obj().get_filed_notes());
+  if(!include_system) {
+    exclude_template_notes(notes);
+  }
+  return notes;
+}
+
 bool UnfiledNotesNotebook::add_note(const Note::Ptr & note)
 {
   NotebookManager::obj().move_note_to_notebook(note, Notebook::Ptr());
@@ -105,6 +128,13 @@ Glib::RefPtr<Gdk::Pixbuf> UnfiledNotesNotebook::get_icon()
 PinnedNotesNotebook::PinnedNotesNotebook(NoteManager & manager)
   : SpecialNotebook(manager, _("Important"))
 {
+  load_pinned_notes();
+  Preferences::obj().get_schema_settings(Preferences::SCHEMA_GNOTE)->signal_changed()
+    .connect(sigc::mem_fun(*this, &PinnedNotesNotebook::on_setting_changed));
+  manager.signal_note_added
+    .connect(sigc::mem_fun(*this, &PinnedNotesNotebook::on_note_added));
+  manager.signal_note_deleted
+    .connect(sigc::mem_fun(*this, &PinnedNotesNotebook::on_note_deleted));
 }
 
 std::string PinnedNotesNotebook::get_normalized_name() const
@@ -114,7 +144,12 @@ std::string PinnedNotesNotebook::get_normalized_name() const
 
 bool PinnedNotesNotebook::contains_note(const Note::Ptr & note, bool)
 {
-  return note->is_pinned();
+  return m_notes.test(note->ordinal());
+}
+
+NoteBitmap PinnedNotesNotebook::get_notes(bool)
+{
+  return m_notes;
 }
 
 bool PinnedNotesNotebook::add_note(const Note::Ptr & note)
@@ -128,6 +163,50 @@ Glib::RefPtr<Gdk::Pixbuf> PinnedNotesNotebook::get_icon()
   return IconManager::obj().get_icon(IconManager::PIN_DOWN, 22);
 }
 
+void PinnedNotesNotebook::on_note_pin_status_changed(const Note & note, bool pinned)
+{
+  if(pinned) {
+    m_notes.set(note.ordinal());
+  }
+  else {
+    m_notes.reset(note.ordinal());
+  }
+}
+
+void PinnedNotesNotebook::on_setting_changed(const Glib::ustring & key)
+{
+  if(key == Preferences::MENU_PINNED_NOTES) {
+    load_pinned_notes();
+  }
+}
+
+void PinnedNotesNotebook::on_note_added(const NoteBase::Ptr & note)
+{
+  // pinned before it was loaded, like a note coming from synchronization
+  if(static_pointer_cast<Note>(note)->is_pinned()) {
+    m_notes.set(note->ordinal());
+  }
+}
+
+void PinnedNotesNotebook::on_note_deleted(const NoteBase::Ptr & note)
+{
+  m_notes.reset(note->ordinal());
+}
+
+void PinnedNotesNotebook::load_pinned_notes()
+{
+  m_notes.clear();
+  std::vector<std::string> pinned_uris;
+  sharp::string_split(pinned_uris, Preferences::obj().get_schema_settings(
+    Preferences::SCHEMA_GNOTE)->get_string(Preferences::MENU_PINNED_NOTES), " \t\n");
+  FOREACH(const std::string & uri, pinned_uris) {
+    NoteBase::Ptr note = m_note_manager.find_by_uri(uri);
+    if(note) {
+      m_notes.set(note->ordinal());
+    }
+  }
+}
+
 
 ActiveNotesNotebook::ActiveNotesNotebook(NoteManager & manager)
   : SpecialNotebook(manager, _("Active"))
@@ -143,16 +222,26 @@ std::string ActiveNotesNotebook::get_normalized_name() const
 
 bool ActiveNotesNotebook::contains_note(const Note::Ptr & note, bool include_system)
 {
-  bool contains = m_notes.find(note) != m_notes.end();
+  bool contains = m_notes.test(note->ordinal());
   if(!contains || include_system) {
     return contains;
   }
   return !is_template_note(note);
 }
 
+NoteBitmap ActiveNotesNotebook::get_notes(bool include_system)
+{
+  NoteBitmap notes = m_notes;
+  if(!include_system) {
+    exclude_template_notes(notes);
+  }
+  return notes;
+}
+
 bool ActiveNotesNotebook::add_note(const Note::Ptr & note)
 {
-  if(m_notes.insert(note).second) {
+  if(!m_notes.test(note->ordinal())) {
+    m_notes.set(note->ordinal());
     signal_size_changed();
   }
 
@@ -166,28 +255,16 @@ Glib::RefPtr<Gdk::Pixbuf> ActiveNotesNotebook::get_icon()
 
 void ActiveNotesNotebook::on_note_deleted(const NoteBase::Ptr & note)
 {
-  std::set<Note::Ptr>::iterator iter = m_notes.find(static_pointer_cast<Note>(note));
-  if(iter != m_notes.end()) {
-    m_notes.erase(iter);
+  if(m_notes.test(note->ordinal())) {
+    m_notes.reset(note->ordinal());
     signal_size_changed();
   }
 }
 
 bool ActiveNotesNotebook::empty()
 {
-  if(m_notes.size() == 0) {
-    return true;
-  }
-
   // ignore template notes
-  Tag::Ptr templ_tag = template_tag();
-  FOREACH(const Note::Ptr & note, m_notes) {
-    if(!note->contains_tag(templ_tag)) {
-      return false;
-    }
-  }
-
-  return true;
+  return get_notes().empty();
 }
 
 
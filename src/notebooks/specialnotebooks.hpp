@@ -24,8 +24,6 @@
 #define __NOTEBOOKS_SPECIALNOTEBOOKS_HPP_
 
 
-#include <set>
-
 #include "base/macros.hpp"
 #include "notebook.hpp"
 #include "tag.hpp"
@@ -60,6 +58,7 @@ public:
   AllNotesNotebook(NoteManager &);
   virtual std::string get_normalized_name() const override;
   virtual bool        contains_note(const Note::Ptr & note, bool include_system = false) override;
+  virtual NoteBitmap  get_notes(bool include_system = false) override;
   virtual bool        add_note(const Note::Ptr &) override;
   virtual Glib::RefPtr<Gdk::Pixbuf> get_icon() override;
 };
@@ -73,6 +72,7 @@ public:
   UnfiledNotesNotebook(NoteManager &);
   virtual std::string get_normalized_name() const override;
   virtual bool        contains_note(const Note::Ptr & note, bool include_system = false) override;
+  virtual NoteBitmap  get_notes(bool include_system = false) override;
   virtual bool        add_note(const Note::Ptr &) override;
   virtual Glib::RefPtr<Gdk::Pixbuf> get_icon() override;
 };
@@ -86,8 +86,18 @@ public:
   PinnedNotesNotebook(NoteManager &);
   virtual std::string get_normalized_name() const override;
   virtual bool        contains_note(const Note::Ptr & note, bool include_system = false) override;
+  virtual NoteBitmap  get_notes(bool include_system = false) override;
   virtual bool        add_note(const Note::Ptr &) override;
   virtual Glib::RefPtr<Gdk::Pixbuf> get_icon() override;
+  void on_note_pin_status_changed(const Note & note, bool pinned);
+private:
+  void on_setting_changed(const Glib::ustring & key);
+  void on_note_added(const NoteBase::Ptr & note);
+  void on_note_deleted(const NoteBase::Ptr & note);
+  void load_pinned_notes();
+
+  // Parsed from the pinned notes setting only when it changes
+  NoteBitmap m_notes;
 };
 
 
@@ -99,6 +109,7 @@ public:
   ActiveNotesNotebook(NoteManager &);
   virtual std::string get_normalized_name() const override;
   virtual bool        contains_note(const Note::Ptr & note, bool include_system = false) override;
+  virtual NoteBitmap  get_notes(bool include_system = false) override;
   virtual bool        add_note(const Note::Ptr &) override;
   virtual Glib::RefPtr<Gdk::Pixbuf> get_icon() override;
   bool empty();
@@ -106,7 +117,7 @@ public:
 private:
   void on_note_deleted(const NoteBase::Ptr & note);
 
-  std::set<Note::Ptr> m_notes;
+  NoteBitmap m_notes;
 };
 
 
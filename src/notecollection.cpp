@@ -0,0 +1,57 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "notecollection.hpp"
+
+
+namespace gnote {
+
+void NoteCollection::add(const NoteBase::Ptr & note)
+{
+  if(contains(note)) {
+    return;
+  }
+  m_positions[note.get()] = m_entries.insert(Entry(note)).first;
+  m_ordinals.set(note->ordinal());
+}
+
+
+void NoteCollection::remove(const NoteBase::Ptr & note)
+{
+  PositionMap::iterator position = m_positions.find(note.get());
+  if(position != m_positions.end()) {
+    m_entries.erase(position->second);
+    m_positions.erase(position);
+    m_ordinals.reset(note->ordinal());
+  }
+}
+
+
+void NoteCollection::update(const NoteBase::Ptr & note)
+{
+  PositionMap::iterator position = m_positions.find(note.get());
+  if(position == m_positions.end() || position->second->change_date == note->change_date()) {
+    return;
+  }
+  m_entries.erase(position->second);
+  position->second = m_entries.insert(Entry(note)).first;
+}
+
+}
@@ -0,0 +1,168 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _NOTECOLLECTION_HPP_
+#define _NOTECOLLECTION_HPP_
+
+#include <cstddef>
+#include <iterator>
+#include <set>
+
+#include "base/macros.hpp"
+#include "notebase.hpp"
+
+
+namespace gnote {
+
+
+// Notes of a note manager, newest change date first.
+// Position of every note is kept in a hash, so a note, that got a new
+// change date, is moved in O(log n) instead of sorting all notes again.
+// Iteration is read-only, so the notes can be walked without copying them.
+class NoteCollection
+{
+private:
+  struct Entry
+  {
+    explicit Entry(const NoteBase::Ptr & n)
+      : note(n)
+      , change_date(n->change_date())
+      {}
+
+    NoteBase::Ptr note;
+    // Date the note is ordered by, until it is updated
+    sharp::DateTime change_date;
+  };
+  struct NewerFirst
+  {
+    bool operator()(const Entry & a, const Entry & b) const
+      {
+        if(a.change_date != b.change_date) {
+          return a.change_date > b.change_date;
+        }
+        return a.note < b.note;
+      }
+  };
+  typedef std::set<Entry, NewerFirst> EntrySet;
+  typedef unordered_map<const NoteBase*, EntrySet::iterator> PositionMap;
+public:
+  class const_iterator
+  {
+  public:
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef NoteBase::Ptr value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const NoteBase::Ptr *pointer;
+    typedef const NoteBase::Ptr & reference;
+
+    const_iterator()
+      {}
+
+    reference operator*() const
+      {
+        return m_iter->note;
+      }
+    pointer operator->() const
+      {
+        return &m_iter->note;
+      }
+    const_iterator & operator++()
+      {
+        ++m_iter;
+        return *this;
+      }
+    const_iterator operator++(int)
+      {
+        const_iterator old(*this);
+        ++m_iter;
+        return old;
+      }
+    const_iterator & operator--()
+      {
+        --m_iter;
+        return *this;
+      }
+    const_iterator operator--(int)
+      {
+        const_iterator old(*this);
+        --m_iter;
+        return old;
+      }
+    bool operator==(const const_iterator & other) const
+      {
+        return m_iter == other.m_iter;
+      }
+    bool operator!=(const const_iterator & other) const
+      {
+        return m_iter != other.m_iter;
+      }
+  private:
+    friend class NoteCollection;
+
+    explicit const_iterator(EntrySet::const_iterator iter)
+      : m_iter(iter)
+      {}
+
+    EntrySet::const_iterator m_iter;
+  };
+  typedef const_iterator iterator;
+  typedef NoteBase::Ptr value_type;
+  typedef std::size_t size_type;
+
+  const_iterator begin() const
+    {
+      return const_iterator(m_entries.begin());
+    }
+  const_iterator end() const
+    {
+      return const_iterator(m_entries.end());
+    }
+  size_type size() const
+    {
+      return m_entries.size();
+    }
+  bool empty() const
+    {
+      return m_entries.empty();
+    }
+  bool contains(const NoteBase::Ptr & note) const
+    {
+      return m_positions.find(note.get()) != m_positions.end();
+    }
+  // Ordinals of all notes in collection
+  const NoteBitmap & ordinals() const
+    {
+      return m_ordinals;
+    }
+
+  // Does nothing, if note is already there
+  void add(const NoteBase::Ptr & note);
+  void remove(const NoteBase::Ptr & note);
+  // Move note to the position for its current change date
+  void update(const NoteBase::Ptr & note);
+private:
+  EntrySet m_entries;
+  PositionMap m_positions;
+  NoteBitmap m_ordinals;
+};
+
+}
+
+#endif
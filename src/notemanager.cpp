@@ -23,20 +23,104 @@
 #include <config.h>
 #endif
 
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
 #include <glibmm/i18n.h>
 
 #include "applicationaddin.hpp"
 #include "debug.hpp"
 #include "notemanager.hpp"
+#include "notemetadatacache.hpp"
+#include "notesavescheduler.hpp"
+#include "searchindex.hpp"
 #include "addinmanager.hpp"
 #include "ignote.hpp"
 #include "itagmanager.hpp"
 #include "preferences.hpp"
 #include "sharp/directory.hpp"
 #include "sharp/dynamicmodule.hpp"
+#include "sharp/workerpool.hpp"
 
 namespace gnote {
 
+  namespace {
+
+  // Reads headers of note files on a pool of threads, taking them from
+  // metadata cache for unchanged files.
+  // Note text is not read, it is loaded when needed.
+  class NoteHeaderLoader
+  {
+  public:
+    struct Header
+    {
+      std::string file;
+      NoteData *data;
+      std::string content_hash;
+      Glib::ustring version;
+      std::string error;
+      bool cached;
+    };
+
+    NoteHeaderLoader(const std::list<std::string> & files, const NoteMetadataCache & cache)
+      : m_cache(cache)
+      {
+        m_headers.resize(files.size());
+        std::vector<Header>::iterator header = m_headers.begin();
+        for(std::list<std::string>::const_iterator iter = files.begin(); iter != files.end(); ++iter, ++header) {
+          header->file = *iter;
+          header->data = NULL;
+          header->cached = false;
+        }
+      }
+
+    std::vector<Header> & load()
+      {
+        std::size_t thread_count = std::min<std::size_t>(m_headers.size() / MIN_NOTES_PER_THREAD + 1,
+                                                         sharp::WorkerPool::processor_count());
+        sharp::WorkerPool(m_headers.size(), sigc::mem_fun(*this, &NoteHeaderLoader::load_header))
+          .run(thread_count);
+        return m_headers;
+      }
+  private:
+    static const std::size_t MIN_NOTES_PER_THREAD = 50;
+
+    void load_header(std::size_t index)
+      {
+        Header & header = m_headers[index];
+        try {
+          header.data = new NoteData(NoteBase::url_from_path(header.file));
+          std::list<Glib::ustring> tags;
+          NoteMetadataCache::FileStamp stamp;
+          if(NoteMetadataCache::get_file_stamp(header.file, stamp)
+             && m_cache.lookup(header.file, stamp, *header.data, tags, header.content_hash)) {
+            header.data->set_text_file(header.file, stamp);
+            header.version = NoteArchiver::CURRENT_VERSION;
+            header.cached = true;
+          }
+          else {
+            NoteArchiver::read_header(header.file, *header.data, tags, header.version);
+          }
+          FOREACH(const Glib::ustring & tag_str, tags) {
+            Tag::Ptr tag = ITagManager::obj().get_or_create_tag(tag_str);
+            header.data->tags()[tag->normalized_name()] = tag;
+          }
+        }
+        catch(const std::exception & e) {
+          delete header.data;
+          header.data = NULL;
+          header.error = e.what();
+        }
+      }
+
+    const NoteMetadataCache & m_cache;
+    std::vector<Header> m_headers;
+  };
+
+  }
+
+
   NoteManager::NoteManager(const Glib::ustring & directory)
     : NoteManagerBase(directory)
   {
@@ -49,6 +133,9 @@ namespace gnote {
   void NoteManager::_common_init(const Glib::ustring & directory, const Glib::ustring & backup_directory)
   {
     m_addin_mgr = NULL;
+    m_save_scheduler = new NoteSaveScheduler;
+    m_upgrade_timeout = new utils::InterruptableTimeout;
+    m_upgrade_timeout->signal_timeout.connect(sigc::mem_fun(*this, &NoteManager::on_upgrade_timeout));
     bool is_first_run = first_run();
 
     NoteManagerBase::_common_init(directory, backup_directory);
@@ -63,6 +150,10 @@ namespace gnote {
 
     m_addin_mgr = create_addin_manager ();
 
+    m_metadata_cache_dirty = false;
+    signal_note_saved.connect(sigc::mem_fun(*this, &NoteManager::on_note_metadata_changed));
+    signal_note_deleted.connect(sigc::mem_fun(*this, &NoteManager::on_note_metadata_changed));
+
     if (is_first_run) {
       std::list<ImportAddin*> l;
       m_addin_mgr->get_import_addins(l);
@@ -102,6 +193,8 @@ namespace gnote {
 
   NoteManager::~NoteManager()
   {
+    delete m_upgrade_timeout;
+    delete m_save_scheduler;
     delete m_addin_mgr;
   }
 
@@ -184,20 +277,49 @@ namespace gnote {
     std::list<std::string> files;
     sharp::directory_get_files_with_ext(notes_dir(), ".note", files);
 
-    for(std::list<std::string>::const_iterator iter = files.begin();
-        iter != files.end(); ++iter) {
-      const std::string & file_path(*iter);
+    std::size_t cached_count = 0;
+    std::size_t cache_size = 0;
+    std::vector<NoteHeaderLoader::Header> headers;
+    {
+      // Cache file only stays mapped while headers are loaded
+      NoteMetadataCache cache(metadata_cache_file());
+      NoteHeaderLoader loader(files, cache);
+      loader.load().swap(headers);
+      cache_size = cache.size();
+    }
+    FOREACH(NoteHeaderLoader::Header & header, headers) {
+      if(header.cached) {
+        ++cached_count;
+      }
+      const std::string & file_path(header.file);
       try {
-        Note::Ptr note = Note::load(file_path, *this);
+        if(!header.data) {
+          throw std::runtime_error(header.error);
+        }
+
+        Note::Ptr note = Note::create_existing_note(header.data, file_path, *this);
+        header.data = NULL;
+        note->set_content_hash(header.content_hash);
+        if(header.version != NoteArchiver::CURRENT_VERSION) {
+          m_outdated_notes.push_back(note);
+        }
         add_note(note);
       } 
       catch (const std::exception & e) {
+        delete header.data;
         /* TRANSLATORS: first %s is file, second is error */
         ERR_OUT(_("Error parsing note XML, skipping \"%s\": %s"),
                 file_path.c_str(), e.what());
       }
     }
+    // Rewrite cache, if anything was missing or outdated in it
+    m_metadata_cache_dirty = cached_count != files.size() || cache_size != cached_count;
     post_load();
+    save_metadata_cache();
+    if(!m_outdated_notes.empty()) {
+      // Old format, rewritten in one batch instead of holding up startup
+      m_upgrade_timeout->reset(4000);
+    }
     // Make sure that a Start Note Uri is set in the preferences, and
     // make sure that the Uri is valid to prevent bug #508982. This
     // has to be done here for long-time Tomboy users who won't go
@@ -218,14 +340,13 @@ namespace gnote {
   {
     NoteManagerBase::post_load();
 
-    // Load all the addins for our notes.
-    // Iterating through copy of notes list, because list may be
-    // changed when loading addins.
-    NoteBase::List notesCopy(m_notes);
-    FOREACH(const NoteBase::Ptr & iter, notesCopy) {
-      Note::Ptr note(static_pointer_cast<Note>(iter));
+    // Note addins are not loaded here, but when note buffer is created
+  }
 
-      m_addin_mgr->load_addins_for_note (note);
+  void NoteManager::load_note_addins(const Note::Ptr & note)
+  {
+    if(m_addin_mgr && !m_addin_mgr->note_addins_loaded(note)) {
+      m_addin_mgr->load_addins_for_note(note);
     }
   }
 
@@ -273,11 +394,54 @@ namespace gnote {
     DBG_OUT("Saving unsaved notes...");
       
     // Use a copy of the notes to prevent bug #510442 (crash on exit
-    // when iterating the notes to save them.
-    NoteBase::List notesCopy(m_notes);
+    // when iterating the notes to save them, saving moves notes in the collection.
+    std::vector<NoteBase::Ptr> notesCopy(m_notes.begin(), m_notes.end());
+    // Nothing to wait for after the last writes, make sure they reach the disk
+    m_save_scheduler->sync_to_disk(true);
     FOREACH(const NoteBase::Ptr & note, notesCopy) {
       note->save();
     }
+    m_save_scheduler->flush();
+
+    search_index().save();
+    save_metadata_cache();
+  }
+
+  std::string NoteManager::metadata_cache_file() const
+  {
+    return Glib::build_filename(notes_dir(), NoteMetadataCache::CACHE_FILE_NAME);
+  }
+
+  void NoteManager::save_metadata_cache()
+  {
+    if(m_metadata_cache_dirty && NoteMetadataCache::write(metadata_cache_file(), m_notes)) {
+      m_metadata_cache_dirty = false;
+    }
+  }
+
+  void NoteManager::on_note_metadata_changed(const NoteBase::Ptr &)
+  {
+    m_metadata_cache_dirty = true;
+  }
+
+  // Save scheduler writes the whole batch within one flush window
+  void NoteManager::on_upgrade_timeout()
+  {
+    FOREACH(const NoteBase::WeakPtr & weak_note, m_outdated_notes) {
+      Note::Ptr note = static_pointer_cast<Note>(weak_note.lock());
+      if(note) {
+        note->rewrite();
+      }
+    }
+    m_outdated_notes.clear();
+  }
+
+
+  void NoteManager::delete_note(const NoteBase::Ptr & note)
+  {
+    // Pending write would bring the deleted file back
+    m_save_scheduler->cancel(note->file_path());
+    NoteManagerBase::delete_note(note);
   }
 
   NoteBase::Ptr NoteManager::note_load(const Glib::ustring & file_name)
@@ -302,12 +466,8 @@ namespace gnote {
   NoteBase::Ptr NoteManager::create_new_note(const Glib::ustring & title, const Glib::ustring & xml_content, 
                                         const std::string & guid)
   {
-    NoteBase::Ptr new_note = NoteManagerBase::create_new_note(title, xml_content, guid);
-
-    // Load all the addins for the new note
-    m_addin_mgr->load_addins_for_note(static_pointer_cast<Note>(new_note));
-
-    return new_note;
+    // Addins are loaded when buffer for the note is created
+    return NoteManagerBase::create_new_note(title, xml_content, guid);
   }
 
   NoteBase::Ptr NoteManager::note_create_new(const Glib::ustring & title, const Glib::ustring & file_name)
@@ -29,6 +29,7 @@
 namespace gnote {
 
   class AddinManager;
+  class NoteSaveScheduler;
 
   class NoteManager 
     : public NoteManagerBase
@@ -47,7 +48,15 @@ namespace gnote {
         return *m_addin_mgr;
       }
 
+    NoteSaveScheduler & save_scheduler()
+      {
+        return *m_save_scheduler;
+      }
+
     virtual NoteBase::Ptr get_or_create_template_note() override;
+    virtual void delete_note(const NoteBase::Ptr & note) override;
+    // Load addins for note, unless they are already loaded
+    void load_note_addins(const Note::Ptr & note);
 
     ChangedHandler signal_note_buffer_changed;
 
@@ -69,8 +78,17 @@ namespace gnote {
     void create_start_notes();
     void load_notes();
     void on_exiting_event();
+    std::string metadata_cache_file() const;
+    void save_metadata_cache();
+    void on_note_metadata_changed(const NoteBase::Ptr & note);
+    void on_upgrade_timeout();
 
     AddinManager   *m_addin_mgr;
+    NoteSaveScheduler *m_save_scheduler;
+    bool            m_metadata_cache_dirty;
+    // Notes in older file format, rewritten together after startup
+    std::list<NoteBase::WeakPtr> m_outdated_notes;
+    utils::InterruptableTimeout *m_upgrade_timeout;
   };
 
 
@@ -19,16 +19,16 @@
  */
 
 
-#include <boost/bind.hpp>
 #include <boost/format.hpp>
 #include <glibmm/i18n.h>
 
 #include "debug.hpp"
 #include "ignote.hpp"
 #include "itagmanager.hpp"
+#include "linkindex.hpp"
 #include "notemanagerbase.hpp"
+#include "searchindex.hpp"
 #include "utils.hpp"
-#include "trie.hpp"
 #include "notebooks/notebookmanager.hpp"
 #include "sharp/directory.hpp"
 #include "sharp/files.hpp"
@@ -38,11 +38,10 @@
 
 namespace gnote {
 
-bool compare_dates(const NoteBase::Ptr & a, const NoteBase::Ptr & b)
-{
-  return (static_pointer_cast<Note>(a)->change_date() > static_pointer_cast<Note>(b)->change_date());
-}
-
+// Number of removed titles to always tolerate in trie before rebuilding it
+const size_t MIN_TRIE_GARBAGE = 100;
+// Changed titles are applied to trie after this many milliseconds of no changes
+const guint TRIE_UPDATE_TIMEOUT = 200;
 
 class TrieController
 {
@@ -52,17 +51,26 @@ public:
 
   void add_note(const NoteBase::Ptr & note);
   void update();
-  TrieTree<NoteBase::WeakPtr> *title_trie() const
+  // Pending changes are applied before trie is used
+  const TrieTree<NoteBase::WeakPtr> *title_trie()
     {
+      flush();
       return m_title_trie;
     }
 private:
   void on_note_added(const NoteBase::Ptr & added);
   void on_note_deleted (const NoteBase::Ptr & deleted);
   void on_note_renamed(const NoteBase::Ptr & renamed, const Glib::ustring & old_title);
+  void on_updates_thawed();
+  bool remove_title(const Glib::ustring & title, const NoteBase::Ptr & note);
+  void apply_changes();
+  void flush();
 
   NoteManagerBase & m_manager;
   TrieTree<NoteBase::WeakPtr> *m_title_trie;
+  bool m_compute_pending;
+  bool m_rebuild_pending;
+  utils::InterruptableTimeout m_update_timeout;
 };
 
 
@@ -91,12 +99,18 @@ Glib::ustring NoteManagerBase::sanitize_xml_content(const Glib::ustring & xml_co
 
 
 NoteManagerBase::NoteManagerBase(const Glib::ustring & directory)
-  : m_notes_dir(directory)
+  : m_trie_controller(NULL)
+  , m_search_index(NULL)
+  , m_link_index(NULL)
+  , m_notes_dir(directory)
+  , m_freeze_count(0)
 {
 }
 
 NoteManagerBase::~NoteManagerBase()
 {
+  delete m_link_index;
+  delete m_search_index;
   delete m_trie_controller;
 }
 
@@ -117,6 +131,22 @@ void NoteManagerBase::_common_init(const Glib::ustring & /*directory*/, const Gl
   m_trie_controller = create_trie_controller();
 
   create_notes_dir();
+
+  m_search_index = new SearchIndex(*this, Glib::build_filename(notes_dir(), SearchIndex::INDEX_FILE_NAME));
+  m_link_index = new LinkIndex(*this);
+  // Done here rather than in a note addin, since addins only exist for opened notes
+  signal_note_tag_removed.connect(sigc::mem_fun(*this, &NoteManagerBase::on_note_tag_removed));
+}
+
+// Tags, that no note has anymore, are removed.
+// System tags, like the ones of notebooks, are kept for their owners.
+void NoteManagerBase::on_note_tag_removed(const NoteBase::Ptr &, const std::string & tag_name)
+{
+  Tag::Ptr tag = ITagManager::obj().get_tag(tag_name);
+  DBG_OUT("Tag removed, popularity count: %d", tag ? tag->popularity() : 0);
+  if(tag && !tag->is_system() && tag->popularity() == 0) {
+    ITagManager::obj().remove_tag(tag);
+  }
 }
 
 bool NoteManagerBase::first_run() const
@@ -153,10 +183,18 @@ TrieController *NoteManagerBase::create_trie_controller()
 
 void NoteManagerBase::post_load()
 {
-  m_notes.sort(boost::bind(&compare_dates, _1, _2));
-
   // Update the trie so addins can access it, if they want.
   m_trie_controller->update ();
+
+  // Reindex notes that were changed since index was last saved
+  m_search_index->update();
+}
+
+void NoteManagerBase::thaw_updates()
+{
+  if(m_freeze_count > 0 && --m_freeze_count == 0) {
+    signal_updates_thawed();
+  }
 }
 
 size_t NoteManagerBase::trie_max_length()
@@ -169,18 +207,14 @@ TrieHit<NoteBase::WeakPtr>::ListPtr NoteManagerBase::find_trie_matches(const Gli
   return m_trie_controller->title_trie()->find_matches(match);
 }
 
+const TrieTree<NoteBase::WeakPtr> & NoteManagerBase::title_trie() const
+{
+  return *m_trie_controller->title_trie();
+}
+
 NoteBase::List NoteManagerBase::get_notes_linking_to(const Glib::ustring & title) const
 {
-  Glib::ustring tag = "<link:internal>" + utils::XmlEncoder::encode(title) + "</link:internal>";
-  NoteBase::List result;
-  FOREACH(const NoteBase::Ptr & note, m_notes) {
-    if(note->get_title() != title) {
-      if(note->get_complete_note_xml().find(tag) != std::string::npos) {
-        result.push_back(note);
-      }
-    }
-  }
-  return result;
+  return m_link_index->get_notes_linking_to(title);
 }
 
 void NoteManagerBase::add_note(const NoteBase::Ptr & note)
@@ -188,38 +222,86 @@ void NoteManagerBase::add_note(const NoteBase::Ptr & note)
   if(note) {
     note->signal_renamed.connect(sigc::mem_fun(*this, &NoteManagerBase::on_note_rename));
     note->signal_saved.connect(sigc::mem_fun(*this, &NoteManagerBase::on_note_save));
-    m_notes.push_back(note);
+    m_notes.add(note);
+    index_note(note);
+  }
+}
+
+std::string NoteManagerBase::title_key(const Glib::ustring & title)
+{
+  return title.lowercase().raw();
+}
+
+void NoteManagerBase::index_note(const NoteBase::Ptr & note)
+{
+  UriEntry & entry = m_notes_by_uri[note->uri()];
+  if(entry.note) {
+    unindex_title(entry.note, entry.title_key);
+  }
+  entry.note = note;
+  entry.title_key = title_key(note->get_title());
+  m_notes_by_title.insert(std::make_pair(entry.title_key, note));
+}
+
+void NoteManagerBase::unindex_note(const NoteBase::Ptr & note)
+{
+  UriMap::iterator iter = m_notes_by_uri.find(note->uri());
+  if(iter != m_notes_by_uri.end()) {
+    unindex_title(note, iter->second.title_key);
+    m_notes_by_uri.erase(iter);
+  }
+}
+
+void NoteManagerBase::unindex_title(const NoteBase::Ptr & note, const std::string & key)
+{
+  std::pair<TitleMap::iterator, TitleMap::iterator> range = m_notes_by_title.equal_range(key);
+  for(TitleMap::iterator iter = range.first; iter != range.second; ++iter) {
+    if(iter->second == note) {
+      m_notes_by_title.erase(iter);
+      return;
+    }
   }
 }
 
 void NoteManagerBase::on_note_rename(const NoteBase::Ptr & note, const Glib::ustring & old_title)
 {
+  // Old title is not always reported correctly, use the key note is indexed with
+  UriMap::iterator iter = m_notes_by_uri.find(note->uri());
+  if(iter != m_notes_by_uri.end()) {
+    unindex_title(note, iter->second.title_key);
+    iter->second.title_key = title_key(note->get_title());
+    m_notes_by_title.insert(std::make_pair(iter->second.title_key, note));
+  }
+
   signal_note_renamed(note, old_title);
-  m_notes.sort(boost::bind(&compare_dates, _1, _2));
+  m_notes.update(note);
 }
 
 void NoteManagerBase::on_note_save (const NoteBase::Ptr & note)
 {
   signal_note_saved(note);
-  m_notes.sort(boost::bind(&compare_dates, _1, _2));
+  m_notes.update(note);
 }
 
+// Of several notes with the same title, the most recently changed one is found
 NoteBase::Ptr NoteManagerBase::find(const Glib::ustring & linked_title) const
 {
-  FOREACH(const NoteBase::Ptr & note, m_notes) {
-    if(note->get_title().lowercase() == linked_title.lowercase()) {
-      return note;
+  std::pair<TitleMap::const_iterator, TitleMap::const_iterator> range
+    = m_notes_by_title.equal_range(title_key(linked_title));
+  NoteBase::Ptr note;
+  for(TitleMap::const_iterator iter = range.first; iter != range.second; ++iter) {
+    if(!note || iter->second->change_date() > note->change_date()) {
+      note = iter->second;
     }
   }
-  return NoteBase::Ptr();
+  return note;
 }
 
 NoteBase::Ptr NoteManagerBase::find_by_uri(const std::string & uri) const
 {
-  FOREACH(const NoteBase::Ptr & note, m_notes) {
-    if (note->uri() == uri) {
-      return note;
-    }
+  UriMap::const_iterator iter = m_notes_by_uri.find(uri);
+  if(iter != m_notes_by_uri.end()) {
+    return iter->second.note;
   }
   return NoteBase::Ptr();
 }
@@ -342,7 +424,8 @@ NoteBase::Ptr NoteManagerBase::create_new_note(const Glib::ustring & title, cons
   new_note->signal_renamed.connect(sigc::mem_fun(*this, &NoteManagerBase::on_note_rename));
   new_note->signal_saved.connect(sigc::mem_fun(*this, &NoteManagerBase::on_note_save));
 
-  m_notes.push_back(new_note);
+  m_notes.add(new_note);
+  index_note(new_note);
 
   signal_note_added(new_note);
 
@@ -461,6 +544,7 @@ void NoteManagerBase::delete_note(const NoteBase::Ptr & note)
   }
 
   m_notes.remove(note);
+  unindex_note(note);
   note->delete_note();
 
   DBG_OUT("Deleting note '%s'.", note->get_title().c_str());
@@ -501,10 +585,14 @@ NoteBase::Ptr NoteManagerBase::create_with_guid(const Glib::ustring & title, con
 TrieController::TrieController(NoteManagerBase & manager)
   : m_manager(manager)
   ,  m_title_trie(NULL)
+  , m_compute_pending(false)
+  , m_rebuild_pending(false)
 {
   m_manager.signal_note_deleted.connect(sigc::mem_fun(*this, &TrieController::on_note_deleted));
   m_manager.signal_note_added.connect(sigc::mem_fun(*this, &TrieController::on_note_added));
   m_manager.signal_note_renamed.connect(sigc::mem_fun(*this, &TrieController::on_note_renamed));
+  m_manager.signal_updates_thawed.connect(sigc::mem_fun(*this, &TrieController::on_updates_thawed));
+  m_update_timeout.signal_timeout.connect(sigc::mem_fun(*this, &TrieController::flush));
 
   update();
 }
@@ -519,20 +607,78 @@ void TrieController::on_note_added(const NoteBase::Ptr & note)
   add_note(note);
 }
 
-void TrieController::on_note_deleted(const NoteBase::Ptr &)
+void TrieController::on_note_deleted(const NoteBase::Ptr & deleted)
 {
-  update();
+  remove_title(deleted->get_title(), deleted);
+
+  // Removed titles leave their states behind, drop them once there are many
+  if(m_title_trie->removed_count() > std::max<size_t>(MIN_TRIE_GARBAGE, m_manager.get_notes().size())) {
+    m_rebuild_pending = true;
+  }
+  apply_changes();
 }
 
-void TrieController::on_note_renamed(const NoteBase::Ptr &, const Glib::ustring &)
+void TrieController::on_note_renamed(const NoteBase::Ptr & renamed, const Glib::ustring & old_title)
 {
-  update();
+  // Some renames report new title as the old one, rebuild in that case
+  if(old_title == renamed->get_title() || !remove_title(old_title, renamed)) {
+    m_rebuild_pending = true;
+    apply_changes();
+    return;
+  }
+  add_note(renamed);
+}
+
+void TrieController::on_updates_thawed()
+{
+  apply_changes();
+}
+
+// Titles are keywords in trie, so a title shared by several notes is only
+// there once. Keep it as long as some note still has it.
+bool TrieController::remove_title(const Glib::ustring & title, const NoteBase::Ptr & note)
+{
+  if(!m_title_trie->remove_keyword(title)) {
+    return false;
+  }
+  NoteBase::Ptr other = m_manager.find(title);
+  if(other && other != note) {
+    m_title_trie->add_keyword(other->get_title(), other);
+    m_compute_pending = true;
+  }
+  return true;
 }
 
 void TrieController::add_note(const NoteBase::Ptr & note)
 {
   m_title_trie->add_keyword(note->get_title(), note);
-  m_title_trie->compute_failure_graph();
+  m_compute_pending = true;
+  apply_changes();
+}
+
+// Pending changes are applied once for a batch of changed notes, either
+// after updates are thawed (see NoteManagerBase::freeze_updates()) or
+// once notes stop changing, unless trie is needed earlier
+void TrieController::apply_changes()
+{
+  if(m_manager.updates_frozen()) {
+    return;
+  }
+  if(m_rebuild_pending || m_compute_pending) {
+    m_update_timeout.reset(TRIE_UPDATE_TIMEOUT);
+  }
+}
+
+void TrieController::flush()
+{
+  m_update_timeout.cancel();
+  if(m_rebuild_pending) {
+    update();
+  }
+  else if(m_compute_pending) {
+    m_title_trie->compute_failure_graph();
+    m_compute_pending = false;
+  }
 }
 
 void TrieController::update()
@@ -546,6 +692,9 @@ void TrieController::update()
     m_title_trie->add_keyword(note->get_title(), note);
   }
   m_title_trie->compute_failure_graph();
+  m_compute_pending = false;
+  m_rebuild_pending = false;
+  m_update_timeout.cancel();
 }
 
 
@@ -23,11 +23,14 @@
 #define _NOTEMANAGERBASE_HPP_
 
 #include "notebase.hpp"
-#include "triehit.hpp"
+#include "notecollection.hpp"
+#include "trie.hpp"
 
 
 namespace gnote {
 
+class LinkIndex;
+class SearchIndex;
 class TrieController;
 
 class NoteManagerBase
@@ -44,6 +47,15 @@ public:
 
   size_t trie_max_length();
   TrieHit<NoteBase::WeakPtr>::ListPtr find_trie_matches(const Glib::ustring &);
+  const TrieTree<NoteBase::WeakPtr> & title_trie() const;
+  SearchIndex & search_index() const
+    {
+      return *m_search_index;
+    }
+  LinkIndex & link_index() const
+    {
+      return *m_link_index;
+    }
 
   void read_only(bool ro)
     {
@@ -63,7 +75,7 @@ public:
   virtual NoteBase::Ptr get_or_create_template_note();
   NoteBase::Ptr find_template_note() const;
   Glib::ustring get_unique_name(const Glib::ustring & basename) const;
-  void delete_note(const NoteBase::Ptr & note);
+  virtual void delete_note(const NoteBase::Ptr & note);
   // Import a note read from file_path
   // Will ensure the sanity including the unique title.
   NoteBase::Ptr import_note(const Glib::ustring & file_path);
@@ -73,7 +85,8 @@ public:
     {
       return m_notes_dir;
     }
-  const NoteBase::List & get_notes() const
+  // Newest change date first
+  const NoteCollection & get_notes() const
     { 
       return m_notes;
     }
@@ -83,10 +96,28 @@ public:
       return m_start_note_uri; 
     }
 
+  // Many notes are about to change. Listeners can check updates_frozen()
+  // and postpone expensive refreshes until signal_updates_thawed.
+  // Calls can be nested, signal is emitted when the last freeze is thawed.
+  void freeze_updates()
+    {
+      ++m_freeze_count;
+    }
+  void thaw_updates();
+  bool updates_frozen() const
+    {
+      return m_freeze_count > 0;
+    }
+
   ChangedHandler signal_note_deleted;
   ChangedHandler signal_note_added;
   NoteBase::RenamedHandler signal_note_renamed;
   NoteBase::SavedHandler signal_note_saved;
+  // Tag changes of every note, open or not. Lets addins follow all notes
+  // without connecting to each of them.
+  NoteBase::TagAddedHandler signal_note_tag_added;
+  NoteBase::TagRemovedHandler signal_note_tag_removed;
+  sigc::signal<void> signal_updates_thawed;
 protected:
   virtual void _common_init(const Glib::ustring & directory, const Glib::ustring & backup);
   bool first_run() const;
@@ -96,6 +127,7 @@ protected:
   void add_note(const NoteBase::Ptr &);
   void on_note_rename(const NoteBase::Ptr & note, const Glib::ustring & old_title);
   void on_note_save(const NoteBase::Ptr & note);
+  void on_note_tag_removed(const NoteBase::Ptr & note, const std::string & tag_name);
   virtual NoteBase::Ptr create_note_from_template(const Glib::ustring & title,
                                                   const NoteBase::Ptr & template_note,
                                                   const std::string & guid);
@@ -107,18 +139,37 @@ protected:
   Glib::ustring make_new_file_name(const Glib::ustring & guid) const;
   virtual NoteBase::Ptr note_load(const Glib::ustring & file_name) = 0;
 
-  NoteBase::List m_notes;
+  NoteCollection m_notes;
   std::string m_start_note_uri;
   Glib::ustring m_backup_dir;
   Glib::ustring m_default_note_template_title;
 private:
+  // Several notes can have the same title
+  typedef unordered_multimap<std::string, NoteBase::Ptr> TitleMap;
+  struct UriEntry
+  {
+    NoteBase::Ptr note;
+    // Key of the note in title map
+    std::string title_key;
+  };
+  typedef unordered_map<std::string, UriEntry> UriMap;
+
+  static std::string title_key(const Glib::ustring & title);
+  void index_note(const NoteBase::Ptr & note);
+  void unindex_note(const NoteBase::Ptr & note);
+  void unindex_title(const NoteBase::Ptr & note, const std::string & key);
   void create_notes_dir() const;
   bool create_directory(const Glib::ustring & directory) const;
   TrieController *create_trie_controller();
 
   TrieController *m_trie_controller;
+  SearchIndex *m_search_index;
+  LinkIndex *m_link_index;
+  TitleMap m_notes_by_title;
+  UriMap m_notes_by_uri;
   Glib::ustring m_notes_dir;
   bool m_read_only;
+  int m_freeze_count;
 };
 
 }
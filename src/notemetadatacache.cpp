@@ -0,0 +1,348 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstring>
+#include <fstream>
+
+#include <glibmm/i18n.h>
+#include <glibmm/miscutils.h>
+
+#include "debug.hpp"
+#include "notemetadatacache.hpp"
+#include "sharp/files.hpp"
+
+
+namespace gnote {
+
+namespace {
+
+// File layout, all numbers in host byte order:
+//   magic, format version, entry count, checksum of the rest of the file
+//   entries, each prefixed by its length:
+//     file name, file stamp, title, create/change/metadata change dates,
+//     cursor, selection bound, width, height, tag count, tag names, content hash
+// Strings are stored as length followed by UTF-8 bytes.
+const char CACHE_MAGIC[4] = { 'G', 'N', 'M', 'C' };
+const guint32 CACHE_VERSION = 3;
+const std::size_t HEADER_SIZE = sizeof(CACHE_MAGIC) + 3 * sizeof(guint32);
+
+guint32 checksum(const char *data, std::size_t size)
+{
+  // FNV-1a
+  guint32 hash = 2166136261u;
+  for(std::size_t i = 0; i < size; ++i) {
+    hash ^= guint8(data[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+
+class CacheWriter
+{
+public:
+  explicit CacheWriter(std::string & buffer)
+    : m_buffer(buffer)
+    {}
+
+  template <typename T>
+  void write(T value)
+    {
+      m_buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+  void write_string(const std::string & value)
+    {
+      write<guint32>(value.size());
+      m_buffer.append(value);
+    }
+  void write_date(const sharp::DateTime & date)
+    {
+      write<gint64>(date.sec());
+      write<gint64>(date.usec());
+    }
+private:
+  std::string & m_buffer;
+};
+
+
+// All reads are bounds checked, reader goes to failed state on overrun
+class CacheReader
+{
+public:
+  CacheReader(const char *begin, const char *end)
+    : m_pos(begin)
+    , m_end(end)
+    , m_failed(false)
+    {}
+
+  template <typename T>
+  T read()
+    {
+      T value = T();
+      if(!m_failed && std::size_t(m_end - m_pos) >= sizeof(T)) {
+        std::memcpy(&value, m_pos, sizeof(T));
+        m_pos += sizeof(T);
+      }
+      else {
+        m_failed = true;
+      }
+      return value;
+    }
+  std::string read_string()
+    {
+      guint32 length = read<guint32>();
+      if(m_failed || std::size_t(m_end - m_pos) < length) {
+        m_failed = true;
+        return std::string();
+      }
+      std::string value(m_pos, length);
+      m_pos += length;
+      return value;
+    }
+  sharp::DateTime read_date()
+    {
+      gint64 sec = read<gint64>();
+      gint64 usec = read<gint64>();
+      return sharp::DateTime(sec, usec);
+    }
+  const char *skip(std::size_t length)
+    {
+      if(m_failed || std::size_t(m_end - m_pos) < length) {
+        m_failed = true;
+        return m_end;
+      }
+      m_pos += length;
+      return m_pos;
+    }
+  const char *pos() const
+    {
+      return m_pos;
+    }
+  bool at_end() const
+    {
+      return m_pos == m_end;
+    }
+  bool failed() const
+    {
+      return m_failed;
+    }
+private:
+  const char *m_pos;
+  const char *m_end;
+  bool m_failed;
+};
+
+}
+
+
+const char *NoteMetadataCache::CACHE_FILE_NAME = "note-metadata-cache";
+
+
+NoteMetadataCache::NoteMetadataCache(const std::string & cache_file)
+  : m_cache_file(cache_file)
+  , m_mapped_file(NULL)
+{
+  if(!load()) {
+    m_entries.clear();
+  }
+}
+
+
+NoteMetadataCache::~NoteMetadataCache()
+{
+  if(m_mapped_file) {
+    g_mapped_file_unref(m_mapped_file);
+  }
+}
+
+
+bool NoteMetadataCache::load()
+{
+  if(!sharp::file_exists(m_cache_file)) {
+    return false;
+  }
+
+  GError *error = NULL;
+  m_mapped_file = g_mapped_file_new(m_cache_file.c_str(), FALSE, &error);
+  if(!m_mapped_file) {
+    ERR_OUT(_("Failed to open note metadata cache %s: %s"), m_cache_file.c_str(), error->message);
+    g_error_free(error);
+    return false;
+  }
+
+  const char *contents = g_mapped_file_get_contents(m_mapped_file);
+  std::size_t length = g_mapped_file_get_length(m_mapped_file);
+  if(length < HEADER_SIZE || std::memcmp(contents, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0) {
+    DBG_OUT("Note metadata cache %s has unknown format, rebuilding", m_cache_file.c_str());
+    return false;
+  }
+
+  CacheReader header(contents + sizeof(CACHE_MAGIC), contents + HEADER_SIZE);
+  guint32 version = header.read<guint32>();
+  guint32 count = header.read<guint32>();
+  guint32 sum = header.read<guint32>();
+  const char *payload = contents + HEADER_SIZE;
+  const char *end = contents + length;
+  if(version != CACHE_VERSION || sum != checksum(payload, end - payload)) {
+    DBG_OUT("Note metadata cache %s is outdated or corrupt, rebuilding", m_cache_file.c_str());
+    return false;
+  }
+
+  // Only file names are read here, the rest is decoded on lookup
+  CacheReader reader(payload, end);
+  for(guint32 i = 0; i < count; ++i) {
+    guint32 entry_length = reader.read<guint32>();
+    Entry entry;
+    entry.begin = reader.pos();
+    entry.end = reader.skip(entry_length);
+    if(reader.failed()) {
+      return false;
+    }
+    CacheReader entry_reader(entry.begin, entry.end);
+    std::string file_name = entry_reader.read_string();
+    if(entry_reader.failed()) {
+      return false;
+    }
+    m_entries[file_name] = entry;
+  }
+
+  return reader.at_end();
+}
+
+
+bool NoteMetadataCache::lookup(const std::string & file, const FileStamp & stamp,
+                               NoteData & data, std::list<Glib::ustring> & tags,
+                               std::string & content_hash) const
+{
+  EntryMap::const_iterator iter = m_entries.find(Glib::path_get_basename(file));
+  if(iter == m_entries.end()) {
+    return false;
+  }
+
+  CacheReader reader(iter->second.begin, iter->second.end);
+  reader.read_string();
+  FileStamp cached_stamp;
+  cached_stamp.mtime = reader.read<gint64>();
+  cached_stamp.mtime_nsec = reader.read<gint64>();
+  cached_stamp.ctime = reader.read<gint64>();
+  cached_stamp.inode = reader.read<guint64>();
+  cached_stamp.size = reader.read<gint64>();
+  if(reader.failed() || cached_stamp != stamp) {
+    return false;
+  }
+
+  Glib::ustring title = reader.read_string();
+  sharp::DateTime create_date = reader.read_date();
+  sharp::DateTime change_date = reader.read_date();
+  sharp::DateTime metadata_change_date = reader.read_date();
+  gint32 cursor_position = reader.read<gint32>();
+  gint32 selection_bound_position = reader.read<gint32>();
+  gint32 width = reader.read<gint32>();
+  gint32 height = reader.read<gint32>();
+  guint32 tag_count = reader.read<guint32>();
+  std::list<Glib::ustring> tag_names;
+  for(guint32 i = 0; i < tag_count && !reader.failed(); ++i) {
+    tag_names.push_back(reader.read_string());
+  }
+  std::string hash = reader.read_string();
+  if(reader.failed() || !reader.at_end() || !title.validate()) {
+    return false;
+  }
+
+  data.title() = title;
+  data.create_date() = create_date;
+  data.set_change_date(change_date);
+  data.metadata_change_date() = metadata_change_date;
+  data.set_cursor_position(cursor_position);
+  data.set_selection_bound_position(selection_bound_position);
+  data.width() = width;
+  data.height() = height;
+  tags.swap(tag_names);
+  content_hash.swap(hash);
+  return true;
+}
+
+
+bool NoteMetadataCache::write(const std::string & cache_file, const NoteCollection & notes)
+{
+  std::string payload;
+  std::string entry;
+  guint32 count = 0;
+  FOREACH(const NoteBase::Ptr & note, notes) {
+    FileStamp stamp;
+    if(!get_file_stamp(note->file_path(), stamp)) {
+      continue;
+    }
+
+    const NoteData & data = note->data();
+    entry.clear();
+    CacheWriter writer(entry);
+    writer.write_string(Glib::path_get_basename(note->file_path()));
+    writer.write<gint64>(stamp.mtime);
+    writer.write<gint64>(stamp.mtime_nsec);
+    writer.write<gint64>(stamp.ctime);
+    writer.write<guint64>(stamp.inode);
+    writer.write<gint64>(stamp.size);
+    writer.write_string(data.title());
+    writer.write_date(data.create_date());
+    writer.write_date(data.change_date());
+    writer.write_date(data.metadata_change_date());
+    writer.write<gint32>(data.cursor_position());
+    writer.write<gint32>(data.selection_bound_position());
+    writer.write<gint32>(data.width());
+    writer.write<gint32>(data.height());
+    writer.write<guint32>(data.tags().size());
+    for(NoteData::TagMap::const_iterator iter = data.tags().begin(); iter != data.tags().end(); ++iter) {
+      writer.write_string(iter->second->name());
+    }
+    writer.write_string(note->content_hash());
+
+    CacheWriter(payload).write<guint32>(entry.size());
+    payload += entry;
+    ++count;
+  }
+
+  std::string header(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  CacheWriter header_writer(header);
+  header_writer.write<guint32>(CACHE_VERSION);
+  header_writer.write<guint32>(count);
+  header_writer.write<guint32>(checksum(payload.data(), payload.size()));
+
+  std::string tmp_file = cache_file + ".tmp";
+  std::ofstream fout(tmp_file.c_str(), std::ios::binary);
+  if(!fout.is_open()) {
+    ERR_OUT(_("Failed to write note metadata cache %s"), tmp_file.c_str());
+    return false;
+  }
+  fout.write(header.data(), header.size());
+  fout.write(payload.data(), payload.size());
+  fout.close();
+
+  if(fout.fail()) {
+    ERR_OUT(_("Failed to write note metadata cache %s"), tmp_file.c_str());
+    sharp::file_delete(tmp_file);
+    return false;
+  }
+
+  sharp::file_move(tmp_file, cache_file);
+  return true;
+}
+
+}
@@ -0,0 +1,87 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _NOTEMETADATACACHE_HPP_
+#define _NOTEMETADATACACHE_HPP_
+
+#include <list>
+#include <string>
+
+#include <glib.h>
+#include <glibmm/ustring.h>
+
+#include "base/macros.hpp"
+#include "notebase.hpp"
+#include "notecollection.hpp"
+#include "sharp/files.hpp"
+
+
+namespace gnote {
+
+// Binary cache of note headers (everything in NoteData, except text)
+// and content hashes.
+// Entries are keyed by note file name and are only used, while
+// the stamp (modification time, inode, size) of the note file stays
+// the same.
+// The cache file is memory mapped, a corrupt or outdated file is
+// treated as empty, so it gets rebuilt.
+class NoteMetadataCache
+{
+public:
+  static const char *CACHE_FILE_NAME;
+
+  typedef sharp::FileStamp FileStamp;
+  static bool get_file_stamp(const std::string & file, FileStamp & stamp)
+    {
+      return sharp::file_stamp(file, stamp);
+    }
+
+  explicit NoteMetadataCache(const std::string & cache_file);
+  ~NoteMetadataCache();
+
+  // Fill data, tag names and content hash from cache, if there is an up to date entry for file.
+  // Content hash is empty, if it was not known when cache was written.
+  bool lookup(const std::string & file, const FileStamp & stamp,
+              NoteData & data, std::list<Glib::ustring> & tags, std::string & content_hash) const;
+  std::size_t size() const
+    {
+      return m_entries.size();
+    }
+
+  // Replace the cache file with entries for given notes
+  static bool write(const std::string & cache_file, const NoteCollection & notes);
+private:
+  struct Entry
+  {
+    const char *begin;
+    const char *end;
+  };
+  typedef unordered_map<std::string, Entry> EntryMap;
+
+  bool load();
+
+  std::string m_cache_file;
+  GMappedFile *m_mapped_file;
+  EntryMap m_entries;
+};
+
+}
+
+#endif
@@ -0,0 +1,240 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdio>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+#include <glibmm/i18n.h>
+
+#include "debug.hpp"
+#include "notesavescheduler.hpp"
+#include "base/macros.hpp"
+
+
+namespace gnote {
+
+NoteSaveScheduler::NoteSaveScheduler(guint flush_window_ms)
+  : m_flush_window(flush_window_ms)
+  , m_thread(NULL)
+  , m_flush_requested(false)
+  , m_stop(false)
+  , m_sync_to_disk(false)
+  , m_next_id(0)
+{
+  m_dispatcher.connect(sigc::mem_fun(*this, &NoteSaveScheduler::dispatch_completions));
+  try {
+    m_thread = Glib::Threads::Thread::create(sigc::mem_fun(*this, &NoteSaveScheduler::worker));
+  }
+  catch(const Glib::Threads::ThreadError & e) {
+    ERR_OUT(_("Failed to create thread for saving notes, saving synchronously: %s"), e.what().c_str());
+  }
+}
+
+
+NoteSaveScheduler::~NoteSaveScheduler()
+{
+  if(m_thread) {
+    {
+      Glib::Threads::Mutex::Lock lock(m_lock);
+      m_stop = true;
+      m_queued_cond.signal();
+    }
+    m_thread->join();
+  }
+  dispatch_completions();
+}
+
+
+void NoteSaveScheduler::schedule(const std::string & file, const std::string & content,
+                                 const CompletionSlot & done)
+{
+  guint64 id = ++m_next_id;
+  m_completions[file].push_back(std::make_pair(id, done));
+
+  if(m_thread) {
+    Glib::Threads::Mutex::Lock lock(m_lock);
+    // Replaces a write of the same file, that has not been started yet
+    PendingWrite & write = m_pending[file];
+    write.content = content;
+    write.id = id;
+    m_queued_cond.signal();
+    return;
+  }
+
+  WriteMap batch;
+  batch[file].content = content;
+  batch[file].id = id;
+  ResultList results;
+  write_batch(batch, m_sync_to_disk, results);
+  {
+    Glib::Threads::Mutex::Lock lock(m_lock);
+    m_results.insert(m_results.end(), results.begin(), results.end());
+  }
+  dispatch_completions();
+}
+
+
+void NoteSaveScheduler::sync_to_disk(bool sync)
+{
+  Glib::Threads::Mutex::Lock lock(m_lock);
+  m_sync_to_disk = sync;
+}
+
+
+void NoteSaveScheduler::cancel(const std::string & file)
+{
+  {
+    Glib::Threads::Mutex::Lock lock(m_lock);
+    m_pending.erase(file);
+    while(m_writing.find(file) != m_writing.end()) {
+      m_written_cond.wait(m_lock);
+    }
+  }
+  dispatch_completions();
+  m_completions.erase(file);
+}
+
+
+void NoteSaveScheduler::flush()
+{
+  {
+    Glib::Threads::Mutex::Lock lock(m_lock);
+    m_flush_requested = true;
+    m_queued_cond.signal();
+    while(!m_pending.empty() || !m_writing.empty()) {
+      m_written_cond.wait(m_lock);
+    }
+    m_flush_requested = false;
+  }
+  dispatch_completions();
+}
+
+
+void NoteSaveScheduler::worker()
+{
+  while(true) {
+    WriteMap batch;
+    bool sync;
+    {
+      Glib::Threads::Mutex::Lock lock(m_lock);
+      while(m_pending.empty() && !m_stop) {
+        m_queued_cond.wait(m_lock);
+      }
+      if(m_pending.empty()) {
+        return;
+      }
+
+      // Collect writes arriving within flush window into the same batch
+      gint64 end_time = g_get_monotonic_time() + gint64(m_flush_window) * G_TIME_SPAN_MILLISECOND;
+      while(!m_stop && !m_flush_requested && m_queued_cond.wait_until(m_lock, end_time)) {
+      }
+
+      batch.swap(m_pending);
+      sync = m_sync_to_disk;
+      for(WriteMap::const_iterator iter = batch.begin(); iter != batch.end(); ++iter) {
+        m_writing.insert(iter->first);
+      }
+    }
+
+    ResultList results;
+    write_batch(batch, sync, results);
+
+    {
+      Glib::Threads::Mutex::Lock lock(m_lock);
+      m_writing.clear();
+      m_results.insert(m_results.end(), results.begin(), results.end());
+      m_written_cond.broadcast();
+    }
+    m_dispatcher.emit();
+  }
+}
+
+
+void NoteSaveScheduler::write_batch(const WriteMap & batch, bool sync, ResultList & results)
+{
+  // Write all temporary files first, then rename them in one go
+  for(WriteMap::const_iterator iter = batch.begin(); iter != batch.end(); ++iter) {
+    WriteResult result;
+    result.file = iter->first;
+    result.id = iter->second.id;
+    result.success = false;
+
+    std::string tmp_file = iter->first + ".tmp";
+    FILE *fout = g_fopen(tmp_file.c_str(), "wb");
+    if(fout) {
+      const std::string & content = iter->second.content;
+      result.success = std::fwrite(content.data(), 1, content.size(), fout) == content.size()
+                       && std::fflush(fout) == 0;
+      if(result.success && sync) {
+        result.success = fsync(fileno(fout)) == 0;
+      }
+      if(std::fclose(fout) != 0) {
+        result.success = false;
+      }
+    }
+    results.push_back(result);
+  }
+
+  FOREACH(WriteResult & result, results) {
+    std::string tmp_file = result.file + ".tmp";
+    if(result.success) {
+      result.success = g_rename(tmp_file.c_str(), result.file.c_str()) == 0;
+    }
+    if(!result.success) {
+      ERR_OUT(_("Failed to save note file %s"), result.file.c_str());
+      g_unlink(tmp_file.c_str());
+    }
+  }
+}
+
+
+void NoteSaveScheduler::dispatch_completions()
+{
+  ResultList results;
+  {
+    Glib::Threads::Mutex::Lock lock(m_lock);
+    results.swap(m_results);
+  }
+
+  FOREACH(const WriteResult & result, results) {
+    CompletionMap::iterator completions = m_completions.find(result.file);
+    if(completions == m_completions.end()) {
+      continue;
+    }
+
+    // Coalesced writes are complete too
+    std::vector<CompletionSlot> done;
+    CompletionList & list = completions->second;
+    while(!list.empty() && list.front().first <= result.id) {
+      done.push_back(list.front().second);
+      list.pop_front();
+    }
+    if(list.empty()) {
+      m_completions.erase(completions);
+    }
+
+    FOREACH(CompletionSlot & slot, done) {
+      slot(result.success);
+    }
+  }
+}
+
+}
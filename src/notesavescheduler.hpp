@@ -0,0 +1,106 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _NOTESAVESCHEDULER_HPP_
+#define _NOTESAVESCHEDULER_HPP_
+
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <glibmm/dispatcher.h>
+#include <glibmm/threads.h>
+#include <sigc++/slot.h>
+
+
+namespace gnote {
+
+// Writes serialized notes to disk on a background thread.
+// Writes queued within a flush window are done as one batch, several
+// writes to the same file are coalesced into the last one. Every file
+// is written to a temporary file and renamed over the original.
+// Completion slots are called on the thread that created the scheduler.
+class NoteSaveScheduler
+{
+public:
+  // Called with true, if file was written successfully
+  typedef sigc::slot<void, bool> CompletionSlot;
+
+  static const guint DEFAULT_FLUSH_WINDOW = 200;
+
+  explicit NoteSaveScheduler(guint flush_window_ms = DEFAULT_FLUSH_WINDOW);
+  // Finishes all queued writes
+  ~NoteSaveScheduler();
+
+  void schedule(const std::string & file, const std::string & content, const CompletionSlot & done);
+  // Drop queued write of file and wait for it, if it is being written
+  void cancel(const std::string & file);
+  // Write everything queued and wait for it
+  void flush();
+  // fsync files before renaming them, for writes that are not started yet
+  void sync_to_disk(bool sync);
+private:
+  struct PendingWrite
+  {
+    std::string content;
+    guint64 id;
+  };
+  typedef std::map<std::string, PendingWrite> WriteMap;
+
+  struct WriteResult
+  {
+    std::string file;
+    guint64 id;
+    bool success;
+  };
+  typedef std::vector<WriteResult> ResultList;
+
+  typedef std::list<std::pair<guint64, CompletionSlot> > CompletionList;
+  typedef std::map<std::string, CompletionList> CompletionMap;
+
+  void worker();
+  void write_batch(const WriteMap & batch, bool sync, ResultList & results);
+  void dispatch_completions();
+
+  const guint m_flush_window;
+  Glib::Threads::Thread *m_thread;
+  Glib::Dispatcher m_dispatcher;
+
+  // Guarded by m_lock
+  Glib::Threads::Mutex m_lock;
+  Glib::Threads::Cond m_queued_cond;
+  Glib::Threads::Cond m_written_cond;
+  WriteMap m_pending;
+  std::set<std::string> m_writing;
+  ResultList m_results;
+  bool m_flush_requested;
+  bool m_stop;
+  bool m_sync_to_disk;
+
+  // Only used on the main thread
+  guint64 m_next_id;
+  CompletionMap m_completions;
+};
+
+}
+
+#endif
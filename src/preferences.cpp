@@ -59,6 +59,7 @@ namespace gnote {
   const char * Preferences::SYNC_SELECTED_SERVICE_ADDIN = "sync-selected-service-addin";
   const char * Preferences::SYNC_CONFIGURED_CONFLICT_BEHAVIOR = "sync-conflict-behavior";
   const char * Preferences::SYNC_AUTOSYNC_TIMEOUT = "autosync-timeout";
+  const char * Preferences::SYNC_DELTA_REVISIONS = "sync-delta-revisions";
 
   const char * Preferences::NOTE_RENAME_BEHAVIOR = "note-rename-behavior";
   const char * Preferences::USE_STATUS_ICON = "use-status-icon";
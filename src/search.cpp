@@ -24,6 +24,7 @@
 #include "sharp/string.hpp"
 #include "notemanager.hpp"
 #include "search.hpp"
+#include "searchindex.hpp"
 #include "itagmanager.hpp"
 #include "utils.hpp"
 
@@ -39,58 +40,75 @@ namespace gnote {
   Search::ResultsPtr Search::search_notes(const std::string & query, bool case_sensitive, 
                                   const notebooks::Notebook::Ptr & selected_notebook)
   {
-    Glib::ustring search_text = query;
-    if(!case_sensitive) {
-      search_text = search_text.lowercase();
-    }
-
     std::vector<std::string> words;
-    Search::split_watching_quotes(words, std::string(search_text));
+    split_query(query, case_sensitive, words);
 
-    // Used for matching in the raw note XML
-    std::vector<std::string> encoded_words; 
-    Search::split_watching_quotes(encoded_words, utils::XmlEncoder::encode (search_text));
+    // Content matches are looked up in the index, so that notes
+    // don't need to be scanned one by one
+    SearchIndex::Matches content_matches;
+    m_manager.search_index().find_matches(words, case_sensitive, content_matches);
     ResultsPtr temp_matches(new Results);
       
-      // Skip over notes that are template notes
-    Tag::Ptr template_tag = ITagManager::obj().get_or_create_system_tag(ITagManager::TEMPLATE_NOTE_SYSTEM_TAG);
+    // Notes to search in: the selected notebook or all of them, without template notes
+    NoteBitmap searched_notes;
+    if(selected_notebook) {
+      searched_notes = selected_notebook->get_notes();
+    }
+    else {
+      searched_notes = m_manager.get_notes().ordinals();
+      Tag::Ptr template_tag = ITagManager::obj().get_or_create_system_tag(ITagManager::TEMPLATE_NOTE_SYSTEM_TAG);
+      searched_notes.subtract(template_tag->notes());
+    }
 
     FOREACH(const NoteBase::Ptr & iter, m_manager.get_notes()) {
-      Note::Ptr note(static_pointer_cast<Note>(iter));
-
-      // Skip template notes
-      if (note->contains_tag (template_tag)) {
+      if(!searched_notes.test(iter->ordinal())) {
         continue;
       }
-        
-      // Skip notes that are not in the
-      // selected notebook
-      if (selected_notebook && !selected_notebook->contains_note(note))
-        continue;
+      Note::Ptr note(static_pointer_cast<Note>(iter));
         
       // First check the note's title for a match,
-      // if there is no match check the note's raw
-      // XML for at least one match, to avoid
-      // deserializing Buffers unnecessarily.
+      // if there is no match use the count from the index.
       if (0 < find_match_count_in_note (note->get_title(),
                                         words,
                                         case_sensitive)) {
         temp_matches->insert(std::make_pair(INT_MAX, note));
       }
-      else if (check_note_has_match (note, encoded_words,
-                                case_sensitive)) {
-        int match_count =
-          find_match_count_in_note (note->text_content(),
-                                    words, case_sensitive);
-        if (match_count > 0) {
+      else {
+        SearchIndex::Matches::const_iterator match = content_matches.find(note->uri());
+        if (match != content_matches.end() && match->second > 0) {
           // TODO: Improve note.GetHashCode()
-          temp_matches->insert(std::make_pair(match_count, note));
+          temp_matches->insert(std::make_pair(match->second, note));
         }
       }
     }
     return temp_matches;
   }
 
+  int Search::note_match_count(const Note::Ptr & note, const std::string & query, bool case_sensitive)
+  {
+    Tag::Ptr template_tag = ITagManager::obj().get_or_create_system_tag(ITagManager::TEMPLATE_NOTE_SYSTEM_TAG);
+    if(note->contains_tag(template_tag)) {
+      return 0;
+    }
+
+    std::vector<std::string> words;
+    split_query(query, case_sensitive, words);
+    if(0 < find_match_count_in_note(note->get_title(), words, case_sensitive)) {
+      return INT_MAX;
+    }
+    return m_manager.search_index().count_matches(note->uri(), words, case_sensitive);
+  }
+
+  void Search::split_query(const std::string & query, bool case_sensitive, std::vector<std::string> & words)
+  {
+    Glib::ustring search_text = query;
+    if(!case_sensitive) {
+      search_text = search_text.lowercase();
+    }
+
+    split_watching_quotes(words, std::string(search_text));
+  }
+
   bool Search::check_note_has_match(const Note::Ptr & note, 
                                     const std::vector<std::string> & encoded_words,
                                     bool match_case)
@@ -74,11 +74,15 @@ public:
   /// </returns>  
   ResultsPtr search_notes(const std::string &, bool, 
                           const notebooks::Notebook::Ptr & );
+  // Match number of a single note, as search_notes() gives it,
+  // 0 if note does not match. Notebook of the note is not checked.
+  int note_match_count(const Note::Ptr & note, const std::string & query, bool case_sensitive);
   bool check_note_has_match(const Note::Ptr & note, const std::vector<std::string> & ,
                             bool match_case);
   int find_match_count_in_note(Glib::ustring note_text, const std::vector<std::string> &,
                                bool match_case);
 private:
+  static void split_query(const std::string & query, bool case_sensitive, std::vector<std::string> & words);
 
   NoteManager &m_manager;
 };
@@ -0,0 +1,579 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <fstream>
+
+#include <glibmm/i18n.h>
+#include <glibmm/unicode.h>
+
+#include "debug.hpp"
+#include "notemanagerbase.hpp"
+#include "searchindex.hpp"
+#include "sharp/files.hpp"
+#include "sharp/workerpool.hpp"
+#include "sharp/xmlconvert.hpp"
+
+
+namespace gnote {
+
+namespace {
+
+const char *INDEX_FILE_HEADER = "gnote-search-index 2";
+
+// Index is written to disk after this many milliseconds of no changes
+const guint SAVE_TIMEOUT = 10000;
+
+int count_occurences(const std::string & text, const std::string & word)
+{
+  int count = 0;
+  std::string::size_type pos = text.find(word);
+  while(pos != std::string::npos) {
+    ++count;
+    pos = text.find(word, pos + word.size());
+  }
+  return count;
+}
+
+// Same lower case form of a word, as split_words() gives
+std::string lowercase_word(const std::string & word)
+{
+  Glib::ustring text(word);
+  Glib::ustring lower;
+  for(Glib::ustring::const_iterator iter = text.begin(); iter != text.end(); ++iter) {
+    lower += Glib::Unicode::tolower(*iter);
+  }
+  return lower.raw();
+}
+
+}
+
+
+const char *SearchIndex::INDEX_FILE_NAME = "search-index";
+
+
+void SearchIndex::split_words(const Glib::ustring & text, std::vector<std::string> & words,
+                              bool lowercase)
+{
+  Glib::ustring word;
+  for(Glib::ustring::const_iterator iter = text.begin(); iter != text.end(); ++iter) {
+    gunichar c = *iter;
+    if(Glib::Unicode::isalnum(c)) {
+      word += lowercase ? Glib::Unicode::tolower(c) : c;
+    }
+    else if(!word.empty()) {
+      words.push_back(word.raw());
+      word.clear();
+    }
+  }
+  if(!word.empty()) {
+    words.push_back(word.raw());
+  }
+}
+
+
+SearchIndex::SearchIndex(NoteManagerBase & manager, const Glib::ustring & index_file)
+  : m_manager(manager)
+  , m_index_file(index_file)
+  , m_dirty(false)
+{
+  if(!load()) {
+    m_notes.clear();
+    m_suffixes.clear();
+    m_words.clear();
+  }
+
+  m_manager.signal_note_added.connect(sigc::mem_fun(*this, &SearchIndex::on_note_added));
+  m_manager.signal_note_deleted.connect(sigc::mem_fun(*this, &SearchIndex::on_note_deleted));
+  m_manager.signal_note_renamed.connect(sigc::mem_fun(*this, &SearchIndex::on_note_renamed));
+  m_manager.signal_note_saved.connect(sigc::mem_fun(*this, &SearchIndex::on_note_saved));
+  m_save_timeout.signal_timeout.connect(sigc::mem_fun(*this, &SearchIndex::on_save_timeout));
+}
+
+
+SearchIndex::~SearchIndex()
+{
+  m_save_timeout.cancel();
+  save();
+}
+
+
+void SearchIndex::update()
+{
+  unordered_set<std::string> uris;
+  FOREACH(const NoteBase::Ptr & note, m_manager.get_notes()) {
+    uris.insert(note->uri());
+    NoteMap::const_iterator iter = m_notes.find(note->uri());
+    if(iter == m_notes.end()
+       || iter->second.change_date != sharp::XmlConvert::to_string(note->change_date())) {
+      add_note(note);
+    }
+  }
+
+  std::vector<std::string> removed;
+  for(NoteMap::const_iterator iter = m_notes.begin(); iter != m_notes.end(); ++iter) {
+    if(uris.find(iter->first) == uris.end()) {
+      removed.push_back(iter->first);
+    }
+  }
+  FOREACH(const std::string & uri, removed) {
+    remove_note(uri);
+  }
+
+  if(m_dirty) {
+    m_save_timeout.cancel();
+    save();
+  }
+}
+
+
+void SearchIndex::save()
+{
+  if(!m_dirty) {
+    return;
+  }
+
+  std::string tmp_file = m_index_file + ".tmp";
+  std::ofstream fout(tmp_file.c_str());
+  if(!fout.is_open()) {
+    ERR_OUT(_("Failed to write search index %s"), tmp_file.c_str());
+    return;
+  }
+
+  fout << INDEX_FILE_HEADER << '\n';
+  for(NoteMap::const_iterator note = m_notes.begin(); note != m_notes.end(); ++note) {
+    fout << note->first << ' ' << note->second.change_date << ' ' << note->second.words.size() << '\n';
+    for(WordCounts::const_iterator word = note->second.words.begin();
+        word != note->second.words.end(); ++word) {
+      fout << word->first << ' ' << word->second << '\n';
+    }
+  }
+  fout.close();
+
+  if(fout.fail()) {
+    ERR_OUT(_("Failed to write search index %s"), tmp_file.c_str());
+    sharp::file_delete(tmp_file);
+    return;
+  }
+
+  sharp::file_move(tmp_file, m_index_file);
+  m_dirty = false;
+}
+
+
+bool SearchIndex::load()
+{
+  if(!sharp::file_exists(m_index_file)) {
+    return false;
+  }
+
+  std::ifstream fin(m_index_file.c_str());
+  std::string header;
+  std::getline(fin, header);
+  if(header != INDEX_FILE_HEADER) {
+    DBG_OUT("Search index %s has unknown format, rebuilding", m_index_file.c_str());
+    return false;
+  }
+
+  std::string uri;
+  while(fin >> uri) {
+    NoteEntry entry;
+    std::size_t word_count = 0;
+    if(!(fin >> entry.change_date >> word_count)) {
+      return false;
+    }
+    for(std::size_t i = 0; i < word_count; ++i) {
+      std::string word;
+      int count = 0;
+      if(!(fin >> word >> count)) {
+        return false;
+      }
+      entry.words[word] = count;
+    }
+    index_words(uri, entry.words);
+    m_notes[uri] = entry;
+  }
+
+  return fin.eof();
+}
+
+
+void SearchIndex::add_note(const NoteBase::Ptr & note)
+{
+  const std::string & uri = note->uri();
+  NoteEntry & entry = m_notes[uri];
+  unindex_words(uri, entry.words);
+  entry.words.clear();
+
+  std::vector<std::string> words;
+  split_words(note->text_content(), words, false);
+  FOREACH(const std::string & word, words) {
+    ++entry.words[word];
+  }
+  entry.change_date = sharp::XmlConvert::to_string(note->change_date());
+
+  index_words(uri, entry.words);
+  queue_save();
+}
+
+
+void SearchIndex::remove_note(const std::string & uri)
+{
+  NoteMap::iterator iter = m_notes.find(uri);
+  if(iter != m_notes.end()) {
+    unindex_words(uri, iter->second.words);
+    m_notes.erase(iter);
+    queue_save();
+  }
+}
+
+
+void SearchIndex::index_words(const std::string & uri, const WordCounts & words)
+{
+  // Index is lower case, different spellings of a word add up
+  WordCounts lower;
+  for(WordCounts::const_iterator iter = words.begin(); iter != words.end(); ++iter) {
+    lower[lowercase_word(iter->first)] += iter->second;
+  }
+  for(WordCounts::const_iterator iter = lower.begin(); iter != lower.end(); ++iter) {
+    std::pair<WordMap::iterator, bool> word = m_words.insert(std::make_pair(iter->first, Matches()));
+    if(word.second) {
+      add_suffixes(word.first);
+    }
+    word.first->second[uri] = iter->second;
+  }
+}
+
+
+void SearchIndex::unindex_words(const std::string & uri, const WordCounts & words)
+{
+  for(WordCounts::const_iterator iter = words.begin(); iter != words.end(); ++iter) {
+    WordMap::iterator word = m_words.find(lowercase_word(iter->first));
+    if(word != m_words.end()) {
+      word->second.erase(uri);
+      if(word->second.empty()) {
+        remove_suffixes(word);
+        m_words.erase(word);
+      }
+    }
+  }
+}
+
+
+void SearchIndex::add_suffixes(WordMap::const_iterator word)
+{
+  const std::string & text = word->first;
+  for(std::string::size_type i = 0; i < text.size(); ++i) {
+    // Skip UTF-8 continuation bytes, no valid search string can start there
+    if((text[i] & 0xC0) != 0x80) {
+      m_suffixes.insert(Suffix(text.c_str() + i, word));
+    }
+  }
+}
+
+
+void SearchIndex::remove_suffixes(WordMap::const_iterator word)
+{
+  const std::string & text = word->first;
+  for(std::string::size_type i = 0; i < text.size(); ++i) {
+    if((text[i] & 0xC0) == 0x80) {
+      continue;
+    }
+    std::pair<SuffixSet::iterator, SuffixSet::iterator> range
+      = m_suffixes.equal_range(Suffix(text.c_str() + i, word));
+    for(SuffixSet::iterator iter = range.first; iter != range.second; ++iter) {
+      if(iter->word == word) {
+        m_suffixes.erase(iter);
+        break;
+      }
+    }
+  }
+}
+
+
+void SearchIndex::find_matches(const std::vector<std::string> & words, bool case_sensitive,
+                               Matches & matches) const
+{
+  matches.clear();
+  bool first = true;
+
+  FOREACH(const std::string & word, words) {
+    if(word.empty()) {
+      continue;
+    }
+
+    std::vector<std::string> parts;
+    split_words(word, parts);
+
+    Matches word_matches;
+    if(!case_sensitive && parts.size() == 1 && parts[0] == word) {
+      // The most common case, a single lower case word can be answered from index
+      find_word(word, word_matches);
+    }
+    else if(case_sensitive && parts.size() == 1 && lowercase_word(word) == parts[0]) {
+      // Single word as written, from the words of notes containing it in any case
+      Matches candidates;
+      find_word(parts[0], candidates);
+      for(Matches::const_iterator iter = candidates.begin(); iter != candidates.end(); ++iter) {
+        NoteMap::const_iterator note = m_notes.find(iter->first);
+        int count = count_in_words(note->second.words, word, true);
+        if(count > 0) {
+          word_matches[iter->first] = count;
+        }
+      }
+    }
+    else {
+      // Use index to find candidates, then check actual text of each candidate
+      Matches candidates;
+      if(parts.empty()) {
+        for(NoteMap::const_iterator iter = m_notes.begin(); iter != m_notes.end(); ++iter) {
+          candidates[iter->first] = 0;
+        }
+      }
+      else {
+        find_word(parts[0], candidates);
+        for(std::size_t i = 1; i < parts.size() && !candidates.empty(); ++i) {
+          Matches part_matches;
+          find_word(parts[i], part_matches);
+          for(Matches::iterator iter = candidates.begin(); iter != candidates.end();) {
+            if(part_matches.find(iter->first) == part_matches.end()) {
+              candidates.erase(iter++);
+            }
+            else {
+              ++iter;
+            }
+          }
+        }
+      }
+
+      count_in_texts(candidates, word, case_sensitive, word_matches);
+    }
+
+    if(word_matches.empty()) {
+      matches.clear();
+      return;
+    }
+
+    if(first) {
+      matches.swap(word_matches);
+      first = false;
+    }
+    else {
+      for(Matches::iterator iter = matches.begin(); iter != matches.end();) {
+        Matches::const_iterator word_match = word_matches.find(iter->first);
+        if(word_match == word_matches.end()) {
+          matches.erase(iter++);
+        }
+        else {
+          iter->second += word_match->second;
+          ++iter;
+        }
+      }
+      if(matches.empty()) {
+        return;
+      }
+    }
+  }
+}
+
+
+void SearchIndex::find_word(const std::string & word, Matches & matches) const
+{
+  // Search is substring based, so every indexed word containing the
+  // searched one is a match. Such words have a suffix starting with it,
+  // all of those are next to each other in the sorted suffix set.
+  std::set<const std::string*> found;
+  for(SuffixSet::const_iterator iter = m_suffixes.lower_bound(Suffix(word.c_str(), m_words.end()));
+      iter != m_suffixes.end() && std::strncmp(iter->suffix, word.c_str(), word.size()) == 0; ++iter) {
+    if(!found.insert(&iter->word->first).second) {
+      continue;
+    }
+    int occurences = count_occurences(iter->word->first, word);
+    for(Matches::const_iterator note = iter->word->second.begin(); note != iter->word->second.end(); ++note) {
+      matches[note->first] += occurences * note->second;
+    }
+  }
+}
+
+
+int SearchIndex::count_matches(const std::string & uri, const std::vector<std::string> & words,
+                               bool case_sensitive) const
+{
+  NoteMap::const_iterator note = m_notes.find(uri);
+  if(note == m_notes.end()) {
+    return 0;
+  }
+
+  int matches = 0;
+  FOREACH(const std::string & word, words) {
+    if(word.empty()) {
+      continue;
+    }
+
+    std::vector<std::string> parts;
+    split_words(word, parts);
+    int count = 0;
+    if(parts.size() == 1 && parts[0] == (case_sensitive ? lowercase_word(word) : word)) {
+      // Substring matches in the words of the note, like find_word() does
+      count = count_in_words(note->second.words, word, case_sensitive);
+    }
+    else {
+      Matches candidates, counts;
+      candidates[uri] = 0;
+      count_in_texts(candidates, word, case_sensitive, counts);
+      count = counts[uri];
+    }
+
+    if(count == 0) {
+      return 0;
+    }
+    matches += count;
+  }
+
+  return matches;
+}
+
+
+int SearchIndex::count_in_words(const WordCounts & words, const std::string & word, bool case_sensitive)
+{
+  int count = 0;
+  for(WordCounts::const_iterator iter = words.begin(); iter != words.end(); ++iter) {
+    count += count_occurences(case_sensitive ? iter->first : lowercase_word(iter->first), word)
+             * iter->second;
+  }
+  return count;
+}
+
+
+namespace {
+
+// Text of notes, that are not in memory, read from their files
+class NoteTextReader
+{
+public:
+  explicit NoteTextReader(const std::vector<Glib::ustring> & files)
+    : m_files(files)
+    , m_texts(files.size())
+    {}
+  void read()
+    {
+      sharp::WorkerPool(m_files.size(), sigc::mem_fun(*this, &NoteTextReader::read_file))
+        .run(sharp::WorkerPool::processor_count());
+    }
+  const Glib::ustring & text(std::size_t index) const
+    {
+      return m_texts[index];
+    }
+private:
+  void read_file(std::size_t index)
+    {
+      try {
+        NoteArchiver & archiver = NoteArchiver::obj();
+        m_texts[index] = archiver.get_text_from_note_content(archiver.get_text_from_note_file(m_files[index]));
+      }
+      catch(const std::exception & e) {
+        ERR_OUT(_("Failed to read text of note %s: %s"), m_files[index].c_str(), e.what());
+      }
+    }
+
+  const std::vector<Glib::ustring> & m_files;
+  std::vector<Glib::ustring> m_texts;
+};
+
+}
+
+
+void SearchIndex::count_in_texts(const Matches & candidates, const std::string & word,
+                                 bool case_sensitive, Matches & matches) const
+{
+  // Text of notes in memory is used as is, the rest is read in a batch
+  // spread over worker threads, without loading it into the notes
+  std::vector<Glib::ustring> texts;
+  std::vector<std::string> unread_uris;
+  std::vector<Glib::ustring> unread_files;
+  std::vector<std::string> uris;
+  for(Matches::const_iterator iter = candidates.begin(); iter != candidates.end(); ++iter) {
+    NoteBase::Ptr note = m_manager.find_by_uri(iter->first);
+    if(!note) {
+      continue;
+    }
+    if(note->data().is_text_loaded()) {
+      uris.push_back(iter->first);
+      texts.push_back(note->text_content());
+    }
+    else {
+      unread_uris.push_back(iter->first);
+      unread_files.push_back(note->data().text_file());
+    }
+  }
+
+  NoteTextReader reader(unread_files);
+  reader.read();
+  for(std::size_t i = 0; i < unread_uris.size(); ++i) {
+    uris.push_back(unread_uris[i]);
+    texts.push_back(reader.text(i));
+  }
+
+  for(std::size_t i = 0; i < uris.size(); ++i) {
+    Glib::ustring text = case_sensitive ? texts[i] : texts[i].lowercase();
+    int count = count_occurences(text.raw(), word);
+    if(count > 0) {
+      matches[uris[i]] = count;
+    }
+  }
+}
+
+
+void SearchIndex::on_note_added(const NoteBase::Ptr & note)
+{
+  add_note(note);
+}
+
+
+void SearchIndex::on_note_deleted(const NoteBase::Ptr & note)
+{
+  remove_note(note->uri());
+}
+
+
+void SearchIndex::on_note_renamed(const NoteBase::Ptr & note, const Glib::ustring &)
+{
+  add_note(note);
+}
+
+
+void SearchIndex::on_note_saved(const NoteBase::Ptr & note)
+{
+  add_note(note);
+}
+
+
+void SearchIndex::queue_save()
+{
+  m_dirty = true;
+  m_save_timeout.reset(SAVE_TIMEOUT);
+}
+
+
+void SearchIndex::on_save_timeout()
+{
+  save();
+}
+
+}
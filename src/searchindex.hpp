@@ -0,0 +1,130 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _SEARCHINDEX_HPP_
+#define _SEARCHINDEX_HPP_
+
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <glibmm/ustring.h>
+
+#include "base/macros.hpp"
+#include "notebase.hpp"
+#include "utils.hpp"
+
+
+namespace gnote {
+
+class NoteManagerBase;
+
+
+// Inverted index of the words in note contents.
+// Maps each (lowercase) word to the notes containing it and the number
+// of occurences. Words of each note are kept as written, so that case
+// sensitive search of a single word does not need the note text. Kept up to date using note manager signals and stored
+// on disk, so that it does not need to be rebuilt on every start.
+class SearchIndex
+{
+public:
+  // Note URI -> number of matches
+  typedef std::map<std::string, int> Matches;
+
+  static const char *INDEX_FILE_NAME;
+
+  static void split_words(const Glib::ustring & text, std::vector<std::string> & words,
+                          bool lowercase = true);
+
+  SearchIndex(NoteManagerBase & manager, const Glib::ustring & index_file);
+  ~SearchIndex();
+
+  // Bring index up to date with notes in manager. To be called after notes are loaded.
+  void update();
+  void save();
+  void add_note(const NoteBase::Ptr & note);
+  void remove_note(const std::string & uri);
+  // Find notes containing all of the given words.
+  // For case insensitive search, words must be in lower case.
+  void find_matches(const std::vector<std::string> & words, bool case_sensitive, Matches & matches) const;
+  // Number of matches in a single note, as find_matches() gives it, 0 if note does not match
+  int count_matches(const std::string & uri, const std::vector<std::string> & words, bool case_sensitive) const;
+private:
+  // word -> count
+  typedef std::map<std::string, int> WordCounts;
+  struct NoteEntry
+  {
+    std::string change_date;
+    // Words as written in the note
+    WordCounts words;
+  };
+  typedef unordered_map<std::string, NoteEntry> NoteMap;
+  // word -> (note URI -> count)
+  typedef std::map<std::string, Matches> WordMap;
+  // Suffix of an indexed word, used to find words containing a substring
+  struct Suffix
+  {
+    Suffix(const char *s, WordMap::const_iterator w)
+      : suffix(s)
+      , word(w)
+      {}
+    const char *suffix;
+    WordMap::const_iterator word;
+  };
+  struct SuffixLess
+  {
+    bool operator()(const Suffix & a, const Suffix & b) const
+      {
+        return std::strcmp(a.suffix, b.suffix) < 0;
+      }
+  };
+  typedef std::multiset<Suffix, SuffixLess> SuffixSet;
+
+  void on_note_added(const NoteBase::Ptr & note);
+  void on_note_deleted(const NoteBase::Ptr & note);
+  void on_note_renamed(const NoteBase::Ptr & note, const Glib::ustring & old_title);
+  void on_note_saved(const NoteBase::Ptr & note);
+  void on_save_timeout();
+  void queue_save();
+  bool load();
+  void index_words(const std::string & uri, const WordCounts & words);
+  void unindex_words(const std::string & uri, const WordCounts & words);
+  void add_suffixes(WordMap::const_iterator word);
+  void remove_suffixes(WordMap::const_iterator word);
+  void find_word(const std::string & word, Matches & matches) const;
+  void count_in_texts(const Matches & candidates, const std::string & word, bool case_sensitive,
+                      Matches & matches) const;
+  static int count_in_words(const WordCounts & words, const std::string & word, bool case_sensitive);
+
+  NoteManagerBase & m_manager;
+  Glib::ustring m_index_file;
+  NoteMap m_notes;
+  WordMap m_words;
+  // Suffixes of all words in m_words, sorted
+  SuffixSet m_suffixes;
+  bool m_dirty;
+  utils::InterruptableTimeout m_save_timeout;
+};
+
+}
+
+#endif
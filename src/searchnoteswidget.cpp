@@ -62,6 +62,7 @@ SearchNotesWidget::SearchNotesWidget(NoteManager & m)
   , m_initial_position_restored(false)
   , m_sort_column_id(2)
   , m_sort_column_order(Gtk::SORT_DESCENDING)
+  , m_update_pending(false)
 {
   set_hexpand(true);
   set_vexpand(true);
@@ -94,6 +95,7 @@ SearchNotesWidget::SearchNotesWidget(NoteManager & m)
   m.signal_note_added.connect(sigc::mem_fun(*this, &SearchNotesWidget::on_note_added));
   m.signal_note_renamed.connect(sigc::mem_fun(*this, &SearchNotesWidget::on_note_renamed));
   m.signal_note_saved.connect(sigc::mem_fun(*this, &SearchNotesWidget::on_note_saved));
+  m.signal_updates_thawed.connect(sigc::mem_fun(*this, &SearchNotesWidget::on_updates_thawed));
 
   // Watch when notes are added to notebooks so the search
   // results will be updated immediately instead of waiting
@@ -168,6 +170,7 @@ void SearchNotesWidget::perform_search()
   Glib::ustring text = m_search_text;
   if(text.empty()) {
     m_current_matches.clear();
+    update_notebook_notes();
     m_store_filter->refilter();
     if(m_tree->get_realized()) {
       m_tree->scroll_to_point (0, 0);
@@ -197,6 +200,7 @@ void SearchNotesWidget::perform_search()
     }
 
     add_matches_column();
+    update_notebook_notes();
     m_store_filter->refilter();
     if(m_tree->get_realized()) {
       m_tree->scroll_to_point(0, 0);
@@ -501,6 +505,7 @@ void SearchNotesWidget::update_results()
   }
 
   m_store = Gtk::ListStore::create(m_column_types);
+  m_note_rows.clear();
 
   m_store_filter = Gtk::TreeModelFilter::create(m_store);
   m_store_filter->set_visible_func(sigc::mem_fun(*this, &SearchNotesWidget::filter_notes));
@@ -514,18 +519,9 @@ void SearchNotesWidget::update_results()
   m_store_sort->signal_sort_column_changed()
     .connect(sigc::mem_fun(*this, &SearchNotesWidget::on_sorting_changed));
 
-  int cnt = 0;
-
+  update_notebook_notes();
   FOREACH(const NoteBase::Ptr & note_iter, m_manager.get_notes()) {
-    Note::Ptr note(static_pointer_cast<Note>(note_iter));
-    std::string nice_date = utils::get_pretty_print_date(note->change_date(), true);
-
-    Gtk::TreeIter iter = m_store->append();
-    iter->set_value(0, get_note_icon());  /* icon */
-    iter->set_value(1, note->get_title()); /* title */
-    iter->set_value(2, nice_date);  /* change date */
-    iter->set_value(3, note);      /* note */
-    cnt++;
+    append_note_row(static_pointer_cast<Note>(note_iter));
   }
 
   m_tree->set_model(m_store_sort);
@@ -585,8 +581,7 @@ bool SearchNotesWidget::filter_notes(const Gtk::TreeIter & iter)
     return false;
   }
 
-  notebooks::Notebook::Ptr selected_notebook = get_selected_notebook();
-  if(!selected_notebook || !selected_notebook->contains_note(note)) {
+  if(!m_notebook_notes.test(note->ordinal())) {
     return false;
   }
 
@@ -781,12 +776,8 @@ bool SearchNotesWidget::filter_by_tag(const Note::Ptr & note)
     return true;
   }
 
-  //   // FIXME: Ugh!  NOT an O(1) operation.  Is there a better way?
-  std::list<Tag::Ptr> tags;
-  note->get_tags(tags);
-  for(std::list<Tag::Ptr>::const_iterator iter = tags.begin();
-      iter != tags.end(); ++iter) {
-    if(m_selected_tags.find(*iter) != m_selected_tags.end()) {
+  FOREACH(const Tag::Ptr & tag, m_selected_tags) {
+    if(tag->has_note(*note)) {
       return true;
     }
   }
@@ -1156,12 +1147,18 @@ int SearchNotesWidget::compare_search_hits(const Gtk::TreeIter & a, const Gtk::T
 
 void SearchNotesWidget::on_note_deleted(const NoteBase::Ptr & note)
 {
+  if(postpone_update()) {
+    return;
+  }
   restore_matches_window();
   delete_note(static_pointer_cast<Note>(note));
 }
 
 void SearchNotesWidget::on_note_added(const NoteBase::Ptr & note)
 {
+  if(postpone_update()) {
+    return;
+  }
   restore_matches_window();
   add_note(static_pointer_cast<Note>(note));
 }
@@ -1169,30 +1166,96 @@ void SearchNotesWidget::on_note_added(const NoteBase::Ptr & note)
 void SearchNotesWidget::on_note_renamed(const NoteBase::Ptr & note,
                                         const std::string &)
 {
+  if(postpone_update()) {
+    return;
+  }
   restore_matches_window();
   rename_note(static_pointer_cast<Note>(note));
 }
 
-void SearchNotesWidget::on_note_saved(const NoteBase::Ptr&)
+void SearchNotesWidget::on_note_saved(const NoteBase::Ptr & note)
 {
+  if(postpone_update()) {
+    return;
+  }
   restore_matches_window();
-  update_results();
+  update_note(*note);
 }
 
-void SearchNotesWidget::delete_note(const Note::Ptr & note)
+// While note manager updates are frozen, rebuild results once after thaw
+bool SearchNotesWidget::postpone_update()
 {
-  Gtk::TreeModel::Children rows = m_store->children();
+  if(m_manager.updates_frozen()) {
+    m_update_pending = true;
+    return true;
+  }
+  return false;
+}
 
-  for(Gtk::TreeModel::iterator iter = rows.begin();
-      rows.end() != iter; iter++) {
-    if(note == iter->get_value(m_column_types.note)) {
-      m_store->erase(iter);
-      break;
-    }
+void SearchNotesWidget::on_updates_thawed()
+{
+  if(m_update_pending) {
+    m_update_pending = false;
+    restore_matches_window();
+    update_results();
+  }
+}
+
+void SearchNotesWidget::delete_note(const Note::Ptr & note)
+{
+  m_current_matches.erase(note->uri());
+  // Ordinal goes to the next new note
+  m_notebook_notes.reset(note->ordinal());
+  NoteRowMap::iterator row = m_note_rows.find(note->uri());
+  if(row != m_note_rows.end()) {
+    m_store->erase(row->second);
+    m_note_rows.erase(row);
   }
 }
 
 void SearchNotesWidget::add_note(const Note::Ptr & note)
+{
+  update_notebook_note(note);
+  update_note_match(note);
+  append_note_row(note);
+}
+
+void SearchNotesWidget::rename_note(const Note::Ptr & note)
+{
+  update_note(*note);
+}
+
+void SearchNotesWidget::update_note(const NoteBase & note)
+{
+  NoteRowMap::iterator row = m_note_rows.find(note.uri());
+  if(row == m_note_rows.end()) {
+    return;
+  }
+
+  Gtk::TreeIter iter = row->second;
+  Note::Ptr row_note = iter->get_value(m_column_types.note);
+  update_notebook_note(row_note);
+  update_note_match(row_note);
+
+  // Setting a value refilters and resorts the row
+  bool changed = false;
+  std::string title = row_note->get_title();
+  if(title != iter->get_value(m_column_types.title)) {
+    iter->set_value(m_column_types.title, title);
+    changed = true;
+  }
+  std::string nice_date = utils::get_pretty_print_date(row_note->change_date(), true);
+  if(nice_date != iter->get_value(m_column_types.change_date)) {
+    iter->set_value(m_column_types.change_date, nice_date);
+    changed = true;
+  }
+  if(!changed) {
+    // Change date, notebook, pin or search match changed, filter and sort have to be told
+    m_store->row_changed(m_store->get_path(iter), iter);
+  }
+}
+
+void SearchNotesWidget::append_note_row(const Note::Ptr & note)
 {
   std::string nice_date =
     utils::get_pretty_print_date(note->change_date(), true);
@@ -1201,18 +1264,45 @@ void SearchNotesWidget::add_note(const Note::Ptr & note)
   iter->set_value(m_column_types.title, std::string(note->get_title()));
   iter->set_value(m_column_types.change_date, nice_date);
   iter->set_value(m_column_types.note, note);
+  m_note_rows[note->uri()] = iter;
 }
 
-void SearchNotesWidget::rename_note(const Note::Ptr & note)
+void SearchNotesWidget::update_note_match(const Note::Ptr & note)
 {
-  Gtk::TreeModel::Children rows = m_store->children();
+  if(m_search_text.empty()) {
+    return;
+  }
 
-  for(Gtk::TreeModel::iterator iter = rows.begin();
-      rows.end() != iter; iter++) {
-    if(note == iter->get_value(m_column_types.note)) {
-      iter->set_value(m_column_types.title, std::string(note->get_title()));
-      break;
-    }
+  Search search(m_manager);
+  int matches = search.note_match_count(note, Glib::ustring(m_search_text).lowercase(), false);
+  if(matches > 0) {
+    m_current_matches[note->uri()] = matches;
+  }
+  else {
+    m_current_matches.erase(note->uri());
+  }
+}
+
+void SearchNotesWidget::update_notebook_notes()
+{
+  notebooks::Notebook::Ptr selected_notebook = get_selected_notebook();
+  if(selected_notebook) {
+    m_notebook_notes = selected_notebook->get_notes();
+  }
+  else {
+    m_notebook_notes.clear();
+  }
+}
+
+// Only the note itself can have moved in or out of the selected notebook
+void SearchNotesWidget::update_notebook_note(const Note::Ptr & note)
+{
+  notebooks::Notebook::Ptr selected_notebook = get_selected_notebook();
+  if(selected_notebook && selected_notebook->contains_note(note)) {
+    m_notebook_notes.set(note->ordinal());
+  }
+  else {
+    m_notebook_notes.reset(note->ordinal());
   }
 }
 
@@ -1263,24 +1353,33 @@ Gtk::Window *SearchNotesWidget::get_owning_window()
   return dynamic_cast<Gtk::Window*>(widget);
 }
 
-void SearchNotesWidget::on_note_added_to_notebook(const Note &,
+void SearchNotesWidget::on_note_added_to_notebook(const Note & note,
                                                   const notebooks::Notebook::Ptr &)
 {
+  if(postpone_update()) {
+    return;
+  }
   restore_matches_window();
-  update_results();
+  update_note(note);
 }
 
-void SearchNotesWidget::on_note_removed_from_notebook(const Note &,
+void SearchNotesWidget::on_note_removed_from_notebook(const Note & note,
                                                       const notebooks::Notebook::Ptr &)
 {
+  if(postpone_update()) {
+    return;
+  }
   restore_matches_window();
-  update_results();
+  update_note(note);
 }
 
-void SearchNotesWidget::on_note_pin_status_changed(const Note &, bool)
+void SearchNotesWidget::on_note_pin_status_changed(const Note & note, bool)
 {
+  if(postpone_update()) {
+    return;
+  }
   restore_matches_window();
-  update_results();
+  update_note(note);
 }
 
 Gtk::Menu *SearchNotesWidget::get_note_list_context_menu()
@@ -111,9 +111,19 @@ private:
   void on_note_added(const NoteBase::Ptr & note);
   void on_note_renamed(const NoteBase::Ptr&, const std::string&);
   void on_note_saved(const NoteBase::Ptr&);
+  bool postpone_update();
+  void on_updates_thawed();
   void delete_note(const Note::Ptr & note);
   void add_note(const Note::Ptr & note);
   void rename_note(const Note::Ptr & note);
+  // Refresh the row of note in place, so that only it is filtered and sorted again
+  void update_note(const NoteBase & note);
+  void append_note_row(const Note::Ptr & note);
+  // Search match of a single note, for the active search
+  void update_note_match(const Note::Ptr & note);
+  // Take the notes of selected notebook, which rows are filtered by
+  void update_notebook_notes();
+  void update_notebook_note(const Note::Ptr & note);
   void on_open_note();
   void on_open_note_new_window();
   Gtk::Window *get_owning_window();
@@ -167,7 +177,13 @@ private:
   notebooks::NotebooksTreeView *m_notebooksTree;
   sigc::connection m_on_notebook_selection_changed_cid;
   std::set<Tag::Ptr>  m_selected_tags;
+  // Notes of the selected notebook, built when it is selected and updated
+  // for every note, that is added or changed
+  NoteBitmap m_notebook_notes;
   Glib::RefPtr<Gtk::ListStore> m_store;
+  // Note URI -> row in m_store, rows of list store persist until removed
+  typedef unordered_map<std::string, Gtk::TreeIter> NoteRowMap;
+  NoteRowMap m_note_rows;
   Glib::RefPtr<Gtk::TreeModelSort> m_store_sort;
   Glib::RefPtr<Gtk::TreeModelFilter> m_store_filter;
   RecentNotesColumnTypes m_column_types;
@@ -183,6 +199,7 @@ private:
   std::string m_search_text;
   int m_sort_column_id;
   Gtk::SortType m_sort_column_order;
+  bool m_update_pending;
 
   static Glib::RefPtr<Gdk::Pixbuf> get_note_icon();
 };
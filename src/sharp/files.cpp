@@ -23,6 +23,10 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
 #include <glib/gstdio.h>
 #include <glibmm.h>
 #include <giomm/file.h>
@@ -74,5 +78,23 @@ namespace sharp {
   {
     g_rename(from.c_str(), to.c_str());
   }
+
+  bool file_stamp(const std::string & p, FileStamp & stamp)
+  {
+    GStatBuf st;
+    if(g_stat(p.c_str(), &st) != 0) {
+      return false;
+    }
+    stamp.mtime = st.st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+    stamp.mtime_nsec = st.st_mtim.tv_nsec;
+#else
+    stamp.mtime_nsec = 0;
+#endif
+    stamp.ctime = st.st_ctime;
+    stamp.inode = st.st_ino;
+    stamp.size = st.st_size;
+    return true;
+  }
 }
 
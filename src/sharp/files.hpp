@@ -27,8 +27,39 @@
 
 #include <string>
 
+#include <glib.h>
+
 namespace sharp {
 
+  /** what is known about file version, to tell if it has changed.
+   *  Modification time has a granularity of a second on some systems,
+   *  inode and change time catch files replaced within the same second. */
+  struct FileStamp
+  {
+    FileStamp()
+      : mtime(0)
+      , mtime_nsec(0)
+      , ctime(0)
+      , inode(0)
+      , size(0)
+      {}
+    bool operator==(const FileStamp & other) const
+      {
+        return mtime == other.mtime && mtime_nsec == other.mtime_nsec
+          && ctime == other.ctime && inode == other.inode && size == other.size;
+      }
+    bool operator!=(const FileStamp & other) const
+      {
+        return !(*this == other);
+      }
+
+    gint64 mtime;
+    gint64 mtime_nsec;
+    gint64 ctime;
+    guint64 inode;
+    gint64 size;
+  };
+
   bool file_exists(const std::string & p);
   void file_delete(const std::string & p);
   void file_move(const std::string & from, const std::string & to);
@@ -39,6 +70,8 @@ namespace sharp {
   /** return the filename from the file path */
   std::string file_filename(const std::string & p);
   void file_copy(const std::string & source, const std::string & dest);
+  /** get stamp of the file, false if file does not exist */
+  bool file_stamp(const std::string & p, FileStamp & stamp);
 }
 
 
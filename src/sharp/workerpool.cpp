@@ -0,0 +1,91 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <vector>
+
+#include <unistd.h>
+
+#include <glibmm/i18n.h>
+#include <libxml/parser.h>
+
+#include "debug.hpp"
+#include "sharp/workerpool.hpp"
+
+
+namespace sharp {
+
+WorkerPool::WorkerPool(std::size_t count, const sigc::slot<void, std::size_t> & work)
+  : m_count(count)
+  , m_work(work)
+  , m_next(0)
+{
+}
+
+
+void WorkerPool::run(std::size_t max_threads)
+{
+  if(m_count == 0) {
+    return;
+  }
+  xmlInitParser();
+
+  std::size_t thread_count = std::min(m_count, std::max<std::size_t>(max_threads, 1)) - 1;
+  std::vector<Glib::Threads::Thread*> threads;
+  for(std::size_t i = 0; i < thread_count; ++i) {
+    try {
+      threads.push_back(Glib::Threads::Thread::create(sigc::mem_fun(*this, &WorkerPool::worker)));
+    }
+    catch(const Glib::Threads::ThreadError & e) {
+      ERR_OUT(_("Failed to create worker thread: %s"), e.what().c_str());
+      break;
+    }
+  }
+
+  worker();
+  for(std::vector<Glib::Threads::Thread*>::iterator iter = threads.begin(); iter != threads.end(); ++iter) {
+    (*iter)->join();
+  }
+}
+
+
+std::size_t WorkerPool::processor_count()
+{
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return cpus > 1 ? cpus : 1;
+}
+
+
+void WorkerPool::worker()
+{
+  while(true) {
+    std::size_t index;
+    {
+      Glib::Threads::Mutex::Lock lock(m_lock);
+      if(m_next >= m_count) {
+        return;
+      }
+      index = m_next++;
+    }
+    m_work(index);
+  }
+}
+
+}
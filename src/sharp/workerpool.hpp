@@ -0,0 +1,59 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _SHARP_WORKERPOOL_HPP_
+#define _SHARP_WORKERPOOL_HPP_
+
+#include <cstddef>
+
+#include <glibmm/threads.h>
+#include <sigc++/slot.h>
+
+
+namespace sharp {
+
+/**
+ * Calls work for every index in [0, count), spreading the calls over
+ * up to max_threads threads. The calling thread is one of them, so
+ * max_threads of 1 runs everything in place.
+ * The work slot must not throw; errors are to be stored per item.
+ * libxml2 is initialized beforehand, so work may parse XML.
+ */
+class WorkerPool
+{
+public:
+  WorkerPool(std::size_t count, const sigc::slot<void, std::size_t> & work);
+  void run(std::size_t max_threads);
+
+  /// Number of processors online, at least 1
+  static std::size_t processor_count();
+private:
+  void worker();
+
+  const std::size_t m_count;
+  sigc::slot<void, std::size_t> m_work;
+  std::size_t m_next;
+  Glib::Threads::Mutex m_lock;
+};
+
+}
+
+
+#endif
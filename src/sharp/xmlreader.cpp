@@ -101,6 +101,21 @@ namespace sharp {
       return false;
     }
     int res = xmlTextReaderRead(m_reader);
+    if(res < 0) {
+      m_error = true;
+    }
+    return (res > 0);
+  }
+
+  bool XmlReader::skip()
+  {
+    if(m_error) {
+      return false;
+    }
+    int res = xmlTextReaderNext(m_reader);
+    if(res < 0) {
+      m_error = true;
+    }
     return (res > 0);
   }
 
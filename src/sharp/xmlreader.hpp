@@ -55,6 +55,15 @@ public:
    *  return false if it couldn't be read. (either end or error)
    */
   bool read();
+  /** skip the children of the current node and move to the next sibling
+   *  return false if it couldn't be read. (either end or error)
+   */
+  bool skip();
+  /** true if reader could not be opened or document is not well formed */
+  bool has_error() const
+    {
+      return m_error;
+    }
 
   xmlReaderTypes get_node_type();
   
@@ -21,15 +21,20 @@
 #include <algorithm>
 #include <fstream>
 #include <stdexcept>
+#include <vector>
 
-#include <boost/format.hpp>
+#include <glib/gstdio.h>
+#include <glibmm/fileutils.h>
 #include <glibmm/i18n.h>
 
 #include "debug.hpp"
 #include "filesystemsyncserver.hpp"
+#include "notedelta.hpp"
 #include "sharp/directory.hpp"
+#include "sharp/exception.hpp"
 #include "sharp/files.hpp"
 #include "sharp/uuid.hpp"
+#include "sharp/workerpool.hpp"
 #include "sharp/xml.hpp"
 #include "sharp/xmlreader.hpp"
 #include "sharp/xmlwriter.hpp"
@@ -53,15 +58,82 @@ int str_to_int(const std::string & s)
 namespace gnote {
 namespace sync {
 
+namespace {
+
+// Notes changed by other clients can only be found by looking at the whole
+// cache, that is done once in this many revisions
+const int FULL_CACHE_PRUNE_INTERVAL = 100;
+
+// Reads notes from revision directories on a small pool of threads.
+// Latency of a remote (mounted) server dominates, so several notes are read
+// at the same time. Each note is read in one go and parsed right away.
+class NoteDownloader
+{
+public:
+  struct Download
+  {
+    std::string note_id;
+    int revision;
+    shared_ptr<NoteUpdate> update;
+    std::string error;
+  };
+
+  NoteDownloader(std::vector<Download> & downloads, const std::string & server_path,
+                 const std::string & cache_dir)
+    : m_downloads(downloads)
+    , m_server_path(server_path)
+    , m_cache_dir(cache_dir)
+    {}
+
+  void run()
+    {
+      sharp::WorkerPool(m_downloads.size(), sigc::mem_fun(*this, &NoteDownloader::download))
+        .run(MAX_THREADS);
+    }
+private:
+  enum { MAX_THREADS = 4 };
+
+  void download(std::size_t index)
+    {
+      Download & download = m_downloads[index];
+      try {
+        std::string xml = FileSystemSyncServer::read_note_revision(m_server_path, m_cache_dir,
+                                                                   download.note_id, download.revision);
+        download.update.reset(new NoteUpdate(xml, "", download.note_id, download.revision));
+      }
+      catch(const Glib::Exception & e) {
+        download.error = e.what();
+      }
+      catch(const std::exception & e) {
+        download.error = e.what();
+      }
+    }
+
+  std::vector<Download> & m_downloads;
+  const std::string m_server_path;
+  const std::string m_cache_dir;
+};
+
+}
+
+
 SyncServer::Ptr FileSystemSyncServer::create(const std::string & path)
 {
-  return SyncServer::Ptr(new FileSystemSyncServer(path));
+  return SyncServer::Ptr(new FileSystemSyncServer(path, ""));
 }
 
 
-FileSystemSyncServer::FileSystemSyncServer(const std::string & localSyncPath)
+SyncServer::Ptr FileSystemSyncServer::create(const std::string & path, const std::string & cache_path)
+{
+  return SyncServer::Ptr(new FileSystemSyncServer(path, cache_path));
+}
+
+
+FileSystemSyncServer::FileSystemSyncServer(const std::string & localSyncPath, const std::string & cache_path)
   : m_server_path(localSyncPath)
-  , m_cache_path(Glib::build_filename(Glib::get_tmp_dir(), Glib::get_user_name(), "gnote"))
+  , m_cache_path(cache_path)
+  , m_manifest_loaded(false)
+  , m_new_revision(-1)
 {
   if(!sharp::directory_exists(m_server_path)) {
     throw std::invalid_argument(("Directory not found: " + m_server_path).c_str());
@@ -70,28 +142,68 @@ FileSystemSyncServer::FileSystemSyncServer(const std::string & localSyncPath)
   m_lock_path = Glib::build_filename(m_server_path, "lock");
   m_manifest_path = Glib::build_filename(m_server_path, "manifest.xml");
 
-  m_new_revision = latest_revision() + 1;
-  m_new_revision_path = get_revision_dir_path(m_new_revision);
-
   m_lock_timeout.signal_timeout
     .connect(sigc::mem_fun(*this, &FileSystemSyncServer::lock_timeout));
 }
 
 
 void FileSystemSyncServer::upload_notes(const std::list<Note::Ptr> & notes)
+{
+  DBG_OUT("UploadNotes: notes.Count = %d", int(notes.size()));
+  std::list<std::string> files;
+  ContentHashMap hashes;
+  FOREACH(const Note::Ptr & note, notes) {
+    files.push_back(note->file_path());
+    hashes[note->id()] = note->content_hash();
+  }
+  upload_note_files(files, hashes);
+}
+
+
+void FileSystemSyncServer::upload_note_files(const std::list<std::string> & files, const ContentHashMap & hashes)
 {
   if(sharp::directory_exists(m_new_revision_path) == false) {
     sharp::directory_create(m_new_revision_path);
   }
-  DBG_OUT("UploadNotes: notes.Count = %d", int(notes.size()));
-  for(std::list<Note::Ptr>::const_iterator iter = notes.begin(); iter != notes.end(); ++iter) {
+  std::string notes_cache_dir = cache_dir();
+  FOREACH(const std::string & file, files) {
     try {
-      std::string serverNotePath = Glib::build_filename(m_new_revision_path, sharp::file_filename((*iter)->file_path()));
-      sharp::file_copy((*iter)->file_path(), serverNotePath);
-      m_updated_notes.push_back(sharp::file_basename((*iter)->file_path()));
+      std::string note_id = sharp::file_basename(file);
+      std::string serverNotePath = Glib::build_filename(m_new_revision_path, sharp::file_filename(file));
+      // Delta left over from a failed transaction with the same revision
+      std::string serverDeltaPath = Glib::build_filename(m_new_revision_path, note_id + ".delta");
+      if(m_cache_path == "") {
+        sharp::file_copy(file, serverNotePath);
+        g_unlink(serverDeltaPath.c_str());
+      }
+      else {
+        std::string content = Glib::file_get_contents(file);
+        bool stored = false;
+        try {
+          stored = upload_note_delta(note_id, content);
+        }
+        catch(const Glib::Exception & e) {
+          DBG_OUT("Sync: Storing full copy of note \"%s\": %s", file.c_str(), e.what().c_str());
+        }
+        catch(const std::exception & e) {
+          DBG_OUT("Sync: Storing full copy of note \"%s\": %s", file.c_str(), e.what());
+        }
+        if(!stored) {
+          Glib::file_set_contents(serverNotePath, content);
+          g_unlink(serverDeltaPath.c_str());
+        }
+
+        // Becomes the base for the next delta once committed
+        if(notes_cache_dir != "") {
+          write_cache_file(cache_file_path(notes_cache_dir, note_id) + ".new", m_new_revision, content);
+          m_cached_notes.insert(note_id);
+        }
+      }
+      ContentHashMap::const_iterator hash = hashes.find(note_id);
+      m_updated_notes[note_id] = hash != hashes.end() ? hash->second : "";
     }
     catch(...) {
-      DBG_OUT("Sync: Error uploading note \"%s\"", (*iter)->get_title().c_str());
+      DBG_OUT("Sync: Error uploading note \"%s\"", file.c_str());
     }
   }
 }
@@ -99,7 +211,7 @@ void FileSystemSyncServer::upload_notes(const std::list<Note::Ptr> & notes)
 
 void FileSystemSyncServer::delete_notes(const std::list<std::string> & deletedNoteUUIDs)
 {
-  m_deleted_notes.insert(m_deleted_notes.end(), deletedNoteUUIDs.begin(), deletedNoteUUIDs.end());
+  m_deleted_notes.insert(deletedNoteUUIDs.begin(), deletedNoteUUIDs.end());
 }
 
 
@@ -107,17 +219,12 @@ std::list<std::string> FileSystemSyncServer::get_all_note_uuids()
 {
   std::list<std::string> noteUUIDs;
 
-  if(is_valid_xml_file(m_manifest_path)) {
-    // TODO: Permission errors
-    xmlDocPtr xml_doc = xmlReadFile(m_manifest_path.c_str(), "UTF-8", 0);
-    xmlNodePtr root_node = xmlDocGetRootElement(xml_doc);
-    sharp::XmlNodeSet noteIds = sharp::xml_node_xpath_find(root_node, "//note/@id");
-    DBG_OUT("get_all_note_uuids has %d notes", int(noteIds.size()));
-    for(sharp::XmlNodeSet::iterator iter = noteIds.begin(); iter != noteIds.end(); ++iter) {
-      noteUUIDs.push_back(sharp::xml_node_content(*iter));
-    }
-    xmlFreeDoc(xml_doc);
+  const Manifest & current = manifest();
+  for(unordered_map<std::string, int>::const_iterator iter = current.notes.begin();
+      iter != current.notes.end(); ++iter) {
+    noteUUIDs.push_back(iter->first);
   }
+  DBG_OUT("get_all_note_uuids has %d notes", int(noteUUIDs.size()));
 
   return noteUUIDs;
 }
@@ -125,67 +232,62 @@ std::list<std::string> FileSystemSyncServer::get_all_note_uuids()
 
 bool FileSystemSyncServer::updates_available_since(int revision)
 {
-  return latest_revision() > revision; // TODO: Mounting, etc?
+  // Background checks only need the revision, not the whole manifest
+  int latest = read_manifest_revision(m_manifest_path);
+  if(latest < 0) {
+    latest = latest_revision();
+  }
+  return latest > revision; // TODO: Mounting, etc?
 }
 
 
-std::map<std::string, NoteUpdate> FileSystemSyncServer::get_note_updates_since(int revision)
+std::map<std::string, NoteUpdate> FileSystemSyncServer::get_note_updates_since(int revision,
+                                                                              const ContentHashMap & local_hashes)
 {
   std::map<std::string, NoteUpdate> noteUpdates;
+  std::vector<NoteDownloader::Download> downloads;
+
+  const Manifest & current = manifest();
+  for(unordered_map<std::string, int>::const_iterator iter = current.notes.begin();
+      iter != current.notes.end(); ++iter) {
+    const std::string & note_id = iter->first;
+    int rev = iter->second;
+    if(rev <= revision) {
+      continue;
+    }
 
-  std::string tempPath = Glib::build_filename(m_cache_path, "sync_temp");
-  if(!sharp::directory_exists(tempPath)) {
-    sharp::directory_create(tempPath);
-  }
-  else {
-    // Empty the temp dir
-    try {
-      std::list<std::string> files;
-      sharp::directory_get_files(tempPath, files);
-      for(std::list<std::string>::iterator iter = files.begin(); iter != files.end(); ++iter) {
-        sharp::file_delete(*iter);
+    // Same content locally, no need to read it
+    ContentHashMap::const_iterator hash = current.hashes.find(note_id);
+    if(hash != current.hashes.end()) {
+      ContentHashMap::const_iterator local_hash = local_hashes.find(note_id);
+      if(local_hash != local_hashes.end() && local_hash->second == hash->second) {
+        NoteUpdate update("", "", note_id, rev);
+        update.m_content_hash = hash->second;
+        update.m_unchanged = true;
+        noteUpdates.insert(std::make_pair(note_id, update));
+        continue;
       }
     }
-    catch(...) {}
+
+    NoteDownloader::Download download;
+    download.note_id = note_id;
+    download.revision = rev;
+    downloads.push_back(download);
   }
 
-  if(is_valid_xml_file(m_manifest_path)) {
-    xmlDocPtr xml_doc = xmlReadFile(m_manifest_path.c_str(), "UTF-8", 0);
-    xmlNodePtr root_node = xmlDocGetRootElement(xml_doc);
+  NoteDownloader(downloads, m_server_path, cache_dir()).run();
 
-    std::string xpath = str(boost::format("//note[@rev > %1%]") % revision);
-    sharp::XmlNodeSet noteNodes = sharp::xml_node_xpath_find(root_node, xpath.c_str());
-    DBG_OUT("get_note_updates_since xpath returned %d nodes", int(noteNodes.size()));
-    for(sharp::XmlNodeSet::iterator iter = noteNodes.begin(); iter != noteNodes.end(); ++iter) {
-      std::string note_id = sharp::xml_node_content(sharp::xml_node_xpath_find_single_node(*iter, "@id"));
-      int rev = str_to_int(sharp::xml_node_content(sharp::xml_node_xpath_find_single_node(*iter, "@rev")));
-      if(noteUpdates.find(note_id) == noteUpdates.end()) {
-        // Copy the file from the server to the temp directory
-        std::string revDir = get_revision_dir_path(rev);
-        std::string serverNotePath = Glib::build_filename(revDir, note_id + ".note");
-        std::string noteTempPath = Glib::build_filename(tempPath, note_id + ".note");
-        sharp::file_copy(serverNotePath, noteTempPath);
-
-        // Get the title, contents, etc.
-        std::string noteTitle;
-        std::string noteXml;
-        std::ifstream fin(noteTempPath.c_str());
-        if(fin.is_open()) {
-          do {
-            std::string line;
-            std::getline(fin, line);
-            if(!fin.eof()) {
-              noteXml += line + "\n";
-            }
-          }
-          while(!fin.eof());
-          fin.close();
-        }
-        NoteUpdate update(noteXml, noteTitle, note_id, rev);
-        noteUpdates.insert(std::make_pair(note_id, update));
-      }
+  std::string error;
+  FOREACH(NoteDownloader::Download & download, downloads) {
+    if(download.update) {
+      noteUpdates.insert(std::make_pair(download.note_id, *download.update));
     }
-    xmlFreeDoc(xml_doc);
+    else if(error.empty()) {
+      error = download.error;
+    }
+  }
+  if(!error.empty()) {
+    throw sharp::Exception(error);
   }
 
   DBG_OUT("get_note_updates_since (%d) returning: %d", revision, int(noteUpdates.size()));
@@ -235,6 +337,10 @@ bool FileSystemSyncServer::begin_sync_transaction()
   m_initial_sync_attempt = sharp::DateTime();
   m_last_sync_lock_hash = "";
 
+  // Not done on creation, so that servers for background checks are cheap
+  m_new_revision = latest_revision() + 1;
+  m_new_revision_path = get_revision_dir_path(m_new_revision);
+
   // Create a new lock file so other clients know another client is
   // actively synchronizing right now.
   m_sync_lock.renew_count = 0;
@@ -247,6 +353,9 @@ bool FileSystemSyncServer::begin_sync_transaction()
 
   m_updated_notes.clear();
   m_deleted_notes.clear();
+  finish_cached_notes(false);
+  // Another client may have committed since manifest was last read
+  m_manifest_loaded = false;
 
   return true;
 }
@@ -263,18 +372,7 @@ bool FileSystemSyncServer::commit_sync_transaction()
       sharp::directory_create(m_new_revision_path);
     }
 
-    std::map<std::string, std::string> notes;
-    if(is_valid_xml_file(m_manifest_path) == true) {
-      xmlDocPtr xml_doc = xmlReadFile(m_manifest_path.c_str(), "UTF-8", 0);
-      xmlNodePtr root_node = xmlDocGetRootElement(xml_doc);
-      sharp::XmlNodeSet noteNodes = sharp::xml_node_xpath_find(root_node, "//note");
-      for(sharp::XmlNodeSet::iterator iter = noteNodes.begin(); iter != noteNodes.end(); ++iter) {
-        std::string note_id = sharp::xml_node_get_attribute(*iter, "id");
-        std::string rev = sharp::xml_node_get_attribute(*iter, "rev");
-        notes[note_id] = rev;
-      }
-      xmlFreeDoc(xml_doc);
-    }
+    const Manifest & current = manifest();
 
     // Write out the new manifest file
     sharp::XmlWriter *xml = new sharp::XmlWriter(manifestFilePath);
@@ -284,28 +382,36 @@ bool FileSystemSyncServer::commit_sync_transaction()
       xml->write_attribute_string("", "revision", "", TO_STRING(m_new_revision));
       xml->write_attribute_string("", "server-id", "", m_server_id);
 
-      for(std::map<std::string, std::string>::iterator iter = notes.begin(); iter != notes.end(); ++iter) {
+      for(unordered_map<std::string, int>::const_iterator iter = current.notes.begin();
+          iter != current.notes.end(); ++iter) {
         // Don't write out deleted notes
-        if(std::find(m_deleted_notes.begin(), m_deleted_notes.end(), iter->first) != m_deleted_notes.end()) {
+        if(m_deleted_notes.find(iter->first) != m_deleted_notes.end()) {
           continue;
         }
 
         // Skip updated notes, we'll update them in a sec
-        if(std::find(m_updated_notes.begin(), m_updated_notes.end(), iter->first) != m_updated_notes.end()) {
+        if(m_updated_notes.find(iter->first) != m_updated_notes.end()) {
           continue;
         }
 
         xml->write_start_element("", "note", "");
         xml->write_attribute_string("", "id", "", iter->first);
-        xml->write_attribute_string("", "rev", "", iter->second);
+        xml->write_attribute_string("", "rev", "", TO_STRING(iter->second));
+        ContentHashMap::const_iterator hash = current.hashes.find(iter->first);
+        if(hash != current.hashes.end()) {
+          xml->write_attribute_string("", "content-hash", "", hash->second);
+        }
         xml->write_end_element();
       }
 
       // Write out all the updated notes
-      for(std::list<std::string>::iterator iter = m_updated_notes.begin(); iter != m_updated_notes.end(); ++iter) {
+      FOREACH(const ContentHashMap::value_type & note, m_updated_notes) {
         xml->write_start_element("", "note", "");
-        xml->write_attribute_string("", "id", "", *iter);
+        xml->write_attribute_string("", "id", "", note.first);
         xml->write_attribute_string("", "rev", "", TO_STRING(m_new_revision));
+        if(note.second != "") {
+          xml->write_attribute_string("", "content-hash", "", note.second);
+        }
         xml->write_end_element();
       }
 
@@ -339,31 +445,63 @@ bool FileSystemSyncServer::commit_sync_transaction()
     // Copy the /${parent}/${rev}/manifest.xml -> /manifest.xml
     sharp::file_copy(manifestFilePath, m_manifest_path);
 
+    // Older revisions of deleted notes and of notes stored as a full copy
+    // are no longer needed. Notes stored as a delta still need them.
+    std::map<std::string, int> replaced_notes;
+    FOREACH(const std::string & note_id, m_deleted_notes) {
+      unordered_map<std::string, int>::const_iterator rev = current.notes.find(note_id);
+      if(rev != current.notes.end()) {
+        replaced_notes[note_id] = rev->second;
+      }
+    }
+    FOREACH(const ContentHashMap::value_type & note, m_updated_notes) {
+      unordered_map<std::string, int>::const_iterator rev = current.notes.find(note.first);
+      if(rev != current.notes.end()
+         && sharp::file_exists(Glib::build_filename(m_new_revision_path, note.first + ".note"))) {
+        replaced_notes[note.first] = rev->second;
+      }
+    }
+
+    // Bring the parsed manifest up to date instead of reading it again
+    FOREACH(const std::string & note_id, m_deleted_notes) {
+      m_manifest.notes.erase(note_id);
+      m_manifest.hashes.erase(note_id);
+    }
+    FOREACH(const ContentHashMap::value_type & note, m_updated_notes) {
+      m_manifest.notes[note.first] = m_new_revision;
+      if(note.second != "") {
+        m_manifest.hashes[note.first] = note.second;
+      }
+      else {
+        m_manifest.hashes.erase(note.first);
+      }
+    }
+    m_manifest.revision = m_new_revision;
+    m_manifest.server_id = m_server_id;
+    sharp::file_stamp(m_manifest_path, m_manifest_stamp);
+    finish_cached_notes(true);
+
     try {
       // Delete /manifest.xml.old
       if(sharp::file_exists(oldManifestPath)) {
         sharp::file_delete(oldManifestPath);
       }
 
-      std::string oldManifestFilePath = Glib::build_filename(get_revision_dir_path(m_new_revision - 1), "manifest.xml");
-      if(sharp::file_exists(oldManifestFilePath)) {
-        // TODO: Do step #8 as described in http://bugzilla.gnome.org/show_bug.cgi?id=321037#c17
-        // Like this?
-        std::list<std::string> files;
-        sharp::directory_get_files(oldManifestFilePath, files);
-        for(std::list<std::string>::iterator iter = files.begin(); iter != files.end(); ++iter) {
-          std::string fileGuid = sharp::file_basename(*iter);
-          if(std::find(m_deleted_notes.begin(), m_deleted_notes.end(), fileGuid) != m_deleted_notes.end()
-             || std::find(m_updated_notes.begin(), m_updated_notes.end(), fileGuid) != m_updated_notes.end()) {
-            sharp::file_delete(Glib::build_filename(oldManifestFilePath, *iter));
-          }
-          // TODO: Need to check *all* revision dirs, not just previous (duh)
-          //       Should be a way to cache this from checking earlier.
+      // Step #8 as described in http://bugzilla.gnome.org/show_bug.cgi?id=321037#c17,
+      // following delta chains back to the full copy they start from
+      for(std::map<std::string, int>::const_iterator iter = replaced_notes.begin();
+          iter != replaced_notes.end(); ++iter) {
+        FOREACH(const std::string & file, get_revision_files(iter->first, iter->second)) {
+          sharp::file_delete(file);
         }
-
-        // TODO: Leaving old empty dir for now.  Some stuff is probably easier
-        //       when you can guarantee the existence of each intermediate directory?
       }
+
+      // TODO: Leaving old empty dir for now.  Some stuff is probably easier
+      //       when you can guarantee the existence of each intermediate directory?
+    }
+    catch(Glib::Exception & e) {
+      ERR_OUT(_("Exception during server cleanup while committing. Server integrity is OK, but "
+                "there may be some excess files floating around.  Here's the error: %s\n"), e.what().c_str());
     }
     catch(std::exception & e) {
       ERR_OUT(_("Exception during server cleanup while committing. Server integrity is OK, but "
@@ -381,6 +519,7 @@ bool FileSystemSyncServer::commit_sync_transaction()
 
 bool FileSystemSyncServer::cancel_sync_transaction()
 {
+  finish_cached_notes(false);
   m_lock_timeout.cancel();
   sharp::file_delete(m_lock_path);
   return true;
@@ -389,18 +528,8 @@ bool FileSystemSyncServer::cancel_sync_transaction()
 
 int FileSystemSyncServer::latest_revision()
 {
-  int latestRev = -1;
+  int latestRev = manifest().revision;
   int latestRevDir = -1;
-  xmlDocPtr xml_doc = NULL;
-  if(is_valid_xml_file(m_manifest_path) == true) {
-    xml_doc = xmlReadFile(m_manifest_path.c_str(), "UTF-8", 0);
-    xmlNodePtr root_node = xmlDocGetRootElement(xml_doc);
-    xmlNodePtr syncNode = sharp::xml_node_xpath_find_single_node(root_node, "//sync");
-    std::string latestRevStr = sharp::xml_node_get_attribute(syncNode, "revision");
-    if(latestRevStr != "") {
-      latestRev = str_to_int(latestRevStr);
-    }
-  }
 
   bool foundValidManifest = false;
   while (!foundValidManifest) {
@@ -459,7 +588,6 @@ int FileSystemSyncServer::latest_revision()
     }
   }
 
-  xmlFreeDoc(xml_doc);
   return latestRev;
 }
 
@@ -514,14 +642,7 @@ std::string FileSystemSyncServer::id()
   m_server_id = "";
 
   // Attempt to read from manifest file first
-  if(is_valid_xml_file(m_manifest_path)) {
-    sharp::XmlReader reader(m_manifest_path);
-    if(reader.read()) {
-      if(reader.get_node_type() == XML_READER_TYPE_ELEMENT && reader.get_name() == "sync") {
-	m_server_id = reader.get_attribute("server-id");
-      }
-    }
-  }
+  m_server_id = manifest().server_id;
 
   // Generate a new ID if there isn't already one
   if(m_server_id == "") {
@@ -532,9 +653,306 @@ std::string FileSystemSyncServer::id()
 }
 
 
+const FileSystemSyncServer::Manifest & FileSystemSyncServer::manifest()
+{
+  // Inode and size change too, when another client replaces the file
+  // within the modification time resolution
+  sharp::FileStamp stamp;
+  sharp::file_stamp(m_manifest_path, stamp);
+
+  if(!m_manifest_loaded || stamp != m_manifest_stamp) {
+    m_manifest = Manifest();
+    if(!read_manifest(m_manifest_path, m_manifest)) {
+      m_manifest = Manifest();
+    }
+    m_manifest_stamp = stamp;
+    m_manifest_loaded = true;
+  }
+
+  return m_manifest;
+}
+
+
+bool FileSystemSyncServer::read_manifest(const std::string & path, Manifest & manifest)
+{
+  if(!sharp::file_exists(path)) {
+    return false;
+  }
+
+  sharp::XmlReader reader(path);
+  return Manifest::read(reader, manifest);
+}
+
+
+int FileSystemSyncServer::read_manifest_revision(const std::string & path)
+{
+  if(!sharp::file_exists(path)) {
+    return -1;
+  }
+
+  sharp::XmlReader reader(path);
+  return Manifest::read_revision(reader);
+}
+
+
 std::string FileSystemSyncServer::get_revision_dir_path(int rev)
 {
-  return Glib::build_filename(m_server_path, TO_STRING(rev/100), TO_STRING(rev));
+  return get_revision_dir_path(m_server_path, rev);
+}
+
+
+std::string FileSystemSyncServer::get_revision_dir_path(const std::string & server_path, int rev)
+{
+  return Glib::build_filename(server_path, TO_STRING(rev/100), TO_STRING(rev));
+}
+
+
+std::string FileSystemSyncServer::read_note_revision(const std::string & server_path, const std::string & cache_dir,
+                                                     const std::string & note_id, int revision)
+{
+  int cached_revision = -1;
+  std::string cached;
+  if(cache_dir != "") {
+    read_cache_file(cache_dir, note_id, cached_revision, cached);
+  }
+
+  // Walk back to a full copy of the note or to the revision in cache,
+  // then apply the deltas on the way forward again
+  std::vector<std::string> deltas;
+  std::string content;
+  int rev = revision;
+  while(true) {
+    if(rev == cached_revision) {
+      content = cached;
+      break;
+    }
+
+    std::string rev_dir = get_revision_dir_path(server_path, rev);
+    std::string note_path = Glib::build_filename(rev_dir, note_id + ".note");
+    if(sharp::file_exists(note_path)) {
+      content = Glib::file_get_contents(note_path);
+      break;
+    }
+
+    int base_revision, chain_length;
+    std::string delta;
+    std::string delta_file = Glib::file_get_contents(Glib::build_filename(rev_dir, note_id + ".delta"));
+    if(!NoteDelta::parse_file(delta_file, base_revision, chain_length, delta) || base_revision >= rev) {
+      throw sharp::Exception("Corrupt revision " + TO_STRING(rev) + " of note " + note_id);
+    }
+    deltas.push_back(delta);
+    rev = base_revision;
+  }
+
+  for(std::vector<std::string>::reverse_iterator iter = deltas.rbegin(); iter != deltas.rend(); ++iter) {
+    content = NoteDelta::apply(content, *iter);
+  }
+
+  if(cache_dir != "" && revision != cached_revision) {
+    try {
+      write_cache_file(cache_file_path(cache_dir, note_id), revision, content);
+    }
+    catch(const Glib::Exception & e) {
+      ERR_OUT(_("Failed to cache note %s: %s"), note_id.c_str(), e.what().c_str());
+    }
+  }
+
+  return content;
+}
+
+
+bool FileSystemSyncServer::upload_note_delta(const std::string & note_id, const std::string & content)
+{
+  const Manifest & current = manifest();
+  unordered_map<std::string, int>::const_iterator base = current.notes.find(note_id);
+  if(base == current.notes.end()) {
+    return false;
+  }
+  int base_revision = base->second;
+
+  int chain_length = 0;
+  std::string base_delta_path = Glib::build_filename(get_revision_dir_path(base_revision), note_id + ".delta");
+  if(sharp::file_exists(base_delta_path)) {
+    int base_base_revision;
+    std::string base_delta;
+    if(!NoteDelta::parse_file(Glib::file_get_contents(base_delta_path),
+                              base_base_revision, chain_length, base_delta)) {
+      return false;
+    }
+  }
+  if(chain_length >= NoteDelta::MAX_CHAIN_LENGTH) {
+    return false;
+  }
+
+  std::string base_content = read_note_revision(m_server_path, cache_dir(), note_id, base_revision);
+  std::string delta = NoteDelta::create(base_content, content);
+  // Most of the note has changed
+  if(delta.size() > content.size() / 2) {
+    return false;
+  }
+
+  Glib::file_set_contents(Glib::build_filename(m_new_revision_path, note_id + ".delta"),
+                          NoteDelta::file_content(base_revision, chain_length + 1, delta));
+  // Left over from a failed transaction with the same revision
+  g_unlink(Glib::build_filename(m_new_revision_path, note_id + ".note").c_str());
+  return true;
+}
+
+
+std::list<std::string> FileSystemSyncServer::get_revision_files(const std::string & note_id, int rev)
+{
+  std::list<std::string> files;
+  while(rev >= 0) {
+    std::string rev_dir = get_revision_dir_path(rev);
+    std::string note_path = Glib::build_filename(rev_dir, note_id + ".note");
+    if(sharp::file_exists(note_path)) {
+      files.push_back(note_path);
+      break;
+    }
+
+    std::string delta_path = Glib::build_filename(rev_dir, note_id + ".delta");
+    int base_revision, chain_length;
+    std::string delta;
+    if(!sharp::file_exists(delta_path)
+       || !NoteDelta::parse_file(Glib::file_get_contents(delta_path), base_revision, chain_length, delta)
+       || base_revision >= rev) {
+      break;
+    }
+    files.push_back(delta_path);
+    rev = base_revision;
+  }
+
+  return files;
+}
+
+
+std::string FileSystemSyncServer::cache_dir()
+{
+  if(m_cache_path == "") {
+    return "";
+  }
+
+  // Cached notes are only valid for the server they came from
+  std::string server_id = m_server_id != "" ? m_server_id : manifest().server_id;
+  if(server_id == "") {
+    return "";
+  }
+
+  std::string dir = Glib::build_filename(m_cache_path, server_id);
+  try {
+    if(!sharp::directory_exists(dir)) {
+      sharp::directory_create(dir);
+    }
+  }
+  catch(const Glib::Exception & e) {
+    ERR_OUT(_("Failed to create synchronization cache directory %s: %s"), dir.c_str(), e.what().c_str());
+    return "";
+  }
+  return dir;
+}
+
+
+std::string FileSystemSyncServer::cache_file_path(const std::string & cache_dir, const std::string & note_id)
+{
+  return Glib::build_filename(cache_dir, note_id + ".cache");
+}
+
+
+bool FileSystemSyncServer::read_cache_file(const std::string & cache_dir, const std::string & note_id,
+                                           int & revision, std::string & content)
+{
+  std::string path = cache_file_path(cache_dir, note_id);
+  if(!sharp::file_exists(path)) {
+    return false;
+  }
+
+  // Revision on the first line, note file after it
+  try {
+    std::string data = Glib::file_get_contents(path);
+    std::string::size_type header_end = data.find('\n');
+    if(header_end == std::string::npos) {
+      return false;
+    }
+    revision = STRING_TO_INT(data.substr(0, header_end));
+    content = data.substr(header_end + 1);
+    return true;
+  }
+  catch(const Glib::Exception &) {
+  }
+  catch(const std::exception &) {
+  }
+
+  return false;
+}
+
+
+void FileSystemSyncServer::write_cache_file(const std::string & path, int revision, const std::string & content)
+{
+  Glib::file_set_contents(path, TO_STRING(revision) + "\n" + content);
+}
+
+
+void FileSystemSyncServer::finish_cached_notes(bool committed)
+{
+  if(m_cache_path == "" || (m_cached_notes.empty() && !committed)) {
+    return;
+  }
+
+  std::string notes_cache_dir = cache_dir();
+  if(notes_cache_dir != "") {
+    FOREACH(const std::string & note_id, m_cached_notes) {
+      std::string path = cache_file_path(notes_cache_dir, note_id);
+      std::string new_path = path + ".new";
+      if(!committed || g_rename(new_path.c_str(), path.c_str()) != 0) {
+        g_unlink(new_path.c_str());
+      }
+    }
+    if(committed) {
+      prune_cache(notes_cache_dir);
+    }
+  }
+  m_cached_notes.clear();
+}
+
+
+void FileSystemSyncServer::prune_cache(const std::string & notes_cache_dir)
+{
+  if(m_new_revision % FULL_CACHE_PRUNE_INTERVAL == 0) {
+    std::list<std::string> files;
+    sharp::directory_get_files_with_ext(notes_cache_dir, ".cache", files);
+    FOREACH(const std::string & file, files) {
+      prune_cache_file(file, sharp::file_basename(file));
+    }
+    return;
+  }
+
+  // Otherwise only the notes changed in this transaction
+  FOREACH(const std::string & note_id, m_deleted_notes) {
+    prune_cache_file(cache_file_path(notes_cache_dir, note_id), note_id);
+  }
+  FOREACH(const ContentHashMap::value_type & note, m_updated_notes) {
+    prune_cache_file(cache_file_path(notes_cache_dir, note.first), note.first);
+  }
+}
+
+
+void FileSystemSyncServer::prune_cache_file(const std::string & file, const std::string & note_id)
+{
+  unordered_map<std::string, int>::const_iterator rev = m_manifest.notes.find(note_id);
+  bool keep = false;
+  if(rev != m_manifest.notes.end()) {
+    // Only the revision line is needed, the note after it can be large
+    std::ifstream fin(file.c_str());
+    std::string line;
+    int cached_revision = std::getline(fin, line) ? str_to_int(line) : -1;
+    // Older revision is a delta base only, until a full copy supersedes it
+    keep = cached_revision == rev->second
+      || (cached_revision >= 0 && cached_revision < rev->second
+          && !sharp::file_exists(Glib::build_filename(get_revision_dir_path(rev->second), note_id + ".note")));
+  }
+  if(!keep) {
+    g_unlink(file.c_str());
+  }
 }
 
 
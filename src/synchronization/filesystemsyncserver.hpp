@@ -23,8 +23,10 @@
 
 #include "base/macros.hpp"
 #include "isyncmanager.hpp"
+#include "servermanifest.hpp"
 #include "utils.hpp"
 #include "sharp/datetime.hpp"
+#include "sharp/files.hpp"
 
 
 namespace gnote {
@@ -36,28 +38,71 @@ class FileSystemSyncServer
 {
 public:
   static SyncServer::Ptr create(const std::string & path);
+  // Stores new revisions of notes as deltas against previous ones, with a
+  // full copy every NoteDelta::MAX_CHAIN_LENGTH revisions. Last known server
+  // contents of notes are kept under cache_path, so that deltas are created
+  // and applied without reading whole chains from the server.
+  static SyncServer::Ptr create(const std::string & path, const std::string & cache_path);
   virtual bool begin_sync_transaction() override;
   virtual bool commit_sync_transaction() override;
   virtual bool cancel_sync_transaction() override;
   virtual std::list<std::string> get_all_note_uuids() override;
-  virtual std::map<std::string, NoteUpdate> get_note_updates_since(int revision) override;
+  virtual std::map<std::string, NoteUpdate> get_note_updates_since(int revision, const ContentHashMap & local_hashes) override;
   virtual void delete_notes(const std::list<std::string> & deletedNoteUUIDs) override;
   virtual void upload_notes(const std::list<Note::Ptr> & notes) override;
   virtual int latest_revision() override; // NOTE: Only reliable during a transaction
   virtual SyncLockInfo current_sync_lock() override;
   virtual std::string id() override;
   virtual bool updates_available_since(int revision) override;
+
+  // Upload note files as they are on disk, used by upload_notes().
+  // Hashes are by note ID and can be missing.
+  void upload_note_files(const std::list<std::string> & files,
+                         const ContentHashMap & hashes = ContentHashMap());
+  // Content of note at revision, following deltas. Cache directory can be empty.
+  static std::string read_note_revision(const std::string & server_path, const std::string & cache_dir,
+                                        const std::string & note_id, int revision);
 private:
-  explicit FileSystemSyncServer(const std::string & path);
+  typedef ServerManifest Manifest;
+
+  FileSystemSyncServer(const std::string & path, const std::string & cache_path);
+
+  // Parsed once and reused, while the file on the server is unchanged
+  const Manifest & manifest();
+  static bool read_manifest(const std::string & path, Manifest & manifest);
+  // Revision from the manifest header only, -1 if not there
+  static int read_manifest_revision(const std::string & path);
 
   std::string get_revision_dir_path(int rev);
+  static std::string get_revision_dir_path(const std::string & server_path, int rev);
+  // False, if a full copy is better
+  bool upload_note_delta(const std::string & note_id, const std::string & content);
+  // Files on server, that make up the note at revision
+  std::list<std::string> get_revision_files(const std::string & note_id, int rev);
+
+  // Directory for this server under cache path, empty if cache is not used
+  std::string cache_dir();
+  static std::string cache_file_path(const std::string & cache_dir, const std::string & note_id);
+  static bool read_cache_file(const std::string & cache_dir, const std::string & note_id,
+                              int & revision, std::string & content);
+  static void write_cache_file(const std::string & path, int revision, const std::string & content);
+  // Makes cached contents of uploaded notes current, or drops them
+  void finish_cached_notes(bool committed);
+  // Drops cached notes, that are no longer on the server or were superseded by a full copy.
+  // Looks at notes changed in this transaction, all of the cache only now and then.
+  void prune_cache(const std::string & notes_cache_dir);
+  void prune_cache_file(const std::string & file, const std::string & note_id);
   void cleanup_old_sync(const SyncLockInfo & syncLockInfo);
   void update_lock_file(const SyncLockInfo & syncLockInfo);
   bool is_valid_xml_file(const std::string & xmlFilePath);
   void lock_timeout();
 
-  std::list<std::string> m_updated_notes;
-  std::list<std::string> m_deleted_notes;
+  // Note ID -> content hash
+  ContentHashMap m_updated_notes;
+  unordered_set<std::string> m_deleted_notes;
+  Manifest m_manifest;
+  bool m_manifest_loaded;
+  sharp::FileStamp m_manifest_stamp;
 
   std::string m_server_id;
 
@@ -68,6 +113,8 @@ private:
 
   int m_new_revision;
   std::string m_new_revision_path;
+  // Notes uploaded in this transaction, that have their content cached
+  unordered_set<std::string> m_cached_notes;
 
   sharp::DateTime m_initial_sync_attempt;
   std::string m_last_sync_lock_hash;
@@ -26,6 +26,7 @@
 #include "debug.hpp"
 #include "filesystemsyncserver.hpp"
 #include "fusesyncserviceaddin.hpp"
+#include "ignote.hpp"
 #include "preferences.hpp"
 #include "sharp/directory.hpp"
 #include "sharp/files.hpp"
@@ -81,7 +82,12 @@ SyncServer::Ptr FuseSyncServiceAddin::create_sync_server()
   if(is_configured()) {
     if(!is_mounted() && !mount_fuse(true)) // mount_fuse may throw GnoteSyncException!
       throw std::runtime_error(("Could not mount " + m_mount_path).c_str());
-    server = FileSystemSyncServer::create(m_mount_path);
+    if(Preferences::obj().get_schema_settings(Preferences::SCHEMA_SYNC)->get_boolean(Preferences::SYNC_DELTA_REVISIONS)) {
+      server = FileSystemSyncServer::create(m_mount_path, Glib::build_filename(IGnote::cache_dir(), "sync"));
+    }
+    else {
+      server = FileSystemSyncServer::create(m_mount_path);
+    }
   }
   else {
     throw new std::logic_error("create_sync_server called without being configured");
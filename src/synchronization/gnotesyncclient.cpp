@@ -22,6 +22,9 @@
 #define _SYNCHRONIZATION_GNOTESYNCCLIENT_HPP_
 
 
+#include <algorithm>
+#include <fstream>
+
 #include <glibmm/i18n.h>
 
 #include "debug.hpp"
@@ -38,6 +41,13 @@ namespace sync {
 
   const char * GnoteSyncClient::LOCAL_MANIFEST_FILE_NAME = "manifest.xml";
 
+  namespace {
+    // Journal lines are "<type> <guid> <value>"
+    const char JOURNAL_REVISION = 'R';
+    const char JOURNAL_DELETION = 'D';
+    const char JOURNAL_CONTENT_HASH = 'H';
+  }
+
   SyncClient::Ptr GnoteSyncClient::create(NoteManagerBase & manager)
   {
     GnoteSyncClient *ptr = new GnoteSyncClient;
@@ -71,8 +81,9 @@ namespace sync {
   {
     m_deleted_notes[deletedNote->id()] = deletedNote->get_title();
     m_file_revisions.erase(deletedNote->id());
+    m_file_hashes.erase(deletedNote->id());
 
-    write(m_local_manifest_file_path);
+    append_journal(JOURNAL_DELETION, deletedNote->id(), deletedNote->get_title());
   }
 
 
@@ -85,7 +96,7 @@ namespace sync {
 
   void GnoteSyncClient::read_updated_note_atts(sharp::XmlReader & reader)
   {
-    std::string guid, rev;
+    std::string guid, rev, hash;
     while(reader.move_to_next_attribute()) {
       if(reader.get_name() == "guid") {
 	guid = reader.get_value();
@@ -93,6 +104,9 @@ namespace sync {
       else if(reader.get_name() == "latest-revision") {
 	rev = reader.get_value();
       }
+      else if(reader.get_name() == "content-hash") {
+	hash = reader.get_value();
+      }
     }
     int revision = -1;
     try {
@@ -101,6 +115,9 @@ namespace sync {
     catch(...) {}
     if(guid != "") {
       m_file_revisions[guid] = revision;
+      if(hash != "") {
+        m_file_hashes[guid] = hash;
+      }
     }
   }
 
@@ -144,6 +161,7 @@ namespace sync {
     m_last_sync_date = sharp::DateTime::now().add_days(-1);
     m_last_sync_rev = -1;
     m_file_revisions.clear();
+    m_file_hashes.clear();
     m_deleted_notes.clear();
     m_server_id = "";
 
@@ -186,12 +204,93 @@ namespace sync {
 	}
       }
     }
+    reader.close();
+
+    replay_journal(journal_path(manifest_path));
+  }
+
+
+  std::string GnoteSyncClient::journal_path(const std::string & manifest_path)
+  {
+    return manifest_path + ".journal";
+  }
+
+
+  void GnoteSyncClient::append_journal(char type, const std::string & guid, const std::string & value)
+  {
+    std::string line = value;
+    std::replace(line.begin(), line.end(), '\n', ' ');
+    std::string journal = journal_path(m_local_manifest_file_path);
+    std::ofstream fout(journal.c_str(), std::ios::app);
+    fout << type << ' ' << guid << ' ' << line << '\n';
+    fout.close();
+    if(fout.fail()) {
+      // Keep the change at least in the manifest
+      ERR_OUT(_("Failed to write synchronization journal %s"), journal.c_str());
+      save();
+    }
+  }
+
+
+  void GnoteSyncClient::replay_journal(const std::string & journal)
+  {
+    if(!sharp::file_exists(journal)) {
+      return;
+    }
+
+    // Changes made after manifest was last written, in order.
+    // Incomplete last line, left by a crash, is ignored.
+    std::ifstream fin(journal.c_str());
+    std::string line;
+    while(std::getline(fin, line)) {
+      if(fin.eof() || line.size() < 3 || line[1] != ' ') {
+        continue;
+      }
+      std::string::size_type guid_end = line.find(' ', 2);
+      if(guid_end == std::string::npos) {
+        continue;
+      }
+      std::string guid = line.substr(2, guid_end - 2);
+      std::string value = line.substr(guid_end + 1);
+
+      if(line[0] == JOURNAL_REVISION) {
+        try {
+          m_file_revisions[guid] = STRING_TO_INT(value);
+        }
+        catch(...) {}
+      }
+      else if(line[0] == JOURNAL_CONTENT_HASH) {
+        if(value != "") {
+          m_file_hashes[guid] = value;
+        }
+        else {
+          m_file_hashes.erase(guid);
+        }
+      }
+      else if(line[0] == JOURNAL_DELETION) {
+        m_deleted_notes[guid] = value;
+        m_file_revisions.erase(guid);
+        m_file_hashes.erase(guid);
+      }
+    }
+  }
+
+
+  void GnoteSyncClient::save()
+  {
+    write(m_local_manifest_file_path);
+    std::string journal = journal_path(m_local_manifest_file_path);
+    if(sharp::file_exists(journal)) {
+      sharp::file_delete(journal);
+    }
   }
 
 
   void GnoteSyncClient::write(const std::string & manifest_path)
   {
-    sharp::XmlWriter xml(manifest_path);
+    // Write to temporary file, so a crash does not leave a truncated manifest
+    std::string tmp_path = manifest_path + ".tmp";
+    sharp::XmlWriter xml(tmp_path);
 
     try {
       xml.write_start_document();
@@ -216,6 +315,10 @@ namespace sync {
 	xml.write_start_element("", "note", "");
 	xml.write_attribute_string("", "guid", "", noteGuid->first);
 	xml.write_attribute_string("", "latest-revision", "", TO_STRING(noteGuid->second));
+	std::map<std::string, std::string>::iterator hash = m_file_hashes.find(noteGuid->first);
+	if(hash != m_file_hashes.end()) {
+	  xml.write_attribute_string("", "content-hash", "", hash->second);
+	}
 	xml.write_end_element();
       }
 
@@ -240,6 +343,7 @@ namespace sync {
       xml.close();
       throw;
     }
+    sharp::file_move(tmp_path, manifest_path);
   }
 
 
@@ -248,14 +352,14 @@ namespace sync {
     m_last_sync_date = date;
     // If we just did a sync, we should be able to forget older deleted notes
     m_deleted_notes.clear();
-    write(m_local_manifest_file_path);
+    save();
   }
 
 
   void GnoteSyncClient::last_synchronized_revision(int revision)
   {
     m_last_sync_rev = revision;
-    write(m_local_manifest_file_path);
+    save();
   }
 
 
@@ -275,8 +379,32 @@ namespace sync {
   void GnoteSyncClient::set_revision(const NoteBase::Ptr & note, int revision)
   {
     m_file_revisions[note->id()] = revision;
-    // TODO: Should we write on each of these or no?
-    write(m_local_manifest_file_path);
+    // Called for every synchronized note, so the change only goes to the
+    // journal. Manifest is rewritten, when sync is finished.
+    append_journal(JOURNAL_REVISION, note->id(), TO_STRING(revision));
+  }
+
+
+  std::string GnoteSyncClient::get_content_hash(const NoteBase::Ptr & note)
+  {
+    std::map<std::string, std::string>::const_iterator iter = m_file_hashes.find(note->id());
+    if(iter != m_file_hashes.end()) {
+      return iter->second;
+    }
+    return "";
+  }
+
+
+  void GnoteSyncClient::set_content_hash(const NoteBase::Ptr & note, const std::string & hash)
+  {
+    // Unknown hash must not leave an older one behind
+    if(hash != "") {
+      m_file_hashes[note->id()] = hash;
+    }
+    else if(m_file_hashes.erase(note->id()) == 0) {
+      return;
+    }
+    append_journal(JOURNAL_CONTENT_HASH, note->id(), hash);
   }
 
 
@@ -285,6 +413,10 @@ namespace sync {
     if(sharp::file_exists(m_local_manifest_file_path)) {
       sharp::file_delete(m_local_manifest_file_path);
     }
+    std::string journal = journal_path(m_local_manifest_file_path);
+    if(sharp::file_exists(journal)) {
+      sharp::file_delete(journal);
+    }
     parse(m_local_manifest_file_path);
   }
 
@@ -293,7 +425,7 @@ namespace sync {
   {
     if(m_server_id != server_id) {
       m_server_id = server_id;
-      write(m_local_manifest_file_path);
+      save();
     }
   }
 
@@ -46,6 +46,8 @@ namespace sync {
     virtual void last_synchronized_revision(int) override;
     virtual int get_revision(const NoteBase::Ptr & note) override;
     virtual void set_revision(const NoteBase::Ptr & note, int revision) override;
+    virtual std::string get_content_hash(const NoteBase::Ptr & note) override;
+    virtual void set_content_hash(const NoteBase::Ptr & note, const std::string & hash) override;
     virtual std::map<std::string, std::string> deleted_note_titles() override
       {
         return m_deleted_notes;
@@ -69,6 +71,11 @@ namespace sync {
     void on_changed(const Glib::RefPtr<Gio::File>&, const Glib::RefPtr<Gio::File>&,
                     Gio::FileMonitorEvent);
     void write(const std::string & manifest_path);
+    // Write manifest and drop the journal
+    void save();
+    static std::string journal_path(const std::string & manifest_path);
+    void append_journal(char type, const std::string & guid, const std::string & value);
+    void replay_journal(const std::string & journal);
     void read_updated_note_atts(sharp::XmlReader & reader);
     void read_deleted_note_atts(sharp::XmlReader & reader);
     void read_notes(sharp::XmlReader & reader, void (GnoteSyncClient::*read_note_atts)(sharp::XmlReader&));
@@ -78,6 +85,7 @@ namespace sync {
     int m_last_sync_rev;
     std::string m_server_id;
     std::map<std::string, int> m_file_revisions;
+    std::map<std::string, std::string> m_file_hashes;
     std::map<std::string, std::string> m_deleted_notes;
   };
 
@@ -45,6 +45,10 @@ public:
   std::string hash_string();
 };
 
+// Note ID -> hash of synchronized note content, see NoteBase::content_hash()
+typedef unordered_map<std::string, std::string> ContentHashMap;
+
+
 class SyncClient
 {
 public:
@@ -58,6 +62,9 @@ public:
   virtual void last_sync_date(const sharp::DateTime &) = 0;
   virtual int get_revision(const NoteBase::Ptr & note) = 0;
   virtual void set_revision(const NoteBase::Ptr & note, int revision) = 0;
+  // Content hash of note, when it was last synchronized
+  virtual std::string get_content_hash(const NoteBase::Ptr & note) = 0;
+  virtual void set_content_hash(const NoteBase::Ptr & note, const std::string & hash) = 0;
   virtual std::map<std::string, std::string> deleted_note_titles() = 0;
   virtual void reset() = 0;
   virtual std::string associated_server_id() = 0;
@@ -88,7 +95,9 @@ public:
   virtual bool commit_sync_transaction() = 0;
   virtual bool cancel_sync_transaction() = 0;
   virtual std::list<std::string> get_all_note_uuids() = 0;
-  virtual std::map<std::string, NoteUpdate> get_note_updates_since(int revision) = 0;
+  // Notes, which have the same content hash on server as in local_hashes, are
+  // not downloaded, they are returned with m_unchanged set
+  virtual std::map<std::string, NoteUpdate> get_note_updates_since(int revision, const ContentHashMap & local_hashes) = 0;
   virtual void delete_notes(const std::list<std::string> & deletedNoteUUIDs) = 0;
   virtual void upload_notes(const std::list<Note::Ptr> & notes) = 0;
   virtual int latest_revision() = 0; // NOTE: Only reliable during a transaction
@@ -0,0 +1,278 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdio>
+
+#include <gio/gio.h>
+
+#include "base/macros.hpp"
+#include "notedelta.hpp"
+#include "sharp/exception.hpp"
+
+
+namespace gnote {
+namespace sync {
+
+namespace {
+
+// Parts shorter than this are not looked up in the base
+enum { BLOCK_SIZE = 16 };
+enum { HASH_FACTOR = 0x01000193 };
+
+enum Operation {
+  COPY = 0,
+  INSERT = 1
+};
+
+const char DELTA_FILE_MAGIC[] = "GNDELTA1";
+
+
+guint32 block_hash(const char *block)
+{
+  guint32 hash = 0;
+  for(int i = 0; i < BLOCK_SIZE; ++i) {
+    hash = hash * HASH_FACTOR + static_cast<unsigned char>(block[i]);
+  }
+  return hash;
+}
+
+// Factor of the first byte in a block hash, to roll it out
+guint32 first_byte_factor()
+{
+  guint32 factor = 1;
+  for(int i = 1; i < BLOCK_SIZE; ++i) {
+    factor *= HASH_FACTOR;
+  }
+  return factor;
+}
+
+void write_number(std::string & out, std::string::size_type number)
+{
+  while(number >= 0x80) {
+    out += char((number & 0x7f) | 0x80);
+    number >>= 7;
+  }
+  out += char(number);
+}
+
+std::string::size_type read_number(const std::string & in, std::string::size_type & pos)
+{
+  std::string::size_type number = 0;
+  for(unsigned shift = 0; pos < in.size() && shift < 8 * sizeof(number); shift += 7) {
+    unsigned char byte = in[pos++];
+    number |= std::string::size_type(byte & 0x7f) << shift;
+    if(!(byte & 0x80)) {
+      return number;
+    }
+  }
+  throw sharp::Exception("Corrupt note delta");
+}
+
+void write_insert(std::string & out, const std::string & target,
+                  std::string::size_type start, std::string::size_type end)
+{
+  if(end > start) {
+    out += char(INSERT);
+    write_number(out, end - start);
+    out.append(target, start, end - start);
+  }
+}
+
+void write_copy(std::string & out, std::string::size_type offset, std::string::size_type length)
+{
+  out += char(COPY);
+  write_number(out, offset);
+  write_number(out, length);
+}
+
+std::string convert(GConverter *converter, const std::string & input)
+{
+  std::string output;
+  char buffer[4096];
+  const char *in = input.data();
+  gsize in_left = input.size();
+  while(true) {
+    gsize bytes_read = 0;
+    gsize bytes_written = 0;
+    GError *error = NULL;
+    GConverterResult result = g_converter_convert(converter, in, in_left, buffer, sizeof(buffer),
+                                                  G_CONVERTER_INPUT_AT_END,
+                                                  &bytes_read, &bytes_written, &error);
+    if(result == G_CONVERTER_ERROR) {
+      std::string message = error->message;
+      g_error_free(error);
+      g_object_unref(converter);
+      throw sharp::Exception(message);
+    }
+    output.append(buffer, bytes_written);
+    in += bytes_read;
+    in_left -= bytes_read;
+    if(result == G_CONVERTER_FINISHED) {
+      break;
+    }
+    if(bytes_read == 0 && bytes_written == 0) {
+      g_object_unref(converter);
+      throw sharp::Exception("Corrupt note delta");
+    }
+  }
+  g_object_unref(converter);
+  return output;
+}
+
+std::string compress(const std::string & data)
+{
+  return convert(G_CONVERTER(g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB, -1)), data);
+}
+
+std::string decompress(const std::string & data)
+{
+  return convert(G_CONVERTER(g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB)), data);
+}
+
+}
+
+
+std::string NoteDelta::create(const std::string & base, const std::string & target)
+{
+  std::string ops;
+  write_number(ops, base.size());
+  write_number(ops, target.size());
+
+  // Blocks of base at block boundaries, first one wins
+  unordered_map<guint32, std::string::size_type> blocks;
+  for(std::string::size_type offset = 0; offset + BLOCK_SIZE <= base.size(); offset += BLOCK_SIZE) {
+    blocks.insert(std::make_pair(block_hash(base.data() + offset), offset));
+  }
+
+  // Hash of every block of target is looked up, rolling it byte by byte
+  const guint32 first_factor = first_byte_factor();
+  std::string::size_type literal_start = 0;
+  std::string::size_type pos = 0;
+  guint32 hash = 0;
+  bool have_hash = false;
+  while(pos + BLOCK_SIZE <= target.size()) {
+    if(!have_hash) {
+      hash = block_hash(target.data() + pos);
+      have_hash = true;
+    }
+
+    unordered_map<guint32, std::string::size_type>::const_iterator block = blocks.find(hash);
+    if(block != blocks.end() && base.compare(block->second, BLOCK_SIZE, target, pos, BLOCK_SIZE) == 0) {
+      // Extend the match both ways as far as it goes
+      std::string::size_type base_start = block->second;
+      std::string::size_type target_start = pos;
+      while(target_start > literal_start && base_start > 0
+            && base[base_start - 1] == target[target_start - 1]) {
+        --base_start;
+        --target_start;
+      }
+      std::string::size_type base_end = block->second + BLOCK_SIZE;
+      std::string::size_type target_end = pos + BLOCK_SIZE;
+      while(target_end < target.size() && base_end < base.size() && base[base_end] == target[target_end]) {
+        ++base_end;
+        ++target_end;
+      }
+
+      write_insert(ops, target, literal_start, target_start);
+      write_copy(ops, base_start, target_end - target_start);
+      pos = literal_start = target_end;
+      have_hash = false;
+      continue;
+    }
+
+    if(pos + BLOCK_SIZE < target.size()) {
+      hash = (hash - static_cast<unsigned char>(target[pos]) * first_factor) * HASH_FACTOR
+             + static_cast<unsigned char>(target[pos + BLOCK_SIZE]);
+    }
+    ++pos;
+  }
+  write_insert(ops, target, literal_start, target.size());
+
+  return compress(ops);
+}
+
+
+std::string NoteDelta::apply(const std::string & base, const std::string & delta)
+{
+  std::string ops = decompress(delta);
+  std::string::size_type pos = 0;
+  if(read_number(ops, pos) != base.size()) {
+    throw sharp::Exception("Note delta was created for a different base");
+  }
+  std::string::size_type target_size = read_number(ops, pos);
+
+  std::string target;
+  target.reserve(target_size);
+  while(pos < ops.size()) {
+    char op = ops[pos++];
+    if(op == COPY) {
+      std::string::size_type offset = read_number(ops, pos);
+      std::string::size_type length = read_number(ops, pos);
+      if(offset > base.size() || length > base.size() - offset) {
+        throw sharp::Exception("Corrupt note delta");
+      }
+      target.append(base, offset, length);
+    }
+    else if(op == INSERT) {
+      std::string::size_type length = read_number(ops, pos);
+      if(length > ops.size() - pos) {
+        throw sharp::Exception("Corrupt note delta");
+      }
+      target.append(ops, pos, length);
+      pos += length;
+    }
+    else {
+      throw sharp::Exception("Corrupt note delta");
+    }
+  }
+
+  if(target.size() != target_size) {
+    throw sharp::Exception("Corrupt note delta");
+  }
+  return target;
+}
+
+
+std::string NoteDelta::file_content(int base_revision, int chain_length, const std::string & delta)
+{
+  return std::string(DELTA_FILE_MAGIC) + " " + TO_STRING(base_revision) + " "
+    + TO_STRING(chain_length) + "\n" + delta;
+}
+
+
+bool NoteDelta::parse_file(const std::string & content, int & base_revision, int & chain_length,
+                           std::string & delta)
+{
+  std::string::size_type header_end = content.find('\n');
+  if(header_end == std::string::npos) {
+    return false;
+  }
+  std::string header = content.substr(0, header_end);
+  char magic[sizeof(DELTA_FILE_MAGIC)];
+  if(std::sscanf(header.c_str(), "%8s %d %d", magic, &base_revision, &chain_length) != 3
+     || std::string(magic) != DELTA_FILE_MAGIC || base_revision < 0 || chain_length < 1) {
+    return false;
+  }
+  delta = content.substr(header_end + 1);
+  return true;
+}
+
+}
+}
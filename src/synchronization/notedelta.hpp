@@ -0,0 +1,56 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _SYNCHRONIZATION_NOTEDELTA_HPP_
+#define _SYNCHRONIZATION_NOTEDELTA_HPP_
+
+
+#include <string>
+
+
+namespace gnote {
+namespace sync {
+
+// Compressed binary deltas between revisions of a note file. Parts of the
+// target found in the base are stored as copies, the rest literally, so the
+// size of a delta follows the size of an edit, not of the note.
+class NoteDelta
+{
+public:
+  // Longest chain of deltas on a server before a full copy is stored again
+  enum { MAX_CHAIN_LENGTH = 10 };
+
+  // Delta turning base into target
+  static std::string create(const std::string & base, const std::string & target);
+  // Throws sharp::Exception, if delta is corrupt or was not created for this base
+  static std::string apply(const std::string & base, const std::string & delta);
+
+  // Content of a delta file on a server: revision of the base, length of the
+  // delta chain up to and including this one, and the delta itself
+  static std::string file_content(int base_revision, int chain_length, const std::string & delta);
+  // False, if content is not a delta file
+  static bool parse_file(const std::string & content, int & base_revision, int & chain_length,
+                         std::string & delta);
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "servermanifest.hpp"
+
+
+namespace gnote {
+namespace sync {
+
+namespace {
+
+int str_to_int(const std::string & s)
+{
+  try {
+    return STRING_TO_INT(s);
+  }
+  catch(...) {
+    return 0;
+  }
+}
+
+}
+
+
+bool ServerManifest::read(sharp::XmlReader & reader, ServerManifest & manifest)
+{
+  while(reader.read()) {
+    if(reader.get_node_type() != XML_READER_TYPE_ELEMENT) {
+      continue;
+    }
+    std::string name = reader.get_name();
+    if(name == "note") {
+      std::string id = reader.get_attribute("id");
+      manifest.notes[id] = str_to_int(reader.get_attribute("rev"));
+      std::string hash = reader.get_attribute("content-hash");
+      if(hash != "") {
+        manifest.hashes[id] = hash;
+      }
+    }
+    else if(name == "sync") {
+      std::string revision = reader.get_attribute("revision");
+      if(revision != "") {
+        manifest.revision = str_to_int(revision);
+      }
+      manifest.server_id = reader.get_attribute("server-id");
+    }
+  }
+
+  return !reader.has_error();
+}
+
+
+int ServerManifest::read_revision(sharp::XmlReader & reader)
+{
+  while(reader.read()) {
+    if(reader.get_node_type() != XML_READER_TYPE_ELEMENT) {
+      continue;
+    }
+    if(reader.get_name() == "sync") {
+      std::string revision = reader.get_attribute("revision");
+      if(revision != "") {
+        return str_to_int(revision);
+      }
+    }
+    break;
+  }
+
+  return -1;
+}
+
+}
+}
@@ -0,0 +1,60 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef _SYNCHRONIZATION_SERVERMANIFEST_HPP_
+#define _SYNCHRONIZATION_SERVERMANIFEST_HPP_
+
+
+#include <string>
+
+#include "base/macros.hpp"
+#include "isyncmanager.hpp"
+#include "sharp/xmlreader.hpp"
+
+
+namespace gnote {
+namespace sync {
+
+// Contents of manifest.xml on a sync server, in the format shared by
+// FileSystemSyncServer and WebDavSyncServer
+struct ServerManifest
+{
+  ServerManifest()
+    : revision(-1)
+    {}
+
+  // Single streaming pass, the manifest can list many thousands of notes
+  static bool read(sharp::XmlReader & reader, ServerManifest & manifest);
+  // Revision from the root element only, the rest is not read. -1 if not there.
+  static int read_revision(sharp::XmlReader & reader);
+
+  int revision;
+  std::string server_id;
+  // Note ID -> revision
+  unordered_map<std::string, int> notes;
+  // Note ID -> content hash, for notes uploaded with one
+  ContentHashMap hashes;
+};
+
+}
+}
+
+#endif
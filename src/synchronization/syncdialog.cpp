@@ -30,6 +30,7 @@
 #include "ignote.hpp"
 #include "iconmanager.hpp"
 #include "notemanager.hpp"
+#include "notesavescheduler.hpp"
 #include "notewindow.hpp"
 #include "preferences.hpp"
 #include "syncdialog.hpp"
@@ -713,6 +714,7 @@ void SyncDialog::rename_note(const Note::Ptr & note, const std::string & newTitl
 
   // Preserve note information
   note->save(); // Write to file
+  static_cast<NoteManager&>(m_manager).save_scheduler().flush();
   bool noteOpen = note->is_opened();
   std::string newContent = //note.XmlContent;
     NoteArchiver::obj().get_renamed_note_xml(note->xml_content(), oldTitle, newTitle);
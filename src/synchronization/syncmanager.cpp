@@ -20,6 +20,8 @@
 
 #include "config.h"
 
+#include <vector>
+
 #include <boost/bind.hpp>
 #include <glibmm/i18n.h>
 #include <gtkmm/actiongroup.h>
@@ -32,9 +34,11 @@
 #include "ignote.hpp"
 #include "gnotesyncclient.hpp"
 #include "notemanager.hpp"
+#include "notesavescheduler.hpp"
 #include "preferences.hpp"
 #include "silentui.hpp"
 #include "syncmanager.hpp"
+#include "syncplan.hpp"
 #include "syncserviceaddin.hpp"
 #include "sharp/xmlreader.hpp"
 
@@ -42,10 +46,17 @@
 namespace gnote {
 namespace sync {
 
+  namespace {
+    // Number of downloaded notes to apply in one main thread call
+    const std::size_t NOTE_CHANGE_BATCH_SIZE = 100;
+  }
+
+
   SyncManager::SyncManager(NoteManagerBase & m)
     : m_note_manager(m)
     , m_state(IDLE)
     , m_sync_thread(NULL)
+    , m_changed_notes_complete(false)
   {
   }
 
@@ -93,6 +104,7 @@ namespace sync {
       NoteManager & manager(dynamic_cast<NoteManager&>(note_mgr()));
       Preferences::obj().get_schema_settings(Preferences::SCHEMA_SYNC)->signal_changed()
         .connect(sigc::mem_fun(*this, &SyncManager::preferences_setting_changed));
+      manager.signal_note_added.connect(sigc::mem_fun(*this, &SyncManager::mark_note_changed));
       manager.signal_note_saved.connect(sigc::mem_fun(*this, &SyncManager::handle_note_saved_or_deleted));
       manager.signal_note_deleted.connect(sigc::mem_fun(*this, &SyncManager::handle_note_saved_or_deleted));
       manager.signal_note_buffer_changed.connect(sigc::mem_fun(*this, &SyncManager::handle_note_buffer_changed));
@@ -106,6 +118,8 @@ namespace sync {
 
   void SyncManager::reset_client()
   {
+    // No note is synchronized now
+    m_changed_notes_complete = false;
     try {
       m_client->reset();
     }
@@ -209,7 +223,12 @@ namespace sync {
 
       // Handle notes modified or added on server
       DBG_OUT("Sync: GetNoteUpdatesSince rev %d", m_client->last_synchronized_revision());
-      std::map<std::string, NoteUpdate> noteUpdates = server->get_note_updates_since(m_client->last_synchronized_revision());
+      // Notes with the same content hash on server are not downloaded
+      ContentHashMap localHashes;
+      utils::main_context_call(boost::bind(
+        sigc::mem_fun(*this, &SyncManager::get_content_hashes), boost::ref(localHashes)));
+      std::map<std::string, NoteUpdate> noteUpdates
+        = server->get_note_updates_since(m_client->last_synchronized_revision(), localHashes);
       DBG_OUT("Sync: %d updates since rev %d", int(noteUpdates.size()), m_client->last_synchronized_revision());
 
       // Gather list of new/updated note titles
@@ -224,12 +243,10 @@ namespace sync {
 
       // First, check for new local notes that might have title conflicts
       // with the updates coming from the server.  Prompt the user if necessary.
-      // TODO: Lots of searching here and in the next foreach...
-      //       Want this stuff to happen all at once first, but
-      //       maybe there's a way to store this info and pass it on?
+      // Lookups by UUID and title are hashed by the note manager.
       for(std::map<std::string, NoteUpdate>::iterator iter = noteUpdates.begin();
           iter != noteUpdates.end(); ++iter) {
-        if(!find_note_by_uuid(iter->second.m_uuid) != 0) {
+        if(find_note_by_uuid(iter->second.m_uuid) == 0) {
           NoteBase::Ptr existingNote = note_mgr().find(iter->second.m_title);
           if(existingNote != 0 && !iter->second.basically_equal_to(static_pointer_cast<Note>(existingNote))) {
             DBG_OUT("Sync: Early conflict detection for '%s'", iter->second.m_title.c_str());
@@ -248,19 +265,16 @@ namespace sync {
       // Process updates from the server; the bread and butter of sync!
       for(std::map<std::string, NoteUpdate>::iterator iter = noteUpdates.begin();
           iter != noteUpdates.end(); ++iter) {
+        if(iter->second.m_unchanged) {
+          // Local note already has this content, only record the revision
+          queue_note_change(boost::bind(
+            sigc::mem_fun(*this, &SyncManager::mark_note_synchronized), iter->second));
+          continue;
+        }
+
         NoteBase::Ptr existingNote = find_note_by_uuid(iter->second.m_uuid);
 
         if(existingNote == 0) {
-          // Actually, it's possible to have a conflict here
-          // because of automatically-created notes like
-          // template notes (if a note with a new tag syncs
-          // before its associated template). So check by
-          // title and delete if necessary.
-          existingNote = note_mgr().find(iter->second.m_title);
-          if(existingNote != 0) {
-            DBG_OUT("SyncManager: Deleting auto-generated note: %s", iter->second.m_title.c_str());
-            delete_note_in_main_thread(static_pointer_cast<Note>(existingNote));
-          }
           create_note_in_main_thread(iter->second);
         }
         else if(existingNote->metadata_change_date() <= m_client->last_sync_date()
@@ -271,6 +285,8 @@ namespace sync {
         else {
           // Logger.Debug ("Sync: Late conflict detection for '{0}'", noteUpdate.Title);
           DBG_OUT("SyncManager: Content conflict in note update for note '%s'", iter->second.m_title.c_str());
+          // User has to see notes as they are so far
+          flush_note_changes();
           // Note already exists locally, but has been modified since last sync; prompt user
           if(m_sync_ui != 0) {
             m_sync_ui->note_conflict_detected(static_pointer_cast<Note>(existingNote), iter->second, noteUpdateTitles);
@@ -285,12 +301,16 @@ namespace sync {
         }
       }
 
+      flush_note_changes();
+
       // Note deletion may affect the GUI, so we have to use the
       // delegate to run in the main gtk thread.
       // To be consistent, any exceptions in the delgate will be caught
       // and then rethrown in the synchronization thread.
+      // Server note list is fetched once and used for deletions both ways.
+      SyncPlan plan(server->get_all_note_uuids());
       utils::main_context_call(boost::bind(
-        sigc::mem_fun(*this, &SyncManager::delete_notes), server));
+        sigc::mem_fun(*this, &SyncManager::delete_notes), boost::cref(plan)));
 
       // TODO: Add following updates to syncDialog treeview
 
@@ -298,20 +318,28 @@ namespace sync {
       // Look through all the notes modified on the client
       // and upload new or modified ones to the server
       std::list<Note::Ptr> newOrModifiedNotes;
-      FOREACH(const NoteBase::Ptr & iter, note_mgr().get_notes()) {
+      ContentHashMap uploadedHashes;
+      // Saving moves notes in the collection, walk a snapshot of it
+      std::vector<NoteBase::Ptr> local_notes(note_mgr().get_notes().begin(), note_mgr().get_notes().end());
+      FOREACH(const NoteBase::Ptr & iter, local_notes) {
         Note::Ptr note = static_pointer_cast<Note>(iter);
         if(m_client->get_revision(note) == -1) {
           // This is a new note that has never been synchronized to the server
           // TODO: *OR* this is a note that we lost revision info for!!!
           // TODO: Do the above NOW!!! (don't commit this dummy)
-          note_save(note);
+          uploadedHashes[note->id()] = note_save(note);
           newOrModifiedNotes.push_back(note);
           if(m_sync_ui != 0)
             m_sync_ui->note_synchronized_th(note->get_title(), UPLOAD_NEW);
         }
         else if(m_client->get_revision(note) <= m_client->last_synchronized_revision()
                 && note->metadata_change_date() > m_client->last_sync_date()) {
-          note_save(note);
+          std::string hash = note_save(note);
+          if(hash != "" && hash == m_client->get_content_hash(note)) {
+            // Only data, that is not synchronized, has changed, like cursor position
+            continue;
+          }
+          uploadedHashes[note->id()] = hash;
           newOrModifiedNotes.push_back(note);
           if(m_sync_ui != 0) {
             m_sync_ui->note_synchronized_th(note->get_title(), UPLOAD_MODIFIED);
@@ -321,25 +349,21 @@ namespace sync {
 
       DBG_OUT("Sync: Uploading %d note updates", int(newOrModifiedNotes.size()));
       if(newOrModifiedNotes.size() > 0) {
+        // Server copies note files, so queued saves have to be written first
+        utils::main_context_call(sigc::mem_fun(*this, &SyncManager::flush_note_saves));
         set_state(UPLOADING);
         server->upload_notes(newOrModifiedNotes); // TODO: Callbacks to update GUI as upload progresses
       }
 
       // Handle notes deleted on client
-      std::list<std::string> locallyDeletedUUIDs;
-      std::list<std::string> all_note_uuids = server->get_all_note_uuids();
-      for(std::list<std::string>::iterator iter = all_note_uuids.begin();
-          iter != all_note_uuids.end(); ++iter) {
-        if(find_note_by_uuid(*iter) == 0) {
-          locallyDeletedUUIDs.push_back(*iter);
-          if(m_sync_ui != 0) {
-            std::string deletedTitle = *iter;
-            std::map<std::string, std::string> deleted_note_titles = m_client->deleted_note_titles();
-            if(deleted_note_titles.find(*iter) != deleted_note_titles.end()) {
-              deletedTitle = deleted_note_titles[*iter];
-            }
-            m_sync_ui->note_synchronized_th(deletedTitle, DELETE_FROM_SERVER);
-          }
+      // Uploaded notes are local, so the list from before upload is still good
+      std::list<std::string> locallyDeletedUUIDs = plan.deleted_locally(note_mgr().get_notes());
+      if(m_sync_ui != 0 && locallyDeletedUUIDs.size() > 0) {
+        std::map<std::string, std::string> deleted_note_titles = m_client->deleted_note_titles();
+        FOREACH(const std::string & uuid, locallyDeletedUUIDs) {
+          std::map<std::string, std::string>::iterator title = deleted_note_titles.find(uuid);
+          m_sync_ui->note_synchronized_th(title != deleted_note_titles.end() ? title->second : uuid,
+                                          DELETE_FROM_SERVER);
         }
       }
       if(locallyDeletedUUIDs.size() > 0) {
@@ -355,6 +379,7 @@ namespace sync {
         for(std::list<Note::Ptr>::iterator iter = newOrModifiedNotes.begin();
             iter != newOrModifiedNotes.end(); ++iter) {
           m_client->set_revision(*iter, newRevision);
+          m_client->set_content_hash(*iter, uploadedHashes[(*iter)->id()]);
         }
         set_state(SUCCEEDED);
       }
@@ -377,6 +402,8 @@ namespace sync {
       ERR_OUT(_("Synchronization failed with the following exception: %s"), e.what());
       // TODO: Report graphically to user
       try {
+        // Keep the notes, that were downloaded before failure
+        flush_note_changes();
         set_state(IDLE); // stop progress
         set_state(FAILED);
         set_state(IDLE); // required to allow user to sync again
@@ -445,8 +472,15 @@ namespace sync {
   }
 
 
-  void SyncManager::handle_note_saved_or_deleted(const NoteBase::Ptr &)
+  void SyncManager::mark_note_changed(const NoteBase::Ptr & note)
+  {
+    m_changed_notes.insert(note->id());
+  }
+
+
+  void SyncManager::handle_note_saved_or_deleted(const NoteBase::Ptr & note)
   {
+    mark_note_changed(note);
     if(m_sync_thread == NULL && m_autosync_timeout_pref_minutes > 0) {
       sharp::TimeSpan time_since_last_check(sharp::DateTime::now() - m_last_background_check);
       sharp::TimeSpan time_until_next_check(
@@ -491,16 +525,7 @@ namespace sync {
         // TODO: Figure out a clever way to get the specific error up to the GUI
       }
       bool server_has_updates = false;
-      bool client_has_updates = m_client->deleted_note_titles().size() > 0;
-      if(!client_has_updates) {
-        FOREACH(const NoteBase::Ptr & iter, note_mgr().get_notes()) {
-          Note::Ptr note = static_pointer_cast<Note>(iter);
-          if(m_client->get_revision(note) == -1 || note->metadata_change_date() > m_client->last_sync_date()) {
-            client_has_updates = true;
-            break;
-          }
-        }
-      }
+      bool client_has_updates = check_client_updates();
 
       // NOTE: Important to check, at least to verify
       //       that server is available
@@ -528,6 +553,42 @@ namespace sync {
   }
 
 
+  bool SyncManager::check_client_updates()
+  {
+    if(m_client->deleted_note_titles().size() > 0) {
+      return true;
+    }
+
+    // Once all notes are known to be synchronized, only the ones
+    // saved or deleted since then have to be checked
+    if(m_changed_notes_complete) {
+      FOREACH(const std::string & uuid, m_changed_notes) {
+        NoteBase::Ptr note = find_note_by_uuid(uuid);
+        if(note != 0 && note_has_updates(note)) {
+          return true;
+        }
+      }
+    }
+    else {
+      FOREACH(const NoteBase::Ptr & note, note_mgr().get_notes()) {
+        if(note_has_updates(note)) {
+          return true;
+        }
+      }
+      m_changed_notes_complete = true;
+    }
+
+    m_changed_notes.clear();
+    return false;
+  }
+
+
+  bool SyncManager::note_has_updates(const NoteBase::Ptr & note)
+  {
+    return m_client->get_revision(note) == -1 || note->metadata_change_date() > m_client->last_sync_date();
+  }
+
+
   void SyncManager::set_state(SyncState new_state)
   {
     m_state = new_state;
@@ -581,34 +642,57 @@ namespace sync {
 
   void SyncManager::create_note_in_main_thread(const NoteUpdate & noteUpdate)
   {
-    // Note creation may affect the GUI, so we have to use the
-    // delegate to run in the main gtk thread.
-    // To be consistent, any exceptions in the delgate will be caught
-    // and then rethrown in the synchronization thread.
-    utils::main_context_call(boost::bind(
+    queue_note_change(boost::bind(
       sigc::mem_fun(*this, &SyncManager::create_note), noteUpdate));
   }
 
 
   void SyncManager::update_note_in_main_thread(const Note::Ptr & existingNote, const NoteUpdate & noteUpdate)
   {
-    // Note update may affect the GUI, so we have to use the
-    // delegate to run in the main gtk thread.
-    // To be consistent, any exceptions in the delgate will be caught
-    // and then rethrown in the synchronization thread.
-    utils::main_context_call(boost::bind(
+    queue_note_change(boost::bind(
       sigc::mem_fun(*this, &SyncManager::update_note), existingNote, noteUpdate));
   }
 
 
-  void SyncManager::delete_note_in_main_thread(const Note::Ptr & existingNote)
+  void SyncManager::queue_note_change(const sigc::slot<void> & change)
+  {
+    m_pending_note_changes.push_back(change);
+    if(m_pending_note_changes.size() >= NOTE_CHANGE_BATCH_SIZE) {
+      flush_note_changes();
+    }
+  }
+
+
+  void SyncManager::flush_note_changes()
   {
-    // Note deletion may affect the GUI, so we have to use the
+    if(m_pending_note_changes.empty()) {
+      return;
+    }
+
+    NoteChangeList changes;
+    changes.swap(m_pending_note_changes);
+    // Note changes may affect the GUI, so we have to use the
     // delegate to run in the main gtk thread.
-    // To be consistent, any exceptions in the delgate will be caught
-    // and then rethrown in the synchronization thread.
+    // A whole batch is applied in one call, instead of a round trip per note.
     utils::main_context_call(boost::bind(
-      sigc::mem_fun(*this, &SyncManager::delete_note), existingNote));
+      sigc::mem_fun(*this, &SyncManager::apply_note_changes), changes));
+  }
+
+
+  void SyncManager::apply_note_changes(const NoteChangeList & changes)
+  {
+    // Let title trie, search results etc. update once for the whole batch
+    note_mgr().freeze_updates();
+    try {
+      FOREACH(const sigc::slot<void> & change, changes) {
+        change();
+      }
+    }
+    catch(...) {
+      note_mgr().thaw_updates();
+      throw;
+    }
+    note_mgr().thaw_updates();
   }
 
 
@@ -621,6 +705,9 @@ namespace sync {
     catch(...)
     {} // TODO: Handle exception in case that serverNote.XmlContent is invalid XML
     m_client->set_revision(static_pointer_cast<Note>(localNote), serverNote.m_latest_revision);
+    // Saving is queued, so hash has to be updated here
+    localNote->update_content_hash();
+    m_client->set_content_hash(localNote, localNote->content_hash());
 
     // Update dialog's sync status
     if(m_sync_ui != 0) {
@@ -687,25 +774,16 @@ namespace sync {
   }
 
 
-  void SyncManager::delete_notes(const SyncServer::Ptr & server)
+  void SyncManager::delete_notes(const SyncPlan & plan)
   {
     try {
-      // Make list of all local notes
-      std::list<NoteBase::Ptr> localNotes = note_mgr().get_notes();
-
-      // Get all notes currently on server
-      std::list<std::string> serverNotes = server->get_all_note_uuids();
-
       // Delete notes locally that have been deleted on the server
-      FOREACH(const NoteBase::Ptr & iter, localNotes) {
-        Note::Ptr note = static_pointer_cast<Note>(iter);
-	if(SyncManager::_obj().m_client->get_revision(note) != -1
-	   && std::find(serverNotes.begin(), serverNotes.end(), note->id()) == serverNotes.end()) {
-	  if(m_sync_ui != 0) {
-	    m_sync_ui->note_synchronized(note->get_title(), DELETE_FROM_CLIENT);
-	  }
-	  note_mgr().delete_note(note);
-	}
+      std::list<NoteBase::Ptr> deleted = plan.deleted_on_server(note_mgr().get_notes(), *m_client);
+      FOREACH(const NoteBase::Ptr & note, deleted) {
+        if(m_sync_ui != 0) {
+          m_sync_ui->note_synchronized(note->get_title(), DELETE_FROM_CLIENT);
+        }
+        note_mgr().delete_note(note);
       }
     }
     catch(std::exception & e) {
@@ -720,7 +798,19 @@ namespace sync {
   void SyncManager::create_note(const NoteUpdate & noteUpdate)
   {
     try {
-      NoteBase::Ptr existingNote = note_mgr().create_with_guid(noteUpdate.m_title, noteUpdate.m_uuid);
+      // Actually, it's possible to have a conflict here
+      // because of automatically-created notes like
+      // template notes (if a note with a new tag syncs
+      // before its associated template). So check by
+      // title and delete if necessary.
+      // This is done here, because such note can be created by previous
+      // change in the same batch.
+      NoteBase::Ptr existingNote = note_mgr().find(noteUpdate.m_title);
+      if(existingNote != 0) {
+        DBG_OUT("SyncManager: Deleting auto-generated note: %s", noteUpdate.m_title.c_str());
+        delete_note(existingNote);
+      }
+      existingNote = note_mgr().create_with_guid(noteUpdate.m_title, noteUpdate.m_uuid);
       update_local_note(existingNote, noteUpdate, DOWNLOAD_NEW);
     }
     catch(std::exception & e) {
@@ -732,10 +822,10 @@ namespace sync {
   }
 
 
-  void SyncManager::update_note(const Note::Ptr & existingNote, const NoteUpdate & noteUpdate)
+  void SyncManager::delete_note(const NoteBase::Ptr & existingNote)
   {
     try {
-      update_local_note(existingNote, noteUpdate, DOWNLOAD_MODIFIED);
+      note_mgr().delete_note(existingNote);
     }
     catch(std::exception & e) {
       DBG_OUT("Exception caught in %s: %s\n", __func__, e.what());
@@ -746,10 +836,10 @@ namespace sync {
   }
 
 
-  void SyncManager::delete_note(const Note::Ptr & existingNote)
+  void SyncManager::update_note(const Note::Ptr & existingNote, const NoteUpdate & noteUpdate)
   {
     try {
-      note_mgr().delete_note(existingNote);
+      update_local_note(existingNote, noteUpdate, DOWNLOAD_MODIFIED);
     }
     catch(std::exception & e) {
       DBG_OUT("Exception caught in %s: %s\n", __func__, e.what());
@@ -760,9 +850,41 @@ namespace sync {
   }
 
 
-  void SyncManager::note_save(const Note::Ptr & note)
+  std::string SyncManager::note_save(const Note::Ptr & note)
+  {
+    std::string hash;
+    utils::main_context_call(boost::bind(&SyncManager::save_and_hash, note, boost::ref(hash)));
+    return hash;
+  }
+
+
+  void SyncManager::save_and_hash(const Note::Ptr & note, std::string & hash)
+  {
+    note->save();
+    note->update_content_hash();
+    hash = note->content_hash();
+  }
+
+
+  void SyncManager::get_content_hashes(ContentHashMap & hashes)
+  {
+    SyncPlan::local_content_hashes(note_mgr().get_notes(), *m_client).swap(hashes);
+  }
+
+
+  void SyncManager::mark_note_synchronized(const NoteUpdate & noteUpdate)
+  {
+    NoteBase::Ptr note = find_note_by_uuid(noteUpdate.m_uuid);
+    if(note != 0) {
+      m_client->set_revision(note, noteUpdate.m_latest_revision);
+      m_client->set_content_hash(note, noteUpdate.m_content_hash);
+    }
+  }
+
+
+  void SyncManager::flush_note_saves()
   {
-    utils::main_context_call(sigc::mem_fun(*note, &Note::save));
+    static_cast<NoteManager&>(note_mgr()).save_scheduler().flush();
   }
 
 
@@ -22,6 +22,7 @@
 #define _SYNCHRONIZATION_SYNCMANAGER_HPP_
 
 
+#include <list>
 #include <map>
 
 #include <glibmm/main.h>
@@ -34,6 +35,7 @@
 namespace gnote {
 namespace sync {
 
+  class SyncPlan;
   class SyncServiceAddin;
 
   class SyncManager
@@ -65,24 +67,35 @@ namespace sync {
         return static_cast<SyncManager&>(obj());
       }
     void _init(NoteManagerBase &);
+    void mark_note_changed(const NoteBase::Ptr & note);
     void handle_note_saved_or_deleted(const NoteBase::Ptr & note);
     void handle_note_buffer_changed(const NoteBase::Ptr & note);
     void preferences_setting_changed(const Glib::ustring & key);
     void update_sync_action();
     void background_sync_checker();
+    bool check_client_updates();
+    bool note_has_updates(const NoteBase::Ptr & note);
     void set_state(SyncState new_state);
     void create_note_in_main_thread(const NoteUpdate & noteUpdate);
     void update_note_in_main_thread(const Note::Ptr & existingNote, const NoteUpdate & noteUpdate);
-    void delete_note_in_main_thread(const Note::Ptr & existingNote);
+    typedef std::list<sigc::slot<void> > NoteChangeList;
+    void queue_note_change(const sigc::slot<void> & change);
+    void flush_note_changes();
+    void apply_note_changes(const NoteChangeList & changes);
     void update_local_note(const NoteBase::Ptr & localNote, const NoteUpdate & serverNote, NoteSyncType syncType);
     NoteBase::Ptr find_note_by_uuid(const std::string & uuid);
     NoteManagerBase & note_mgr();
     void get_synchronized_xml_bits(const std::string & noteXml, std::string & title, std::string & tags, std::string & content);
-    void delete_notes(const SyncServer::Ptr & server);
+    void delete_notes(const SyncPlan & plan);
     void create_note(const NoteUpdate & noteUpdate);
+    void delete_note(const NoteBase::Ptr & existingNote);
     void update_note(const Note::Ptr & existingNote, const NoteUpdate & noteUpdate);
-    void delete_note(const Note::Ptr & existingNote);
-    static void note_save(const Note::Ptr & note);
+    // Saves note in main thread, returns its content hash
+    static std::string note_save(const Note::Ptr & note);
+    static void save_and_hash(const Note::Ptr & note, std::string & hash);
+    void get_content_hashes(ContentHashMap & hashes);
+    void mark_note_synchronized(const NoteUpdate & noteUpdate);
+    void flush_note_saves();
 
     NoteManagerBase & m_note_manager;
     SyncState m_state;
@@ -92,6 +105,12 @@ namespace sync {
     int m_autosync_timeout_pref_minutes;
     int m_current_autosync_timeout_minutes;
     sharp::DateTime m_last_background_check;
+    // Downloaded changes, not yet applied. Only used by sync thread.
+    NoteChangeList m_pending_note_changes;
+    // Notes added, saved or deleted since the last background check
+    unordered_set<std::string> m_changed_notes;
+    // Whether all other notes are known to be synchronized
+    bool m_changed_notes_complete;
   };
 
 
@@ -0,0 +1,84 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "syncplan.hpp"
+
+
+namespace gnote {
+namespace sync {
+
+SyncPlan::SyncPlan(const std::list<std::string> & server_notes)
+  : m_server_note_list(server_notes)
+  , m_server_notes(server_notes.begin(), server_notes.end())
+{
+}
+
+
+std::list<NoteBase::Ptr> SyncPlan::deleted_on_server(const NoteCollection & local_notes,
+                                                     SyncClient & client) const
+{
+  std::list<NoteBase::Ptr> deleted;
+  FOREACH(const NoteBase::Ptr & note, local_notes) {
+    if(m_server_notes.find(note->id()) == m_server_notes.end() && client.get_revision(note) != -1) {
+      deleted.push_back(note);
+    }
+  }
+
+  return deleted;
+}
+
+
+std::list<std::string> SyncPlan::deleted_locally(const NoteCollection & local_notes) const
+{
+  UuidSet local;
+  FOREACH(const NoteBase::Ptr & note, local_notes) {
+    local.insert(note->id());
+  }
+
+  std::list<std::string> deleted;
+  FOREACH(const std::string & uuid, m_server_note_list) {
+    if(local.find(uuid) == local.end()) {
+      deleted.push_back(uuid);
+    }
+  }
+
+  return deleted;
+}
+
+
+ContentHashMap SyncPlan::local_content_hashes(const NoteCollection & local_notes, SyncClient & client)
+{
+  ContentHashMap hashes;
+  FOREACH(const NoteBase::Ptr & note, local_notes) {
+    std::string hash = note->content_hash();
+    if(hash == "" && client.get_revision(note) != -1
+       && note->metadata_change_date() <= client.last_sync_date()) {
+      hash = client.get_content_hash(note);
+    }
+    if(hash != "") {
+      hashes[note->id()] = hash;
+    }
+  }
+  return hashes;
+}
+
+}
+}
@@ -0,0 +1,70 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef _SYNCHRONIZATION_SYNCPLAN_HPP_
+#define _SYNCHRONIZATION_SYNCPLAN_HPP_
+
+
+#include <list>
+#include <string>
+
+#include "base/macros.hpp"
+#include "isyncmanager.hpp"
+#include "notecollection.hpp"
+
+
+namespace gnote {
+namespace sync {
+
+// Works out which notes a synchronization has to delete, both locally and
+// on the server. Note UUIDs from the server are hashed once per run, so
+// every decision is a set lookup instead of a scan over the other side.
+class SyncPlan
+{
+public:
+  typedef unordered_set<std::string> UuidSet;
+
+  explicit SyncPlan(const std::list<std::string> & server_notes);
+
+  const UuidSet & server_notes() const
+    {
+      return m_server_notes;
+    }
+
+  // Local notes, that have been synchronized before, but are no longer on the server
+  std::list<NoteBase::Ptr> deleted_on_server(const NoteCollection & local_notes,
+                                             SyncClient & client) const;
+  // Notes on the server, that no longer exist locally
+  std::list<std::string> deleted_locally(const NoteCollection & local_notes) const;
+  // Content hashes of local notes, servers skip downloads of the same content.
+  // Notes, that were not saved since loaded, have the hash of last sync,
+  // if they have not changed since it.
+  static ContentHashMap local_content_hashes(const NoteCollection & local_notes, SyncClient & client);
+private:
+  // Keeps server order, so that results do not depend on hashing
+  std::list<std::string> m_server_note_list;
+  UuidSet m_server_notes;
+};
+
+}
+}
+
+#endif
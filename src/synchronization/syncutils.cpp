@@ -37,6 +37,7 @@ namespace gnote {
 namespace sync {
 
   NoteUpdate::NoteUpdate(const std::string & xml_content, const std::string & title, const std::string & uuid, int latest_revision)
+    : m_unchanged(false)
   {
     m_xml_content = xml_content;
     m_title = title;
@@ -62,14 +63,19 @@ namespace sync {
 
   bool NoteUpdate::basically_equal_to(const Note::Ptr & existing_note)
   {
+    // Both hashes cover title, tags and content, no need to parse anything
+    if(m_unchanged) {
+      return true;
+    }
+    if(m_content_hash != "" && m_content_hash == existing_note->content_hash()) {
+      return true;
+    }
+
     // NOTE: This would be so much easier if NoteUpdate
     //       was not just a container for a big XML string
-    sharp::XmlReader xml;
-    xml.load_buffer(m_xml_content);
     NoteData *data = new NoteData(m_uuid);
-    NoteArchiver::obj().read(xml, *data);
     std::auto_ptr<NoteData> update_data(data);
-    xml.close();
+    NoteArchiver::obj().read_buffer(m_xml_content, *data);
 
     // NOTE: Mostly a hack to ignore missing version attributes
     std::string existing_inner_content = get_inner_content(existing_note->data().text());
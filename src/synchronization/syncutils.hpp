@@ -73,6 +73,10 @@ namespace sync {
     std::string m_title;
     std::string m_uuid; //needed?
     int m_latest_revision;
+    // Hash of synchronized content from server manifest, empty if not known
+    std::string m_content_hash;
+    // Content is the same as of local note, so it was not downloaded
+    bool m_unchanged;
 
     NoteUpdate(const std::string & xml_content, const std::string & title, const std::string & uuid, int latest_revision);
     bool basically_equal_to(const Note::Ptr & existing_note);
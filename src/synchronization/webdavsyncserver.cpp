@@ -0,0 +1,1007 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include <glibmm/fileutils.h>
+#include <glibmm/i18n.h>
+#include <libsoup/soup.h>
+
+#include "debug.hpp"
+#include "notedelta.hpp"
+#include "webdavsyncserver.hpp"
+#include "sharp/exception.hpp"
+#include "sharp/files.hpp"
+#include "sharp/uuid.hpp"
+#include "sharp/workerpool.hpp"
+#include "sharp/xml.hpp"
+#include "sharp/xmlreader.hpp"
+#include "sharp/xmlwriter.hpp"
+
+
+namespace gnote {
+namespace sync {
+
+namespace {
+
+const char *MANIFEST_FILE = "manifest.xml";
+const char *LOCK_FILE = "lock";
+
+const char *PROPFIND_RESOURCE_TYPE =
+  "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+  "<propfind xmlns=\"DAV:\"><prop><resourcetype/></prop></propfind>";
+
+
+int str_to_int(const std::string & s)
+{
+  try {
+    return STRING_TO_INT(s);
+  }
+  catch(...) {
+    return 0;
+  }
+}
+
+
+// Revision for directory name, -1 if name is not a number
+int revision_from_name(const std::string & name)
+{
+  if(name.empty() || name.find_first_not_of("0123456789") != std::string::npos) {
+    return -1;
+  }
+  return str_to_int(name);
+}
+
+
+// Element name without namespace prefix
+std::string local_name(const std::string & name)
+{
+  std::string::size_type pos = name.find(':');
+  return pos == std::string::npos ? name : name.substr(pos + 1);
+}
+
+
+std::string strip_trailing_slash(const std::string & path)
+{
+  if(path.size() > 1 && path[path.size() - 1] == '/') {
+    return path.substr(0, path.size() - 1);
+  }
+  return path;
+}
+
+
+// Calls transfer for every item, up to MAX_CONNECTIONS at the same time
+template <typename T>
+class TransferPool
+{
+public:
+  TransferPool(std::vector<T> & items, const sigc::slot<void, T&> & transfer)
+    : m_items(items)
+    , m_transfer(transfer)
+    {}
+
+  void run()
+    {
+      sharp::WorkerPool(m_items.size(), sigc::mem_fun(*this, &TransferPool::transfer))
+        .run(WebDavSyncServer::MAX_CONNECTIONS);
+    }
+private:
+  void transfer(std::size_t index)
+    {
+      m_transfer(m_items[index]);
+    }
+
+  std::vector<T> & m_items;
+  sigc::slot<void, T&> m_transfer;
+};
+
+}
+
+
+struct WebDavSyncServer::Upload
+{
+  std::string file;
+  std::string path;
+  bool success;
+};
+
+
+struct WebDavSyncServer::Download
+{
+  std::string note_id;
+  int revision;
+  std::string path;
+  shared_ptr<NoteUpdate> update;
+  std::string error;
+};
+
+
+struct WebDavSyncServer::Removal
+{
+  std::string note_id;
+  int revision;
+};
+
+
+SyncServer::Ptr WebDavSyncServer::create(const std::string & url, const std::string & username,
+                                         const std::string & password, bool accept_ssl_cert)
+{
+  return SyncServer::Ptr(new WebDavSyncServer(url, username, password, accept_ssl_cert));
+}
+
+
+WebDavSyncServer::WebDavSyncServer(const std::string & url, const std::string & username,
+                                   const std::string & password, bool accept_ssl_cert)
+  : m_session(NULL)
+  , m_base_uri(NULL)
+  , m_manifest_loaded(false)
+  , m_transaction_active(false)
+  , m_new_revision(-1)
+{
+  // Paths are resolved relative to server URL, so it has to be a directory
+  std::string base = url;
+  if(base.empty() || base[base.size() - 1] != '/') {
+    base += '/';
+  }
+  m_base_uri = soup_uri_new(base.c_str());
+  if(!m_base_uri || !SOUP_URI_VALID_FOR_HTTP(m_base_uri)) {
+    if(m_base_uri) {
+      soup_uri_free(m_base_uri);
+    }
+    throw std::invalid_argument(("Invalid WebDAV URL: " + url).c_str());
+  }
+  if(username != "") {
+    soup_uri_set_user(m_base_uri, username.c_str());
+    soup_uri_set_password(m_base_uri, password.c_str());
+  }
+
+  // Connections are kept alive and reused by the session
+  m_session = soup_session_new_with_options(
+    SOUP_SESSION_MAX_CONNS, int(MAX_CONNECTIONS),
+    SOUP_SESSION_MAX_CONNS_PER_HOST, int(MAX_CONNECTIONS),
+    SOUP_SESSION_SSL_USE_SYSTEM_CA_FILE, TRUE,
+    SOUP_SESSION_SSL_STRICT, accept_ssl_cert ? FALSE : TRUE,
+    SOUP_SESSION_USER_AGENT, PACKAGE_NAME "/" PACKAGE_VERSION,
+    NULL);
+
+  m_lock_timeout.signal_timeout
+    .connect(sigc::mem_fun(*this, &WebDavSyncServer::lock_timeout));
+}
+
+
+WebDavSyncServer::~WebDavSyncServer()
+{
+  soup_session_abort(m_session);
+  g_object_unref(m_session);
+  soup_uri_free(m_base_uri);
+}
+
+
+void WebDavSyncServer::upload_notes(const std::list<Note::Ptr> & notes)
+{
+  DBG_OUT("UploadNotes: notes.Count = %d", int(notes.size()));
+  std::list<std::string> files;
+  ContentHashMap hashes;
+  FOREACH(const Note::Ptr & note, notes) {
+    files.push_back(note->file_path());
+    hashes[note->id()] = note->content_hash();
+  }
+  upload_note_files(files, hashes);
+}
+
+
+void WebDavSyncServer::upload_note_files(const std::list<std::string> & files, const ContentHashMap & hashes)
+{
+  std::string rev_dir = get_revision_dir_path(m_new_revision);
+  make_collection(TO_STRING(m_new_revision / 100) + "/");
+  make_collection(rev_dir);
+
+  std::vector<Upload> uploads;
+  uploads.reserve(files.size());
+  FOREACH(const std::string & file, files) {
+    Upload upload;
+    upload.file = file;
+    upload.path = rev_dir + sharp::file_filename(file);
+    upload.success = false;
+    uploads.push_back(upload);
+  }
+
+  TransferPool<Upload> pool(uploads, sigc::mem_fun(*this, &WebDavSyncServer::upload_file));
+  pool.run();
+
+  FOREACH(const Upload & upload, uploads) {
+    if(upload.success) {
+      std::string note_id = sharp::file_basename(upload.file);
+      ContentHashMap::const_iterator hash = hashes.find(note_id);
+      m_updated_notes[note_id] = hash != hashes.end() ? hash->second : "";
+    }
+    else {
+      DBG_OUT("Sync: Error uploading note \"%s\"", upload.file.c_str());
+    }
+  }
+}
+
+
+void WebDavSyncServer::upload_file(Upload & upload)
+{
+  try {
+    put(upload.path, Glib::file_get_contents(upload.file));
+    upload.success = true;
+  }
+  catch(const Glib::Exception & e) {
+    ERR_OUT(_("Failed to upload %s: %s"), upload.file.c_str(), e.what().c_str());
+  }
+  catch(const std::exception & e) {
+    ERR_OUT(_("Failed to upload %s: %s"), upload.file.c_str(), e.what());
+  }
+}
+
+
+void WebDavSyncServer::delete_notes(const std::list<std::string> & deletedNoteUUIDs)
+{
+  m_deleted_notes.insert(deletedNoteUUIDs.begin(), deletedNoteUUIDs.end());
+}
+
+
+std::list<std::string> WebDavSyncServer::get_all_note_uuids()
+{
+  std::list<std::string> noteUUIDs;
+
+  const Manifest & current = manifest();
+  for(unordered_map<std::string, int>::const_iterator iter = current.notes.begin();
+      iter != current.notes.end(); ++iter) {
+    noteUUIDs.push_back(iter->first);
+  }
+  DBG_OUT("get_all_note_uuids has %d notes", int(noteUUIDs.size()));
+
+  return noteUUIDs;
+}
+
+
+bool WebDavSyncServer::updates_available_since(int revision)
+{
+  // Background checks only need the revision from the manifest header.
+  // Servers, that do not support ranges, send the whole file.
+  Headers headers;
+  headers["Range"] = "bytes=0-" + TO_STRING(int(MANIFEST_PROBE_SIZE) - 1);
+  Response response = request("GET", MANIFEST_FILE, headers);
+  int latest = -1;
+  if(SOUP_STATUS_IS_SUCCESSFUL(response.status)) {
+    latest = parse_manifest_revision(response.body);
+  }
+  else if(response.status != SOUP_STATUS_NOT_FOUND
+          && response.status != SOUP_STATUS_REQUESTED_RANGE_NOT_SATISFIABLE) {
+    throw GnoteSyncException(("GET manifest.xml: " + std::string(soup_status_get_phrase(response.status))).c_str());
+  }
+
+  if(latest < 0) {
+    latest = latest_revision();
+  }
+  return latest > revision;
+}
+
+
+std::map<std::string, NoteUpdate> WebDavSyncServer::get_note_updates_since(int revision,
+                                                                          const ContentHashMap & local_hashes)
+{
+  std::map<std::string, NoteUpdate> noteUpdates;
+  std::vector<Download> downloads;
+
+  const Manifest & current = manifest();
+  for(unordered_map<std::string, int>::const_iterator iter = current.notes.begin();
+      iter != current.notes.end(); ++iter) {
+    if(iter->second <= revision) {
+      continue;
+    }
+
+    // Same content locally, no need to download it
+    ContentHashMap::const_iterator hash = current.hashes.find(iter->first);
+    if(hash != current.hashes.end()) {
+      ContentHashMap::const_iterator local_hash = local_hashes.find(iter->first);
+      if(local_hash != local_hashes.end() && local_hash->second == hash->second) {
+        NoteUpdate update("", "", iter->first, iter->second);
+        update.m_content_hash = hash->second;
+        update.m_unchanged = true;
+        noteUpdates.insert(std::make_pair(iter->first, update));
+        continue;
+      }
+    }
+
+    Download download;
+    download.note_id = iter->first;
+    download.revision = iter->second;
+    download.path = get_revision_dir_path(iter->second) + iter->first + ".note";
+    downloads.push_back(download);
+  }
+
+  TransferPool<Download> pool(downloads, sigc::mem_fun(*this, &WebDavSyncServer::download_note));
+  pool.run();
+
+  std::string error;
+  FOREACH(Download & download, downloads) {
+    if(download.update) {
+      noteUpdates.insert(std::make_pair(download.note_id, *download.update));
+    }
+    else if(error.empty()) {
+      error = download.error;
+    }
+  }
+  if(!error.empty()) {
+    throw sharp::Exception(error);
+  }
+
+  DBG_OUT("get_note_updates_since (%d) returning: %d", revision, int(noteUpdates.size()));
+  return noteUpdates;
+}
+
+
+void WebDavSyncServer::download_note(Download & download)
+{
+  try {
+    std::string xml;
+    if(get(download.path, xml) || get_note_deltas(download.note_id, download.revision, xml)) {
+      download.update.reset(new NoteUpdate(xml, "", download.note_id, download.revision));
+    }
+    else {
+      download.error = "Note not found on server: " + download.path;
+    }
+  }
+  catch(const std::exception & e) {
+    download.error = e.what();
+  }
+}
+
+
+bool WebDavSyncServer::get_note_deltas(const std::string & note_id, int revision, std::string & content)
+{
+  // Walk back to a full copy of the note, then apply deltas on the way forward
+  std::vector<std::string> deltas;
+  int rev = revision;
+  do {
+    std::string delta_file;
+    if(!get(get_revision_dir_path(rev) + note_id + ".delta", delta_file)) {
+      return false;
+    }
+    int base_revision, chain_length;
+    std::string delta;
+    if(!NoteDelta::parse_file(delta_file, base_revision, chain_length, delta) || base_revision >= rev) {
+      throw sharp::Exception("Corrupt revision " + TO_STRING(rev) + " of note " + note_id);
+    }
+    deltas.push_back(delta);
+    rev = base_revision;
+  } while(!get(get_revision_dir_path(rev) + note_id + ".note", content));
+
+  for(std::vector<std::string>::reverse_iterator iter = deltas.rbegin(); iter != deltas.rend(); ++iter) {
+    content = NoteDelta::apply(content, *iter);
+  }
+  return true;
+}
+
+
+void WebDavSyncServer::remove_note_revision(Removal & removal)
+{
+  try {
+    int rev = removal.revision;
+    while(rev >= 0) {
+      std::string path = get_revision_dir_path(rev) + removal.note_id;
+      Response response = request("DELETE", path + ".note");
+      if(response.status != SOUP_STATUS_NOT_FOUND) {
+        if(!SOUP_STATUS_IS_SUCCESSFUL(response.status)) {
+          throw GnoteSyncException(("DELETE " + path + ".note: " + soup_status_get_phrase(response.status)).c_str());
+        }
+        break;
+      }
+
+      // Stored as a delta by FileSystemSyncServer, follow it back to the full copy
+      std::string delta_file;
+      if(!get(path + ".delta", delta_file)) {
+        break;
+      }
+      remove(path + ".delta");
+      int base_revision, chain_length;
+      std::string delta;
+      if(!NoteDelta::parse_file(delta_file, base_revision, chain_length, delta) || base_revision >= rev) {
+        break;
+      }
+      rev = base_revision;
+    }
+  }
+  catch(const std::exception & e) {
+    ERR_OUT(_("Failed to remove revision %d of note %s: %s"), removal.revision, removal.note_id.c_str(), e.what());
+  }
+}
+
+
+bool WebDavSyncServer::begin_sync_transaction()
+{
+  // Same lock file protocol as FileSystemSyncServer, so that clients
+  // using a mounted server see the lock too
+  std::string lock;
+  if(get(LOCK_FILE, lock)) {
+    SyncLockInfo currentSyncLock = current_sync_lock();
+    if(m_initial_sync_attempt == sharp::DateTime()) {
+      DBG_OUT("Sync: Discovered a sync lock file, wait at least %s before trying again.", currentSyncLock.duration.string().c_str());
+      // This is our initial attempt to sync and we've detected
+      // a sync file, so we're gonna have to wait.
+      m_initial_sync_attempt = sharp::DateTime::now();
+      m_last_sync_lock_hash = currentSyncLock.hash_string();
+      return false;
+    }
+    else if(m_last_sync_lock_hash != currentSyncLock.hash_string()) {
+      DBG_OUT("Sync: Updated sync lock file discovered, wait at least %s before trying again.", currentSyncLock.duration.string().c_str());
+      // The sync lock has been updated and is still a valid lock
+      m_initial_sync_attempt = sharp::DateTime::now();
+      m_last_sync_lock_hash = currentSyncLock.hash_string();
+      return false;
+    }
+    else {
+      // The sync lock is the same so check to see if the
+      // duration of the lock has expired.  If it hasn't, wait
+      // even longer.
+      if(sharp::DateTime::now() - currentSyncLock.duration < m_initial_sync_attempt) {
+        DBG_OUT("Sync: You haven't waited long enough for the sync file to expire.");
+        return false;
+      }
+
+      cleanup_old_sync();
+    }
+  }
+
+  // Reset the initialSyncAttempt
+  m_initial_sync_attempt = sharp::DateTime();
+  m_last_sync_lock_hash = "";
+
+  // Not done on creation, so that servers for background checks are cheap
+  m_stale_revisions.clear();
+  m_new_revision = manifest().revision;
+  if(m_new_revision < 0) {
+    m_new_revision = find_latest_revision(m_stale_revisions);
+  }
+  ++m_new_revision;
+
+  // Create a new lock file so other clients know another client is
+  // actively synchronizing right now.
+  m_sync_lock.renew_count = 0;
+  m_sync_lock.revision = m_new_revision;
+  update_lock_file(m_sync_lock);
+  // Reset the timer to 20 seconds sooner than the sync lock duration
+  m_lock_timeout.reset(m_sync_lock.duration.total_milliseconds() - 20000);
+
+  m_updated_notes.clear();
+  m_deleted_notes.clear();
+  // Another client may have committed since manifest was last read.
+  // After that nobody else changes it, while we hold the lock.
+  m_transaction_active = false;
+  manifest();
+  m_transaction_active = true;
+
+  return true;
+}
+
+
+bool WebDavSyncServer::commit_sync_transaction()
+{
+  if(m_updated_notes.size() > 0 || m_deleted_notes.size() > 0) {
+    std::string rev_dir = get_revision_dir_path(m_new_revision);
+    make_collection(TO_STRING(m_new_revision / 100) + "/");
+    make_collection(rev_dir);
+
+    Manifest updated = manifest();
+    FOREACH(const std::string & note_id, m_deleted_notes) {
+      updated.notes.erase(note_id);
+      updated.hashes.erase(note_id);
+    }
+    FOREACH(const ContentHashMap::value_type & note, m_updated_notes) {
+      updated.notes[note.first] = m_new_revision;
+      if(note.second != "") {
+        updated.hashes[note.first] = note.second;
+      }
+      else {
+        updated.hashes.erase(note.first);
+      }
+    }
+    updated.revision = m_new_revision;
+    updated.server_id = m_server_id;
+
+    std::string rev_manifest = rev_dir + MANIFEST_FILE;
+    put(rev_manifest, manifest_xml(updated));
+
+    // Replace /manifest.xml in one step on the server side
+    Headers headers;
+    headers["Destination"] = url_for(MANIFEST_FILE);
+    headers["Overwrite"] = "T";
+    Response response = request("COPY", rev_manifest, headers);
+    if(!SOUP_STATUS_IS_SUCCESSFUL(response.status)) {
+      throw GnoteSyncException(("Failed to update server manifest: "
+                                + std::string(soup_status_get_phrase(response.status))).c_str());
+    }
+
+    // Older revisions of updated and deleted notes are no longer needed
+    const Manifest & current = manifest();
+    std::vector<Removal> removals;
+    for(unordered_map<std::string, int>::const_iterator iter = current.notes.begin();
+        iter != current.notes.end(); ++iter) {
+      if(m_deleted_notes.find(iter->first) != m_deleted_notes.end()
+         || m_updated_notes.find(iter->first) != m_updated_notes.end()) {
+        Removal removal;
+        removal.note_id = iter->first;
+        removal.revision = iter->second;
+        removals.push_back(removal);
+      }
+    }
+    m_manifest = updated;
+    m_manifest_etag.clear();
+
+    TransferPool<Removal> pool(removals, sigc::mem_fun(*this, &WebDavSyncServer::remove_note_revision));
+    pool.run();
+
+    // New revision directory is ours now, even if a failed sync left it behind
+    FOREACH(int rev, m_stale_revisions) {
+      if(rev == m_new_revision) {
+        continue;
+      }
+      try {
+        remove(get_revision_dir_path(rev));
+      }
+      catch(const std::exception & e) {
+        ERR_OUT(_("Failed to remove revision %d left by a failed synchronization: %s"), rev, e.what());
+      }
+    }
+    m_stale_revisions.clear();
+  }
+
+  m_lock_timeout.cancel();
+  remove(LOCK_FILE);
+  m_transaction_active = false;
+  return true;
+}
+
+
+bool WebDavSyncServer::cancel_sync_transaction()
+{
+  m_lock_timeout.cancel();
+  m_transaction_active = false;
+  remove(LOCK_FILE);
+  return true;
+}
+
+
+int WebDavSyncServer::latest_revision()
+{
+  int latestRev = manifest().revision;
+  if(latestRev >= 0) {
+    return latestRev;
+  }
+
+  // No manifest, look for the latest revision directory with valid manifest
+  std::list<int> stale_revisions;
+  return find_latest_revision(stale_revisions);
+}
+
+
+int WebDavSyncServer::find_latest_revision(std::list<int> & stale_revisions)
+{
+  std::vector<int> parents;
+  FOREACH(const std::string & dir, get_collections("")) {
+    int parent = revision_from_name(dir);
+    if(parent >= 0) {
+      parents.push_back(parent);
+    }
+  }
+  std::sort(parents.rbegin(), parents.rend());
+
+  FOREACH(int parent, parents) {
+    std::vector<int> revisions;
+    FOREACH(const std::string & dir, get_collections(TO_STRING(parent) + "/")) {
+      int rev = revision_from_name(dir);
+      if(rev >= 0) {
+        revisions.push_back(rev);
+      }
+    }
+    std::sort(revisions.rbegin(), revisions.rend());
+
+    FOREACH(int rev, revisions) {
+      std::string revManifest;
+      if(get(get_revision_dir_path(rev) + MANIFEST_FILE, revManifest) && is_valid_xml(revManifest)) {
+        return rev;
+      }
+      stale_revisions.push_back(rev);
+    }
+  }
+
+  return -1;
+}
+
+
+SyncLockInfo WebDavSyncServer::current_sync_lock()
+{
+  SyncLockInfo syncLockInfo;
+
+  std::string lock;
+  if(!get(LOCK_FILE, lock) || !is_valid_xml(lock)) {
+    return syncLockInfo;
+  }
+
+  xmlDocPtr xml_doc = xmlReadMemory(lock.c_str(), lock.size(), LOCK_FILE, "UTF-8", 0);
+  xmlNodePtr root_node = xmlDocGetRootElement(xml_doc);
+
+  xmlNodePtr node = sharp::xml_node_xpath_find_single_node(root_node, "//transaction-id/text ()");
+  if(node != NULL) {
+    syncLockInfo.transaction_id = sharp::xml_node_content(node);
+  }
+
+  node = sharp::xml_node_xpath_find_single_node(root_node, "//client-id/text ()");
+  if(node != NULL) {
+    syncLockInfo.client_id = sharp::xml_node_content(node);
+  }
+
+  node = sharp::xml_node_xpath_find_single_node(root_node, "renew-count/text ()");
+  if(node != NULL) {
+    syncLockInfo.renew_count = str_to_int(sharp::xml_node_content(node));
+  }
+
+  node = sharp::xml_node_xpath_find_single_node(root_node, "lock-expiration-duration/text ()");
+  if(node != NULL) {
+    syncLockInfo.duration = sharp::TimeSpan::parse(sharp::xml_node_content(node));
+  }
+
+  node = sharp::xml_node_xpath_find_single_node(root_node, "revision/text ()");
+  if(node != NULL) {
+    syncLockInfo.revision = str_to_int(sharp::xml_node_content(node));
+  }
+
+  xmlFreeDoc(xml_doc);
+  return syncLockInfo;
+}
+
+
+std::string WebDavSyncServer::id()
+{
+  m_server_id = manifest().server_id;
+
+  // Generate a new ID if there isn't already one
+  if(m_server_id == "") {
+    m_server_id = sharp::uuid().string();
+  }
+
+  return m_server_id;
+}
+
+
+WebDavSyncServer::Response WebDavSyncServer::request(const char *method, const std::string & path,
+                                                     const Headers & headers, const std::string & body)
+{
+  SoupURI *uri = soup_uri_new_with_base(m_base_uri, path.c_str());
+  SoupMessage *msg = soup_message_new_from_uri(method, uri);
+  soup_uri_free(uri);
+
+  for(Headers::const_iterator iter = headers.begin(); iter != headers.end(); ++iter) {
+    soup_message_headers_replace(msg->request_headers, iter->first.c_str(), iter->second.c_str());
+  }
+  if(body != "") {
+    soup_message_set_request(msg, "text/xml", SOUP_MEMORY_COPY, body.data(), body.size());
+  }
+
+  Response response;
+  response.status = soup_session_send_message(m_session, msg);
+  if(msg->response_body->length > 0) {
+    response.body.assign(msg->response_body->data, msg->response_body->length);
+  }
+  const char *etag = soup_message_headers_get_one(msg->response_headers, "ETag");
+  if(etag) {
+    response.etag = etag;
+  }
+  g_object_unref(msg);
+
+  if(SOUP_STATUS_IS_TRANSPORT_ERROR(response.status)) {
+    throw GnoteSyncException((std::string(method) + " " + path + ": "
+                              + soup_status_get_phrase(response.status)).c_str());
+  }
+  return response;
+}
+
+
+bool WebDavSyncServer::get(const std::string & path, std::string & content)
+{
+  Response response = request("GET", path);
+  if(response.status == SOUP_STATUS_NOT_FOUND) {
+    return false;
+  }
+  if(!SOUP_STATUS_IS_SUCCESSFUL(response.status)) {
+    throw GnoteSyncException(("GET " + path + ": " + soup_status_get_phrase(response.status)).c_str());
+  }
+  content.swap(response.body);
+  return true;
+}
+
+
+void WebDavSyncServer::put(const std::string & path, const std::string & content)
+{
+  Response response = request("PUT", path, Headers(), content);
+  if(!SOUP_STATUS_IS_SUCCESSFUL(response.status)) {
+    throw GnoteSyncException(("PUT " + path + ": " + soup_status_get_phrase(response.status)).c_str());
+  }
+}
+
+
+void WebDavSyncServer::remove(const std::string & path)
+{
+  Response response = request("DELETE", path);
+  if(!SOUP_STATUS_IS_SUCCESSFUL(response.status) && response.status != SOUP_STATUS_NOT_FOUND) {
+    throw GnoteSyncException(("DELETE " + path + ": " + soup_status_get_phrase(response.status)).c_str());
+  }
+}
+
+
+void WebDavSyncServer::make_collection(const std::string & path)
+{
+  Response response = request("MKCOL", path);
+  // Method Not Allowed means, that it already exists
+  if(!SOUP_STATUS_IS_SUCCESSFUL(response.status) && response.status != SOUP_STATUS_METHOD_NOT_ALLOWED) {
+    throw GnoteSyncException(("MKCOL " + path + ": " + soup_status_get_phrase(response.status)).c_str());
+  }
+}
+
+
+std::list<std::string> WebDavSyncServer::get_collections(const std::string & path)
+{
+  std::list<std::string> collections;
+
+  Headers headers;
+  headers["Depth"] = "1";
+  Response response = request("PROPFIND", path, headers, PROPFIND_RESOURCE_TYPE);
+  if(response.status == SOUP_STATUS_NOT_FOUND) {
+    return collections;
+  }
+  if(response.status != SOUP_STATUS_MULTI_STATUS) {
+    throw GnoteSyncException(("PROPFIND " + path + ": " + soup_status_get_phrase(response.status)).c_str());
+  }
+
+  SoupURI *uri = soup_uri_new_with_base(m_base_uri, path.c_str());
+  std::string own_path = strip_trailing_slash(soup_uri_get_path(uri));
+  soup_uri_free(uri);
+
+  // Response lists the collection itself and its members
+  sharp::XmlReader reader;
+  reader.load_buffer(response.body);
+  std::string href;
+  bool is_collection = false;
+  while(reader.read()) {
+    std::string name = local_name(reader.get_name());
+    if(reader.get_node_type() == XML_READER_TYPE_ELEMENT) {
+      if(name == "response") {
+        href = "";
+        is_collection = false;
+      }
+      else if(name == "href") {
+        href = reader.read_string();
+      }
+      else if(name == "collection") {
+        is_collection = true;
+      }
+    }
+    else if(reader.get_node_type() == XML_READER_TYPE_END_ELEMENT && name == "response") {
+      if(!is_collection || href == "") {
+        continue;
+      }
+      // href can be absolute URI or path
+      SoupURI *member = soup_uri_new_with_base(m_base_uri, href.c_str());
+      std::string member_path = strip_trailing_slash(soup_uri_get_path(member));
+      soup_uri_free(member);
+      if(member_path == own_path) {
+        continue;
+      }
+      char *decoded = soup_uri_decode(member_path.substr(member_path.rfind('/') + 1).c_str());
+      collections.push_back(decoded);
+      g_free(decoded);
+    }
+  }
+
+  return collections;
+}
+
+
+std::string WebDavSyncServer::url_for(const std::string & path) const
+{
+  SoupURI *uri = soup_uri_new_with_base(m_base_uri, path.c_str());
+  soup_uri_set_user(uri, NULL);
+  soup_uri_set_password(uri, NULL);
+  char *str = soup_uri_to_string(uri, FALSE);
+  std::string url = str;
+  g_free(str);
+  soup_uri_free(uri);
+  return url;
+}
+
+
+const WebDavSyncServer::Manifest & WebDavSyncServer::manifest()
+{
+  if(m_manifest_loaded && m_transaction_active) {
+    return m_manifest;
+  }
+
+  // Only download it again, if it has changed
+  Headers headers;
+  if(m_manifest_loaded && m_manifest_etag != "") {
+    headers["If-None-Match"] = m_manifest_etag;
+  }
+  Response response = request("GET", MANIFEST_FILE, headers);
+  if(response.status == SOUP_STATUS_NOT_MODIFIED) {
+    return m_manifest;
+  }
+
+  m_manifest = Manifest();
+  m_manifest_etag = "";
+  if(SOUP_STATUS_IS_SUCCESSFUL(response.status)) {
+    if(parse_manifest(response.body, m_manifest)) {
+      m_manifest_etag = response.etag;
+    }
+    else {
+      m_manifest = Manifest();
+    }
+  }
+  else if(response.status != SOUP_STATUS_NOT_FOUND) {
+    throw GnoteSyncException(("GET manifest.xml: " + std::string(soup_status_get_phrase(response.status))).c_str());
+  }
+  m_manifest_loaded = true;
+
+  return m_manifest;
+}
+
+
+int WebDavSyncServer::parse_manifest_revision(const std::string & xml)
+{
+  // Works on the beginning of the file too, revision is on the root element
+  sharp::XmlReader reader;
+  reader.load_buffer(xml);
+  return Manifest::read_revision(reader);
+}
+
+
+bool WebDavSyncServer::parse_manifest(const std::string & xml, Manifest & manifest)
+{
+  sharp::XmlReader reader;
+  reader.load_buffer(xml);
+  return Manifest::read(reader, manifest);
+}
+
+
+bool WebDavSyncServer::is_valid_xml(const std::string & xml)
+{
+  xmlDocPtr xml_doc = xmlReadMemory(xml.c_str(), xml.size(), NULL, "UTF-8", 0);
+  if(!xml_doc) {
+    return false;
+  }
+  xmlFreeDoc(xml_doc);
+  return true;
+}
+
+
+std::string WebDavSyncServer::get_revision_dir_path(int rev)
+{
+  return TO_STRING(rev / 100) + "/" + TO_STRING(rev) + "/";
+}
+
+
+std::string WebDavSyncServer::manifest_xml(const Manifest & manifest) const
+{
+  sharp::XmlWriter xml;
+  xml.write_start_document();
+  xml.write_start_element("", "sync", "");
+  xml.write_attribute_string("", "revision", "", TO_STRING(manifest.revision));
+  xml.write_attribute_string("", "server-id", "", manifest.server_id);
+
+  for(unordered_map<std::string, int>::const_iterator iter = manifest.notes.begin();
+      iter != manifest.notes.end(); ++iter) {
+    xml.write_start_element("", "note", "");
+    xml.write_attribute_string("", "id", "", iter->first);
+    xml.write_attribute_string("", "rev", "", TO_STRING(iter->second));
+    ContentHashMap::const_iterator hash = manifest.hashes.find(iter->first);
+    if(hash != manifest.hashes.end()) {
+      xml.write_attribute_string("", "content-hash", "", hash->second);
+    }
+    xml.write_end_element();
+  }
+
+  xml.write_end_element();
+  xml.write_end_document();
+  xml.close();
+  return xml.to_string();
+}
+
+
+void WebDavSyncServer::update_lock_file(const SyncLockInfo & syncLockInfo)
+{
+  sharp::XmlWriter xml;
+  xml.write_start_document();
+  xml.write_start_element("", "lock", "");
+
+  xml.write_start_element("", "transaction-id", "");
+  xml.write_string(syncLockInfo.transaction_id);
+  xml.write_end_element();
+
+  xml.write_start_element("", "client-id", "");
+  xml.write_string(syncLockInfo.client_id);
+  xml.write_end_element();
+
+  xml.write_start_element("", "renew-count", "");
+  xml.write_string(TO_STRING(syncLockInfo.renew_count));
+  xml.write_end_element();
+
+  xml.write_start_element("", "lock-expiration-duration", "");
+  xml.write_string(syncLockInfo.duration.string());
+  xml.write_end_element();
+
+  xml.write_start_element("", "revision", "");
+  xml.write_string(TO_STRING(syncLockInfo.revision));
+  xml.write_end_element();
+
+  xml.write_end_element();
+  xml.write_end_document();
+  xml.close();
+
+  put(LOCK_FILE, xml.to_string());
+}
+
+
+void WebDavSyncServer::cleanup_old_sync()
+{
+  DBG_OUT("Sync: Cleaning up a previous failed sync transaction");
+  std::string current;
+  if(!get(MANIFEST_FILE, current) || !is_valid_xml(current)) {
+    // Restore manifest from the latest revision that has a valid one
+    for(int rev = latest_revision(); rev >= 0; --rev) {
+      std::string rev_manifest;
+      if(get(get_revision_dir_path(rev) + MANIFEST_FILE, rev_manifest) && is_valid_xml(rev_manifest)) {
+        put(MANIFEST_FILE, rev_manifest);
+        m_manifest_loaded = false;
+        break;
+      }
+    }
+  }
+
+  // Delete the old lock file
+  DBG_OUT("Sync: Deleting expired lockfile");
+  try {
+    remove(LOCK_FILE);
+  }
+  catch(std::exception & e) {
+    ERR_OUT(_("Error deleting the old synchronization lock \"%s\": %s"), LOCK_FILE, e.what());
+  }
+}
+
+
+void WebDavSyncServer::lock_timeout()
+{
+  m_sync_lock.renew_count++;
+  update_lock_file(m_sync_lock);
+  // Reset the timer to 20 seconds sooner than the sync lock duration
+  m_lock_timeout.reset(m_sync_lock.duration.total_milliseconds() - 20000);
+}
+
+
+}
+}
@@ -0,0 +1,151 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _SYNCHRONIZATION_WEBDAVSYNCSERVER_HPP_
+#define _SYNCHRONIZATION_WEBDAVSYNCSERVER_HPP_
+
+#include <list>
+#include <map>
+#include <string>
+
+#include "base/macros.hpp"
+#include "isyncmanager.hpp"
+#include "servermanifest.hpp"
+#include "utils.hpp"
+#include "sharp/datetime.hpp"
+
+
+typedef struct _SoupSession SoupSession;
+typedef struct _SoupURI SoupURI;
+
+
+namespace gnote {
+namespace sync {
+
+
+// Talks to a WebDAV server directly, without mounting it.
+// Uses the same layout as FileSystemSyncServer (manifest.xml, lock and
+// revision directories), so both can be used with the same server.
+// Connections are kept alive between requests and several notes are
+// transferred at the same time.
+class WebDavSyncServer
+  : public SyncServer
+{
+public:
+  // Transfers in flight at the same time
+  enum { MAX_CONNECTIONS = 4 };
+  // Bytes of manifest downloaded to check for updates
+  enum { MANIFEST_PROBE_SIZE = 512 };
+
+  static SyncServer::Ptr create(const std::string & url, const std::string & username,
+                                const std::string & password, bool accept_ssl_cert);
+  virtual ~WebDavSyncServer();
+
+  virtual bool begin_sync_transaction() override;
+  virtual bool commit_sync_transaction() override;
+  virtual bool cancel_sync_transaction() override;
+  virtual std::list<std::string> get_all_note_uuids() override;
+  virtual std::map<std::string, NoteUpdate> get_note_updates_since(int revision, const ContentHashMap & local_hashes) override;
+  virtual void delete_notes(const std::list<std::string> & deletedNoteUUIDs) override;
+  virtual void upload_notes(const std::list<Note::Ptr> & notes) override;
+  virtual int latest_revision() override; // NOTE: Only reliable during a transaction
+  virtual SyncLockInfo current_sync_lock() override;
+  virtual std::string id() override;
+  virtual bool updates_available_since(int revision) override;
+
+  // Upload note files as they are on disk, used by upload_notes().
+  // Hashes are by note ID and can be missing.
+  void upload_note_files(const std::list<std::string> & files,
+                         const ContentHashMap & hashes = ContentHashMap());
+private:
+  typedef ServerManifest Manifest;
+
+  struct Response
+  {
+    unsigned status;
+    std::string body;
+    std::string etag;
+  };
+  typedef std::map<std::string, std::string> Headers;
+
+  struct Upload;
+  struct Download;
+  struct Removal;
+
+  WebDavSyncServer(const std::string & url, const std::string & username,
+                   const std::string & password, bool accept_ssl_cert);
+
+  // Blocking request, path is relative to server URL. Safe to call from several threads.
+  Response request(const char *method, const std::string & path,
+                   const Headers & headers = Headers(), const std::string & body = "");
+  // Content of file, false if there is no such file
+  bool get(const std::string & path, std::string & content);
+  void put(const std::string & path, const std::string & content);
+  void remove(const std::string & path);
+  void make_collection(const std::string & path);
+  std::list<std::string> get_collections(const std::string & path);
+  std::string url_for(const std::string & path) const;
+  void upload_file(Upload & upload);
+  void download_note(Download & download);
+  // Removes a replaced note revision, with the delta chain it is built on
+  void remove_note_revision(Removal & removal);
+  // Note stored as deltas by FileSystemSyncServer, false if there are none
+  bool get_note_deltas(const std::string & note_id, int revision, std::string & content);
+
+  const Manifest & manifest();
+  static bool parse_manifest(const std::string & xml, Manifest & manifest);
+  // Revision from the manifest header only, -1 if not there
+  static int parse_manifest_revision(const std::string & xml);
+  static bool is_valid_xml(const std::string & xml);
+  static std::string get_revision_dir_path(int rev);
+  // Latest revision directory with a valid manifest, -1 if none.
+  // Newer directories without one are added to stale_revisions.
+  int find_latest_revision(std::list<int> & stale_revisions);
+  std::string manifest_xml(const Manifest & manifest) const;
+  void cleanup_old_sync();
+  void update_lock_file(const SyncLockInfo & syncLockInfo);
+  void lock_timeout();
+
+  SoupSession *m_session;
+  SoupURI *m_base_uri;
+
+  // Note ID -> content hash
+  ContentHashMap m_updated_notes;
+  unordered_set<std::string> m_deleted_notes;
+  Manifest m_manifest;
+  bool m_manifest_loaded;
+  std::string m_manifest_etag;
+  bool m_transaction_active;
+
+  std::string m_server_id;
+  int m_new_revision;
+  // Revision directories left behind by failed syncs, removed on commit
+  std::list<int> m_stale_revisions;
+
+  sharp::DateTime m_initial_sync_attempt;
+  std::string m_last_sync_lock_hash;
+  utils::InterruptableTimeout m_lock_timeout;
+  SyncLockInfo m_sync_lock;
+};
+
+}
+}
+
+#endif
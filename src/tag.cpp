@@ -21,11 +21,10 @@
 
 
 
-#include <map>
+#include <vector>
 
 #include <glibmm.h>
 
-#include "sharp/map.hpp"
 #include "sharp/string.hpp"
 #include "note.hpp"
 #include "tag.hpp"
@@ -43,18 +42,19 @@ namespace gnote {
 
   void Tag::add_note(NoteBase & note)
   {
-    if(m_notes.find(note.uri()) == m_notes.end()) {
-      m_notes[note.uri()] = &note;
-    }
+    m_notes.set(note.ordinal());
   }
 
 
   void Tag::remove_note(const NoteBase & note)
   {
-    NoteMap::iterator iter = m_notes.find(note.uri());
-    if(iter != m_notes.end()) {
-      m_notes.erase(iter);
-    }
+    m_notes.reset(note.ordinal());
+  }
+
+
+  bool Tag::has_note(const NoteBase & note) const
+  {
+    return m_notes.test(note.ordinal());
   }
 
 
@@ -78,13 +78,20 @@ namespace gnote {
 
   void Tag::get_notes(std::list<NoteBase*> & l) const
   {
-    sharp::map_get_values(m_notes, l);
+    std::vector<NoteBitmap::size_type> ordinals;
+    m_notes.get_bits(ordinals);
+    FOREACH(NoteBitmap::size_type ordinal, ordinals) {
+      NoteBase *note = NoteBase::from_ordinal(ordinal);
+      if(note) {
+        l.push_back(note);
+      }
+    }
   }
 
 
   int Tag::popularity() const
   {
-    return m_notes.size();
+    return m_notes.count();
   }
 
 }
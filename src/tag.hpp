@@ -25,10 +25,10 @@
 #define __TAG_HPP_
 
 #include <list>
-#include <map>
 #include <string>
 
 #include "base/macros.hpp"
+#include "notebitmap.hpp"
 
 namespace gnote {
 
@@ -93,6 +93,14 @@ namespace gnote {
     // </summary>
     void get_notes(std::list<NoteBase*> &) const;
     // <summary>
+    // Ordinals of the notes this tag is associated with.
+    // </summary>
+    const NoteBitmap & notes() const
+      {
+        return m_notes;
+      }
+    bool has_note(const NoteBase & ) const;
+    // <summary>
     // Returns the number of notes this is currently tagging.
     // </summary>
     int popularity() const;
@@ -104,11 +112,10 @@ namespace gnote {
     bool        m_issystem;
     bool        m_isproperty;
     // <summary>
-    // Used to track which notes are currently tagged by this tag.  The
-    // dictionary key is the Note.Uri.
+    // Used to track which notes are currently tagged by this tag.
+    // Bits are note ordinals.
     // </summary>
-    typedef std::map<std::string, NoteBase*> NoteMap;
-    NoteMap m_notes;
+    NoteBitmap m_notes;
   };
 
 
@@ -22,12 +22,13 @@
 
 #include <string.h>
 
+#include <algorithm>
+
 #include <glibmm.h>
 
 #include "tagmanager.hpp"
 #include "debug.hpp"
 #include "note.hpp"
-#include "sharp/map.hpp"
 #include "sharp/string.hpp"
 #include "sharp/exception.hpp"
 
@@ -48,15 +49,75 @@ namespace gnote {
       return strcmp(tag_a->normalized_name().c_str(), 
                     tag_b->normalized_name().c_str());
     }
+
+    bool is_listed(const Tag::Ptr & tag)
+    {
+      return !tag->is_system() && !tag->is_property();
+    }
   }
 
   TagManager::TagManager()
-    :  m_tags(Gtk::ListStore::create(m_columns))
+    :  m_main_thread(Glib::Threads::Thread::self())
+    ,  m_tags(Gtk::ListStore::create(m_columns))
     ,  m_sorted_tags(Gtk::TreeModelSort::create(m_tags))
   {
     m_sorted_tags->set_sort_func (0, sigc::ptr_fun(&compare_tags_sort_func));
     m_sorted_tags->set_sort_column(0, Gtk::SORT_ASCENDING);
-    
+    m_new_tags_dispatcher.connect(sigc::mem_fun(*this, &TagManager::sync_tag_list));
+  }
+
+
+  std::string TagManager::normalize(const std::string & tag_name)
+  {
+    std::string normalized_tag_name = Glib::ustring(sharp::string_trim(tag_name)).lowercase();
+    if (normalized_tag_name.empty())
+      throw sharp::Exception ("TagManager: tag name is empty.");
+    return normalized_tag_name;
+  }
+
+
+  TagManager::Shard & TagManager::shard_for(const std::string & name) const
+  {
+    return m_shards[g_str_hash(name.c_str()) % SHARD_COUNT];
+  }
+
+
+  Tag::Ptr TagManager::find(const std::string & name) const
+  {
+    Shard & shard = shard_for(name);
+    Glib::Threads::Mutex::Lock lock(shard.lock);
+    NameMap::const_iterator iter = shard.tags.find(name);
+    if(iter != shard.tags.end()) {
+      return iter->second;
+    }
+    return Tag::Ptr();
+  }
+
+
+  void TagManager::remember(const std::string & name, const Tag::Ptr & tag) const
+  {
+    // Both shards are locked, lower one first, so that remove_tag either
+    // sees the new spelling or the tag is already gone here
+    Shard & tag_shard = shard_for(tag->normalized_name());
+    Shard & name_shard = shard_for(name);
+    Shard & first = &tag_shard < &name_shard ? tag_shard : name_shard;
+    Shard & second = &tag_shard < &name_shard ? name_shard : tag_shard;
+    Glib::Threads::Mutex::Lock first_lock(first.lock);
+    Glib::Threads::Mutex::Lock second_lock(second.lock, Glib::Threads::NOT_LOCK);
+    if(&second != &first) {
+      second_lock.acquire();
+    }
+
+    NameMap::const_iterator iter = tag_shard.tags.find(tag->normalized_name());
+    if(iter == tag_shard.tags.end() || iter->second != tag) {
+      return;
+    }
+    std::vector<std::string> & aliases = tag_shard.aliases[tag->normalized_name()];
+    if(aliases.size() >= MAX_ALIASES || std::find(aliases.begin(), aliases.end(), name) != aliases.end()) {
+      return;
+    }
+    aliases.push_back(name);
+    name_shard.tags[name] = tag;
   }
 
 
@@ -69,27 +130,19 @@ namespace gnote {
     if (tag_name.empty())
       throw sharp::Exception("TagManager.GetTag () called with a null tag name.");
 
-    std::string normalized_tag_name = Glib::ustring(sharp::string_trim(tag_name)).lowercase();
-    if (normalized_tag_name.empty())
-      throw sharp::Exception ("TagManager.GetTag () called with an empty tag name.");
-
-    std::vector<std::string> splits;
-    sharp::string_split(splits, normalized_tag_name, ":");
-    if ((splits.size() > 2) || Glib::str_has_prefix(normalized_tag_name, Tag::SYSTEM_TAG_PREFIX)) {
-      Glib::Mutex::Lock lock(m_locker);
-      std::map<std::string, Tag::Ptr>::const_iterator iter = m_internal_tags.find(normalized_tag_name);
-      if(iter != m_internal_tags.end()) {
-        return iter->second;
-      }
-      return Tag::Ptr();
-    }
-    std::map<std::string, Gtk::TreeIter>::const_iterator iter = m_tag_map.find(normalized_tag_name);
-    if (iter != m_tag_map.end()) {
-      Gtk::TreeIter tree_iter = iter->second;
-      return (*tree_iter)[m_columns.m_tag];
+    Tag::Ptr tag = find(tag_name);
+    if(tag) {
+      return tag;
     }
 
-    return Tag::Ptr();
+    std::string normalized_tag_name = normalize(tag_name);
+    if(normalized_tag_name != tag_name) {
+      tag = find(normalized_tag_name);
+      if(tag) {
+        remember(tag_name, tag);
+      }
+    }
+    return tag;
   }
   
   // <summary>
@@ -100,48 +153,72 @@ namespace gnote {
     if (tag_name.empty())
       throw sharp::Exception ("TagManager.GetOrCreateTag () called with a null tag name.");
 
-    std::string normalized_tag_name = Glib::ustring(sharp::string_trim(tag_name)).lowercase();
-    if (normalized_tag_name.empty())
-      throw sharp::Exception ("TagManager.GetOrCreateTag () called with an empty tag name.");
-
-    std::vector<std::string> splits;
-    sharp::string_split(splits, normalized_tag_name, ":");
-    if ((splits.size() > 2) || Glib::str_has_prefix(normalized_tag_name, Tag::SYSTEM_TAG_PREFIX)){
-      Glib::Mutex::Lock lock(m_locker);
-      std::map<std::string, Tag::Ptr>::iterator iter;
-      iter = m_internal_tags.find(normalized_tag_name);
-      if(iter != m_internal_tags.end()) {
-        return iter->second;
+    Tag::Ptr tag = find(tag_name);
+    if(tag) {
+      return tag;
+    }
+
+    std::string normalized_tag_name = normalize(tag_name);
+    bool tag_added = false;
+    {
+      Shard & shard = shard_for(normalized_tag_name);
+      Glib::Threads::Mutex::Lock lock(shard.lock);
+      Tag::Ptr & entry = shard.tags[normalized_tag_name];
+      if(!entry) {
+        entry.reset(new Tag(sharp::string_trim(tag_name)));
+        tag_added = true;
+      }
+      tag = entry;
+    }
+    if(normalized_tag_name != tag_name) {
+      remember(tag_name, tag);
+    }
+
+    if(tag_added && is_listed(tag)) {
+      bool first;
+      {
+        Glib::Threads::Mutex::Lock lock(m_new_tags_lock);
+        first = m_new_tags.empty();
+        m_new_tags.push_back(tag);
+      }
+      if(Glib::Threads::Thread::self() == m_main_thread) {
+        sync_tag_list();
       }
-      else {
-        Tag::Ptr t(new Tag(tag_name));
-        m_internal_tags [ t->normalized_name() ] = t;
-        return t;
+      else if(first) {
+        m_new_tags_dispatcher.emit();
       }
     }
-    Gtk::TreeIter iter;
-    bool tag_added = false;
-    Tag::Ptr tag = get_tag (normalized_tag_name);
-    if (!tag) {
 
-      Glib::Mutex::Lock lock(m_locker);
+    return tag;
+  }
 
-      tag = get_tag (normalized_tag_name);
-      if (!tag) {
-        tag.reset(new Tag (sharp::string_trim(tag_name)));
-        iter = m_tags->append ();
-        (*iter)[m_columns.m_tag] = tag;
-        m_tag_map [tag->normalized_name()] = iter;
 
-        tag_added = true;
-      }
+  void TagManager::sync_tag_list()
+  {
+    std::vector<Tag::Ptr> new_tags;
+    {
+      Glib::Threads::Mutex::Lock lock(m_new_tags_lock);
+      new_tags.swap(m_new_tags);
     }
 
-    if (tag_added) {
+    FOREACH(const Tag::Ptr & tag, new_tags) {
+      // Could have been removed in the meantime
+      if(find(tag->normalized_name()) != tag
+         || m_tag_map.find(tag->normalized_name()) != m_tag_map.end()) {
+        continue;
+      }
+      Gtk::TreeIter iter = m_tags->append();
+      (*iter)[m_columns.m_tag] = tag;
+      m_tag_map[tag->normalized_name()] = iter;
       m_signal_tag_added(tag, iter);
     }
+  }
 
-    return tag;
+
+  Glib::RefPtr<Gtk::TreeModel> TagManager::get_tags()
+  {
+    sync_tag_list();
+    return m_sorted_tags;
   }
     
   /// <summary>
@@ -184,60 +261,85 @@ namespace gnote {
     if (!tag)
       throw sharp::Exception ("TagManager.RemoveTag () called with a null tag");
 
-    if(tag->is_property() || tag->is_system()){
-
-      Glib::Mutex::Lock lock(m_locker);
+    // Forget the name and every spelling of it
+    std::vector<std::string> aliases;
+    {
+      Shard & shard = shard_for(tag->normalized_name());
+      Glib::Threads::Mutex::Lock lock(shard.lock);
+      NameMap::iterator iter = shard.tags.find(tag->normalized_name());
+      if(iter != shard.tags.end() && iter->second == tag) {
+        shard.tags.erase(iter);
+      }
+      AliasMap::iterator alias_iter = shard.aliases.find(tag->normalized_name());
+      if(alias_iter != shard.aliases.end()) {
+        aliases.swap(alias_iter->second);
+        shard.aliases.erase(alias_iter);
+      }
+    }
+    FOREACH(const std::string & alias, aliases) {
+      Shard & shard = shard_for(alias);
+      Glib::Threads::Mutex::Lock lock(shard.lock);
+      NameMap::iterator iter = shard.tags.find(alias);
+      if(iter != shard.tags.end() && iter->second == tag) {
+        shard.tags.erase(iter);
+      }
+    }
 
-      m_internal_tags.erase(tag->normalized_name());
+    if(!is_listed(tag)) {
+      return;
     }
-    bool tag_removed = false;
-    std::map<std::string, Gtk::TreeIter>::iterator map_iter;
-    map_iter = m_tag_map.find(tag->normalized_name());
-    if (map_iter != m_tag_map.end()) {
 
-      Glib::Mutex::Lock lock(m_locker);
+    sync_tag_list();
+    TagMap::iterator map_iter = m_tag_map.find(tag->normalized_name());
+    if (map_iter == m_tag_map.end()) {
+      return;
+    }
 
-      map_iter = m_tag_map.find(tag->normalized_name());
-      if (map_iter != m_tag_map.end()) {
-        Gtk::TreeIter iter = map_iter->second;
-        if (!m_tags->erase(iter)) {
-          DBG_OUT("TagManager: Removed tag: %s", tag->normalized_name().c_str());
-        } 
-        else { 
-          // FIXME: For some really weird reason, this block actually gets called sometimes!
-          DBG_OUT("TagManager: Call to remove tag from ListStore failed: %s", tag->normalized_name().c_str());
-        }
+    Gtk::TreeIter iter = map_iter->second;
+    if (!m_tags->erase(iter)) {
+      DBG_OUT("TagManager: Removed tag: %s", tag->normalized_name().c_str());
+    } 
+    else { 
+      // FIXME: For some really weird reason, this block actually gets called sometimes!
+      DBG_OUT("TagManager: Call to remove tag from ListStore failed: %s", tag->normalized_name().c_str());
+    }
 
-        m_tag_map.erase(map_iter);
-        DBG_OUT("Removed TreeIter from tag_map: %s", tag->normalized_name().c_str());
-        tag_removed = true;
+    m_tag_map.erase(map_iter);
+    DBG_OUT("Removed TreeIter from tag_map: %s", tag->normalized_name().c_str());
 
-        std::list<NoteBase*> notes;
-        tag->get_notes(notes);
-        FOREACH(NoteBase *note_iter, notes) {
-          note_iter->remove_tag(tag);
-        }
-      }
+    std::list<NoteBase*> notes;
+    tag->get_notes(notes);
+    FOREACH(NoteBase *note_iter, notes) {
+      note_iter->remove_tag(tag);
     }
 
-    if (tag_removed) {
-      m_signal_tag_removed(tag->normalized_name());
-    }
+    m_signal_tag_removed(tag->normalized_name());
   }
   
   void TagManager::all_tags(std::list<Tag::Ptr> & tags) const
   {
-    // Add in the system tags first
-    sharp::map_get_values(m_internal_tags, tags);
-    
-    // Now all the other tags
-    for(TagMap::const_iterator iter = m_tag_map.begin();
-        iter != m_tag_map.end(); ++iter) {
-      Tag::Ptr tag;
-      iter->second->get_value(0, tag);      
-      tags.push_back(tag);
+    // System tags first, then all the other ones, each sorted by name
+    std::map<std::string, Tag::Ptr> system_tags;
+    std::map<std::string, Tag::Ptr> listed_tags;
+    for(int i = 0; i < SHARD_COUNT; ++i) {
+      Glib::Threads::Mutex::Lock lock(m_shards[i].lock);
+      const NameMap & shard_tags = m_shards[i].tags;
+      for(NameMap::const_iterator iter = shard_tags.begin(); iter != shard_tags.end(); ++iter) {
+        // Each tag once, by its normalized name
+        if(iter->first == iter->second->normalized_name()) {
+          (is_listed(iter->second) ? listed_tags : system_tags)[iter->first] = iter->second;
+        }
+      }
+    }
+
+    for(std::map<std::string, Tag::Ptr>::const_iterator iter = system_tags.begin();
+        iter != system_tags.end(); ++iter) {
+      tags.push_back(iter->second);
+    }
+    for(std::map<std::string, Tag::Ptr>::const_iterator iter = listed_tags.begin();
+        iter != listed_tags.end(); ++iter) {
+      tags.push_back(iter->second);
     }
   }
 
 }
-
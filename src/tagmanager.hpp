@@ -1,7 +1,7 @@
 /*
  * gnote
  *
- * Copyright (C) 2013 Aurimas Cernius
+ * Copyright (C) 2013-2014 Aurimas Cernius
  * Copyright (C) 2009 Hubert Figuiere
  *
  * This program is free software: you can redistribute it and/or modify
@@ -25,9 +25,13 @@
 #define __TAG_MANAGER_HPP_
 
 
+#include <map>
+#include <vector>
+
 #include <sigc++/signal.h>
 
-#include <glibmm/thread.h>
+#include <glibmm/dispatcher.h>
+#include <glibmm/threads.h>
 #include <gtkmm/liststore.h>
 #include <gtkmm/treemodelsort.h>
 
@@ -38,6 +42,12 @@
 
 namespace gnote {
 
+// Tags are interned in a hash table split into shards with a lock each,
+// so notes can be read and tagged on any thread.
+// A few other spellings of each name are remembered as well, so looking
+// them up again is a single hash probe without normalizing the name.
+// The list model of user visible tags is only touched on the main thread,
+// tags created on other threads are added to it from there.
 class TagManager
   : public ITagManager
 {
@@ -48,13 +58,27 @@ public:
   virtual Tag::Ptr get_or_create_tag(const std::string &) override;
   virtual Tag::Ptr get_system_tag(const std::string & tag_name) const override;
   virtual Tag::Ptr get_or_create_system_tag(const std::string & name) override;
+  // Main thread only
   virtual void remove_tag(const Tag::Ptr & tag) override;
-  Glib::RefPtr<Gtk::TreeModel> get_tags() const
-    {
-      return m_sorted_tags;
-    }
+  // Main thread only
+  Glib::RefPtr<Gtk::TreeModel> get_tags();
   virtual void all_tags(std::list<Tag::Ptr> &) const override;
 private:
+  enum { SHARD_COUNT = 16 };
+  // Spellings remembered per tag, others are normalized on every lookup
+  enum { MAX_ALIASES = 4 };
+
+  // Tag name, as given or normalized -> tag
+  typedef unordered_map<std::string, Tag::Ptr> NameMap;
+  // Normalized name -> other spellings of it in NameMap, in any shard
+  typedef unordered_map<std::string, std::vector<std::string> > AliasMap;
+  struct Shard
+  {
+    Glib::Threads::Mutex lock;
+    NameMap tags;
+    AliasMap aliases;
+  };
+
   class ColumnRecord
     : public Gtk::TreeModelColumnRecord
   {
@@ -65,16 +89,28 @@ private:
       }
     Gtk::TreeModelColumn<Tag::Ptr> m_tag;
   };
+
+  static std::string normalize(const std::string & tag_name);
+  Shard & shard_for(const std::string & name) const;
+  Tag::Ptr find(const std::string & name) const;
+  void remember(const std::string & name, const Tag::Ptr & tag) const;
+  // Adds tags created since last call to the list model
+  void sync_tag_list();
+
+  mutable Shard                    m_shards[SHARD_COUNT];
+  Glib::Threads::Thread           *m_main_thread;
+
   ColumnRecord                     m_columns;
   Glib::RefPtr<Gtk::ListStore>     m_tags;
   Glib::RefPtr<Gtk::TreeModelSort> m_sorted_tags;
   // The key for this dictionary is Tag.Name.ToLower ().
   typedef std::map<std::string, Gtk::TreeIter> TagMap;
   TagMap                           m_tag_map;
-  typedef std::map<std::string, Tag::Ptr> InternalMap;
-  InternalMap                      m_internal_tags;
-  mutable Glib::Mutex              m_locker;
-  
+  // Created tags, that are not in the list model yet
+  std::vector<Tag::Ptr>            m_new_tags;
+  Glib::Threads::Mutex             m_new_tags_lock;
+  Glib::Dispatcher                 m_new_tags_dispatcher;
+
   sigc::signal<void, Tag::Ptr, const Gtk::TreeIter &> m_signal_tag_added;
   sigc::signal<void, const std::string &> m_signal_tag_removed;
 };
@@ -0,0 +1,137 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdio>
+
+#include <glibmm/miscutils.h>
+
+#include "benchcorpus.hpp"
+#include "base/macros.hpp"
+#include "itagmanager.hpp"
+#include "notebase.hpp"
+#include "sharp/datetime.hpp"
+
+
+namespace test {
+
+namespace {
+
+const char *SYLLABLES[] = {
+  "ka", "lo", "mi", "ne", "ru", "sa", "to", "vi", "po", "de",
+  "gra", "shi", "tor", "ban", "el", "qu", "fen", "dor", "ix", "um",
+};
+const int SYLLABLE_COUNT = sizeof(SYLLABLES) / sizeof(SYLLABLES[0]);
+const int VOCABULARY_SIZE = 5000;
+
+}
+
+
+BenchCorpus::Options::Options()
+  : note_count(1000)
+  , note_words(300)
+  , link_density(2)
+  , tag_count(20)
+  , seed(42)
+{
+}
+
+
+BenchCorpus::BenchCorpus(const Options & options)
+  : m_options(options)
+  , m_rand(g_rand_new_with_seed(options.seed))
+{
+  for(int i = 0; i < VOCABULARY_SIZE; ++i) {
+    std::string word;
+    int syllables = g_rand_int_range(m_rand, 1, 5);
+    for(int j = 0; j < syllables; ++j) {
+      word += SYLLABLES[g_rand_int_range(m_rand, 0, SYLLABLE_COUNT)];
+    }
+    m_words.push_back(word);
+  }
+
+  for(int i = 0; i < m_options.note_count; ++i) {
+    m_titles.push_back(random_word() + " " + random_word() + " " + TO_STRING(i));
+  }
+}
+
+
+BenchCorpus::~BenchCorpus()
+{
+  g_rand_free(m_rand);
+}
+
+
+std::string BenchCorpus::random_word()
+{
+  return m_words[g_rand_int_range(m_rand, 0, m_words.size())];
+}
+
+
+void BenchCorpus::write(const std::string & directory)
+{
+  sharp::DateTime date = sharp::DateTime::now();
+  for(int i = 0; i < m_options.note_count; ++i) {
+    char id[40];
+    std::sprintf(id, "00000000-0000-0000-0000-%012d", i);
+    std::string file = Glib::build_filename(directory, std::string(id) + ".note");
+
+    gnote::NoteData data(gnote::NoteBase::url_from_path(file));
+    data.title() = m_titles[i];
+    data.text() = note_content(i);
+    sharp::DateTime note_date = date;
+    note_date.add_hours(-i);
+    data.create_date() = note_date;
+    data.set_change_date(note_date);
+    if(m_options.tag_count > 0) {
+      int tags = g_rand_int_range(m_rand, 0, MAX_NOTE_TAGS + 1);
+      for(int j = 0; j < tags; ++j) {
+        gnote::Tag::Ptr tag = gnote::ITagManager::obj().get_or_create_tag(
+          "tag " + TO_STRING(g_rand_int_range(m_rand, 0, m_options.tag_count)));
+        data.tags()[tag->normalized_name()] = tag;
+      }
+    }
+    gnote::NoteArchiver::write(file, data);
+  }
+}
+
+
+std::string BenchCorpus::note_content(int index)
+{
+  std::string content = "<note-content version=\"0.1\">" + m_titles[index] + "\n\n";
+  for(int i = 0; i < m_options.note_words; ++i) {
+    if(i > 0) {
+      content += i % 12 ? " " : ".\n";
+    }
+    if(m_options.note_count > 1 && g_rand_int_range(m_rand, 0, 100) < m_options.link_density) {
+      int target = g_rand_int_range(m_rand, 0, m_options.note_count);
+      content += "<link:internal>" + m_titles[target] + "</link:internal>";
+    }
+    else if(i % 50 == 7) {
+      content += "<bold>" + random_word() + "</bold>";
+    }
+    else {
+      content += random_word();
+    }
+  }
+  content += "</note-content>";
+  return content;
+}
+
+}
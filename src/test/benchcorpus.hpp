@@ -0,0 +1,80 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _TEST_BENCHCORPUS_HPP_
+#define _TEST_BENCHCORPUS_HPP_
+
+#include <string>
+#include <vector>
+
+#include <glib.h>
+#include <glibmm/ustring.h>
+
+
+namespace test {
+
+// Synthetic notes for benchmarks.
+// Same options always give the same notes, so that results of different
+// runs can be compared.
+class BenchCorpus
+{
+public:
+  struct Options
+  {
+    Options();
+
+    int note_count;
+    // Words of text in each note
+    int note_words;
+    // Links to other notes per 100 words of text
+    int link_density;
+    // Distinct tags, each note has up to MAX_NOTE_TAGS of them
+    int tag_count;
+    guint32 seed;
+  };
+
+  enum { MAX_NOTE_TAGS = 3 };
+
+  explicit BenchCorpus(const Options & options);
+  ~BenchCorpus();
+
+  // Write notes as .note files into directory, that must exist
+  void write(const std::string & directory);
+  const std::vector<Glib::ustring> & titles() const
+    {
+      return m_titles;
+    }
+  // Word, that appears in note text, for search queries
+  std::string random_word();
+private:
+  BenchCorpus(const BenchCorpus &);
+  BenchCorpus & operator=(const BenchCorpus &);
+
+  std::string note_content(int index);
+
+  Options m_options;
+  GRand *m_rand;
+  std::vector<std::string> m_words;
+  std::vector<Glib::ustring> m_titles;
+};
+
+}
+
+#endif
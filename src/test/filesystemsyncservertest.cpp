@@ -0,0 +1,187 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <boost/test/minimal.hpp>
+#include <glib/gstdio.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+
+#include "base/macros.hpp"
+#include "testfiles.hpp"
+#include "sharp/files.hpp"
+#include "synchronization/filesystemsyncserver.hpp"
+
+using gnote::sync::ContentHashMap;
+using gnote::sync::FileSystemSyncServer;
+using gnote::sync::NoteUpdate;
+using gnote::sync::SyncServer;
+
+
+namespace {
+
+std::string note_xml(const std::string & title, const std::string & text)
+{
+  return "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+         "<note version=\"0.3\" xmlns=\"http://beatniksoftware.com/tomboy\">\n"
+         "<title>" + title + "</title><text xml:space=\"preserve\"><note-content version=\"0.1\">"
+         + title + "\n\n" + text + "</note-content></text></note>\n";
+}
+
+std::string write_note(const std::string & dir, const std::string & id, const std::string & content)
+{
+  std::string file = Glib::build_filename(dir, id + ".note");
+  Glib::file_set_contents(file, content);
+  return file;
+}
+
+bool has_file(const std::string & server, int rev, const std::string & name)
+{
+  return sharp::file_exists(Glib::build_filename(server, TO_STRING(rev / 100), TO_STRING(rev), name));
+}
+
+void upload(const SyncServer::Ptr & server, const std::list<std::string> & files,
+            const std::list<std::string> & deleted = std::list<std::string>())
+{
+  BOOST_CHECK(server->begin_sync_transaction());
+  static_pointer_cast<FileSystemSyncServer>(server)->upload_note_files(files);
+  server->delete_notes(deleted);
+  BOOST_CHECK(server->commit_sync_transaction());
+}
+
+}
+
+
+int test_main(int /*argc*/, char ** /*argv*/)
+{
+  char tmp_dir_tmpl[] = "/tmp/gnotetestfssyncXXXXXX";
+  std::string tmp_dir = g_mkdtemp(tmp_dir_tmpl);
+  std::string notes_dir = Glib::build_filename(tmp_dir, "notes");
+  std::string full_server = Glib::build_filename(tmp_dir, "full");
+  std::string delta_server = Glib::build_filename(tmp_dir, "delta");
+  std::string cache1 = Glib::build_filename(tmp_dir, "cache1");
+  std::string cache2 = Glib::build_filename(tmp_dir, "cache2");
+  g_mkdir(notes_dir.c_str(), 0700);
+  g_mkdir(full_server.c_str(), 0700);
+  g_mkdir(delta_server.c_str(), 0700);
+  g_mkdir(cache1.c_str(), 0700);
+  g_mkdir(cache2.c_str(), 0700);
+
+  std::string text;
+  for(int i = 0; i < 200; ++i) {
+    text += "Line " + TO_STRING(i) + " of a long note\n";
+  }
+  std::string note1_rev0 = note_xml("Note 1", text);
+  std::string note1_rev1 = note_xml("Note 1", "Added at the start\n" + text);
+  std::string note2_rev0 = note_xml("Note 2", "Text");
+
+  // full copies: older revisions of updated and deleted notes are removed on commit
+  {
+    SyncServer::Ptr client1 = FileSystemSyncServer::create(full_server);
+    client1->id();
+    std::list<std::string> files;
+    files.push_back(write_note(notes_dir, "note1", note1_rev0));
+    files.push_back(write_note(notes_dir, "note2", note2_rev0));
+    upload(client1, files);
+    BOOST_CHECK(has_file(full_server, 0, "note1.note"));
+    BOOST_CHECK(has_file(full_server, 0, "note2.note"));
+    BOOST_CHECK(client1->latest_revision() == 0);
+
+    SyncServer::Ptr client2 = FileSystemSyncServer::create(full_server);
+    std::map<std::string, NoteUpdate> updates = client2->get_note_updates_since(-1, ContentHashMap());
+    BOOST_CHECK(updates.size() == 2);
+    BOOST_CHECK(updates.find("note1")->second.m_xml_content == note1_rev0);
+    BOOST_CHECK(updates.find("note2")->second.m_title == "Note 2");
+
+    upload(client1, std::list<std::string>(1, write_note(notes_dir, "note1", note1_rev1)),
+           std::list<std::string>(1, "note2"));
+    BOOST_CHECK(has_file(full_server, 1, "note1.note"));
+    BOOST_CHECK(!has_file(full_server, 1, "note1.delta"));
+    BOOST_CHECK(!has_file(full_server, 0, "note1.note"));
+    BOOST_CHECK(!has_file(full_server, 0, "note2.note"));
+
+    updates = client2->get_note_updates_since(0, ContentHashMap());
+    BOOST_CHECK(updates.size() == 1);
+    BOOST_CHECK(updates.find("note1")->second.m_xml_content == note1_rev1);
+    BOOST_CHECK(updates.find("note1")->second.m_latest_revision == 1);
+    BOOST_CHECK(client2->get_all_note_uuids() == std::list<std::string>(1, "note1"));
+  }
+
+  // deltas: full copy stays while a delta needs it, the whole chain goes with the note
+  {
+    SyncServer::Ptr client1 = FileSystemSyncServer::create(delta_server, cache1);
+    std::string cache_dir = Glib::build_filename(cache1, client1->id());
+    upload(client1, std::list<std::string>(1, write_note(notes_dir, "note1", note1_rev0)));
+    BOOST_CHECK(has_file(delta_server, 0, "note1.note"));
+    BOOST_CHECK(sharp::file_exists(Glib::build_filename(cache_dir, "note1.cache")));
+    BOOST_CHECK(!sharp::file_exists(Glib::build_filename(cache_dir, "note1.cache.new")));
+
+    upload(client1, std::list<std::string>(1, write_note(notes_dir, "note1", note1_rev1)));
+    BOOST_CHECK(has_file(delta_server, 1, "note1.delta"));
+    BOOST_CHECK(!has_file(delta_server, 1, "note1.note"));
+    BOOST_CHECK(has_file(delta_server, 0, "note1.note"));
+
+    // other client reads the chain and caches the result
+    SyncServer::Ptr client2 = FileSystemSyncServer::create(delta_server, cache2);
+    std::string cache_dir2 = Glib::build_filename(cache2, client2->id());
+    std::map<std::string, NoteUpdate> updates = client2->get_note_updates_since(-1, ContentHashMap());
+    BOOST_CHECK(updates.size() == 1);
+    BOOST_CHECK(updates.find("note1")->second.m_xml_content == note1_rev1);
+    BOOST_CHECK(updates.find("note1")->second.m_latest_revision == 1);
+    BOOST_CHECK(sharp::file_exists(Glib::build_filename(cache_dir2, "note1.cache")));
+
+    upload(client1, std::list<std::string>(1, write_note(notes_dir, "note2", note2_rev0)),
+           std::list<std::string>(1, "note1"));
+    BOOST_CHECK(!has_file(delta_server, 1, "note1.delta"));
+    BOOST_CHECK(!has_file(delta_server, 0, "note1.note"));
+    BOOST_CHECK(!sharp::file_exists(Glib::build_filename(cache_dir, "note1.cache")));
+    BOOST_CHECK(sharp::file_exists(Glib::build_filename(cache_dir, "note2.cache")));
+
+    // notes deleted by another client are only dropped from cache by a full prune
+    updates = client2->get_note_updates_since(1, ContentHashMap());
+    BOOST_CHECK(updates.size() == 1);
+    BOOST_CHECK(updates.find("note2")->second.m_xml_content == note2_rev0);
+    upload(client2, std::list<std::string>(1, write_note(notes_dir, "note3", note_xml("Note 3", "Text"))));
+    BOOST_CHECK(sharp::file_exists(Glib::build_filename(cache_dir2, "note1.cache")));
+    BOOST_CHECK(sharp::file_exists(Glib::build_filename(cache_dir2, "note2.cache")));
+    BOOST_CHECK(sharp::file_exists(Glib::build_filename(cache_dir2, "note3.cache")));
+    BOOST_CHECK(client1->get_all_note_uuids().size() == 2);
+
+    // rewritten note is stored as a full copy, older cached revision of another client is
+    // no longer a delta base, but it is only dropped by a full prune as well
+    upload(client1, std::list<std::string>(1, write_note(notes_dir, "note2", note_xml("Note 2", text))));
+    BOOST_CHECK(has_file(delta_server, 4, "note2.note"));
+    upload(client2, std::list<std::string>(1, write_note(notes_dir, "note3", note_xml("Note 3", "More text"))));
+    BOOST_CHECK(sharp::file_exists(Glib::build_filename(cache_dir2, "note2.cache")));
+    BOOST_CHECK(sharp::file_exists(Glib::build_filename(cache_dir2, "note3.cache")));
+
+    // whole cache is pruned every 100 revisions
+    for(int rev = 6; rev <= 100; ++rev) {
+      upload(client2, std::list<std::string>(1, write_note(notes_dir, "note3", note_xml("Note 3", TO_STRING(rev)))));
+    }
+    BOOST_CHECK(sharp::file_exists(Glib::build_filename(delta_server, "1", "100")));
+    BOOST_CHECK(!sharp::file_exists(Glib::build_filename(cache_dir2, "note1.cache")));
+    BOOST_CHECK(!sharp::file_exists(Glib::build_filename(cache_dir2, "note2.cache")));
+    BOOST_CHECK(sharp::file_exists(Glib::build_filename(cache_dir2, "note3.cache")));
+  }
+
+  test::remove_directory(tmp_dir);
+  return 0;
+}
@@ -0,0 +1,459 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Benchmark suite over a generated corpus of notes.
+// Times loading, saving, searching, title matching and synchronization
+// against a local filesystem sync server. Each benchmark is run several
+// rounds, the fastest round counts.
+// Results are lines of "name<TAB>milliseconds", preceded by a comment with
+// the corpus options. When a baseline from an earlier run is given, results
+// are compared with it and exit status is 1 if any of them got slower by
+// more than the tolerance.
+// Usage: gnotebench [--notes=N] [--words=N] [--links=N] [--tags=N] [--seed=N]
+//                   [--rounds=N] [--output=FILE] [--baseline=FILE] [--tolerance=PERCENT]
+// Run by 'make bench', 'make bench-baseline' stores a new baseline.
+
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdio.h>
+#include <vector>
+
+#include <glib/gstdio.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+
+#include "benchcorpus.hpp"
+#include "searchindex.hpp"
+#include "testnotemanager.hpp"
+#include "testsyncclient.hpp"
+#include "testtagmanager.hpp"
+#include "sharp/directory.hpp"
+#include "sharp/files.hpp"
+#include "synchronization/filesystemsyncserver.hpp"
+#include "synchronization/syncplan.hpp"
+
+
+namespace {
+
+const int SEARCH_QUERIES = 200;
+
+struct Options
+{
+  Options()
+    : rounds(5)
+    , tolerance(15)
+    {}
+
+  test::BenchCorpus::Options corpus;
+  int rounds;
+  std::string output;
+  std::string baseline;
+  int tolerance;
+};
+
+typedef std::vector<std::pair<std::string, double> > Results;
+
+
+// Keeps the fastest of several rounds
+class Timer
+{
+public:
+  Timer()
+    : m_start(0)
+    , m_best(-1)
+    {}
+
+  void start()
+    {
+      m_start = g_get_monotonic_time();
+    }
+  void stop()
+    {
+      double ms = (g_get_monotonic_time() - m_start) / 1000.0;
+      if(m_best < 0 || ms < m_best) {
+        m_best = ms;
+      }
+    }
+  double best() const
+    {
+      return m_best;
+    }
+private:
+  gint64 m_start;
+  double m_best;
+};
+
+
+bool parse_option(const char *arg, const char *name, std::string & value)
+{
+  std::size_t len = std::strlen(name);
+  if(std::strncmp(arg, name, len) != 0 || arg[len] != '=') {
+    return false;
+  }
+  value = arg + len + 1;
+  return true;
+}
+
+bool parse_options(int argc, char **argv, Options & options)
+{
+  for(int i = 1; i < argc; ++i) {
+    std::string value;
+    if(parse_option(argv[i], "--notes", value)) {
+      options.corpus.note_count = std::atoi(value.c_str());
+    }
+    else if(parse_option(argv[i], "--words", value)) {
+      options.corpus.note_words = std::atoi(value.c_str());
+    }
+    else if(parse_option(argv[i], "--links", value)) {
+      options.corpus.link_density = std::atoi(value.c_str());
+    }
+    else if(parse_option(argv[i], "--tags", value)) {
+      options.corpus.tag_count = std::atoi(value.c_str());
+    }
+    else if(parse_option(argv[i], "--seed", value)) {
+      options.corpus.seed = std::atoi(value.c_str());
+    }
+    else if(parse_option(argv[i], "--rounds", value)) {
+      options.rounds = std::atoi(value.c_str());
+    }
+    else if(parse_option(argv[i], "--output", value)) {
+      options.output = value;
+    }
+    else if(parse_option(argv[i], "--baseline", value)) {
+      options.baseline = value;
+    }
+    else if(parse_option(argv[i], "--tolerance", value)) {
+      options.tolerance = std::atoi(value.c_str());
+    }
+    else {
+      fprintf(stderr, "Unknown option: %s\n", argv[i]);
+      return false;
+    }
+  }
+  return options.corpus.note_count > 0 && options.rounds > 0;
+}
+
+std::string corpus_description(const Options & options)
+{
+  return "# gnotebench notes=" + TO_STRING(options.corpus.note_count)
+    + " words=" + TO_STRING(options.corpus.note_words)
+    + " links=" + TO_STRING(options.corpus.link_density)
+    + " tags=" + TO_STRING(options.corpus.tag_count)
+    + " seed=" + TO_STRING(options.corpus.seed);
+}
+
+void add_result(Results & results, const char *name, const Timer & timer, std::size_t note_count)
+{
+  results.push_back(std::make_pair(std::string(name), timer.best()));
+  printf("%s: %.2f ms, %.2f us per note\n", name, timer.best(), timer.best() * 1000 / note_count);
+}
+
+
+void remove_directory(const std::string & dir)
+{
+  std::list<std::string> entries;
+  sharp::directory_get_directories(dir, entries);
+  FOREACH(const std::string & subdir, entries) {
+    remove_directory(subdir);
+  }
+  entries.clear();
+  sharp::directory_get_files(dir, entries);
+  FOREACH(const std::string & file, entries) {
+    g_unlink(file.c_str());
+  }
+  g_rmdir(dir.c_str());
+}
+
+
+// Server in FileSystemSyncServer layout, with all notes at revision 0
+void create_server(const std::string & server_dir, const std::list<gnote::NoteBase::Ptr> & notes)
+{
+  std::string rev_dir = Glib::build_filename(server_dir, "0", "0");
+  g_mkdir_with_parents(rev_dir.c_str(), S_IRWXU);
+
+  std::string manifest = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+                         "<sync revision=\"0\" server-id=\"gnotebench\">\n";
+  FOREACH(const gnote::NoteBase::Ptr & note, notes) {
+    sharp::file_copy(note->file_path(), Glib::build_filename(rev_dir, note->id() + ".note"));
+    manifest += "  <note id=\"" + note->id() + "\" rev=\"0\" content-hash=\"" + note->content_hash() + "\" />\n";
+  }
+  manifest += "</sync>\n";
+  Glib::file_set_contents(Glib::build_filename(server_dir, "manifest.xml"), manifest);
+  Glib::file_set_contents(Glib::build_filename(rev_dir, "manifest.xml"), manifest);
+}
+
+
+void run(const Options & options, const std::string & work_dir, Results & results)
+{
+  std::string notes_dir = Glib::build_filename(work_dir, "notes");
+  g_mkdir_with_parents(notes_dir.c_str(), S_IRWXU);
+  test::BenchCorpus corpus(options.corpus);
+  corpus.write(notes_dir);
+  std::size_t note_count = options.corpus.note_count;
+
+  // Load from disk, like on startup, then read text of every note
+  Timer load_timer, text_timer;
+  std::auto_ptr<test::NoteManager> manager;
+  for(int round = 0; round < options.rounds; ++round) {
+    manager.reset();
+    load_timer.start();
+    manager.reset(new test::NoteManager(notes_dir));
+    manager->load_notes();
+    load_timer.stop();
+
+    text_timer.start();
+    FOREACH(const gnote::NoteBase::Ptr & note, manager->get_notes()) {
+      note->text_content();
+    }
+    text_timer.stop();
+  }
+  add_result(results, "load", load_timer, note_count);
+  add_result(results, "load.text", text_timer, note_count);
+
+  // Saving can move notes in the collection
+  std::list<gnote::NoteBase::Ptr> notes(manager->get_notes().begin(), manager->get_notes().end());
+
+  Timer serialize_timer;
+  for(int round = 0; round < options.rounds; ++round) {
+    serialize_timer.start();
+    FOREACH(const gnote::NoteBase::Ptr & note, notes) {
+      gnote::NoteArchiver::write_string(note->data());
+    }
+    serialize_timer.stop();
+  }
+  add_result(results, "save.serialize", serialize_timer, note_count);
+
+  // Writes file and updates search index
+  Timer save_timer;
+  for(int round = 0; round < options.rounds; ++round) {
+    save_timer.start();
+    FOREACH(const gnote::NoteBase::Ptr & note, notes) {
+      note->save();
+    }
+    save_timer.stop();
+  }
+  add_result(results, "save", save_timer, note_count);
+
+  // Content matches from the index and title matches, as Search::search_notes does
+  std::vector<std::vector<std::string> > queries;
+  for(int i = 0; i < SEARCH_QUERIES; ++i) {
+    std::vector<std::string> words;
+    gnote::SearchIndex::split_words(corpus.random_word() + (i % 2 ? " " + corpus.random_word() : ""), words);
+    queries.push_back(words);
+  }
+  Timer search_timer;
+  for(int round = 0; round < options.rounds; ++round) {
+    search_timer.start();
+    FOREACH(const std::vector<std::string> & words, queries) {
+      gnote::SearchIndex::Matches matches;
+      manager->search_index().find_matches(words, false, matches);
+      FOREACH(const gnote::NoteBase::Ptr & note, notes) {
+        Glib::ustring title = note->get_title().lowercase();
+        FOREACH(const std::string & word, words) {
+          if(title.find(word) != Glib::ustring::npos) {
+            matches[note->uri()] = INT_MAX;
+          }
+        }
+      }
+    }
+    search_timer.stop();
+  }
+  add_result(results, "search", search_timer, note_count);
+
+  // Title matches in note text, as done when highlighting links
+  std::vector<Glib::ustring> texts;
+  FOREACH(const gnote::NoteBase::Ptr & note, notes) {
+    texts.push_back(note->text_content());
+  }
+  Timer trie_timer;
+  std::size_t trie_hits = 0;
+  for(int round = 0; round < options.rounds; ++round) {
+    trie_hits = 0;
+    trie_timer.start();
+    FOREACH(const Glib::ustring & text, texts) {
+      trie_hits += manager->find_trie_matches(text)->size();
+    }
+    trie_timer.stop();
+  }
+  add_result(results, "trie", trie_timer, note_count);
+  printf("  %d title matches\n", int(trie_hits));
+
+  // Synchronization: client bookkeeping, full download, download of unchanged
+  // notes and deletion planning
+  std::string server_dir = Glib::build_filename(work_dir, "server");
+  create_server(server_dir, notes);
+  test::SyncClient client(*manager);
+  client.set_manifest_path(Glib::build_filename(work_dir, "manifest.xml"));
+  gnote::sync::ContentHashMap local_hashes;
+  FOREACH(const gnote::NoteBase::Ptr & note, notes) {
+    local_hashes[note->id()] = note->content_hash();
+  }
+
+  Timer client_timer;
+  for(int round = 0; round < options.rounds; ++round) {
+    client_timer.start();
+    FOREACH(const gnote::NoteBase::Ptr & note, notes) {
+      client.set_revision(note, round);
+      client.set_content_hash(note, note->content_hash());
+    }
+    client.last_synchronized_revision(round);
+    client_timer.stop();
+  }
+  add_result(results, "sync.client", client_timer, note_count);
+
+  Timer download_timer, unchanged_timer, plan_timer;
+  for(int round = 0; round < options.rounds; ++round) {
+    gnote::sync::SyncServer::Ptr server = gnote::sync::FileSystemSyncServer::create(server_dir);
+    download_timer.start();
+    server->get_note_updates_since(-1, gnote::sync::ContentHashMap());
+    download_timer.stop();
+
+    unchanged_timer.start();
+    server->get_note_updates_since(-1, local_hashes);
+    unchanged_timer.stop();
+
+    plan_timer.start();
+    gnote::sync::SyncPlan plan(server->get_all_note_uuids());
+    plan.deleted_on_server(manager->get_notes(), client);
+    plan.deleted_locally(manager->get_notes());
+    plan_timer.stop();
+  }
+  add_result(results, "sync.download", download_timer, note_count);
+  add_result(results, "sync.unchanged", unchanged_timer, note_count);
+  add_result(results, "sync.plan", plan_timer, note_count);
+}
+
+
+std::string results_text(const Options & options, const Results & results)
+{
+  std::string text = corpus_description(options) + "\n";
+  for(Results::const_iterator iter = results.begin(); iter != results.end(); ++iter) {
+    char value[32];
+    std::sprintf(value, "%.3f", iter->second);
+    text += iter->first + "\t" + value + "\n";
+  }
+  return text;
+}
+
+
+// Returns false, if baseline is for different corpus
+bool read_baseline(const std::string & file, const Options & options, std::map<std::string, double> & baseline)
+{
+  std::istringstream input(Glib::file_get_contents(file));
+  std::string line;
+  if(!std::getline(input, line) || line != corpus_description(options)) {
+    return false;
+  }
+  while(std::getline(input, line)) {
+    std::string::size_type tab = line.find('\t');
+    if(line.empty() || line[0] == '#' || tab == std::string::npos) {
+      continue;
+    }
+    baseline[line.substr(0, tab)] = std::atof(line.c_str() + tab + 1);
+  }
+  return true;
+}
+
+// Number of results slower than baseline by more than tolerance
+int compare(const Results & results, const std::map<std::string, double> & baseline, int tolerance)
+{
+  int regressions = 0;
+  printf("\nCompared to baseline:\n");
+  for(Results::const_iterator iter = results.begin(); iter != results.end(); ++iter) {
+    std::map<std::string, double>::const_iterator base = baseline.find(iter->first);
+    if(base == baseline.end() || base->second <= 0) {
+      printf("%s: no baseline\n", iter->first.c_str());
+      continue;
+    }
+    double change = (iter->second - base->second) * 100 / base->second;
+    bool regression = change > tolerance;
+    printf("%s: %.2f ms, baseline %.2f ms, %+.1f%%%s\n", iter->first.c_str(), iter->second,
+           base->second, change, regression ? ", REGRESSION" : "");
+    if(regression) {
+      ++regressions;
+    }
+  }
+  return regressions;
+}
+
+}
+
+
+int main(int argc, char **argv)
+{
+  Options options;
+  if(!parse_options(argc, argv, options)) {
+    fprintf(stderr, "Usage: gnotebench [--notes=N] [--words=N] [--links=N] [--tags=N] [--seed=N] "
+                    "[--rounds=N] [--output=FILE] [--baseline=FILE] [--tolerance=PERCENT]\n");
+    return 1;
+  }
+
+  new test::TagManager;
+  char work_dir_tmpl[] = "/tmp/gnotebenchXXXXXX";
+  std::string work_dir = g_mkdtemp(work_dir_tmpl);
+  printf("%s, %d rounds\n", corpus_description(options).c_str() + 2, options.rounds);
+
+  Results results;
+  int status = 0;
+  try {
+    run(options, work_dir, results);
+  }
+  catch(const std::exception & e) {
+    fprintf(stderr, "Benchmark failed: %s\n", e.what());
+    status = 1;
+  }
+  catch(const Glib::Exception & e) {
+    fprintf(stderr, "Benchmark failed: %s\n", e.what().c_str());
+    status = 1;
+  }
+  remove_directory(work_dir);
+  if(status) {
+    return status;
+  }
+
+  try {
+    if(!options.output.empty()) {
+      Glib::file_set_contents(options.output, results_text(options, results));
+    }
+    if(!options.baseline.empty()) {
+      std::map<std::string, double> baseline;
+      if(!read_baseline(options.baseline, options, baseline)) {
+        fprintf(stderr, "Baseline %s was made with different corpus options\n", options.baseline.c_str());
+        return 1;
+      }
+      int regressions = compare(results, baseline, options.tolerance);
+      if(regressions) {
+        printf("%d results slower than baseline by more than %d%%\n", regressions, options.tolerance);
+        return 1;
+      }
+    }
+  }
+  catch(const Glib::FileError & e) {
+    fprintf(stderr, "%s\n", e.what().c_str());
+    return 1;
+  }
+
+  return 0;
+}
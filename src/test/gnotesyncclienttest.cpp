@@ -22,6 +22,7 @@
 
 #include <boost/test/minimal.hpp>
 
+#include "sharp/files.hpp"
 #include "testnotemanager.hpp"
 #include "testsyncclient.hpp"
 #include "testtagmanager.hpp"
@@ -81,6 +82,32 @@ int test_main(int /*argc*/, char ** /*argv*/)
   client.reparse();
   BOOST_CHECK(client.get_revision(note) == 1);
 
+  // revisions are kept in journal until manifest is written
+  std::string journal = test_manifest + ".journal";
+  BOOST_CHECK(sharp::file_exists(journal));
+
+  client.set_content_hash(note, "hash");
+  client.reparse();
+  BOOST_CHECK(client.get_content_hash(note) == "hash");
+
+  gnote::NoteBase::Ptr note2 = manager.create("test2");
+  client.set_revision(note2, 2);
+  client.last_synchronized_revision(2);
+  BOOST_CHECK(!sharp::file_exists(journal));
+  client.reparse();
+  BOOST_CHECK(client.last_synchronized_revision() == 2);
+  BOOST_CHECK(client.get_revision(note) == 1);
+  BOOST_CHECK(client.get_revision(note2) == 2);
+  BOOST_CHECK(client.get_content_hash(note) == "hash");
+  BOOST_CHECK(client.get_content_hash(note2) == "");
+  BOOST_CHECK(client.deleted_note_titles().size() == 3);
+
+  // unknown hash replaces the old one
+  client.set_content_hash(note, "");
+  client.reparse();
+  BOOST_CHECK(client.get_content_hash(note) == "");
+
+  std::remove(journal.c_str());
   std::remove(test_manifest.c_str());
   return 0;
 }
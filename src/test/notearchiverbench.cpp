@@ -0,0 +1,123 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Benchmark of reading note files, over a corpus of real notes.
+// Compares the single pass parser NoteArchiver uses for files against
+// reading them with XmlReader, which serializes the text again.
+// Usage: notearchiverbench [notes directory] [rounds]
+// Default directory is the one Gnote keeps notes in.
+
+
+#include <cstdlib>
+#include <list>
+#include <stdio.h>
+
+#include <glibmm/miscutils.h>
+
+#include "notebase.hpp"
+#include "testtagmanager.hpp"
+#include "sharp/directory.hpp"
+#include "sharp/xmlreader.hpp"
+
+
+namespace {
+
+double elapsed_ms(gint64 start)
+{
+  return (g_get_monotonic_time() - start) / 1000.0;
+}
+
+void report(const char *what, gint64 start, std::size_t note_count, int rounds)
+{
+  double ms = elapsed_ms(start);
+  printf("%s: %.2f ms, %.2f us per note\n", what, ms, ms * 1000 / (note_count * rounds));
+}
+
+}
+
+
+int main(int argc, char **argv)
+{
+  std::string notes_dir = argc > 1 ? argv[1] : Glib::build_filename(Glib::get_user_data_dir(), "gnote");
+  int rounds = argc > 2 ? std::atoi(argv[2]) : 10;
+
+  new test::TagManager;
+  std::list<std::string> files;
+  sharp::directory_get_files_with_ext(notes_dir, ".note", files);
+  if(files.empty()) {
+    printf("No notes in %s\n", notes_dir.c_str());
+    return 1;
+  }
+  printf("%d notes in %s, %d rounds\n", int(files.size()), notes_dir.c_str(), rounds);
+
+  gint64 start = g_get_monotonic_time();
+  for(int i = 0; i < rounds; ++i) {
+    FOREACH(const std::string & file, files) {
+      gnote::NoteData data(file);
+      sharp::XmlReader xml(file);
+      gnote::NoteArchiver::obj().read(xml, data);
+    }
+  }
+  report("full read, XmlReader", start, files.size(), rounds);
+
+  start = g_get_monotonic_time();
+  for(int i = 0; i < rounds; ++i) {
+    FOREACH(const std::string & file, files) {
+      gnote::NoteData data(file);
+      gnote::NoteArchiver::read(file, data);
+    }
+  }
+  report("full read, single pass", start, files.size(), rounds);
+
+  start = g_get_monotonic_time();
+  for(int i = 0; i < rounds; ++i) {
+    FOREACH(const std::string & file, files) {
+      gnote::NoteData data(file);
+      std::list<Glib::ustring> tags;
+      Glib::ustring version;
+      gnote::NoteArchiver::read_header(file, data, tags, version);
+    }
+  }
+  report("header", start, files.size(), rounds);
+
+  start = g_get_monotonic_time();
+  for(int i = 0; i < rounds; ++i) {
+    FOREACH(const std::string & file, files) {
+      sharp::XmlReader xml(file);
+      while(xml.read()) {
+        if(xml.get_node_type() == XML_READER_TYPE_ELEMENT && xml.get_name() == "text") {
+          xml.read_inner_xml();
+          break;
+        }
+      }
+    }
+  }
+  report("text, XmlReader", start, files.size(), rounds);
+
+  start = g_get_monotonic_time();
+  for(int i = 0; i < rounds; ++i) {
+    FOREACH(const std::string & file, files) {
+      gnote::NoteArchiver::obj().get_text_from_note_file(file);
+    }
+  }
+  report("text, single pass", start, files.size(), rounds);
+
+  return 0;
+}
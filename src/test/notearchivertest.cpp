@@ -0,0 +1,166 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstring>
+
+#include <boost/test/minimal.hpp>
+#include <glib/gstdio.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+
+#include "notebase.hpp"
+#include "testtagmanager.hpp"
+
+
+namespace {
+
+const char *NOTE_TEXT = "<note-content version=\"0.1\">Tom &amp; Jerry\n\n"
+                        "Some <bold>bold</bold> text, a &lt;tag&gt; and \"quotes\"</note-content>";
+
+std::string note_xml(const std::string & version, const std::string & extra)
+{
+  return std::string("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n")
+    + "<note version=\"" + version + "\" xmlns:link=\"http://beatniksoftware.com/tomboy/link\" "
+      "xmlns:size=\"http://beatniksoftware.com/tomboy/size\" xmlns=\"http://beatniksoftware.com/tomboy\">"
+    + extra
+    + "<title>Tom &amp; Jerry</title>"
+    + "<text xml:space=\"preserve\">" + NOTE_TEXT + "</text>"
+    + "<last-change-date>2014-03-01T10:20:30.0000000+02:00</last-change-date>"
+    + "<last-metadata-change-date>2014-03-01T10:20:30.0000000+02:00</last-metadata-change-date>"
+    + "<create-date>2014-02-01T10:20:30.0000000+02:00</create-date>"
+    + "<cursor-position>12</cursor-position>"
+    + "<selection-bound-position>-1</selection-bound-position>"
+    + "<width>450</width><height>360</height>"
+    + "<tags><tag>system:notebook:Cartoons</tag><tag>cat &amp; mouse</tag></tags>"
+    + "</note>\n";
+}
+
+std::string with_text(std::string xml, const std::string & text)
+{
+  return xml.replace(xml.find(NOTE_TEXT), std::strlen(NOTE_TEXT), text);
+}
+
+void check_header(const std::string & file, const std::string & expected_version)
+{
+  gnote::NoteData data("note://gnote/1");
+  std::list<Glib::ustring> tags;
+  Glib::ustring version;
+  gnote::NoteArchiver::read_header(file, data, tags, version);
+  BOOST_CHECK(version == expected_version);
+  BOOST_CHECK(data.title() == "Tom & Jerry");
+  BOOST_CHECK(data.cursor_position() == 12);
+  BOOST_CHECK(data.selection_bound_position() == -1);
+  BOOST_CHECK(data.width() == 450);
+  BOOST_CHECK(data.height() == 360);
+  BOOST_CHECK(data.create_date().is_valid());
+  BOOST_CHECK(data.change_date() > data.create_date());
+  BOOST_CHECK(tags.size() == 2);
+  BOOST_CHECK(tags.front() == "system:notebook:Cartoons");
+  BOOST_CHECK(tags.back() == "cat & mouse");
+}
+
+Glib::ustring reloaded_title;
+
+void on_reloaded(const Glib::ustring & old_title, const gnote::NoteData::TagMap &)
+{
+  reloaded_title = old_title;
+}
+
+}
+
+
+int test_main(int /*argc*/, char ** /*argv*/)
+{
+  new test::TagManager;
+
+  char dir_tmpl[] = "/tmp/gnotetestarchiverXXXXXX";
+  std::string dir = g_mkdtemp(dir_tmpl);
+
+  // usual form, read in a single pass
+  std::string current = Glib::build_filename(dir, "current.note");
+  Glib::file_set_contents(current, note_xml("0.3", ""));
+  check_header(current, "0.3");
+  // text is kept exactly as it is in the file
+  BOOST_CHECK(gnote::NoteArchiver::obj().get_text_from_note_file(current) == NOTE_TEXT);
+
+  // comments are left to XmlReader
+  std::string commented = Glib::build_filename(dir, "commented.note");
+  Glib::file_set_contents(commented, note_xml("0.3", "<!-- written by hand -->"));
+  check_header(commented, "0.3");
+  // text is the same, whichever way the note is read
+  BOOST_CHECK(gnote::NoteArchiver::obj().get_text_from_note_file(commented) == NOTE_TEXT);
+  gnote::NoteData commented_data("note://gnote/4");
+  gnote::NoteArchiver::read(commented, commented_data);
+  BOOST_CHECK(commented_data.title() == "Tom & Jerry");
+  BOOST_CHECK(commented_data.text() == NOTE_TEXT);
+
+  // comments and CDATA inside of text are kept by both
+  std::string cdata = Glib::build_filename(dir, "cdata.note");
+  std::string cdata_text = std::string(NOTE_TEXT).insert(28, "<!-- </text> --><![CDATA[a < b]]>");
+  Glib::file_set_contents(cdata, with_text(note_xml("0.3", ""), cdata_text));
+  BOOST_CHECK(gnote::NoteArchiver::obj().get_text_from_note_file(cdata) == cdata_text);
+  Glib::file_set_contents(cdata, with_text(note_xml("0.3", "<!-- written by hand -->"), cdata_text));
+  BOOST_CHECK(gnote::NoteArchiver::obj().get_text_from_note_file(cdata) == cdata_text);
+
+  // old format is not rewritten while reading
+  std::string old = Glib::build_filename(dir, "old.note");
+  std::string old_xml = note_xml("0.2", "");
+  Glib::file_set_contents(old, old_xml);
+  gnote::NoteData data("note://gnote/2");
+  Glib::ustring version;
+  gnote::NoteArchiver::read(old, data, version);
+  BOOST_CHECK(version == "0.2");
+  BOOST_CHECK(data.text() == NOTE_TEXT);
+  BOOST_CHECK(data.tags().size() == 2);
+  BOOST_CHECK(Glib::file_get_contents(old) == old_xml);
+
+  // same result for notes from a buffer
+  gnote::NoteData buffer_data("note://gnote/3");
+  gnote::NoteArchiver::obj().read_buffer(old_xml, buffer_data);
+  BOOST_CHECK(buffer_data.title() == "Tom & Jerry");
+  BOOST_CHECK(buffer_data.text() == NOTE_TEXT);
+
+  // file changed after header was read, whole note is read again
+  gnote::NoteData changed_data("note://gnote/5");
+  std::list<Glib::ustring> tags;
+  gnote::NoteArchiver::read_header(current, changed_data, tags, version);
+  changed_data.signal_reloaded.connect(sigc::ptr_fun(on_reloaded));
+  std::string changed_xml = note_xml("0.3", "");
+  const char *old_title = "<title>Tom &amp; Jerry</title>";
+  changed_xml.replace(changed_xml.find(old_title), std::strlen(old_title), "<title>Tom and Jerry</title>");
+  Glib::file_set_contents(current, with_text(changed_xml, "<note-content>changed</note-content>"));
+  BOOST_CHECK(changed_data.text() == "<note-content>changed</note-content>");
+  BOOST_CHECK(changed_data.title() == "Tom and Jerry");
+  BOOST_CHECK(reloaded_title == "Tom & Jerry");
+  BOOST_CHECK(changed_data.is_text_readable());
+
+  // text that can not be read is not replaced by an empty one
+  gnote::NoteData lost_data("note://gnote/6");
+  gnote::NoteArchiver::read_header(current, lost_data, tags, version);
+  g_unlink(current.c_str());
+  BOOST_CHECK(!lost_data.is_text_readable());
+  BOOST_CHECK(lost_data.title() == "Tom and Jerry");
+
+  g_unlink(commented.c_str());
+  g_unlink(cdata.c_str());
+  g_unlink(old.c_str());
+  g_rmdir(dir.c_str());
+  return 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <vector>
+
+#include <boost/test/minimal.hpp>
+
+#include "notebitmap.hpp"
+
+
+int test_main(int /*argc*/, char ** /*argv*/)
+{
+  gnote::NoteBitmap a;
+  BOOST_CHECK(a.empty());
+  BOOST_CHECK(a.count() == 0);
+  BOOST_CHECK(!a.test(0));
+
+  a.set(1);
+  a.set(63);
+  a.set(64);
+  a.set(1000);
+  a.set(64);
+  BOOST_CHECK(!a.empty());
+  BOOST_CHECK(a.count() == 4);
+  BOOST_CHECK(a.test(1));
+  BOOST_CHECK(a.test(63));
+  BOOST_CHECK(a.test(64));
+  BOOST_CHECK(a.test(1000));
+  BOOST_CHECK(!a.test(2));
+  BOOST_CHECK(!a.test(999));
+
+  gnote::NoteBitmap b;
+  b.set(2);
+  b.set(64);
+  b.set(5000);
+  BOOST_CHECK(a.intersects(b));
+
+  gnote::NoteBitmap both = a & b;
+  BOOST_CHECK(both.count() == 1);
+  BOOST_CHECK(both.test(64));
+
+  gnote::NoteBitmap any = a | b;
+  BOOST_CHECK(any.count() == 6);
+  std::vector<gnote::NoteBitmap::size_type> bits;
+  any.get_bits(bits);
+  BOOST_CHECK(bits.size() == 6);
+  BOOST_CHECK(bits[0] == 1);
+  BOOST_CHECK(bits[1] == 2);
+  BOOST_CHECK(bits[3] == 64);
+  BOOST_CHECK(bits[5] == 5000);
+
+  gnote::NoteBitmap only_a = a;
+  only_a.subtract(b);
+  BOOST_CHECK(only_a.count() == 3);
+  BOOST_CHECK(!only_a.test(64));
+  BOOST_CHECK(!only_a.intersects(b));
+  BOOST_CHECK((only_a | both) == a);
+
+  a.reset(1000);
+  a.reset(1000);
+  a.reset(7);
+  BOOST_CHECK(a.count() == 3);
+  BOOST_CHECK(!a.test(1000));
+  a.reset(1);
+  a.reset(63);
+  a.reset(64);
+  BOOST_CHECK(a.empty());
+  BOOST_CHECK(a != b);
+
+  return 0;
+}
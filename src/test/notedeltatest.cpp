@@ -0,0 +1,132 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <boost/test/minimal.hpp>
+#include <glib/gstdio.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+
+#include "base/macros.hpp"
+#include "testfiles.hpp"
+#include "sharp/exception.hpp"
+#include "synchronization/filesystemsyncserver.hpp"
+#include "synchronization/notedelta.hpp"
+
+using gnote::sync::FileSystemSyncServer;
+using gnote::sync::NoteDelta;
+
+
+namespace {
+
+std::string note_xml(const std::string & text)
+{
+  return "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+         "<note version=\"0.3\" xmlns=\"http://beatniksoftware.com/tomboy\">\n"
+         "<title>Delta</title><text xml:space=\"preserve\"><note-content version=\"0.1\">Delta\n\n"
+         + text + "</note-content></text></note>\n";
+}
+
+std::string revision_dir(const std::string & server, int rev)
+{
+  std::string dir = Glib::build_filename(server, TO_STRING(rev/100), TO_STRING(rev));
+  g_mkdir_with_parents(dir.c_str(), 0700);
+  return dir;
+}
+
+void store_delta(const std::string & server, int base_rev, int rev, int chain_length,
+                 const std::string & base, const std::string & target)
+{
+  Glib::file_set_contents(Glib::build_filename(revision_dir(server, rev), "note1.delta"),
+                          NoteDelta::file_content(base_rev, chain_length, NoteDelta::create(base, target)));
+}
+
+}
+
+
+int test_main(int /*argc*/, char ** /*argv*/)
+{
+  std::string text;
+  for(int i = 0; i < 2000; ++i) {
+    text += "Line " + TO_STRING(i) + " of a long note\n";
+  }
+  std::string rev0 = note_xml(text);
+  std::string rev1 = note_xml("Added at the start\n" + text);
+  std::string rev2 = note_xml("Added at the start\n" + text + "Added at the end\n");
+  std::string rev3 = note_xml(text.substr(0, text.size() / 2) + "In the middle\n" + text.substr(text.size() / 2));
+
+  // small edits make small deltas
+  std::string delta = NoteDelta::create(rev0, rev1);
+  BOOST_CHECK(delta.size() < rev1.size() / 100);
+  BOOST_CHECK(NoteDelta::apply(rev0, delta) == rev1);
+  BOOST_CHECK(NoteDelta::apply(rev1, NoteDelta::create(rev1, rev3)) == rev3);
+  BOOST_CHECK(NoteDelta::apply("", NoteDelta::create("", rev0)) == rev0);
+  BOOST_CHECK(NoteDelta::apply(rev0, NoteDelta::create(rev0, "")) == "");
+
+  // delta needs the base it was created for
+  bool thrown = false;
+  try {
+    NoteDelta::apply(rev2, delta);
+  }
+  catch(const sharp::Exception &) {
+    thrown = true;
+  }
+  BOOST_CHECK(thrown);
+
+  int base_rev = -1, chain_length = -1;
+  std::string parsed;
+  BOOST_CHECK(NoteDelta::parse_file(NoteDelta::file_content(7, 3, delta), base_rev, chain_length, parsed));
+  BOOST_CHECK(base_rev == 7);
+  BOOST_CHECK(chain_length == 3);
+  BOOST_CHECK(parsed == delta);
+  BOOST_CHECK(!NoteDelta::parse_file(rev0, base_rev, chain_length, parsed));
+
+  char server_tmpl[] = "/tmp/gnotetestdeltaXXXXXX";
+  std::string server = g_mkdtemp(server_tmpl);
+  char cache_tmpl[] = "/tmp/gnotetestdeltacacheXXXXXX";
+  std::string cache = g_mkdtemp(cache_tmpl);
+
+  // full copy in revision 0, deltas after it
+  Glib::file_set_contents(Glib::build_filename(revision_dir(server, 0), "note1.note"), rev0);
+  store_delta(server, 0, 1, 1, rev0, rev1);
+  store_delta(server, 1, 2, 2, rev1, rev2);
+  BOOST_CHECK(FileSystemSyncServer::read_note_revision(server, "", "note1", 0) == rev0);
+  BOOST_CHECK(FileSystemSyncServer::read_note_revision(server, "", "note1", 2) == rev2);
+
+  // revision read is cached, next delta applies to it without older revisions
+  BOOST_CHECK(FileSystemSyncServer::read_note_revision(server, cache, "note1", 2) == rev2);
+  g_unlink(Glib::build_filename(revision_dir(server, 0), "note1.note").c_str());
+  g_unlink(Glib::build_filename(revision_dir(server, 1), "note1.delta").c_str());
+  store_delta(server, 2, 3, 3, rev2, rev3);
+  BOOST_CHECK(FileSystemSyncServer::read_note_revision(server, cache, "note1", 3) == rev3);
+
+  // without cache the chain is broken now
+  thrown = false;
+  try {
+    FileSystemSyncServer::read_note_revision(server, "", "note1", 3);
+  }
+  catch(const Glib::Exception &) {
+    thrown = true;
+  }
+  BOOST_CHECK(thrown);
+
+  test::remove_directory(server);
+  test::remove_directory(cache);
+  return 0;
+}
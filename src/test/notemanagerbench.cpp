@@ -0,0 +1,120 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Benchmark of note lookups by title and URI.
+// Compares NoteManagerBase::find and find_by_uri against linear scans
+// of the note list, which is how they used to be implemented.
+// Only the lookups themselves are measured, not their callers.
+// Usage: notemanagerbench [number of notes]
+
+
+#include <cstdlib>
+#include <stdio.h>
+#include <vector>
+
+#include "testnotemanager.hpp"
+#include "testtagmanager.hpp"
+
+
+namespace {
+
+gnote::NoteBase::Ptr scan_by_title(const gnote::NoteManagerBase & manager, const Glib::ustring & title)
+{
+  FOREACH(const gnote::NoteBase::Ptr & note, manager.get_notes()) {
+    if(note->get_title().lowercase() == title.lowercase()) {
+      return note;
+    }
+  }
+  return gnote::NoteBase::Ptr();
+}
+
+gnote::NoteBase::Ptr scan_by_uri(const gnote::NoteManagerBase & manager, const std::string & uri)
+{
+  FOREACH(const gnote::NoteBase::Ptr & note, manager.get_notes()) {
+    if(note->uri() == uri) {
+      return note;
+    }
+  }
+  return gnote::NoteBase::Ptr();
+}
+
+double elapsed_ms(gint64 start)
+{
+  return (g_get_monotonic_time() - start) / 1000.0;
+}
+
+}
+
+
+int main(int argc, char **argv)
+{
+  int note_count = argc > 1 ? std::atoi(argv[1]) : 5000;
+  // Lookups of each kind
+  const int LOOKUPS = 2000;
+  std::srand(42);
+
+  new test::TagManager;
+  test::NoteManager manager(test::NoteManager::test_notes_dir());
+
+  gint64 start = g_get_monotonic_time();
+  std::vector<gnote::NoteBase::Ptr> notes;
+  for(int i = 0; i < note_count; ++i) {
+    Glib::ustring title = "Benchmark Note " + TO_STRING(i);
+    notes.push_back(manager.create(title, "<note-content>" + title + "\n\nText</note-content>"));
+  }
+  printf("%d notes created in %.2f ms\n", note_count, elapsed_ms(start));
+
+  std::vector<Glib::ustring> titles;
+  std::vector<std::string> uris;
+  for(int i = 0; i < LOOKUPS; ++i) {
+    const gnote::NoteBase::Ptr & note = notes[std::rand() % note_count];
+    titles.push_back(note->get_title().uppercase());
+    uris.push_back(note->uri());
+  }
+
+  int found = 0;
+  start = g_get_monotonic_time();
+  for(int i = 0; i < LOOKUPS; ++i) {
+    found += scan_by_title(manager, titles[i]) ? 1 : 0;
+  }
+  printf("by title, linear scan: %.2f ms, %d found\n", elapsed_ms(start), found);
+
+  found = 0;
+  start = g_get_monotonic_time();
+  for(int i = 0; i < LOOKUPS; ++i) {
+    found += manager.find(titles[i]) ? 1 : 0;
+  }
+  printf("by title, hashed: %.2f ms, %d found\n", elapsed_ms(start), found);
+
+  found = 0;
+  start = g_get_monotonic_time();
+  for(int i = 0; i < LOOKUPS; ++i) {
+    found += scan_by_uri(manager, uris[i]) ? 1 : 0;
+  }
+  printf("by URI, linear scan: %.2f ms, %d found\n", elapsed_ms(start), found);
+
+  found = 0;
+  start = g_get_monotonic_time();
+  for(int i = 0; i < LOOKUPS; ++i) {
+    found += manager.find_by_uri(uris[i]) ? 1 : 0;
+  }
+  printf("by URI, hashed: %.2f ms, %d found\n", elapsed_ms(start), found);
+
+  return 0;
+}
@@ -20,10 +20,30 @@
 
 #include <boost/test/minimal.hpp>
 
+#include <glibmm/miscutils.h>
+
+#include "testnote.hpp"
 #include "testnotemanager.hpp"
 #include "testtagmanager.hpp"
 
 
+namespace {
+
+int tag_changes = 0;
+
+void on_note_tag_added(const gnote::NoteBase &, const gnote::Tag::Ptr &)
+{
+  ++tag_changes;
+}
+
+void on_note_tag_removed(const gnote::NoteBase::Ptr &, const std::string &)
+{
+  --tag_changes;
+}
+
+}
+
+
 int test_main(int /*argc*/, char ** /*argv*/)
 {
   char notes_dir_tmpl[] = "/tmp/gnotetestnotesXXXXXX";
@@ -40,6 +60,143 @@ int test_main(int /*argc*/, char ** /*argv*/)
   BOOST_CHECK(manager.get_notes().size() == 4);
   BOOST_CHECK(manager.find("test note") == test_note);
   BOOST_CHECK(manager.find_by_uri(test_note->uri()) == test_note);
+  BOOST_CHECK(manager.find("Test Note") == test_note);
+
+  test_note->set_title("renamed note");
+  BOOST_CHECK(!manager.find("test note"));
+  BOOST_CHECK(manager.find("renamed note") == test_note);
+
+  manager.delete_note(test_note);
+  BOOST_CHECK(!manager.find("renamed note"));
+  BOOST_CHECK(!manager.find_by_uri(test_note->uri()));
+
+  gnote::NoteBase::Ptr target = manager.create("link & target");
+  gnote::NoteBase::Ptr linker = manager.create("linker",
+    "<note-content>linker\n\n<link:internal>link &amp; target</link:internal></note-content>");
+  gnote::NoteBase::List backlinks = manager.get_notes_linking_to("link & target");
+  BOOST_CHECK(backlinks.size() == 1);
+  BOOST_CHECK(backlinks.front() == linker);
+  BOOST_CHECK(manager.get_notes_linking_to("linker").empty());
+
+  gnote::NoteBase::Ptr linker2 = manager.create("second linker",
+    "<note-content>second linker\n\n<link:internal>link &amp; target</link:internal></note-content>");
+  BOOST_CHECK(manager.get_notes_linking_to("link & target").size() == 2);
+
+  linker->set_xml_content("<note-content>linker\n\nno links</note-content>");
+  linker->save();
+  backlinks = manager.get_notes_linking_to("link & target");
+  BOOST_CHECK(backlinks.size() == 1);
+  BOOST_CHECK(backlinks.front() == linker2);
+
+  manager.delete_note(linker2);
+  BOOST_CHECK(manager.get_notes_linking_to("link & target").empty());
+
+  // content hash covers title and content, but not other data
+  linker->save();
+  std::string hash = linker->content_hash();
+  BOOST_CHECK(hash != "");
+  linker->data().set_cursor_position(5);
+  linker->save();
+  BOOST_CHECK(linker->content_hash() == hash);
+  linker->set_xml_content("<note-content>linker\n\nchanged</note-content>");
+  linker->save();
+  BOOST_CHECK(linker->content_hash() != hash);
+  hash = linker->content_hash();
+  linker->set_title("renamed linker");
+  BOOST_CHECK(linker->content_hash() != hash);
+
+  // newest change date first, saved note moves to its new place
+  sharp::DateTime date = sharp::DateTime::now();
+  date.add_hours(1);
+  target->data().set_change_date(date);
+  target->save();
+  BOOST_CHECK(*manager.get_notes().begin() == target);
+  date.add_hours(-48);
+  target->data().set_change_date(date);
+  target->save();
+  BOOST_CHECK(manager.get_notes().size() == 5);
+  sharp::DateTime previous;
+  FOREACH(const gnote::NoteBase::Ptr & note, manager.get_notes()) {
+    BOOST_CHECK(!previous.is_valid() || note->change_date() <= previous);
+    previous = note->change_date();
+  }
+  BOOST_CHECK(previous == date);
+
+  // tag changes of any note reach the manager, tags know their notes
+  manager.signal_note_tag_added.connect(sigc::ptr_fun(on_note_tag_added));
+  manager.signal_note_tag_removed.connect(sigc::ptr_fun(on_note_tag_removed));
+  gnote::Tag::Ptr tag = gnote::ITagManager::obj().get_or_create_tag("test tag");
+  target->add_tag(tag);
+  BOOST_CHECK(tag_changes == 1);
+  BOOST_CHECK(tag->has_note(*target));
+  BOOST_CHECK(!tag->has_note(*linker));
+  BOOST_CHECK(tag->popularity() == 1);
+  target->remove_tag(tag);
+  BOOST_CHECK(tag_changes == 0);
+  BOOST_CHECK(!tag->has_note(*target));
+  BOOST_CHECK(tag->popularity() == 0);
+
+  // unused tags are removed from notes without addins too, system tags are kept
+  BOOST_CHECK(!gnote::ITagManager::obj().get_tag("test tag"));
+  gnote::Tag::Ptr shared_tag = gnote::ITagManager::obj().get_or_create_tag("shared tag");
+  target->add_tag(shared_tag);
+  linker->add_tag(shared_tag);
+  target->remove_tag(shared_tag);
+  BOOST_CHECK(gnote::ITagManager::obj().get_tag("shared tag") == shared_tag);
+  linker->remove_tag(shared_tag);
+  BOOST_CHECK(!gnote::ITagManager::obj().get_tag("shared tag"));
+  std::string system_name = std::string(gnote::Tag::SYSTEM_TAG_PREFIX) + "test";
+  gnote::Tag::Ptr system_tag = gnote::ITagManager::obj().get_or_create_tag(system_name);
+  target->add_tag(system_tag);
+  target->remove_tag(system_tag);
+  BOOST_CHECK(system_tag->popularity() == 0);
+  BOOST_CHECK(gnote::ITagManager::obj().get_tag(system_name) == system_tag);
+
+  // title shared by two notes stays in trie until both are gone
+  const char *twin_text = "see twin title here";
+  gnote::NoteBase::Ptr twin1 = manager.create("twin title");
+  gnote::NoteBase::Ptr twin2 = manager.create("twin two");
+  BOOST_CHECK(manager.find_trie_matches(twin_text)->size() == 1);
+  twin2->set_title("twin title");
+  BOOST_CHECK(manager.find_trie_matches("twin two")->empty());
+  // the most recently changed of them is found
+  sharp::DateTime twin_date = sharp::DateTime::now();
+  twin_date.add_hours(2);
+  twin1->data().set_change_date(twin_date);
+  twin1->save();
+  BOOST_CHECK(manager.find("twin title") == twin1);
+  manager.delete_note(twin1);
+  gnote::TrieHit<gnote::NoteBase::WeakPtr>::ListPtr twin_hits = manager.find_trie_matches(twin_text);
+  BOOST_CHECK(twin_hits->size() == 1);
+  BOOST_CHECK(twin_hits->front()->value().lock() == twin2);
+  BOOST_CHECK(manager.find("twin title") == twin2);
+  // the note indexed last goes, the other one is still found
+  gnote::NoteBase::Ptr twin3 = manager.create("twin three");
+  twin3->set_title("Twin Title");
+  manager.delete_note(twin3);
+  BOOST_CHECK(manager.find("twin title") == twin2);
+  BOOST_CHECK(manager.find_by_uri(twin2->uri()) == twin2);
+  manager.delete_note(twin2);
+  BOOST_CHECK(!manager.find("twin title"));
+  BOOST_CHECK(manager.find_trie_matches(twin_text)->empty());
+
+  // ordinal of a destroyed note is reused, the note does not stay in its tags
+  gnote::Tag::Ptr stale_tag = gnote::ITagManager::obj().get_or_create_tag("stale tag");
+  // never added to manager, so it is destroyed without being deleted
+  std::string gone_file = Glib::build_filename(notes_dir, "gone.note");
+  gnote::NoteBase::Ptr gone(new test::Note(new gnote::NoteData(gnote::NoteBase::url_from_path(gone_file)),
+                                           gone_file, manager));
+  gnote::NoteBitmap::size_type ordinal = gone->ordinal();
+  gone->add_tag(stale_tag);
+  BOOST_CHECK(stale_tag->popularity() == 1);
+  gone.reset();
+  BOOST_CHECK(gnote::NoteBase::from_ordinal(ordinal) == NULL);
+  BOOST_CHECK(stale_tag->popularity() == 0);
+  gnote::NoteBase::Ptr reused = manager.create("reused");
+  BOOST_CHECK(reused->ordinal() == ordinal);
+  BOOST_CHECK(gnote::NoteBase::from_ordinal(ordinal) == reused.get());
+  BOOST_CHECK(!stale_tag->has_note(*reused));
+  BOOST_CHECK(stale_tag->popularity() == 0);
 
   return 0;
 }
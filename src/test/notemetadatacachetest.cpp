@@ -0,0 +1,120 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <fstream>
+
+#include <boost/test/minimal.hpp>
+#include <glibmm/miscutils.h>
+
+#include "notemetadatacache.hpp"
+#include "sharp/files.hpp"
+#include "testnotemanager.hpp"
+#include "testtagmanager.hpp"
+
+
+int test_main(int /*argc*/, char ** /*argv*/)
+{
+  char notes_dir_tmpl[] = "/tmp/gnotetestnotesXXXXXX";
+  char *notes_dir = g_mkdtemp(notes_dir_tmpl);
+  BOOST_CHECK(notes_dir != NULL);
+  std::string cache_file = Glib::build_filename(notes_dir, gnote::NoteMetadataCache::CACHE_FILE_NAME);
+
+  new test::TagManager;
+  test::NoteManager manager(notes_dir);
+  gnote::NoteBase::Ptr note1 = manager.create("note one", "<note-content>note one\n\nfirst</note-content>");
+  gnote::NoteBase::Ptr note2 = manager.create("note two", "<note-content>note two\n\nsecond</note-content>");
+  note1->add_tag(gnote::ITagManager::obj().get_or_create_tag("cached"));
+  note1->data().set_cursor_position(5);
+  note1->data().set_extent(300, 200);
+  note1->save();
+  note2->save();
+
+  // Missing cache file is empty
+  {
+    gnote::NoteMetadataCache cache(cache_file);
+    BOOST_CHECK(cache.size() == 0);
+  }
+
+  const gnote::NoteCollection & notes = manager.get_notes();
+  BOOST_CHECK(gnote::NoteMetadataCache::write(cache_file, notes));
+
+  {
+    gnote::NoteMetadataCache cache(cache_file);
+    BOOST_CHECK(cache.size() == 2);
+
+    gnote::NoteMetadataCache::FileStamp stamp;
+    BOOST_CHECK(gnote::NoteMetadataCache::get_file_stamp(note1->file_path(), stamp));
+    gnote::NoteData data(note1->uri());
+    std::list<Glib::ustring> tags;
+    std::string hash;
+    BOOST_CHECK(cache.lookup(note1->file_path(), stamp, data, tags, hash));
+    BOOST_CHECK(data.title() == "note one");
+    BOOST_CHECK(data.create_date() == note1->create_date());
+    BOOST_CHECK(data.change_date() == note1->change_date());
+    BOOST_CHECK(data.cursor_position() == 5);
+    BOOST_CHECK(data.width() == 300);
+    BOOST_CHECK(data.height() == 200);
+    BOOST_CHECK(tags.size() == 1);
+    BOOST_CHECK(tags.front() == "cached");
+    // Content hash survives a restart without reading the text
+    BOOST_CHECK(hash != "");
+    BOOST_CHECK(hash == note1->content_hash());
+
+    // Entry is not used, if file has changed
+    stamp.size += 1;
+    BOOST_CHECK(!cache.lookup(note1->file_path(), stamp, data, tags, hash));
+    stamp.size -= 1;
+    stamp.mtime_nsec += 1;
+    BOOST_CHECK(!cache.lookup(note1->file_path(), stamp, data, tags, hash));
+    stamp.mtime_nsec -= 1;
+    stamp.inode += 1;
+    BOOST_CHECK(!cache.lookup(note1->file_path(), stamp, data, tags, hash));
+    BOOST_CHECK(gnote::NoteMetadataCache::get_file_stamp(note2->file_path(), stamp));
+    BOOST_CHECK(!cache.lookup(Glib::build_filename(notes_dir, "missing.note"), stamp, data, tags, hash));
+  }
+
+  // Corrupt cache is treated as empty
+  {
+    std::fstream fout(cache_file.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+    fout.seekp(-3, std::ios::end);
+    fout.put('X');
+  }
+  {
+    gnote::NoteMetadataCache cache(cache_file);
+    BOOST_CHECK(cache.size() == 0);
+  }
+  {
+    std::ofstream fout(cache_file.c_str(), std::ios::binary | std::ios::trunc);
+    fout << "GNMC";
+  }
+  {
+    gnote::NoteMetadataCache cache(cache_file);
+    BOOST_CHECK(cache.size() == 0);
+  }
+
+  // Rewriting repairs it
+  BOOST_CHECK(gnote::NoteMetadataCache::write(cache_file, notes));
+  {
+    gnote::NoteMetadataCache cache(cache_file);
+    BOOST_CHECK(cache.size() == 2);
+  }
+
+  return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <fstream>
+#include <sstream>
+
+#include <boost/test/minimal.hpp>
+#include <glib/gstdio.h>
+
+#include "notesavescheduler.hpp"
+
+
+namespace {
+
+int successes = 0;
+int failures = 0;
+
+void on_saved(bool success)
+{
+  if(success) {
+    ++successes;
+  }
+  else {
+    ++failures;
+  }
+}
+
+std::string read_file(const std::string & file)
+{
+  std::ifstream fin(file.c_str());
+  std::ostringstream content;
+  content << fin.rdbuf();
+  return content.str();
+}
+
+}
+
+
+int test_main(int /*argc*/, char ** /*argv*/)
+{
+  char dir_tmpl[] = "/tmp/gnotetestsaveXXXXXX";
+  char *dir = g_mkdtemp(dir_tmpl);
+  BOOST_CHECK(dir != NULL);
+  std::string file1 = std::string(dir) + "/1.note";
+  std::string file2 = std::string(dir) + "/2.note";
+
+  {
+    gnote::NoteSaveScheduler scheduler(50);
+    scheduler.schedule(file1, "first", sigc::ptr_fun(on_saved));
+    scheduler.schedule(file2, "second", sigc::ptr_fun(on_saved));
+    scheduler.schedule(file1, "first again", sigc::ptr_fun(on_saved));
+    scheduler.flush();
+
+    // Coalesced writes get their completion too
+    BOOST_CHECK(successes == 3);
+    BOOST_CHECK(failures == 0);
+    BOOST_CHECK(read_file(file1) == "first again");
+    BOOST_CHECK(read_file(file2) == "second");
+    BOOST_CHECK(!g_file_test((file1 + ".tmp").c_str(), G_FILE_TEST_EXISTS));
+
+    // Cancelled write is not done and not reported
+    g_unlink(file2.c_str());
+    scheduler.schedule(file2, "cancelled", sigc::ptr_fun(on_saved));
+    scheduler.cancel(file2);
+    scheduler.flush();
+    BOOST_CHECK(successes == 3);
+    BOOST_CHECK(!g_file_test(file2.c_str(), G_FILE_TEST_EXISTS));
+
+    scheduler.schedule(std::string(dir) + "/missing/3.note", "fails", sigc::ptr_fun(on_saved));
+    scheduler.sync_to_disk(true);
+    scheduler.schedule(file2, "synced", sigc::ptr_fun(on_saved));
+    scheduler.flush();
+    BOOST_CHECK(failures == 1);
+    BOOST_CHECK(successes == 4);
+    BOOST_CHECK(read_file(file2) == "synced");
+
+    // Destructor writes the rest
+    scheduler.schedule(file1, "last", sigc::ptr_fun(on_saved));
+  }
+  BOOST_CHECK(successes == 5);
+  BOOST_CHECK(read_file(file1) == "last");
+
+  g_unlink(file1.c_str());
+  g_unlink(file2.c_str());
+  g_rmdir(dir);
+
+  return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <boost/test/minimal.hpp>
+
+#include "searchindex.hpp"
+#include "testnotemanager.hpp"
+#include "testtagmanager.hpp"
+
+
+int test_main(int /*argc*/, char ** /*argv*/)
+{
+  BOOST_CHECK(gnote::NoteArchiver::obj().get_text_from_note_content(
+                "<note-content>a &amp; <b>b</b> &#65;</note-content>") == "a & b A");
+
+  std::vector<std::string> words;
+  gnote::SearchIndex::split_words("Foo, bar-BAZ  foo", words);
+  BOOST_CHECK(words.size() == 4);
+  BOOST_CHECK(words[0] == "foo");
+  BOOST_CHECK(words[2] == "baz");
+  words.clear();
+  gnote::SearchIndex::split_words("Foo, bar-BAZ", words, false);
+  BOOST_CHECK(words.size() == 3);
+  BOOST_CHECK(words[2] == "BAZ");
+
+  char notes_dir_tmpl[] = "/tmp/gnotetestnotesXXXXXX";
+  char *notes_dir = g_mkdtemp(notes_dir_tmpl);
+  BOOST_CHECK(notes_dir != NULL);
+
+  new test::TagManager;
+  test::NoteManager manager(notes_dir);
+  gnote::NoteBase::Ptr note1 = manager.create("note one",
+    "<note-content>note one\n\nApples and oranges, more apples</note-content>");
+  gnote::NoteBase::Ptr note2 = manager.create("note two",
+    "<note-content>note two\n\nOranges &amp; lemons</note-content>");
+
+  BOOST_CHECK(note2->text_content() == "note two\n\nOranges & lemons");
+
+  gnote::SearchIndex::Matches matches;
+  words.clear();
+  words.push_back("apple");
+  manager.search_index().find_matches(words, false, matches);
+  BOOST_CHECK(matches.size() == 1);
+  BOOST_CHECK(matches[note1->uri()] == 2);
+
+  words.clear();
+  words.push_back("oranges");
+  manager.search_index().find_matches(words, false, matches);
+  BOOST_CHECK(matches.size() == 2);
+
+  words.push_back("lemon");
+  manager.search_index().find_matches(words, false, matches);
+  BOOST_CHECK(matches.size() == 1);
+  BOOST_CHECK(matches.find(note2->uri()) != matches.end());
+
+  // Substring of a word, both at the end and in the middle
+  words.clear();
+  words.push_back("ange");
+  manager.search_index().find_matches(words, false, matches);
+  BOOST_CHECK(matches.size() == 2);
+  words.clear();
+  words.push_back("mon");
+  manager.search_index().find_matches(words, false, matches);
+  BOOST_CHECK(matches.size() == 1);
+  BOOST_CHECK(matches.find(note2->uri()) != matches.end());
+
+  words.clear();
+  words.push_back("oranges & lemons");
+  manager.search_index().find_matches(words, false, matches);
+  BOOST_CHECK(matches.size() == 1);
+
+  words.clear();
+  words.push_back("Apples");
+  manager.search_index().find_matches(words, true, matches);
+  BOOST_CHECK(matches.size() == 1);
+  BOOST_CHECK(matches[note1->uri()] == 1);
+  words.clear();
+  words.push_back("oranges");
+  manager.search_index().find_matches(words, true, matches);
+  BOOST_CHECK(matches.size() == 1);
+  BOOST_CHECK(matches.find(note1->uri()) != matches.end());
+  BOOST_CHECK(manager.search_index().count_matches(note2->uri(), words, true) == 0);
+  words.clear();
+  words.push_back("Oranges & lemons");
+  manager.search_index().find_matches(words, true, matches);
+  BOOST_CHECK(matches.size() == 1);
+  BOOST_CHECK(matches.find(note2->uri()) != matches.end());
+
+  // Single note gets the same count as from find_matches()
+  words.clear();
+  words.push_back("apple");
+  BOOST_CHECK(manager.search_index().count_matches(note1->uri(), words, false) == 2);
+  BOOST_CHECK(manager.search_index().count_matches(note2->uri(), words, false) == 0);
+  words.push_back("oranges");
+  BOOST_CHECK(manager.search_index().count_matches(note1->uri(), words, false) == 3);
+  words.clear();
+  words.push_back("oranges & lemons");
+  BOOST_CHECK(manager.search_index().count_matches(note2->uri(), words, false) == 1);
+
+  manager.delete_note(note1);
+  words.clear();
+  words.push_back("apple");
+  manager.search_index().find_matches(words, false, matches);
+  BOOST_CHECK(matches.empty());
+  words.clear();
+  words.push_back("ples");
+  manager.search_index().find_matches(words, false, matches);
+  BOOST_CHECK(matches.empty());
+  words.clear();
+  words.push_back("ranges");
+  manager.search_index().find_matches(words, false, matches);
+  BOOST_CHECK(matches.size() == 1);
+
+  return 0;
+}
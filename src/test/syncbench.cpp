@@ -0,0 +1,195 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Benchmark of synchronization against a local filesystem sync server.
+// Drives FileSystemSyncServer through the steps of a full sync: upload and
+// commit of all notes, listing and downloading them on another client, the
+// download skip by content hash and a later commit of changed notes stored
+// as deltas. SyncManager itself needs the GUI, so its deletion passes are
+// timed on their own, SyncPlan against the linear scans SyncManager used
+// to do: std::find over the server list for every local note and a note
+// lookup plus copy of deleted titles for every server note.
+// Usage: syncbench [number of notes]
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <glib/gstdio.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+
+#include "testfiles.hpp"
+#include "testnotemanager.hpp"
+#include "testsyncclient.hpp"
+#include "testtagmanager.hpp"
+#include "synchronization/filesystemsyncserver.hpp"
+#include "synchronization/syncplan.hpp"
+#include "sharp/files.hpp"
+
+
+namespace {
+
+double elapsed_ms(gint64 start)
+{
+  return (g_get_monotonic_time() - start) / 1000.0;
+}
+
+std::string write_note(const std::string & dir, const std::string & id, const std::string & title,
+                       const std::string & text)
+{
+  std::string file = Glib::build_filename(dir, id + ".note");
+  Glib::file_set_contents(file,
+    "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+    "<note version=\"0.3\" xmlns=\"http://beatniksoftware.com/tomboy\">"
+    "<title>" + title + "</title>"
+    "<text xml:space=\"preserve\"><note-content version=\"0.1\">" + title + "\n\n" + text
+    + "</note-content></text></note>\n");
+  return file;
+}
+
+// Server has most local notes, a tenth is deleted on it and it has as many
+// notes deleted locally
+void write_server_notes(const std::vector<gnote::NoteBase::Ptr> & notes, const std::string & dir,
+                        std::list<std::string> & files, gnote::sync::ContentHashMap & hashes)
+{
+  for(std::vector<gnote::NoteBase::Ptr>::size_type i = 0; i < notes.size(); ++i) {
+    std::string id = i % 10 ? notes[i]->id() : "deleted-locally-" + TO_STRING(i);
+    files.push_back(write_note(dir, id, "Benchmark Note " + TO_STRING(i), "Text"));
+    hashes[id] = "hash" + TO_STRING(i);
+  }
+}
+
+}
+
+
+int main(int argc, char **argv)
+{
+  int note_count = argc > 1 ? std::atoi(argv[1]) : 20000;
+
+  new test::TagManager;
+  Glib::ustring notes_dir = test::NoteManager::test_notes_dir();
+  test::NoteManager manager(notes_dir);
+  test::SyncClient client(manager);
+  client.set_manifest_path(Glib::build_filename(notes_dir, "manifest.xml"));
+
+  gint64 start = g_get_monotonic_time();
+  std::vector<gnote::NoteBase::Ptr> notes;
+  for(int i = 0; i < note_count; ++i) {
+    Glib::ustring title = "Benchmark Note " + TO_STRING(i);
+    gnote::NoteBase::Ptr note = manager.create(title, "<note-content>" + title + "\n\nText</note-content>");
+    client.set_revision(note, 0);
+    notes.push_back(note);
+  }
+  client.last_synchronized_revision(0);
+  printf("%d notes created in %.2f ms\n", note_count, elapsed_ms(start));
+
+  char tmp_dir_tmpl[] = "/tmp/gnotesyncbenchXXXXXX";
+  std::string tmp_dir = g_mkdtemp(tmp_dir_tmpl);
+  std::string files_dir = Glib::build_filename(tmp_dir, "files");
+  std::string server_dir = Glib::build_filename(tmp_dir, "server");
+  std::string cache_dir = Glib::build_filename(tmp_dir, "cache");
+  g_mkdir(files_dir.c_str(), 0700);
+  g_mkdir(server_dir.c_str(), 0700);
+  g_mkdir(cache_dir.c_str(), 0700);
+  std::list<std::string> files;
+  gnote::sync::ContentHashMap hashes;
+  write_server_notes(notes, files_dir, files, hashes);
+
+  // first client uploads everything
+  gnote::sync::SyncServer::Ptr uploader = gnote::sync::FileSystemSyncServer::create(server_dir, cache_dir);
+  uploader->id();
+  start = g_get_monotonic_time();
+  uploader->begin_sync_transaction();
+  static_pointer_cast<gnote::sync::FileSystemSyncServer>(uploader)->upload_note_files(files, hashes);
+  uploader->commit_sync_transaction();
+  printf("upload and commit: %.2f ms, %d notes\n", elapsed_ms(start), int(files.size()));
+
+  gnote::sync::SyncServer::Ptr server = gnote::sync::FileSystemSyncServer::create(server_dir);
+  start = g_get_monotonic_time();
+  std::list<std::string> server_notes = server->get_all_note_uuids();
+  printf("server note list: %.2f ms, %d notes\n", elapsed_ms(start), int(server_notes.size()));
+
+  start = g_get_monotonic_time();
+  std::size_t downloaded = server->get_note_updates_since(-1, gnote::sync::ContentHashMap()).size();
+  printf("download: %.2f ms, %d notes\n", elapsed_ms(start), int(downloaded));
+
+  start = g_get_monotonic_time();
+  downloaded = server->get_note_updates_since(-1, hashes).size();
+  printf("download, same content hashes: %.2f ms, %d notes\n", elapsed_ms(start), int(downloaded));
+
+  // a tenth of the notes changes a bit and is stored as deltas
+  std::list<std::string> changed;
+  int index = 0;
+  FOREACH(const std::string & file, files) {
+    if(index % 10 == 1) {
+      std::string id = sharp::file_basename(file);
+      changed.push_back(write_note(files_dir, id, "Benchmark Note " + TO_STRING(index), "Changed text"));
+      hashes[id] = "changed" + TO_STRING(index);
+    }
+    ++index;
+  }
+  start = g_get_monotonic_time();
+  uploader->begin_sync_transaction();
+  static_pointer_cast<gnote::sync::FileSystemSyncServer>(uploader)->upload_note_files(changed, hashes);
+  uploader->commit_sync_transaction();
+  printf("delta upload and commit: %.2f ms, %d notes\n", elapsed_ms(start), int(changed.size()));
+
+  start = g_get_monotonic_time();
+  downloaded = server->get_note_updates_since(0, gnote::sync::ContentHashMap()).size();
+  printf("delta download: %.2f ms, %d notes\n", elapsed_ms(start), int(downloaded));
+
+  const gnote::NoteCollection & local_notes = manager.get_notes();
+
+  int found = 0;
+  start = g_get_monotonic_time();
+  FOREACH(const gnote::NoteBase::Ptr & note, local_notes) {
+    if(client.get_revision(note) != -1
+       && std::find(server_notes.begin(), server_notes.end(), note->id()) == server_notes.end()) {
+      ++found;
+    }
+  }
+  printf("deleted on server, linear scan: %.2f ms, %d found\n", elapsed_ms(start), found);
+
+  start = g_get_monotonic_time();
+  gnote::sync::SyncPlan plan(server_notes);
+  found = plan.deleted_on_server(local_notes, client).size();
+  printf("deleted on server, hashed: %.2f ms, %d found\n", elapsed_ms(start), found);
+
+  found = 0;
+  start = g_get_monotonic_time();
+  FOREACH(const std::string & uuid, server_notes) {
+    if(manager.find_by_uri("note://gnote/" + uuid) == 0) {
+      std::map<std::string, std::string> deleted_note_titles = client.deleted_note_titles();
+      found += deleted_note_titles.find(uuid) == deleted_note_titles.end() ? 1 : 0;
+    }
+  }
+  printf("deleted locally, per note lookup: %.2f ms, %d found\n", elapsed_ms(start), found);
+
+  start = g_get_monotonic_time();
+  found = plan.deleted_locally(local_notes).size();
+  printf("deleted locally, hashed: %.2f ms, %d found\n", elapsed_ms(start), found);
+
+  test::remove_directory(tmp_dir);
+  test::remove_directory(Glib::path_get_dirname(notes_dir));
+  return 0;
+}
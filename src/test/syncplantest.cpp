@@ -0,0 +1,112 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <boost/test/minimal.hpp>
+#include <glibmm/miscutils.h>
+
+#include "testfiles.hpp"
+#include "testnotemanager.hpp"
+#include "testsyncclient.hpp"
+#include "testtagmanager.hpp"
+#include "synchronization/filesystemsyncserver.hpp"
+#include "synchronization/syncplan.hpp"
+
+
+int test_main(int /*argc*/, char ** /*argv*/)
+{
+  new test::TagManager;
+  Glib::ustring notes_dir = test::NoteManager::test_notes_dir();
+  test::NoteManager manager(notes_dir);
+  test::SyncClient client(manager);
+  client.set_manifest_path(Glib::build_filename(notes_dir, "manifest.xml"));
+
+  gnote::NoteBase::Ptr synced = manager.create("synced");
+  gnote::NoteBase::Ptr deleted_on_server = manager.create("deleted on server");
+  gnote::NoteBase::Ptr new_note = manager.create("new");
+  client.set_revision(synced, 0);
+  client.set_revision(deleted_on_server, 0);
+
+  std::list<std::string> server_notes;
+  server_notes.push_back("deleted-locally");
+  server_notes.push_back(synced->id());
+  gnote::sync::SyncPlan plan(server_notes);
+  BOOST_CHECK(plan.server_notes().size() == 2);
+
+  // only notes, that were synchronized before
+  const gnote::NoteCollection & local_notes = manager.get_notes();
+  std::list<gnote::NoteBase::Ptr> deleted = plan.deleted_on_server(local_notes, client);
+  BOOST_CHECK(deleted.size() == 1);
+  BOOST_CHECK(deleted.front() == deleted_on_server);
+
+  std::list<std::string> deleted_locally = plan.deleted_locally(local_notes);
+  BOOST_CHECK(deleted_locally.size() == 1);
+  BOOST_CHECK(deleted_locally.front() == "deleted-locally");
+
+  manager.delete_note(synced);
+  deleted_locally = plan.deleted_locally(manager.get_notes());
+  BOOST_CHECK(deleted_locally.size() == 2);
+  BOOST_CHECK(deleted_locally.back() == synced->id());
+
+  // content hashes of saved notes are known
+  gnote::NoteBase::Ptr unchanged = manager.create("unchanged", "<note-content>unchanged\n\nText</note-content>");
+  unchanged->save();
+  BOOST_CHECK(unchanged->content_hash() != "");
+  gnote::sync::ContentHashMap hashes = gnote::sync::SyncPlan::local_content_hashes(manager.get_notes(), client);
+  BOOST_CHECK(hashes[unchanged->id()] == unchanged->content_hash());
+
+  char server_dir_tmpl[] = "/tmp/gnotetestsyncplanXXXXXX";
+  std::string server_dir = g_mkdtemp(server_dir_tmpl);
+  gnote::sync::SyncServer::Ptr server = gnote::sync::FileSystemSyncServer::create(server_dir);
+  server->id();
+  BOOST_CHECK(server->begin_sync_transaction());
+  static_pointer_cast<gnote::sync::FileSystemSyncServer>(server)->upload_note_files(
+    std::list<std::string>(1, unchanged->file_path()), hashes);
+  BOOST_CHECK(server->commit_sync_transaction());
+  client.set_revision(unchanged, 0);
+  client.set_content_hash(unchanged, unchanged->content_hash());
+  client.last_sync_date(sharp::DateTime::now());
+  client.last_synchronized_revision(0);
+
+  // after restart hashes are not known until notes are saved,
+  // unchanged ones still have the hash of last sync and are not downloaded again
+  {
+    test::NoteManager reloaded(notes_dir);
+    reloaded.load_notes();
+    test::SyncClient reloaded_client(reloaded);
+    reloaded_client.set_manifest_path(Glib::build_filename(notes_dir, "manifest.xml"));
+    reloaded_client.reparse();
+
+    gnote::NoteBase::Ptr note = reloaded.find_by_uri(unchanged->uri());
+    BOOST_CHECK(note != 0);
+    BOOST_CHECK(note->content_hash() == "");
+    hashes = gnote::sync::SyncPlan::local_content_hashes(reloaded.get_notes(), reloaded_client);
+    BOOST_CHECK(hashes[unchanged->id()] == unchanged->content_hash());
+
+    std::map<std::string, gnote::sync::NoteUpdate> updates = server->get_note_updates_since(-1, hashes);
+    BOOST_CHECK(updates.size() == 1);
+    BOOST_CHECK(updates.find(unchanged->id())->second.m_unchanged);
+    BOOST_CHECK(updates.find(unchanged->id())->second.m_xml_content == "");
+  }
+
+  test::remove_directory(server_dir);
+  test::remove_directory(Glib::path_get_dirname(notes_dir));
+  return 0;
+}
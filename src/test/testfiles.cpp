@@ -0,0 +1,49 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <glib/gstdio.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+
+#include "testfiles.hpp"
+
+
+namespace test {
+
+void remove_directory(const std::string & dir)
+{
+  try {
+    Glib::Dir entries(dir);
+    for(Glib::DirIterator iter = entries.begin(); iter != entries.end(); ++iter) {
+      std::string path = Glib::build_filename(dir, *iter);
+      if(Glib::file_test(path, Glib::FILE_TEST_IS_DIR) && !Glib::file_test(path, Glib::FILE_TEST_IS_SYMLINK)) {
+        remove_directory(path);
+      }
+      else {
+        g_unlink(path.c_str());
+      }
+    }
+  }
+  catch(const Glib::FileError &) {
+  }
+  g_rmdir(dir.c_str());
+}
+
+}
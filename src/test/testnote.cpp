@@ -28,6 +28,11 @@ Note::Note(gnote::NoteData *_data, const Glib::ustring & filepath, gnote::NoteMa
 {
 }
 
+Note::~Note()
+{
+  leave_tags();
+}
+
 const gnote::NoteDataBufferSynchronizerBase & Note::data_synchronizer() const
 {
   return m_data_synchronizer;
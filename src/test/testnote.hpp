@@ -27,6 +27,7 @@ class Note
 {
 public:
   Note(gnote::NoteData *_data, const Glib::ustring & filepath, gnote::NoteManagerBase & manager);
+  virtual ~Note();
 protected:
   virtual const gnote::NoteDataBufferSynchronizerBase & data_synchronizer() const;
   virtual gnote::NoteDataBufferSynchronizerBase & data_synchronizer();
@@ -19,6 +19,8 @@
 
 #include "testnote.hpp"
 #include "testnotemanager.hpp"
+#include "itagmanager.hpp"
+#include "sharp/directory.hpp"
 
 namespace test {
 
@@ -37,6 +39,24 @@ NoteManager::NoteManager(const Glib::ustring & notesdir)
   _common_init(notesdir, backup);
 }
 
+void NoteManager::load_notes()
+{
+  std::list<std::string> files;
+  sharp::directory_get_files_with_ext(notes_dir(), ".note", files);
+  FOREACH(const std::string & file, files) {
+    gnote::NoteData *data = new gnote::NoteData(gnote::NoteBase::url_from_path(file));
+    std::list<Glib::ustring> tags;
+    Glib::ustring version;
+    gnote::NoteArchiver::read_header(file, *data, tags, version);
+    FOREACH(const Glib::ustring & tag_str, tags) {
+      gnote::Tag::Ptr tag = gnote::ITagManager::obj().get_or_create_tag(tag_str);
+      data->tags()[tag->normalized_name()] = tag;
+    }
+    add_note(gnote::NoteBase::Ptr(new Note(data, file, *this)));
+  }
+  post_load();
+}
+
 gnote::NoteBase::Ptr NoteManager::note_create_new(const Glib::ustring & title, const Glib::ustring & file_name)
 {
   gnote::NoteData *note_data = new gnote::NoteData(gnote::NoteBase::url_from_path(file_name));
@@ -30,6 +30,8 @@ public:
   static Glib::ustring test_notes_dir();
 
   explicit NoteManager(const Glib::ustring & notes_dir);
+  // Load headers of notes in notes directory, like gnote::NoteManager does
+  void load_notes();
 protected:
   virtual gnote::NoteBase::Ptr note_create_new(const Glib::ustring & title, const Glib::ustring & file_name) override;
   virtual gnote::NoteBase::Ptr note_load(const Glib::ustring & file_name) override;
@@ -7,6 +7,24 @@
 
 #include "trie.hpp"
 
+struct HitCounter
+{
+  HitCounter()
+    : hits(0)
+    , first_end(0)
+  {}
+
+  void operator()(int, int end, const std::string &)
+  {
+    if(hits++ == 0) {
+      first_end = end;
+    }
+  }
+
+  int hits;
+  int first_end;
+};
+
 int test_main(int /*argc*/, char ** /*argv*/)
 {
   std::string src = "bazar this is some foo, bar, and baz BazBarFooFoo bazbazarbaz end bazar ąČęĖįŠųŪž";
@@ -44,5 +62,20 @@ int test_main(int /*argc*/, char ** /*argv*/)
             hit->key().c_str(), hit->start(), hit->end());
   }
   printf ("Search finished!\n");
+
+  // Visitor gets the same matches, without a list being built
+  HitCounter counter;
+  trie.find_matches(src, counter);
+  BOOST_CHECK( counter.hits == 16 );
+  BOOST_CHECK( counter.first_end == 3 );
+
+  BOOST_CHECK( trie.remove_keyword("bazar") );
+  BOOST_CHECK( !trie.remove_keyword("bazar") );
+  BOOST_CHECK( !trie.remove_keyword("ba") );
+  BOOST_CHECK( trie.find_matches(src)->size() == 13 );
+
+  trie.add_keyword("bazar", "bazar");
+  trie.compute_failure_graph();
+  BOOST_CHECK( trie.find_matches(src)->size() == 16 );
   return 0;
 }
@@ -0,0 +1,461 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <set>
+
+#include <boost/test/minimal.hpp>
+#include <glib/gstdio.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+#include <glibmm/threads.h>
+#include <libsoup/soup.h>
+
+#include "base/macros.hpp"
+#include "synchronization/webdavsyncserver.hpp"
+
+
+namespace {
+
+const char *USERNAME = "user";
+const char *PASSWORD = "secret";
+const char *ROOT = "/gnote";
+
+// In-memory stand-in for a WebDAV server, supports what sync needs
+class DavServer
+{
+public:
+  DavServer()
+    : m_not_modified_count(0)
+    , m_version(0)
+    {
+      m_collections.insert(ROOT);
+
+      m_context = g_main_context_new();
+      g_main_context_push_thread_default(m_context);
+      m_server = soup_server_new(NULL, NULL);
+      SoupAuthDomain *domain = soup_auth_domain_basic_new(
+        SOUP_AUTH_DOMAIN_REALM, "gnote",
+        SOUP_AUTH_DOMAIN_ADD_PATH, "/",
+        SOUP_AUTH_DOMAIN_BASIC_AUTH_CALLBACK, &DavServer::check_password,
+        NULL);
+      soup_server_add_auth_domain(m_server, domain);
+      g_object_unref(domain);
+      soup_server_add_handler(m_server, NULL, &DavServer::handler, this, NULL);
+      soup_server_listen_local(m_server, 0, SOUP_SERVER_LISTEN_IPV4_ONLY, NULL);
+      g_main_context_pop_thread_default(m_context);
+
+      GSList *uris = soup_server_get_uris(m_server);
+      m_port = soup_uri_get_port(static_cast<SoupURI*>(uris->data));
+      g_slist_free_full(uris, (GDestroyNotify) soup_uri_free);
+
+      m_loop = g_main_loop_new(m_context, FALSE);
+      m_thread = g_thread_new("webdav", &DavServer::run, m_loop);
+    }
+
+  ~DavServer()
+    {
+      g_main_loop_quit(m_loop);
+      g_thread_join(m_thread);
+      g_object_unref(m_server);
+      g_main_loop_unref(m_loop);
+      g_main_context_unref(m_context);
+    }
+
+  std::string url() const
+    {
+      return "http://127.0.0.1:" + TO_STRING(m_port) + ROOT;
+    }
+  bool has(const std::string & path)
+    {
+      Glib::Threads::Mutex::Lock lock(m_lock);
+      return m_files.find(ROOT + path) != m_files.end();
+    }
+  bool has_collection(const std::string & path)
+    {
+      Glib::Threads::Mutex::Lock lock(m_lock);
+      return m_collections.count(ROOT + path) > 0;
+    }
+  void make_collection(const std::string & path)
+    {
+      Glib::Threads::Mutex::Lock lock(m_lock);
+      m_collections.insert(ROOT + path);
+    }
+  void remove(const std::string & path)
+    {
+      Glib::Threads::Mutex::Lock lock(m_lock);
+      m_files.erase(ROOT + path);
+    }
+  int not_modified_count()
+    {
+      Glib::Threads::Mutex::Lock lock(m_lock);
+      return m_not_modified_count;
+    }
+private:
+  struct File
+  {
+    std::string content;
+    int version;
+  };
+
+  static gpointer run(gpointer loop)
+    {
+      g_main_loop_run(static_cast<GMainLoop*>(loop));
+      return NULL;
+    }
+
+  static gboolean check_password(SoupAuthDomain*, SoupMessage*, const char *username,
+                                 const char *password, gpointer)
+    {
+      return std::strcmp(username, USERNAME) == 0 && std::strcmp(password, PASSWORD) == 0;
+    }
+
+  static void handler(SoupServer*, SoupMessage *msg, const char *path,
+                      GHashTable*, SoupClientContext*, gpointer data)
+    {
+      static_cast<DavServer*>(data)->handle(msg, path);
+    }
+
+  static std::string normalize(const std::string & path)
+    {
+      if(path.size() > 1 && path[path.size() - 1] == '/') {
+        return path.substr(0, path.size() - 1);
+      }
+      return path;
+    }
+
+  static std::string parent(const std::string & path)
+    {
+      return path.substr(0, path.rfind('/'));
+    }
+
+  void handle(SoupMessage *msg, const std::string & raw_path)
+    {
+      Glib::Threads::Mutex::Lock lock(m_lock);
+      std::string path = normalize(raw_path);
+      std::string method = msg->method;
+      std::map<std::string, File>::iterator file = m_files.find(path);
+
+      if(method == "GET") {
+        if(file == m_files.end()) {
+          soup_message_set_status(msg, SOUP_STATUS_NOT_FOUND);
+          return;
+        }
+        std::string etag = "\"" + TO_STRING(file->second.version) + "\"";
+        const char *if_none_match = soup_message_headers_get_one(msg->request_headers, "If-None-Match");
+        if(if_none_match && etag == if_none_match) {
+          ++m_not_modified_count;
+          soup_message_set_status(msg, SOUP_STATUS_NOT_MODIFIED);
+          return;
+        }
+        soup_message_headers_replace(msg->response_headers, "ETag", etag.c_str());
+        set_response(msg, SOUP_STATUS_OK, file->second.content);
+      }
+      else if(method == "PUT") {
+        if(!m_collections.count(parent(path))) {
+          soup_message_set_status(msg, SOUP_STATUS_CONFLICT);
+          return;
+        }
+        bool existed = file != m_files.end();
+        File & put = m_files[path];
+        put.content.assign(msg->request_body->data, msg->request_body->length);
+        put.version = ++m_version;
+        soup_message_set_status(msg, existed ? SOUP_STATUS_NO_CONTENT : SOUP_STATUS_CREATED);
+      }
+      else if(method == "DELETE") {
+        if(file != m_files.end()) {
+          m_files.erase(file);
+        }
+        else if(m_collections.erase(path)) {
+          erase_children(path);
+        }
+        else {
+          soup_message_set_status(msg, SOUP_STATUS_NOT_FOUND);
+          return;
+        }
+        soup_message_set_status(msg, SOUP_STATUS_NO_CONTENT);
+      }
+      else if(method == "MKCOL") {
+        if(file != m_files.end() || m_collections.count(path)) {
+          soup_message_set_status(msg, SOUP_STATUS_METHOD_NOT_ALLOWED);
+        }
+        else if(!m_collections.count(parent(path))) {
+          soup_message_set_status(msg, SOUP_STATUS_CONFLICT);
+        }
+        else {
+          m_collections.insert(path);
+          soup_message_set_status(msg, SOUP_STATUS_CREATED);
+        }
+      }
+      else if(method == "COPY" || method == "MOVE") {
+        copy(msg, file, method == "MOVE");
+      }
+      else if(method == "PROPFIND") {
+        propfind(msg, path);
+      }
+      else {
+        soup_message_set_status(msg, SOUP_STATUS_NOT_IMPLEMENTED);
+      }
+    }
+
+  void copy(SoupMessage *msg, std::map<std::string, File>::iterator source, bool move)
+    {
+      const char *destination = soup_message_headers_get_one(msg->request_headers, "Destination");
+      SoupURI *uri = destination ? soup_uri_new(destination) : NULL;
+      if(source == m_files.end() || !uri) {
+        soup_message_set_status(msg, uri ? SOUP_STATUS_NOT_FOUND : SOUP_STATUS_BAD_REQUEST);
+        if(uri) {
+          soup_uri_free(uri);
+        }
+        return;
+      }
+      std::string dest = normalize(soup_uri_get_path(uri));
+      soup_uri_free(uri);
+
+      const char *overwrite = soup_message_headers_get_one(msg->request_headers, "Overwrite");
+      bool exists = m_files.find(dest) != m_files.end();
+      if(exists && overwrite && std::strcmp(overwrite, "F") == 0) {
+        soup_message_set_status(msg, SOUP_STATUS_PRECONDITION_FAILED);
+        return;
+      }
+      if(!m_collections.count(parent(dest))) {
+        soup_message_set_status(msg, SOUP_STATUS_CONFLICT);
+        return;
+      }
+
+      File & copy = m_files[dest];
+      copy.content = source->second.content;
+      copy.version = ++m_version;
+      if(move) {
+        m_files.erase(source);
+      }
+      soup_message_set_status(msg, exists ? SOUP_STATUS_NO_CONTENT : SOUP_STATUS_CREATED);
+    }
+
+  void propfind(SoupMessage *msg, const std::string & path)
+    {
+      if(!m_collections.count(path)) {
+        soup_message_set_status(msg, SOUP_STATUS_NOT_FOUND);
+        return;
+      }
+
+      std::string body = "<?xml version=\"1.0\" encoding=\"utf-8\"?><D:multistatus xmlns:D=\"DAV:\">";
+      body += propfind_response(path + "/", true);
+      FOREACH(const std::string & collection, m_collections) {
+        if(parent(collection) == path) {
+          body += propfind_response(collection + "/", true);
+        }
+      }
+      for(std::map<std::string, File>::iterator iter = m_files.begin(); iter != m_files.end(); ++iter) {
+        if(parent(iter->first) == path) {
+          body += propfind_response(iter->first, false);
+        }
+      }
+      body += "</D:multistatus>";
+      set_response(msg, SOUP_STATUS_MULTI_STATUS, body);
+    }
+
+  static std::string propfind_response(const std::string & href, bool collection)
+    {
+      return "<D:response><D:href>" + href + "</D:href><D:propstat><D:prop><D:resourcetype>"
+        + (collection ? "<D:collection/>" : "")
+        + "</D:resourcetype></D:prop><D:status>HTTP/1.1 200 OK</D:status></D:propstat></D:response>";
+    }
+
+  void erase_children(const std::string & path)
+    {
+      std::string prefix = path + "/";
+      for(std::map<std::string, File>::iterator iter = m_files.begin(); iter != m_files.end();) {
+        if(iter->first.compare(0, prefix.size(), prefix) == 0) {
+          m_files.erase(iter++);
+        }
+        else {
+          ++iter;
+        }
+      }
+      for(std::set<std::string>::iterator iter = m_collections.begin(); iter != m_collections.end();) {
+        if(iter->compare(0, prefix.size(), prefix) == 0) {
+          m_collections.erase(iter++);
+        }
+        else {
+          ++iter;
+        }
+      }
+    }
+
+  static void set_response(SoupMessage *msg, guint status, const std::string & body)
+    {
+      soup_message_set_status(msg, status);
+      soup_message_set_response(msg, "text/xml", SOUP_MEMORY_COPY, body.data(), body.size());
+    }
+
+  GMainContext *m_context;
+  GMainLoop *m_loop;
+  SoupServer *m_server;
+  GThread *m_thread;
+  guint m_port;
+
+  Glib::Threads::Mutex m_lock;
+  std::map<std::string, File> m_files;
+  std::set<std::string> m_collections;
+  int m_not_modified_count;
+  int m_version;
+};
+
+
+std::string write_note(const std::string & dir, const std::string & id, const std::string & title)
+{
+  std::string file = Glib::build_filename(dir, id + ".note");
+  Glib::file_set_contents(file,
+    "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+    "<note version=\"0.3\" xmlns=\"http://beatniksoftware.com/tomboy\">"
+    "<title>" + title + "</title>"
+    "<text xml:space=\"preserve\"><note-content version=\"0.1\">" + title + "\n\nText</note-content></text>"
+    "</note>");
+  return file;
+}
+
+}
+
+
+int test_main(int /*argc*/, char ** /*argv*/)
+{
+  using gnote::sync::SyncServer;
+  using gnote::sync::WebDavSyncServer;
+
+  DavServer dav;
+
+  char notes_dir_tmpl[] = "/tmp/gnotewebdavtestXXXXXX";
+  std::string notes_dir = g_mkdtemp(notes_dir_tmpl);
+  std::list<std::string> files;
+  files.push_back(write_note(notes_dir, "note1", "Note 1"));
+  files.push_back(write_note(notes_dir, "note2", "Note 2"));
+
+  // empty server
+  SyncServer::Ptr client = WebDavSyncServer::create(dav.url(), USERNAME, PASSWORD, false);
+  BOOST_CHECK(!client->updates_available_since(-1));
+  BOOST_CHECK(client->latest_revision() == -1);
+  BOOST_CHECK(client->get_all_note_uuids().empty());
+  std::string server_id = client->id();
+  BOOST_CHECK(server_id != "");
+
+  // first sync uploads notes into revision directory
+  BOOST_CHECK(client->begin_sync_transaction());
+  BOOST_CHECK(dav.has("/lock"));
+  gnote::sync::ContentHashMap hashes;
+  hashes["note1"] = "hash1";
+  static_pointer_cast<WebDavSyncServer>(client)->upload_note_files(files, hashes);
+  BOOST_CHECK(dav.has("/0/0/note1.note"));
+  BOOST_CHECK(dav.has("/0/0/note2.note"));
+  BOOST_CHECK(client->commit_sync_transaction());
+  BOOST_CHECK(!dav.has("/lock"));
+  BOOST_CHECK(dav.has("/0/0/manifest.xml"));
+  BOOST_CHECK(dav.has("/manifest.xml"));
+
+  // another client downloads them
+  SyncServer::Ptr client2 = WebDavSyncServer::create(dav.url(), USERNAME, PASSWORD, false);
+  BOOST_CHECK(client2->latest_revision() == 0);
+  BOOST_CHECK(client2->id() == server_id);
+  BOOST_CHECK(client2->get_all_note_uuids().size() == 2);
+  gnote::sync::ContentHashMap local_hashes;
+  std::map<std::string, gnote::sync::NoteUpdate> updates = client2->get_note_updates_since(-1, local_hashes);
+  BOOST_CHECK(updates.size() == 2);
+  BOOST_CHECK(updates.find("note1") != updates.end());
+  BOOST_CHECK(updates.find("note1")->second.m_title == "Note 1");
+  BOOST_CHECK(updates.find("note1")->second.m_content_hash == "");
+  BOOST_CHECK(updates.find("note2")->second.m_latest_revision == 0);
+  BOOST_CHECK(client2->get_note_updates_since(0, local_hashes).empty());
+
+  // note with the same content hash is not downloaded
+  local_hashes["note1"] = "hash1";
+  local_hashes["note2"] = "hash2";
+  updates = client2->get_note_updates_since(-1, local_hashes);
+  BOOST_CHECK(updates.size() == 2);
+  BOOST_CHECK(updates.find("note1")->second.m_unchanged);
+  BOOST_CHECK(updates.find("note1")->second.m_xml_content == "");
+  BOOST_CHECK(updates.find("note1")->second.m_latest_revision == 0);
+  BOOST_CHECK(!updates.find("note2")->second.m_unchanged);
+  BOOST_CHECK(updates.find("note2")->second.m_title == "Note 2");
+
+  // and deletes one of them
+  BOOST_CHECK(client2->begin_sync_transaction());
+  client2->delete_notes(std::list<std::string>(1, "note2"));
+  BOOST_CHECK(client2->commit_sync_transaction());
+  BOOST_CHECK(dav.has("/0/1/manifest.xml"));
+  BOOST_CHECK(client2->latest_revision() == 1);
+  BOOST_CHECK(!dav.has("/0/0/note2.note"));
+  BOOST_CHECK(dav.has("/0/0/note1.note"));
+
+  // first client sees the change, unchanged manifest is not downloaded again
+  BOOST_CHECK(client->updates_available_since(0));
+  BOOST_CHECK(!client->updates_available_since(1));
+  BOOST_CHECK(client->get_all_note_uuids().size() == 1);
+  int not_modified = dav.not_modified_count();
+  BOOST_CHECK(client->get_all_note_uuids().size() == 1);
+  BOOST_CHECK(dav.not_modified_count() == not_modified + 1);
+
+  // updated note replaces its older revision
+  BOOST_CHECK(client2->begin_sync_transaction());
+  static_pointer_cast<WebDavSyncServer>(client2)->upload_note_files(std::list<std::string>(1, files.front()));
+  BOOST_CHECK(client2->commit_sync_transaction());
+  BOOST_CHECK(dav.has("/0/2/note1.note"));
+  BOOST_CHECK(!dav.has("/0/0/note1.note"));
+  BOOST_CHECK(client2->latest_revision() == 2);
+
+  // lock held by one client blocks others
+  SyncServer::Ptr client3 = WebDavSyncServer::create(dav.url(), USERNAME, PASSWORD, false);
+  BOOST_CHECK(client3->begin_sync_transaction());
+  BOOST_CHECK(!client->begin_sync_transaction());
+  BOOST_CHECK(client3->cancel_sync_transaction());
+  BOOST_CHECK(!dav.has("/lock"));
+
+  // revisions without manifest, left by failed syncs, are skipped and removed on commit
+  dav.remove("/manifest.xml");
+  dav.make_collection("/0/3");
+  dav.make_collection("/0/4");
+  SyncServer::Ptr client4 = WebDavSyncServer::create(dav.url(), USERNAME, PASSWORD, false);
+  BOOST_CHECK(client4->latest_revision() == 2);
+  BOOST_CHECK(dav.has_collection("/0/4"));
+  BOOST_CHECK(client4->begin_sync_transaction());
+  static_pointer_cast<WebDavSyncServer>(client4)->upload_note_files(std::list<std::string>(1, files.front()));
+  BOOST_CHECK(client4->commit_sync_transaction());
+  BOOST_CHECK(dav.has("/0/3/manifest.xml"));
+  BOOST_CHECK(dav.has("/0/3/note1.note"));
+  BOOST_CHECK(!dav.has_collection("/0/4"));
+  BOOST_CHECK(client4->latest_revision() == 3);
+
+  // wrong credentials
+  bool failed = false;
+  try {
+    WebDavSyncServer::create(dav.url(), USERNAME, "wrong", false)->latest_revision();
+  }
+  catch(const gnote::sync::GnoteSyncException &) {
+    failed = true;
+  }
+  BOOST_CHECK(failed);
+
+  FOREACH(const std::string & file, files) {
+    g_unlink(file.c_str());
+  }
+  g_rmdir(notes_dir.c_str());
+  return 0;
+}
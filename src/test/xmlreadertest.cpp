@@ -75,6 +75,20 @@ int test_main(int /*argc*/, char ** /*argv*/)
 #endif
   BOOST_CHECK(xml.read());
   BOOST_CHECK(xml.get_node_type()  == XML_READER_TYPE_TEXT);
+
+  BOOST_CHECK(xml.read());
+  BOOST_CHECK(xml.get_name() == "bold");
+  BOOST_CHECK(xml.skip());
+  BOOST_CHECK(xml.get_node_type()  == XML_READER_TYPE_TEXT);
+  while(xml.read()) {
+  }
+  BOOST_CHECK(!xml.has_error());
+
+  XmlReader broken;
+  broken.load_buffer("<sync><note></sync>");
+  while(broken.read()) {
+  }
+  BOOST_CHECK(broken.has_error());
   
   return 0;
 }
@@ -22,8 +22,8 @@
 #ifndef __TRIE_HPP_
 #define __TRIE_HPP_
 
-#include <list>
-#include <queue>
+#include <algorithm>
+#include <vector>
 
 #include <glibmm.h>
 
@@ -32,233 +32,340 @@
 
 namespace gnote {
 
+// Aho-Corasick automaton.
+// States and transitions are kept in contiguous arrays, built by
+// compute_failure_graph(). Transitions of each state are sorted by
+// character, root state additionally has a dense table for ASCII.
 template<class value_t>
 class TrieTree
 {
+public:
 
-private:
-
-  class TrieState;
-  typedef shared_ptr<TrieState> TrieStatePtr;
-  typedef std::list<TrieStatePtr> TrieStateList;
-  typedef std::queue<TrieStatePtr> TrieStateQueue;
-
-  class TrieState
+  TrieTree(bool case_sensitive)
+    : m_case_sensitive(case_sensitive)
+    , m_max_length(0)
+    , m_removed_count(0)
   {
-  public:
+    m_states.push_back(State(0));
+    std::fill(m_root_table, m_root_table + ROOT_TABLE_SIZE, int(NO_STATE));
+  }
 
-    TrieState(gunichar v, int d, const TrieStatePtr & s)
-      : m_value(v)
-      , m_depth(d)
-      , m_fail_state(s)
-      , m_transitions()
-      , m_payload()
-      , m_payload_present(false)
-    {
+  // New keywords are matched after compute_failure_graph() is called
+  void add_keyword(const Glib::ustring & keyword, const value_t & pattern_id)
+  {
+    if(m_edges.empty() && !m_transitions.empty()) {
+      restore_edges();
     }
 
-    gunichar value() const
-    {
-      return m_value;
-    }
+    int current_state = ROOT;
 
-    int depth() const
-    {
-      return m_depth;
-    }
+    for(Glib::ustring::const_iterator iter = keyword.begin(); iter != keyword.end(); ++iter) {
+      gunichar c = normalize(*iter);
 
-    TrieStatePtr fail_state()
-    {
-      return m_fail_state;
+      typename EdgeMap::iterator edge = m_edges.find(edge_key(current_state, c));
+      if(edge != m_edges.end()) {
+        current_state = edge->second;
+      }
+      else {
+        int target_state = m_states.size();
+        m_states.push_back(State(m_states[current_state].depth + 1));
+        m_edges[edge_key(current_state, c)] = target_state;
+        current_state = target_state;
+      }
     }
 
-    void fail_state(const TrieStatePtr & s)
-    {
-      m_fail_state = s;
+    State & state = m_states[current_state];
+    if(state.payload == NO_STATE) {
+      if(m_free_payloads.empty()) {
+        state.payload = m_payloads.size();
+        m_payloads.push_back(value_t());
+      }
+      else {
+        state.payload = m_free_payloads.back();
+        m_free_payloads.pop_back();
+      }
     }
+    m_payloads[state.payload] = pattern_id;
+    m_max_length = std::max(m_max_length, keyword.size());
+  }
 
-    TrieStateList & transitions()
-    {
-      return m_transitions;
-    }
+  // Stop matching keyword. States are kept, so failure graph remains valid
+  // and does not need to be recomputed.
+  bool remove_keyword(const Glib::ustring & keyword)
+  {
+    int current_state = ROOT;
 
-    value_t payload() const
-    {
-      return m_payload;
+    for(Glib::ustring::const_iterator iter = keyword.begin(); iter != keyword.end(); ++iter) {
+      current_state = next_state(current_state, normalize(*iter));
+      if(current_state == NO_STATE) {
+        return false;
+      }
     }
 
-    void payload(const value_t & p)
-    {
-      m_payload = p;
+    State & state = m_states[current_state];
+    if(state.payload == NO_STATE) {
+      return false;
     }
+    m_payloads[state.payload] = value_t();
+    m_free_payloads.push_back(state.payload);
+    state.payload = NO_STATE;
+    ++m_removed_count;
+    return true;
+  }
 
-    bool payload_present() const
-    {
-      return m_payload_present;
-    }
+  void compute_failure_graph()
+  {
+    flatten_transitions();
+
+    // Failure state is computed breadth-first, so fail state is always
+    // known for states closer to root
+    std::vector<int> state_queue;
+    state_queue.reserve(m_states.size());
+    m_states[ROOT].fail = ROOT;
+    m_states[ROOT].output = NO_STATE;
+    state_queue.push_back(ROOT);
+
+    for(std::size_t head = 0; head < state_queue.size(); ++head) {
+      int current_state = state_queue[head];
+      const State & current = m_states[current_state];
+
+      for(unsigned i = current.first_transition; i < current.first_transition + current.transition_count; ++i) {
+        const Transition & transition = m_transitions[i];
+        State & target = m_states[transition.target];
+        state_queue.push_back(transition.target);
+
+        int fail_state = ROOT;
+        if(current_state != ROOT) {
+          fail_state = current.fail;
+          int next = find_state_transition(fail_state, transition.value);
+          while(next == NO_STATE && fail_state != ROOT) {
+            fail_state = m_states[fail_state].fail;
+            next = find_state_transition(fail_state, transition.value);
+          }
+          if(next != NO_STATE) {
+            fail_state = next;
+          }
+        }
 
-    void payload_present(bool pp)
-    {
-      m_payload_present = pp;
+        // Output link points to the longest suffix, that is a keyword
+        const State & fail = m_states[fail_state];
+        target.fail = fail_state;
+        target.output = fail.payload != NO_STATE ? fail_state : fail.output;
+      }
     }
+  }
 
-  private:
-
-    gunichar m_value;
-    int m_depth;
-    TrieStatePtr m_fail_state;
-    TrieStateList m_transitions;
-    value_t m_payload;
-    bool m_payload_present;
-  };
+  // Calls visitor(start, end, payload) for every match, in order of match end.
+  // Keywords, that are part of longer ones, are reported too.
+  // Does not allocate any memory.
+  template <typename Visitor>
+  void find_matches(const Glib::ustring & haystack, Visitor & visitor) const
+  {
+    int current_state = ROOT;
 
-  const bool m_case_sensitive;
-  const TrieStatePtr m_root;
-  size_t m_max_length;
+    Glib::ustring::const_iterator haystack_iter = haystack.begin();
+    for(int i = 0; haystack_iter != haystack.end(); ++i, ++haystack_iter) {
+      gunichar c = normalize(*haystack_iter);
 
-public:
+      // While there's no matching transition, follow the fail states
+      int next = find_state_transition(current_state, c);
+      while(next == NO_STATE && current_state != ROOT) {
+        current_state = m_states[current_state].fail;
+        next = find_state_transition(current_state, c);
+      }
+      current_state = next == NO_STATE ? ROOT : next;
+
+      // Report the state itself and all keywords, that are suffixes of it.
+      // States on the output chain may have lost their keyword since
+      // failure graph was computed.
+      for(int hit_state = current_state; hit_state != NO_STATE; hit_state = m_states[hit_state].output) {
+        const State & hit = m_states[hit_state];
+        if(hit.payload != NO_STATE) {
+          visitor(i + 1 - hit.depth, i + 1, m_payloads[hit.payload]);
+        }
+      }
+    }
+  }
 
-  TrieTree(bool case_sensitive)
-    : m_case_sensitive(case_sensitive)
-    , m_root(new TrieState('\0', -1, TrieStatePtr()))
-    , m_max_length(0)
+  typename TrieHit<value_t>::ListPtr find_matches(const Glib::ustring & haystack) const
   {
+    typename TrieHit<value_t>::ListPtr matches(new typename TrieHit<value_t>::List());
+    HitCollector collector(haystack, *matches);
+    find_matches(haystack, collector);
+    return matches;
   }
 
-  void add_keyword(const Glib::ustring & keyword, const value_t & pattern_id)
+  size_t max_length() const
   {
-    TrieStatePtr current_state = m_root;
+    return m_max_length;
+  }
 
-    for (Glib::ustring::size_type i = 0; i < keyword.size(); i++) {
-      gunichar c = keyword[i];
-      if (!m_case_sensitive)
-        c = Glib::Unicode::tolower(c);
+  // Number of keywords removed, whose states are still kept
+  size_t removed_count() const
+  {
+    return m_removed_count;
+  }
 
-      TrieStatePtr target_state = find_state_transition(current_state, c);
-      if (0 == target_state) {
-        target_state = TrieStatePtr(new TrieState(c, i, m_root));
-        current_state->transitions().push_front(target_state);
-      }
+private:
 
-      current_state = target_state;
-    }
+  enum {
+    ROOT = 0,
+    NO_STATE = -1,
+    ROOT_TABLE_SIZE = 128
+  };
 
-    current_state->payload(pattern_id);
-    current_state->payload_present(true);
-    m_max_length = std::max(m_max_length, keyword.size());
-  }
+  struct State
+  {
+    explicit State(int d)
+      : depth(d)
+      , fail(ROOT)
+      , output(NO_STATE)
+      , payload(NO_STATE)
+      , first_transition(0)
+      , transition_count(0)
+    {}
+
+    int depth;
+    int fail;
+    int output;
+    int payload;
+    unsigned first_transition;
+    unsigned transition_count;
+  };
 
-  void compute_failure_graph()
+  struct Transition
   {
-    // Failure state is computed breadth-first (-> Queue)
-    TrieStateQueue state_queue;
-
-    // For each direct child of the root state
-    // * Set the fail state to the root state
-    // * Enqueue the state for failure graph computing
-    for (typename TrieStateList::iterator iter = m_root->transitions().begin();
-         m_root->transitions().end() != iter; iter++) {
-      TrieStatePtr & transition = *iter;
-      transition->fail_state(m_root);
-      state_queue.push(transition);
+    gunichar value;
+    int target;
+
+    bool operator<(const Transition & other) const
+    {
+      return value < other.value;
     }
+  };
 
-    while (false == state_queue.empty()) {
-      // Current state already has a valid fail state at this point
-      TrieStatePtr current_state = state_queue.front();
-      state_queue.pop();
-
-      for (typename TrieStateList::iterator iter
-             = current_state->transitions().begin();
-           current_state->transitions().end() != iter; iter++) {
-        TrieStatePtr & transition = *iter;
-        state_queue.push(transition);
-
-        TrieStatePtr fail_state = current_state->fail_state();
-        while ((0 != fail_state)
-               && 0 == find_state_transition(fail_state, transition->value())) {
-          fail_state = fail_state->fail_state();
-        }
+  typedef unordered_map<guint64, int> EdgeMap;
 
-        if (0 == fail_state)
-          transition->fail_state(m_root);
-        else
-          transition->fail_state(find_state_transition(fail_state, transition->value()));
-      }
+  class HitCollector
+  {
+  public:
+    HitCollector(const Glib::ustring & haystack, typename TrieHit<value_t>::List & hits)
+      : m_haystack(haystack)
+      , m_hits(hits)
+    {}
+
+    void operator()(int start, int end, const value_t & payload)
+    {
+      m_hits.push_back(typename TrieHit<value_t>::Ptr(
+        new TrieHit<value_t>(start, end, m_haystack.substr(start, end - start), payload)));
     }
+  private:
+    const Glib::ustring & m_haystack;
+    typename TrieHit<value_t>::List & m_hits;
+  };
+
+  static guint64 edge_key(int state, gunichar c)
+  {
+    return (guint64(state) << 32) | c;
   }
 
-  static TrieStatePtr find_state_transition(const TrieStatePtr & state,
-                                            gunichar value)
+  gunichar normalize(gunichar c) const
   {
-    if (true == state->transitions().empty())
-      return TrieStatePtr();
+    return m_case_sensitive ? c : Glib::Unicode::tolower(c);
+  }
 
-    for (typename TrieStateList::const_iterator iter
-           = state->transitions().begin();
-         state->transitions().end() != iter; iter++) {
-      const TrieStatePtr & transition = *iter;
-      if (transition->value() == value)
-        return transition;
+  int find_state_transition(int state, gunichar value) const
+  {
+    if(state == ROOT && value < gunichar(ROOT_TABLE_SIZE)) {
+      return m_root_table[value];
+    }
 
+    const State & s = m_states[state];
+    Transition key;
+    key.value = value;
+    typename std::vector<Transition>::const_iterator begin = m_transitions.begin() + s.first_transition;
+    typename std::vector<Transition>::const_iterator end = begin + s.transition_count;
+    typename std::vector<Transition>::const_iterator iter = std::lower_bound(begin, end, key);
+    if(iter != end && iter->value == value) {
+      return iter->target;
     }
+    return NO_STATE;
+  }
 
-    return TrieStatePtr();
+  int next_state(int state, gunichar value) const
+  {
+    if(m_edges.empty()) {
+      return find_state_transition(state, value);
+    }
+    typename EdgeMap::const_iterator edge = m_edges.find(edge_key(state, value));
+    return edge == m_edges.end() ? int(NO_STATE) : edge->second;
   }
 
-  typename TrieHit<value_t>::ListPtr find_matches (const Glib::ustring & haystack)
+  // Transitions are only kept in a map while keywords are added
+  void restore_edges()
   {
-    TrieStatePtr current_state = m_root;
-    typename TrieHit<value_t>::ListPtr matches(
-      new typename TrieHit<value_t>::List());
-    int start_index = 0;
+    for(int state = 0; state < int(m_states.size()); ++state) {
+      const State & s = m_states[state];
+      for(unsigned i = s.first_transition; i < s.first_transition + s.transition_count; ++i) {
+        m_edges[edge_key(state, m_transitions[i].value)] = m_transitions[i].target;
+      }
+    }
+  }
 
-    Glib::ustring::const_iterator haystack_iter = haystack.begin();
-    for (Glib::ustring::size_type i = 0; haystack_iter != haystack.end(); ++i, ++haystack_iter ) {
-      gunichar c = *haystack_iter;
-      if (!m_case_sensitive)
-        c = Glib::Unicode::tolower(c);
+  // Lay out transitions of every state next to each other, sorted by character
+  void flatten_transitions()
+  {
+    if(m_edges.empty()) {
+      // Nothing added since last time
+      return;
+    }
+    for(typename std::vector<State>::iterator iter = m_states.begin(); iter != m_states.end(); ++iter) {
+      iter->transition_count = 0;
+    }
+    for(typename EdgeMap::const_iterator iter = m_edges.begin(); iter != m_edges.end(); ++iter) {
+      ++m_states[iter->first >> 32].transition_count;
+    }
 
-      if (current_state == m_root)
-        start_index = i;
+    unsigned offset = 0;
+    for(typename std::vector<State>::iterator iter = m_states.begin(); iter != m_states.end(); ++iter) {
+      iter->first_transition = offset;
+      offset += iter->transition_count;
+      iter->transition_count = 0;
+    }
 
-      // While there's no matching transition, follow the fail states
-      // Because we're potentially changing the depths (aka length of
-      // matched characters) in the tree we're updating the start_index
-      // accordingly
-      while ((current_state != m_root)
-             && 0 == find_state_transition(current_state, c)) {
-        TrieStatePtr old_state = current_state;
-        current_state = current_state->fail_state();
-        start_index += old_state->depth() - current_state->depth();
-      }
+    m_transitions.resize(m_edges.size());
+    for(typename EdgeMap::const_iterator iter = m_edges.begin(); iter != m_edges.end(); ++iter) {
+      State & state = m_states[iter->first >> 32];
+      Transition & transition = m_transitions[state.first_transition + state.transition_count++];
+      transition.value = iter->first & G_GUINT64_CONSTANT(0xFFFFFFFF);
+      transition.target = iter->second;
+    }
 
-      current_state = find_state_transition (current_state, c);
-      if (0 == current_state)
-        current_state = m_root;
-
-      // If the state contains a payload: We've got a hit
-      // Return a TrieHit with the start and end index, the matched
-      // string and the payload object
-      if (current_state->payload_present()) {
-        int hit_length = i - start_index + 1;
-        typename TrieHit<value_t>::Ptr hit(
-          new TrieHit<value_t>(start_index,
-                               start_index + hit_length,
-                               haystack.substr(start_index, hit_length),
-                               current_state->payload()));
-        matches->push_back(hit);
+    std::fill(m_root_table, m_root_table + ROOT_TABLE_SIZE, int(NO_STATE));
+    for(typename std::vector<State>::iterator iter = m_states.begin(); iter != m_states.end(); ++iter) {
+      typename std::vector<Transition>::iterator begin = m_transitions.begin() + iter->first_transition;
+      std::sort(begin, begin + iter->transition_count);
+    }
+    const State & root = m_states[ROOT];
+    for(unsigned i = root.first_transition; i < root.first_transition + root.transition_count; ++i) {
+      if(m_transitions[i].value < gunichar(ROOT_TABLE_SIZE)) {
+        m_root_table[m_transitions[i].value] = m_transitions[i].target;
       }
     }
-
-    return matches;
-  }
-
-  size_t max_length() const
-  {
-    return m_max_length;
+    EdgeMap().swap(m_edges);
   }
 
+  const bool m_case_sensitive;
+  size_t m_max_length;
+  size_t m_removed_count;
+  std::vector<State> m_states;
+  std::vector<Transition> m_transitions;
+  std::vector<value_t> m_payloads;
+  // Slots in m_payloads of removed keywords, reused by add_keyword()
+  std::vector<int> m_free_payloads;
+  int m_root_table[ROOT_TABLE_SIZE];
+  // Transitions as they are added, flattened and dropped by compute_failure_graph()
+  EdgeMap m_edges;
 };
 
 }
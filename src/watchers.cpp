@@ -40,7 +40,6 @@
 #include "notewindow.hpp"
 #include "preferences.hpp"
 #include "itagmanager.hpp"
-#include "triehit.hpp"
 #include "watchers.hpp"
 
 namespace gnote {
@@ -836,40 +835,32 @@ namespace gnote {
   }
 
   
-  void NoteLinkWatcher::do_highlight(const TrieHit<NoteBase::WeakPtr> & hit,
+  void NoteLinkWatcher::do_highlight(int hit_start, int hit_end, const NoteBase::WeakPtr & hit_note_ref,
                                      const Gtk::TextIter & start,
                                      const Gtk::TextIter &)
   {
     // Some of these checks should be replaced with fixes to
     // TitleTrie.FindMatches, probably.
-    if (hit.value().expired()) {
-      DBG_OUT("DoHighlight: null pointer error for '%s'." , hit.key().c_str());
+    NoteBase::Ptr hit_note = hit_note_ref.lock();
+    if (!hit_note) {
+      DBG_OUT("DoHighlight: null pointer error at %d-%d." , hit_start, hit_end);
       return;
     }
-      
-    if (!manager().find(hit.key())) {
-      DBG_OUT ("DoHighlight: '%s' links to non-existing note." ,
-               hit.key().c_str());
+
+    if (hit_note == get_note())
       return;
-    }
-      
-    NoteBase::Ptr hit_note(hit.value());
 
-    if (hit.key().lowercase() != hit_note->get_title().lowercase()) { // == 0 if same string
-      DBG_OUT ("DoHighlight: '%s' links wrongly to note '%s'." ,
-               hit.key().c_str(),
+    if (!manager().find_by_uri(hit_note->uri())) {
+      DBG_OUT ("DoHighlight: '%s' links to non-existing note." ,
                hit_note->get_title().c_str());
       return;
     }
-      
-    if (hit_note == get_note())
-      return;
 
     Gtk::TextIter title_start = start;
-    title_start.forward_chars (hit.start());
+    title_start.forward_chars (hit_start);
 
     Gtk::TextIter title_end = start;
-    title_end.forward_chars (hit.end());
+    title_end.forward_chars (hit_end);
 
     // Only link against whole words/phrases
     if ((!title_start.starts_word () && !title_start.starts_sentence ()) ||
@@ -877,13 +868,22 @@ namespace gnote {
       return;
     }
 
+    // Text is only taken for hits, that passed the cheaper checks
+    Glib::ustring hit_text = title_start.get_slice(title_end);
+    if (hit_text.lowercase() != hit_note->get_title().lowercase()) { // == 0 if same string
+      DBG_OUT ("DoHighlight: '%s' links wrongly to note '%s'." ,
+               hit_text.c_str(),
+               hit_note->get_title().c_str());
+      return;
+    }
+
     // Don't create links inside URLs
     if(get_note()->get_tag_table()->has_link_tag(title_start)) {
       return;
     }
 
     DBG_OUT ("Matching Note title '%s' at %d-%d...",
-             hit.key().c_str(), hit.start(), hit.end());
+             hit_text.c_str(), hit_start, hit_end);
 
     get_note()->get_tag_table()->foreach(
       boost::bind(sigc::mem_fun(*this, &NoteLinkWatcher::remove_link_tag),
@@ -913,9 +913,7 @@ namespace gnote {
       if (idx < 0)
         break;
 
-      TrieHit<NoteBase::WeakPtr> hit(idx, idx + find_title_lower.length(),
-                             find_title_lower, find_note);
-      do_highlight (hit, start, end);
+      do_highlight (idx, idx + find_title_lower.length(), find_note, start, end);
 
       idx += find_title_lower.length();
     }
@@ -923,14 +921,33 @@ namespace gnote {
   }
 
 
+  // Highlights title matches as they are found, without collecting them first
+  class NoteLinkWatcher::TitleHitHighlighter
+  {
+  public:
+    TitleHitHighlighter(NoteLinkWatcher & watcher, const Gtk::TextIter & start, const Gtk::TextIter & end)
+      : m_watcher(watcher)
+      , m_start(start)
+      , m_end(end)
+      {}
+
+    void operator()(int hit_start, int hit_end, const NoteBase::WeakPtr & note)
+      {
+        m_watcher.do_highlight(hit_start, hit_end, note, m_start, m_end);
+      }
+  private:
+    NoteLinkWatcher & m_watcher;
+    const Gtk::TextIter & m_start;
+    const Gtk::TextIter & m_end;
+  };
+
+
   void NoteLinkWatcher::highlight_in_block(const Gtk::TextIter & start,
                                            const Gtk::TextIter & end)
   {
-    TrieHit<NoteBase::WeakPtr>::ListPtr hits = manager().find_trie_matches (start.get_slice (end));
-    for(TrieHit<NoteBase::WeakPtr>::List::const_iterator iter = hits->begin();
-        iter != hits->end(); ++iter) {
-      do_highlight (**iter, start, end);
-    }
+    Glib::ustring text = start.get_slice(end);
+    TitleHitHighlighter highlighter(*this, start, end);
+    manager().title_trie().find_matches(text, highlighter);
   }
 
   void NoteLinkWatcher::unhighlight_in_block(const Gtk::TextIter & start,
@@ -1304,8 +1321,6 @@ namespace gnote {
     m_on_tag_removing_cid = get_note()->signal_tag_removing.connect(
       sigc::mem_fun(*this, &NoteTagsWatcher::on_tag_removing));
 #endif
-    m_on_tag_removed_cid = get_note()->signal_tag_removed.connect(
-      sigc::mem_fun(*this, &NoteTagsWatcher::on_tag_removed));      
   }
 
 
@@ -1313,7 +1328,6 @@ namespace gnote {
   {
     m_on_tag_added_cid.disconnect();
     m_on_tag_removing_cid.disconnect();
-    m_on_tag_removed_cid.disconnect();
   }
 
 
@@ -1340,14 +1354,5 @@ namespace gnote {
 #endif
 
 
-  void NoteTagsWatcher::on_tag_removed(const NoteBase::Ptr&, const std::string& tag_name)
-  {
-    Tag::Ptr tag = ITagManager::obj().get_tag(tag_name);
-    DBG_OUT ("Watchers.OnTagRemoved popularity count: %d", tag ? tag->popularity() : 0);
-    if (tag && tag->popularity() == 0) {
-      ITagManager::obj().remove_tag(tag);
-    }
-  }
-
 }
 
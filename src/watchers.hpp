@@ -40,7 +40,6 @@ extern "C" {
 
 #include "base/macros.hpp"
 #include "noteaddin.hpp"
-#include "triehit.hpp"
 #include "utils.hpp"
 
 namespace gnote {
@@ -182,11 +181,14 @@ namespace gnote {
     virtual void on_note_opened() override;
 
   private:
+    class TitleHitHighlighter;
+
     bool contains_text(const Glib::ustring & text);
     void on_note_added(const NoteBase::Ptr &);
     void on_note_deleted(const NoteBase::Ptr &);
     void on_note_renamed(const NoteBase::Ptr&, const Glib::ustring&);
-    void do_highlight(const TrieHit<NoteBase::WeakPtr> & , const Gtk::TextIter &,const Gtk::TextIter &);
+    void do_highlight(int hit_start, int hit_end, const NoteBase::WeakPtr & hit_note,
+                      const Gtk::TextIter &,const Gtk::TextIter &);
     void highlight_note_in_block (const NoteBase::Ptr &, const Gtk::TextIter &,
                                   const Gtk::TextIter &);
     void highlight_in_block(const Gtk::TextIter &,const Gtk::TextIter &);
@@ -278,11 +280,9 @@ namespace gnote {
   private:
     void on_tag_added(const NoteBase&, const Tag::Ptr&);
     void on_tag_removing(const NoteBase&, const Tag &);
-    void on_tag_removed(const NoteBase::Ptr&, const std::string&);
 
     sigc::connection m_on_tag_added_cid;
     sigc::connection m_on_tag_removing_cid;
-    sigc::connection m_on_tag_removed_cid;
   };
 
 }